@@ -45,6 +45,10 @@ constexpr char kSavedModelVariablesDirectory[] = "variables";
 /// SavedModel variables filename.
 constexpr char kSavedModelVariablesFilename[] = "variables";
 
+/// Filename of the memmapped package holding the SavedModel variables, in the
+/// variables directory.
+constexpr char kSavedModelMemmappedVariablesFilename[] = "variables.mmap";
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CC_SAVED_MODEL_CONSTANTS_H_
@@ -18,6 +18,9 @@ limitations under the License.
 #include <unordered_set>
 
 #include "tensorflow/cc/saved_model/constants.h"
+#if !defined(IS_MOBILE_PLATFORM)
+#include "tensorflow/cc/saved_model/memmapped_variables.h"
+#endif  // IS_MOBILE_PLATFORM
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -230,10 +233,58 @@ Status GetAssetFileDefs(const MetaGraphDef& meta_graph_def,
   return Status::OK();
 }
 
+#if !defined(IS_MOBILE_PLATFORM)
+// Maps the memmapped variables package of the SavedModel in `export_dir`,
+// rewrites the graph of `bundle` to read the variables from it, and points
+// `session_options` at the package.
+Status UseMemmappedVariables(const string& export_dir,
+                             SessionOptions* session_options,
+                             SavedModelBundle* const bundle) {
+  const string package_path =
+      io::JoinPath(export_dir, kSavedModelVariablesDirectory,
+                   kSavedModelMemmappedVariablesFilename);
+  if (!Env::Default()->FileExists(package_path).ok()) {
+    return errors::NotFound(
+        "Could not find memmapped variables package at: ", package_path,
+        ". It can be written with WriteMemmappedSavedModelVariables().");
+  }
+  // Constant folding would copy the memmapped tensors into the graph. Only
+  // the options that imply it are changed.
+  OptimizerOptions* optimizer_options =
+      session_options->config.mutable_graph_options()
+          ->mutable_optimizer_options();
+  if (optimizer_options->opt_level() == OptimizerOptions::L0 &&
+      optimizer_options->do_constant_folding()) {
+    return errors::InvalidArgument(
+        "Memmapped variables cannot be loaded with do_constant_folding, which "
+        "would copy them into the graph");
+  }
+  if (optimizer_options->opt_level() != OptimizerOptions::L0) {
+    // L0 with common subexpression elimination is L1 without constant
+    // folding.
+    optimizer_options->set_opt_level(OptimizerOptions::L0);
+    optimizer_options->set_do_common_subexpression_elimination(true);
+    optimizer_options->set_do_constant_folding(false);
+  }
+
+  bundle->memmapped_env.reset(new MemmappedEnv(Env::Default()));
+  TF_RETURN_IF_ERROR(bundle->memmapped_env->InitializeFromFile(package_path));
+  int num_rewritten;
+  TF_RETURN_IF_ERROR(RewriteVariableRestoresToImmutableConst(
+      bundle->memmapped_env.get(), bundle->meta_graph_def.mutable_graph_def(),
+      &num_rewritten));
+  LOG(INFO) << "Reading " << num_rewritten << " variables from memmapped "
+            << "package: " << package_path;
+  session_options->env = bundle->memmapped_env.get();
+  return Status::OK();
+}
+#endif  // IS_MOBILE_PLATFORM
+
 Status LoadSavedModelInternal(const SessionOptions& session_options,
                               const RunOptions& run_options,
                               const string& export_dir,
                               const std::unordered_set<string>& tags,
+                              bool memmapped_variables,
                               SavedModelBundle* const bundle) {
   if (!MaybeSavedModelDirectory(export_dir)) {
     return Status(error::Code::NOT_FOUND,
@@ -248,8 +299,17 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
   TF_RETURN_IF_ERROR(
       FindMetaGraphDefToLoad(saved_model_proto, tags, &bundle->meta_graph_def));
 
-  TF_RETURN_IF_ERROR(LoadMetaGraphIntoSession(
-      bundle->meta_graph_def, session_options, &bundle->session));
+  SessionOptions options = session_options;
+  if (memmapped_variables) {
+#if !defined(IS_MOBILE_PLATFORM)
+    TF_RETURN_IF_ERROR(UseMemmappedVariables(export_dir, &options, bundle));
+#else
+    return errors::Unimplemented(
+        "Memmapped variables are not supported on mobile platforms");
+#endif  // IS_MOBILE_PLATFORM
+  }
+  TF_RETURN_IF_ERROR(LoadMetaGraphIntoSession(bundle->meta_graph_def, options,
+                                              &bundle->session));
 
   std::vector<AssetFileDef> asset_file_defs;
   TF_RETURN_IF_ERROR(
@@ -271,16 +331,17 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
   return Status::OK();
 }
 
-}  // namespace
-
-Status LoadSavedModel(const SessionOptions& session_options,
-                      const RunOptions& run_options, const string& export_dir,
-                      const std::unordered_set<string>& tags,
-                      SavedModelBundle* const bundle) {
+Status LoadSavedModelAndRecordMetrics(const SessionOptions& session_options,
+                                      const RunOptions& run_options,
+                                      const string& export_dir,
+                                      const std::unordered_set<string>& tags,
+                                      bool memmapped_variables,
+                                      SavedModelBundle* const bundle) {
   // TODO(robson): Add tests for the counters.
   const uint64 start_microseconds = Env::Default()->NowMicros();
-  const Status status = LoadSavedModelInternal(session_options, run_options,
-                                               export_dir, tags, bundle);
+  const Status status =
+      LoadSavedModelInternal(session_options, run_options, export_dir, tags,
+                             memmapped_variables, bundle);
   const uint64 load_latency_microsecs = [&]() -> uint64 {
     const uint64 end_microseconds = Env::Default()->NowMicros();
     // Avoid clock skew.
@@ -302,6 +363,28 @@ Status LoadSavedModel(const SessionOptions& session_options,
   return status;
 }
 
+}  // namespace
+
+Status LoadSavedModel(const SessionOptions& session_options,
+                      const RunOptions& run_options, const string& export_dir,
+                      const std::unordered_set<string>& tags,
+                      SavedModelBundle* const bundle) {
+  return LoadSavedModelAndRecordMetrics(session_options, run_options,
+                                        export_dir, tags,
+                                        /*memmapped_variables=*/false, bundle);
+}
+
+#if !defined(IS_MOBILE_PLATFORM)
+Status LoadSavedModelWithMemmappedVariables(
+    const SessionOptions& session_options, const RunOptions& run_options,
+    const string& export_dir, const std::unordered_set<string>& tags,
+    SavedModelBundle* const bundle) {
+  return LoadSavedModelAndRecordMetrics(session_options, run_options,
+                                        export_dir, tags,
+                                        /*memmapped_variables=*/true, bundle);
+}
+#endif  // IS_MOBILE_PLATFORM
+
 bool MaybeSavedModelDirectory(const string& export_dir) {
   const string saved_model_pb_path =
       io::JoinPath(export_dir, kSavedModelFilenamePb);
@@ -22,13 +22,23 @@ limitations under the License.
 #include <unordered_set>
 
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/platform.h"
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/public/session.h"
+#if !defined(IS_MOBILE_PLATFORM)
+#include "tensorflow/core/util/memmapped_file_system.h"
+#endif  // IS_MOBILE_PLATFORM
 
 namespace tensorflow {
 
 /// SavedModel representation once the SavedModel is loaded from storage.
 struct SavedModelBundle {
+#if !defined(IS_MOBILE_PLATFORM)
+  /// Serves the memmapped variables of a bundle loaded with
+  /// LoadSavedModelWithMemmappedVariables(). Declared first so that it
+  /// outlives the session.
+  std::unique_ptr<MemmappedEnv> memmapped_env;
+#endif  // IS_MOBILE_PLATFORM
   std::unique_ptr<Session> session;
   MetaGraphDef meta_graph_def;
 
@@ -52,6 +62,26 @@ Status LoadSavedModel(const SessionOptions& session_options,
                       const std::unordered_set<string>& tags,
                       SavedModelBundle* const bundle);
 
+/// Like LoadSavedModel(), but for inference only: the variables written into
+/// a memmapped package by WriteMemmappedSavedModelVariables() are not
+/// restored, but become read-only tensors mapped from the package. Loading
+/// large models thus mostly costs the time to map the package, and processes
+/// serving the same model share its pages. Returns NotFound if the SavedModel
+/// has no memmapped package.
+///
+/// Constant folding would copy the mapped tensors into the graph, so the
+/// session is created with `do_constant_folding` off. An `opt_level` of L1,
+/// which implies constant folding, is lowered to L0 with common subexpression
+/// elimination, the other optimization of L1. Returns InvalidArgument if
+/// `session_options` explicitly enables `do_constant_folding` at L0. Not
+/// available on mobile platforms.
+#if !defined(IS_MOBILE_PLATFORM)
+Status LoadSavedModelWithMemmappedVariables(
+    const SessionOptions& session_options, const RunOptions& run_options,
+    const string& export_dir, const std::unordered_set<string>& tags,
+    SavedModelBundle* const bundle);
+#endif  // IS_MOBILE_PLATFORM
+
 /// Checks whether the provided directory could contain a SavedModel. Note that
 /// the method does not load any data by itself. If the method returns `false`,
 /// the export directory definitely does not contain a SavedModel. If the method
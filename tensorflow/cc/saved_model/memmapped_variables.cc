@@ -0,0 +1,375 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/saved_model/memmapped_variables.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/cc/saved_model/constants.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/kernels/immutable_constant_op.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
+#include "tensorflow/core/util/memmapped_file_system_writer.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace {
+
+// A variable that is restored from a checkpoint tensor available in the
+// memmapped package.
+struct MemmappedVariable {
+  string region_name;
+  // The restore ops assigning to the variable.
+  std::vector<const NodeDef*> restores;
+};
+
+// Reads the string vector held by the Const node `node_name`.
+Status GetConstStrings(
+    const std::unordered_map<string, NodeDef*>& nodes_by_name,
+    const string& node_name, std::vector<string>* strings) {
+  const auto it =
+      nodes_by_name.find(ParseTensorName(node_name).first.ToString());
+  if (it == nodes_by_name.end() || it->second->op() != "Const") {
+    return errors::Unimplemented("Input ", node_name,
+                                 " of RestoreV2 is not a Const node.");
+  }
+  const AttrValue* value = AttrSlice(*it->second).Find("value");
+  Tensor tensor;
+  if (value == nullptr || !tensor.FromProto(value->tensor()) ||
+      tensor.dtype() != DT_STRING) {
+    return errors::InvalidArgument("Const node ", node_name,
+                                   " does not hold a string tensor.");
+  }
+  const auto flat = tensor.flat<string>();
+  strings->assign(flat.data(), flat.data() + flat.size());
+  return Status::OK();
+}
+
+// Overwrites the value of the Const node `node` with `strings`.
+void SetConstStrings(const std::vector<string>& strings, NodeDef* node) {
+  Tensor tensor(DT_STRING, TensorShape({static_cast<int64>(strings.size())}));
+  for (size_t i = 0; i < strings.size(); ++i) {
+    tensor.flat<string>()(i) = strings[i];
+  }
+  AttrValue value;
+  tensor.AsProtoTensorContent(value.mutable_tensor());
+  (*node->mutable_attr())["value"] = value;
+}
+
+// Turns the variable `node` into an ImmutableConst reading `region_name`.
+void ConvertVariableToImmutableConst(const string& region_name,
+                                     NodeDef* node) {
+  const AttrValue dtype = node->attr().at("dtype");
+  const AttrValue shape = node->attr().at("shape");
+  node->set_op("ImmutableConst");
+  node->clear_input();
+  // ImmutableConst only has a CPU kernel.
+  DeviceNameUtils::ParsedName device;
+  if (DeviceNameUtils::ParseFullName(node->device(), &device) &&
+      device.has_type && device.type != DEVICE_CPU) {
+    node->clear_device();
+  }
+  // Keep only the attributes that ImmutableConst understands, and the
+  // colocation constraints of the variable.
+  auto* mutable_attr = node->mutable_attr();
+  for (auto it = mutable_attr->begin(); it != mutable_attr->end();) {
+    if (str_util::StartsWith(it->first, "_")) {
+      ++it;
+    } else {
+      it = mutable_attr->erase(it);
+    }
+  }
+  mutable_attr->insert({ImmutableConstantOp::kDTypeAttr, dtype});
+  mutable_attr->insert({ImmutableConstantOp::kShapeAttr, shape});
+  AttrValue region_name_attr;
+  region_name_attr.set_s(region_name);
+  mutable_attr->insert(
+      {ImmutableConstantOp::kMemoryRegionNameAttr, region_name_attr});
+}
+
+}  // namespace
+
+string MemmappedVariableRegionName(StringPiece checkpoint_key) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  string region_name = MemmappedFileSystem::kMemmappedPackagePrefix;
+  for (char c : checkpoint_key) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+        (c >= '0' && c <= '9') || c == '_') {
+      region_name += c;
+    } else {
+      // '.' is a valid region character, so use it as the escape.
+      region_name += '.';
+      region_name += kHexDigits[static_cast<uint8>(c) >> 4];
+      region_name += kHexDigits[static_cast<uint8>(c) & 0xf];
+    }
+  }
+  return region_name;
+}
+
+Status WriteMemmappedSavedModelVariables(const string& export_dir,
+                                         int* num_written) {
+  if (num_written != nullptr) {
+    *num_written = 0;
+  }
+  const string variables_directory =
+      io::JoinPath(export_dir, kSavedModelVariablesDirectory);
+  BundleReader reader(
+      Env::Default(),
+      io::JoinPath(variables_directory, kSavedModelVariablesFilename));
+  TF_RETURN_IF_ERROR(reader.status());
+
+  // Lookups move the iterator, so collect the keys first.  Keys of the
+  // individual slices of partitioned tensors start with a 0 byte.
+  std::vector<string> keys;
+  for (reader.Seek(kHeaderEntryKey); reader.Valid(); reader.Next()) {
+    const StringPiece key = reader.key();
+    if (!key.empty() && key[0] != '\0') {
+      keys.push_back(key.ToString());
+    }
+  }
+
+  MemmappedFileSystemWriter writer;
+  TF_RETURN_IF_ERROR(writer.InitializeToFile(
+      Env::Default(), io::JoinPath(variables_directory,
+                                   kSavedModelMemmappedVariablesFilename)));
+  for (const string& key : keys) {
+    std::vector<TensorSlice> slices;
+    TF_RETURN_IF_ERROR(reader.LookupTensorSlices(key, &slices));
+    DataType dtype;
+    TensorShape shape;
+    TF_RETURN_IF_ERROR(reader.LookupDtypeAndShape(key, &dtype, &shape));
+    if (!slices.empty() || !DataTypeCanUseMemcpy(dtype)) {
+      continue;
+    }
+    Tensor tensor(dtype, shape);
+    TF_RETURN_IF_ERROR(reader.Lookup(key, &tensor));
+    TF_RETURN_IF_ERROR(
+        writer.SaveTensor(tensor, MemmappedVariableRegionName(key)));
+    if (num_written != nullptr) {
+      ++*num_written;
+    }
+  }
+  return writer.FlushAndClose();
+}
+
+Status RewriteVariableRestoresToImmutableConst(Env* memmapped_env,
+                                               GraphDef* graph_def,
+                                               int* num_rewritten) {
+  if (num_rewritten != nullptr) {
+    *num_rewritten = 0;
+  }
+  std::unordered_map<string, NodeDef*> nodes_by_name;
+  for (NodeDef& node : *graph_def->mutable_node()) {
+    nodes_by_name[node.name()] = &node;
+  }
+  auto find_node = [&nodes_by_name](const TensorId& id) -> NodeDef* {
+    const auto it = nodes_by_name.find(id.first.ToString());
+    return it == nodes_by_name.end() ? nullptr : it->second;
+  };
+
+  // Find the variables assigned from a RestoreV2 output that is available in
+  // the package, together with the outputs of each RestoreV2 they use.
+  std::unordered_map<string, MemmappedVariable> variables;
+  std::unordered_map<string, std::unordered_set<int>> memmapped_outputs;
+  std::unordered_map<string, std::vector<string>> tensor_names;
+  std::unordered_map<string, std::vector<string>> shape_and_slices;
+  for (const NodeDef& node : graph_def->node()) {
+    if (node.op() != "Assign" || node.input_size() != 2) continue;
+    const NodeDef* variable = find_node(ParseTensorName(node.input(0)));
+    const TensorId restored = ParseTensorName(node.input(1));
+    const NodeDef* restore = find_node(restored);
+    if (variable == nullptr || restore == nullptr ||
+        (variable->op() != "VariableV2" && variable->op() != "Variable") ||
+        restore->op() != "RestoreV2" || restore->input_size() < 3) {
+      continue;
+    }
+    const AttrValue* shape = AttrSlice(*variable).Find("shape");
+    if (shape == nullptr ||
+        !PartialTensorShape(shape->shape()).IsFullyDefined()) {
+      continue;
+    }
+    if (tensor_names.count(restore->name()) == 0) {
+      TF_RETURN_IF_ERROR(GetConstStrings(nodes_by_name, restore->input(1),
+                                         &tensor_names[restore->name()]));
+      TF_RETURN_IF_ERROR(GetConstStrings(nodes_by_name, restore->input(2),
+                                         &shape_and_slices[restore->name()]));
+    }
+    const std::vector<string>& names = tensor_names[restore->name()];
+    const std::vector<string>& slices = shape_and_slices[restore->name()];
+    const int index = restored.second;
+    if (index < 0 || index >= static_cast<int>(names.size()) ||
+        index >= static_cast<int>(slices.size()) || !slices[index].empty()) {
+      continue;
+    }
+    const string region_name = MemmappedVariableRegionName(names[index]);
+    if (!memmapped_env->FileExists(region_name).ok()) continue;
+
+    MemmappedVariable& memmapped = variables[variable->name()];
+    if (!memmapped.region_name.empty() &&
+        memmapped.region_name != region_name) {
+      return errors::InvalidArgument("Variable ", variable->name(),
+                                     " is restored from several tensors.");
+    }
+    memmapped.region_name = region_name;
+    memmapped.restores.push_back(&node);
+    memmapped_outputs[restore->name()].insert(index);
+  }
+  if (variables.empty()) {
+    return Status::OK();
+  }
+
+  // The restores of the memmapped variables go away, and so do the RestoreV2
+  // outputs they used.  A RestoreV2 that still restores other variables is
+  // shrunk, and the references to its outputs are renumbered.
+  std::unordered_set<string> removed;
+  for (const auto& variable : variables) {
+    for (const NodeDef* restore : variable.second.restores) {
+      removed.insert(restore->name());
+    }
+  }
+  std::unordered_map<string, std::unordered_map<int, int>> renumbered_outputs;
+  for (const auto& outputs : memmapped_outputs) {
+    NodeDef* restore = nodes_by_name[outputs.first];
+    const std::vector<string>& names = tensor_names[outputs.first];
+    if (outputs.second.size() == names.size()) {
+      removed.insert(restore->name());
+      continue;
+    }
+    const std::vector<string>& slices = shape_and_slices[outputs.first];
+    const auto& dtypes = restore->attr().at("dtypes").list().type();
+    std::vector<string> kept_names;
+    std::vector<string> kept_slices;
+    AttrValue kept_dtypes;
+    std::unordered_map<int, int>& renumbered =
+        renumbered_outputs[outputs.first];
+    for (int i = 0; i < static_cast<int>(names.size()); ++i) {
+      if (outputs.second.count(i) > 0) continue;
+      renumbered[i] = kept_names.size();
+      kept_names.push_back(names[i]);
+      kept_slices.push_back(slices[i]);
+      kept_dtypes.mutable_list()->add_type(static_cast<DataType>(dtypes[i]));
+    }
+    SetConstStrings(kept_names,
+                    find_node(ParseTensorName(restore->input(1))));
+    SetConstStrings(kept_slices,
+                    find_node(ParseTensorName(restore->input(2))));
+    (*restore->mutable_attr())["dtypes"] = kept_dtypes;
+  }
+
+  // Once read-only, the variables can no longer feed ref inputs, so the nodes
+  // writing to them (initializers, optimizer updates) are removed too, along
+  // with everything that consumes their outputs.  Control dependencies on
+  // removed nodes are dropped.
+  FunctionLibraryDefinition flib(OpRegistry::Global(), graph_def->library());
+  for (NodeDef& node : *graph_def->mutable_node()) {
+    if (removed.count(node.name()) > 0) continue;
+    bool reads_variable = false;
+    for (const string& input : node.input()) {
+      const TensorId id = ParseTensorName(input);
+      if (id.second >= 0 && variables.count(id.first.ToString()) > 0) {
+        reads_variable = true;
+        break;
+      }
+    }
+    if (!reads_variable) continue;
+    const OpDef* op_def;
+    TF_RETURN_IF_ERROR(flib.LookUpOpDef(node.op(), &op_def));
+    DataTypeVector input_types;
+    DataTypeVector output_types;
+    TF_RETURN_IF_ERROR(
+        InOutTypesForNode(node, *op_def, &input_types, &output_types));
+    for (int i = 0; i < node.input_size() &&
+                    i < static_cast<int>(input_types.size());
+         ++i) {
+      const TensorId id = ParseTensorName(node.input(i));
+      if (id.second >= 0 && variables.count(id.first.ToString()) > 0 &&
+          IsRefType(input_types[i])) {
+        removed.insert(node.name());
+        break;
+      }
+    }
+  }
+  auto is_removed_output = [&removed,
+                            &renumbered_outputs](const TensorId& id) {
+    const string source = id.first.ToString();
+    if (removed.count(source) > 0) return true;
+    const auto renumbered = renumbered_outputs.find(source);
+    return renumbered != renumbered_outputs.end() &&
+           renumbered->second.count(id.second) == 0;
+  };
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const NodeDef& node : graph_def->node()) {
+      if (removed.count(node.name()) > 0) continue;
+      for (const string& input : node.input()) {
+        const TensorId id = ParseTensorName(input);
+        if (id.second >= 0 && is_removed_output(id)) {
+          removed.insert(node.name());
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  for (const auto& variable : variables) {
+    ConvertVariableToImmutableConst(variable.second.region_name,
+                                    nodes_by_name[variable.first]);
+  }
+
+  GraphDef rewritten;
+  for (NodeDef& node : *graph_def->mutable_node()) {
+    if (removed.count(node.name()) > 0) continue;
+    NodeDef* kept = rewritten.add_node();
+    kept->Swap(&node);
+    const std::vector<string> inputs(kept->input().begin(),
+                                     kept->input().end());
+    kept->clear_input();
+    for (const string& input : inputs) {
+      const TensorId id = ParseTensorName(input);
+      const string source = id.first.ToString();
+      if (removed.count(source) > 0) continue;
+      const auto renumbered = renumbered_outputs.find(source);
+      if (renumbered != renumbered_outputs.end() && id.second >= 0) {
+        kept->add_input(
+            strings::StrCat(source, ":", renumbered->second.at(id.second)));
+      } else {
+        kept->add_input(input);
+      }
+    }
+  }
+  *rewritten.mutable_versions() = graph_def->versions();
+  *rewritten.mutable_library() = graph_def->library();
+  graph_def->Swap(&rewritten);
+  if (num_rewritten != nullptr) {
+    *num_rewritten = variables.size();
+  }
+  return Status::OK();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,58 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+/// Helpers for serving SavedModel variables from a memmapped package.
+
+#ifndef TENSORFLOW_CC_SAVED_MODEL_MEMMAPPED_VARIABLES_H_
+#define TENSORFLOW_CC_SAVED_MODEL_MEMMAPPED_VARIABLES_H_
+
+#include <string>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+
+/// Returns the name of the memmapped package region that holds the variable
+/// stored under `checkpoint_key`. Characters that are not allowed in region
+/// names are escaped, so distinct keys always map to distinct regions.
+string MemmappedVariableRegionName(StringPiece checkpoint_key);
+
+/// Writes the variables of the SavedModel in `export_dir` into a memmapped
+/// package next to the variables checkpoint (see
+/// kSavedModelMemmappedVariablesFilename), so that they can be loaded with
+/// LoadSavedModelWithMemmappedVariables(). Only unpartitioned variables of POD
+/// types are written; the others keep being restored from the checkpoint.
+/// Sets `*num_written` to the number of variables written, if not null.
+Status WriteMemmappedSavedModelVariables(const string& export_dir,
+                                         int* num_written);
+
+/// Rewrites `graph_def` so that every variable restored by `RestoreV2` from a
+/// tensor available in the memmapped package of `memmapped_env` becomes an
+/// `ImmutableConst` backed by that package instead. The restore ops of the
+/// rewritten variables are removed from the graph, and so are the nodes that
+/// write to them, such as initializers and optimizer updates, since the
+/// variables become read-only. Variables that are partitioned, resource
+/// variables, and variables missing from the package are left untouched.
+/// Sets `*num_rewritten` to the number of rewritten variables, if not null.
+Status RewriteVariableRestoresToImmutableConst(Env* memmapped_env,
+                                               GraphDef* graph_def,
+                                               int* num_rewritten);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CC_SAVED_MODEL_MEMMAPPED_VARIABLES_H_
@@ -0,0 +1,404 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/saved_model/memmapped_variables.h"
+
+#include <set>
+
+#include "tensorflow/cc/saved_model/constants.h"
+#include "tensorflow/cc/saved_model/loader.h"
+#include "tensorflow/cc/saved_model/signature_constants.h"
+#include "tensorflow/cc/saved_model/tag_constants.h"
+#include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/saved_model.pb.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
+#include "tensorflow/core/util/memmapped_file_system_writer.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kTestDataSharded[] =
+    "cc/saved_model/testdata/half_plus_two/00000123";
+
+// Copies the SavedModel in `src` to `dst`, so that tests can write into it.
+Status CopySavedModel(const string& src, const string& dst) {
+  Env* env = Env::Default();
+  for (const string& dir : {kSavedModelAssetsDirectory,
+                            kSavedModelVariablesDirectory}) {
+    TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(io::JoinPath(dst, dir)));
+    std::vector<string> children;
+    TF_RETURN_IF_ERROR(env->GetChildren(io::JoinPath(src, dir), &children));
+    for (const string& child : children) {
+      TF_RETURN_IF_ERROR(env->CopyFile(io::JoinPath(src, dir, child),
+                                       io::JoinPath(dst, dir, child)));
+    }
+  }
+  return env->CopyFile(io::JoinPath(src, kSavedModelFilenamePb),
+                       io::JoinPath(dst, kSavedModelFilenamePb));
+}
+
+// Writes a SavedModel with `num_variables` float variables of `size`
+// elements, all restored by a single RestoreV2.  Variable "v<i>" is filled
+// with i and read by "v<i>/read".
+Status WriteSavedModel(const string& export_dir, int num_variables,
+                       int64 size) {
+  const string variables_directory =
+      io::JoinPath(export_dir, kSavedModelVariablesDirectory);
+  TF_RETURN_IF_ERROR(Env::Default()->RecursivelyCreateDir(variables_directory));
+  BundleWriter writer(
+      Env::Default(),
+      io::JoinPath(variables_directory, kSavedModelVariablesFilename));
+  MetaGraphDef meta_graph_def;
+  meta_graph_def.mutable_meta_info_def()->add_tags(kSavedModelTagServe);
+  meta_graph_def.mutable_saver_def()->set_filename_tensor_name("save/Const:0");
+  meta_graph_def.mutable_saver_def()->set_restore_op_name("save/restore_all");
+  GraphDef* graph_def = meta_graph_def.mutable_graph_def();
+  graph_def->mutable_versions()->set_producer(TF_GRAPH_DEF_VERSION);
+
+  Tensor tensor_names(DT_STRING, TensorShape({num_variables}));
+  Tensor shape_and_slices(DT_STRING, TensorShape({num_variables}));
+  for (int i = 0; i < num_variables; ++i) {
+    const string name = strings::StrCat("v", i);
+    tensor_names.flat<string>()(i) = name;
+    shape_and_slices.flat<string>()(i) = "";
+    Tensor value(DT_FLOAT, TensorShape({size}));
+    value.flat<float>().setConstant(i);
+    TF_RETURN_IF_ERROR(writer.Add(name, value));
+    TF_RETURN_IF_ERROR(NodeDefBuilder(name, "VariableV2")
+                           .Attr("dtype", DT_FLOAT)
+                           .Attr("shape", TensorShape({size}))
+                           .Finalize(graph_def->add_node()));
+    const string read = strings::StrCat(name, "/read");
+    TF_RETURN_IF_ERROR(NodeDefBuilder(read, "Identity")
+                           .Input(name, 0, DT_FLOAT_REF)
+                           .Finalize(graph_def->add_node()));
+  }
+  TF_RETURN_IF_ERROR(writer.Finish());
+
+  TF_RETURN_IF_ERROR(NodeDefBuilder("save/Const", "Const")
+                         .Attr("dtype", DT_STRING)
+                         .Attr("value", test::AsScalar<string>("model"))
+                         .Finalize(graph_def->add_node()));
+  TF_RETURN_IF_ERROR(NodeDefBuilder("save/RestoreV2/tensor_names", "Const")
+                         .Attr("dtype", DT_STRING)
+                         .Attr("value", tensor_names)
+                         .Finalize(graph_def->add_node()));
+  TF_RETURN_IF_ERROR(NodeDefBuilder("save/RestoreV2/shape_and_slices", "Const")
+                         .Attr("dtype", DT_STRING)
+                         .Attr("value", shape_and_slices)
+                         .Finalize(graph_def->add_node()));
+  TF_RETURN_IF_ERROR(
+      NodeDefBuilder("save/RestoreV2", "RestoreV2")
+          .Input("save/Const", 0, DT_STRING)
+          .Input("save/RestoreV2/tensor_names", 0, DT_STRING)
+          .Input("save/RestoreV2/shape_and_slices", 0, DT_STRING)
+          .Attr("dtypes", DataTypeVector(num_variables, DT_FLOAT))
+          .Finalize(graph_def->add_node()));
+  NodeDefBuilder restore_all("save/restore_all", "NoOp");
+  for (int i = 0; i < num_variables; ++i) {
+    const string assign = strings::StrCat("save/Assign_", i);
+    TF_RETURN_IF_ERROR(NodeDefBuilder(assign, "Assign")
+                           .Input(strings::StrCat("v", i), 0, DT_FLOAT_REF)
+                           .Input("save/RestoreV2", i, DT_FLOAT)
+                           .Finalize(graph_def->add_node()));
+    restore_all.ControlInput(assign);
+  }
+  TF_RETURN_IF_ERROR(restore_all.Finalize(graph_def->add_node()));
+
+  SavedModel saved_model;
+  *saved_model.add_meta_graphs() = meta_graph_def;
+  return WriteBinaryProto(Env::Default(),
+                          io::JoinPath(export_dir, kSavedModelFilenamePb),
+                          saved_model);
+}
+
+Status ReadGraphDef(const string& export_dir, GraphDef* graph_def) {
+  SavedModel saved_model;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(
+      Env::Default(), io::JoinPath(export_dir, kSavedModelFilenamePb),
+      &saved_model));
+  *graph_def = saved_model.meta_graphs(0).graph_def();
+  return Status::OK();
+}
+
+const NodeDef* FindNode(const GraphDef& graph_def, const string& name) {
+  for (const NodeDef& node : graph_def.node()) {
+    if (node.name() == name) return &node;
+  }
+  return nullptr;
+}
+
+string MakeSerializedExample(float x) {
+  Example example;
+  auto* feature_map = example.mutable_features()->mutable_feature();
+  (*feature_map)["x"].mutable_float_list()->add_value(x);
+  return example.SerializeAsString();
+}
+
+TEST(MemmappedVariablesTest, RegionNames) {
+  const std::vector<string> keys = {"a", "a/b", "a.b", "a.2fb", "a_b", ""};
+  std::set<string> region_names;
+  for (const string& key : keys) {
+    const string region_name = MemmappedVariableRegionName(key);
+    EXPECT_TRUE(
+        MemmappedFileSystem::IsWellFormedMemmappedPackageFilename(region_name))
+        << region_name;
+    region_names.insert(region_name);
+  }
+  EXPECT_EQ(keys.size(), region_names.size());
+  EXPECT_EQ(string(MemmappedFileSystem::kMemmappedPackagePrefix) + "a.2fb",
+            MemmappedVariableRegionName("a/b"));
+}
+
+TEST(MemmappedVariablesTest, RewriteHalfPlusTwo) {
+  const string export_dir = io::JoinPath(testing::TmpDir(), "half_plus_two");
+  TF_ASSERT_OK(CopySavedModel(
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataSharded),
+      export_dir));
+  int num_written;
+  TF_ASSERT_OK(WriteMemmappedSavedModelVariables(export_dir, &num_written));
+  EXPECT_EQ(3, num_written);
+
+  MemmappedEnv memmapped_env(Env::Default());
+  TF_ASSERT_OK(memmapped_env.InitializeFromFile(
+      io::JoinPath(export_dir, kSavedModelVariablesDirectory,
+                   kSavedModelMemmappedVariablesFilename)));
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  TF_ASSERT_OK(memmapped_env.NewReadOnlyMemoryRegionFromFile(
+      MemmappedVariableRegionName("a"), &region));
+  ASSERT_LE(sizeof(float), region->length());
+  EXPECT_EQ(0.5, *static_cast<const float*>(region->data()));
+
+  GraphDef graph_def;
+  TF_ASSERT_OK(ReadGraphDef(export_dir, &graph_def));
+  int num_rewritten;
+  TF_ASSERT_OK(RewriteVariableRestoresToImmutableConst(
+      &memmapped_env, &graph_def, &num_rewritten));
+  EXPECT_EQ(3, num_rewritten);
+
+  for (const string& name : {"a", "b", "c"}) {
+    const NodeDef* node = FindNode(graph_def, name);
+    ASSERT_NE(nullptr, node);
+    EXPECT_EQ("ImmutableConst", node->op());
+    EXPECT_EQ(MemmappedVariableRegionName(name),
+              node->attr().at("memory_region_name").s());
+    EXPECT_NE(nullptr, FindNode(graph_def, strings::StrCat(name, "/read")));
+    // The initializer writes to the variable, so it is gone.
+    EXPECT_EQ(nullptr, FindNode(graph_def, strings::StrCat(name, "/Assign")));
+  }
+  for (const string& name :
+       {"save/RestoreV2", "save/RestoreV2_1", "save/RestoreV2_2",
+        "save/Assign", "save/Assign_1", "save/Assign_2"}) {
+    EXPECT_EQ(nullptr, FindNode(graph_def, name)) << name;
+  }
+  const NodeDef* restore_shard = FindNode(graph_def, "save/restore_shard");
+  ASSERT_NE(nullptr, restore_shard);
+  EXPECT_EQ(0, restore_shard->input_size());
+  const NodeDef* init = FindNode(graph_def, "init");
+  ASSERT_NE(nullptr, init);
+  EXPECT_EQ(0, init->input_size());
+  // The variable that is not in the checkpoint keeps being a variable.
+  ASSERT_NE(nullptr, FindNode(graph_def, "filename_tensor"));
+  EXPECT_EQ("VariableV2", FindNode(graph_def, "filename_tensor")->op());
+  EXPECT_NE(nullptr, FindNode(graph_def, "Assign"));
+  // Saving still works off the read-only tensors.
+  EXPECT_NE(nullptr, FindNode(graph_def, "save/SaveV2"));
+}
+
+TEST(MemmappedVariablesTest, RewriteShrinksRestore) {
+  const string export_dir = io::JoinPath(testing::TmpDir(), "shrink");
+  TF_ASSERT_OK(WriteSavedModel(export_dir, 3, 4));
+
+  // Only v1 is available in the package.
+  const string package_path = io::JoinPath(export_dir, "v1.mmap");
+  MemmappedFileSystemWriter writer;
+  TF_ASSERT_OK(writer.InitializeToFile(Env::Default(), package_path));
+  TF_ASSERT_OK(writer.SaveTensor(test::AsTensor<float>({1, 1, 1, 1}),
+                                 MemmappedVariableRegionName("v1")));
+  TF_ASSERT_OK(writer.FlushAndClose());
+  MemmappedEnv memmapped_env(Env::Default());
+  TF_ASSERT_OK(memmapped_env.InitializeFromFile(package_path));
+
+  GraphDef graph_def;
+  TF_ASSERT_OK(ReadGraphDef(export_dir, &graph_def));
+  int num_rewritten;
+  TF_ASSERT_OK(RewriteVariableRestoresToImmutableConst(
+      &memmapped_env, &graph_def, &num_rewritten));
+  EXPECT_EQ(1, num_rewritten);
+
+  EXPECT_EQ("VariableV2", FindNode(graph_def, "v0")->op());
+  EXPECT_EQ("ImmutableConst", FindNode(graph_def, "v1")->op());
+  EXPECT_EQ("VariableV2", FindNode(graph_def, "v2")->op());
+  EXPECT_EQ(nullptr, FindNode(graph_def, "save/Assign_1"));
+
+  // The RestoreV2 no longer reads v1, and v2 moved to its second output.
+  const NodeDef* restore = FindNode(graph_def, "save/RestoreV2");
+  ASSERT_NE(nullptr, restore);
+  EXPECT_EQ(2, restore->attr().at("dtypes").list().type_size());
+  Tensor tensor_names;
+  ASSERT_TRUE(tensor_names.FromProto(
+      FindNode(graph_def, "save/RestoreV2/tensor_names")
+          ->attr()
+          .at("value")
+          .tensor()));
+  test::ExpectTensorEqual<string>(test::AsTensor<string>({"v0", "v2"}),
+                                  tensor_names);
+  Tensor shape_and_slices;
+  ASSERT_TRUE(shape_and_slices.FromProto(
+      FindNode(graph_def, "save/RestoreV2/shape_and_slices")
+          ->attr()
+          .at("value")
+          .tensor()));
+  EXPECT_EQ(2, shape_and_slices.NumElements());
+  EXPECT_EQ("save/RestoreV2:0", FindNode(graph_def, "save/Assign_0")->input(1));
+  EXPECT_EQ("save/RestoreV2:1", FindNode(graph_def, "save/Assign_2")->input(1));
+  EXPECT_EQ(2, FindNode(graph_def, "save/restore_all")->input_size());
+}
+
+TEST(MemmappedVariablesTest, LoadHalfPlusTwo) {
+  const string export_dir =
+      io::JoinPath(testing::TmpDir(), "half_plus_two_load");
+  TF_ASSERT_OK(CopySavedModel(
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataSharded),
+      export_dir));
+  SavedModelBundle bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+  EXPECT_EQ(error::NOT_FOUND,
+            LoadSavedModelWithMemmappedVariables(session_options, run_options,
+                                                 export_dir,
+                                                 {kSavedModelTagServe}, &bundle)
+                .code());
+
+  TF_ASSERT_OK(WriteMemmappedSavedModelVariables(export_dir, nullptr));
+  TF_ASSERT_OK(LoadSavedModelWithMemmappedVariables(
+      session_options, run_options, export_dir, {kSavedModelTagServe},
+      &bundle));
+  ASSERT_NE(nullptr, bundle.memmapped_env);
+
+  const auto& signature_def =
+      bundle.meta_graph_def.signature_def().at("regress_x_to_y");
+  std::vector<string> serialized_examples;
+  for (float x : {0, 1, 2, 3}) {
+    serialized_examples.push_back(MakeSerializedExample(x));
+  }
+  Tensor input = test::AsTensor<string>(serialized_examples, TensorShape({4}));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(bundle.session->Run(
+      {{signature_def.inputs().at(kRegressInputs).name(), input}},
+      {signature_def.outputs().at(kRegressOutputs).name()}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(
+      outputs[0], test::AsTensor<float>({2, 2.5, 3, 3.5}, TensorShape({4, 1})));
+}
+
+TEST(MemmappedVariablesTest, LoadPartiallyMemmapped) {
+  const string export_dir = io::JoinPath(testing::TmpDir(), "partial");
+  TF_ASSERT_OK(WriteSavedModel(export_dir, 3, 4));
+  // An empty package: every variable is restored from the checkpoint.
+  MemmappedFileSystemWriter writer;
+  TF_ASSERT_OK(writer.InitializeToFile(
+      Env::Default(), io::JoinPath(export_dir, kSavedModelVariablesDirectory,
+                                   kSavedModelMemmappedVariablesFilename)));
+  TF_ASSERT_OK(writer.FlushAndClose());
+
+  SavedModelBundle bundle;
+  TF_ASSERT_OK(LoadSavedModelWithMemmappedVariables(
+      SessionOptions(), RunOptions(), export_dir, {kSavedModelTagServe},
+      &bundle));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(
+      bundle.session->Run({}, {"v0/read", "v2/read"}, {}, &outputs));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({0, 0, 0, 0}),
+                                 outputs[0]);
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({2, 2, 2, 2}),
+                                 outputs[1]);
+}
+
+TEST(MemmappedVariablesTest, LoadRejectsConstantFolding) {
+  const string export_dir = io::JoinPath(testing::TmpDir(), "folding");
+  TF_ASSERT_OK(WriteSavedModel(export_dir, 1, 4));
+  TF_ASSERT_OK(WriteMemmappedSavedModelVariables(export_dir, nullptr));
+
+  SessionOptions session_options;
+  OptimizerOptions* optimizer_options =
+      session_options.config.mutable_graph_options()
+          ->mutable_optimizer_options();
+  optimizer_options->set_opt_level(OptimizerOptions::L0);
+  optimizer_options->set_do_constant_folding(true);
+  SavedModelBundle bundle;
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            LoadSavedModelWithMemmappedVariables(session_options, RunOptions(),
+                                                 export_dir,
+                                                 {kSavedModelTagServe}, &bundle)
+                .code());
+
+  optimizer_options->set_do_constant_folding(false);
+  TF_ASSERT_OK(LoadSavedModelWithMemmappedVariables(
+      session_options, RunOptions(), export_dir, {kSavedModelTagServe},
+      &bundle));
+}
+
+// Loads a SavedModel with 16 variables of `size` floats, restoring them from
+// the checkpoint or mapping them from the memmapped package.
+void BM_LoadSavedModel(int iters, int memmapped, int size) {
+  testing::StopTiming();
+  constexpr int kNumVariables = 16;
+  const string export_dir = io::JoinPath(
+      testing::TmpDir(), strings::StrCat("bm_load_saved_model_", size));
+  if (!Env::Default()
+           ->FileExists(io::JoinPath(export_dir, kSavedModelVariablesDirectory,
+                                     kSavedModelMemmappedVariablesFilename))
+           .ok()) {
+    TF_CHECK_OK(WriteSavedModel(export_dir, kNumVariables, size));
+    TF_CHECK_OK(WriteMemmappedSavedModelVariables(export_dir, nullptr));
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumVariables * size *
+                          sizeof(float));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    SavedModelBundle bundle;
+    if (memmapped) {
+      TF_CHECK_OK(LoadSavedModelWithMemmappedVariables(
+          SessionOptions(), RunOptions(), export_dir, {kSavedModelTagServe},
+          &bundle));
+    } else {
+      TF_CHECK_OK(LoadSavedModel(SessionOptions(), RunOptions(), export_dir,
+                                 {kSavedModelTagServe}, &bundle));
+    }
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(bundle.session->Run({}, {"v1/read"}, {}, &outputs));
+  }
+}
+BENCHMARK(BM_LoadSavedModel)
+    ->ArgPair(0, 1 << 10)
+    ->ArgPair(1, 1 << 10)
+    ->ArgPair(0, 1 << 20)
+    ->ArgPair(1, 1 << 20)
+    ->ArgPair(0, 4 << 20)
+    ->ArgPair(1, 4 << 20);
+
+}  // namespace
+}  // namespace tensorflow
@@ -964,5 +964,66 @@ class UnbatchDatasetBenchmark(test.Benchmark):
               batch_size)
 
 
+class BatchAndMapAndBatchBenchmark(test.Benchmark):
+
+  def _benchmarkPipeline(self, dataset, name, batch_size, num_batches=100):
+    dataset = dataset.skip(num_batches - 1)
+    iterator = dataset.make_initializable_iterator()
+    next_element = iterator.get_next()
+    if isinstance(next_element, sparse_tensor.SparseTensor):
+      next_op = next_element.values.op
+    else:
+      next_op = next_element.op
+
+    with session.Session() as sess:
+      deltas = []
+      for _ in range(5):
+        sess.run(iterator.initializer)
+        start = time.time()
+        sess.run(next_op)
+        end = time.time()
+        deltas.append((end - start) / (num_batches * batch_size))
+
+      median_wall_time = np.median(deltas)
+      print("%s batch size: %d Median wall time per element: %f "
+            "microseconds" % (name, batch_size, median_wall_time * 1e6))
+      self.report_benchmark(
+          iters=num_batches * batch_size,
+          wall_time=median_wall_time,
+          name="benchmark_%s_batch_size_%d" % (name, batch_size))
+
+  def benchmarkImagePipeline(self):
+    for batch_size in [32, 128]:
+      with ops.Graph().as_default():
+        image = array_ops.zeros([224, 224, 3], dtype=dtypes.uint8)
+        dataset = dataset_ops.Dataset.from_tensors(image).repeat(None)
+        self._benchmarkPipeline(
+            dataset.batch(batch_size), "batch_image", batch_size)
+      with ops.Graph().as_default():
+        image = array_ops.zeros([224, 224, 3], dtype=dtypes.uint8)
+        dataset = dataset_ops.Dataset.from_tensors(image).repeat(None)
+        dataset = dataset.apply(
+            batching.map_and_batch(
+                lambda x: x + 1, batch_size, num_parallel_batches=2))
+        self._benchmarkPipeline(dataset, "map_and_batch_image", batch_size)
+
+  def benchmarkSparseFeaturePipeline(self):
+
+    def _sparse_feature(i):
+      num_values = math_ops.mod(i, 50) + 1
+      return sparse_tensor.SparseTensor(
+          indices=array_ops.expand_dims(math_ops.range(num_values), 1),
+          values=array_ops.fill([num_values], compat.as_bytes("feature")),
+          dense_shape=[50])
+
+    for batch_size in [32, 128]:
+      with ops.Graph().as_default():
+        dataset = dataset_ops.Dataset.range(10**9)
+        dataset = dataset.apply(
+            batching.map_and_batch(
+                _sparse_feature, batch_size, num_parallel_batches=2))
+        self._benchmarkPipeline(dataset, "map_and_batch_sparse", batch_size)
+
+
 if __name__ == "__main__":
   test.main()
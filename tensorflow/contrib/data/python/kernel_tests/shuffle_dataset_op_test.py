@@ -17,13 +17,19 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import time
+
 import numpy as np
 
 from tensorflow.contrib.data.python.kernel_tests import dataset_serialization_test_base
 from tensorflow.contrib.data.python.ops import shuffle_ops
+from tensorflow.contrib.data.python.ops import stats_ops
+from tensorflow.core.framework import summary_pb2
+from tensorflow.python.client import session
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import errors
 from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
 from tensorflow.python.platform import test
 
 
@@ -87,6 +93,12 @@ class ShuffleAndRepeatTest(
     for i in range(5):
       self.assertSequenceEqual(sorted(output[i * 20:(i + 1) * 20]), range(20))
 
+  def testCorrectOutputWithoutSeed(self):
+    # Without a seed, the buffer is filled by concurrent calls to the input.
+    output = self.gen_outputs(lambda: self._build_ds(None), [], 100)
+    for i in range(5):
+      self.assertSequenceEqual(sorted(output[i * 20:(i + 1) * 20]), range(20))
+
   def testReshuffling(self):
     # Check that the output orders of different epochs are indeed different.
     output = self.gen_outputs(lambda: self._build_ds(10), [], 100)
@@ -158,5 +170,52 @@ class ShuffleAndRepeatSerializationTest(
                         100)
 
 
+class ShuffleDatasetBenchmark(test.Benchmark):
+
+  def _buffer_bytes(self, summary_str):
+    summary_proto = summary_pb2.Summary()
+    summary_proto.ParseFromString(summary_str)
+    for value in summary_proto.value:
+      if value.tag.endswith("::Shuffle::buffer_bytes"):
+        return value.simple_value
+    return 0.0
+
+  def benchmarkShuffleStartupLatency(self):
+    for buffer_size in [10**4, 10**5, 10**6]:
+      # Unseeded shuffles fill the buffer with concurrent calls to the input.
+      for seed in [None, 42]:
+        with ops.Graph().as_default():
+          stats_aggregator = stats_ops.StatsAggregator()
+          # The first element is produced only once the buffer is full.
+          dataset = dataset_ops.Dataset.range(buffer_size).map(
+              lambda x: array_ops.fill([8], x)).shuffle(
+                  buffer_size, seed=seed).apply(
+                      stats_ops.set_stats_aggregator(stats_aggregator))
+          iterator = dataset.make_initializable_iterator()
+          next_element = iterator.get_next()
+          summary_t = stats_aggregator.get_summary()
+
+          with session.Session() as sess:
+            deltas = []
+            for _ in range(5):
+              sess.run(iterator.initializer)
+              start = time.time()
+              sess.run(next_element.op)
+              end = time.time()
+              deltas.append(end - start)
+            buffer_bytes = self._buffer_bytes(sess.run(summary_t))
+
+            median_wall_time = np.median(deltas)
+            name = "benchmark_shuffle_startup_latency_buffer_size_%d_%s" % (
+                buffer_size, "serial" if seed else "parallel")
+            print("%s: median time to first element %f seconds, buffer "
+                  "bytes %d" % (name, median_wall_time, buffer_bytes))
+            self.report_benchmark(
+                iters=5,
+                wall_time=median_wall_time,
+                extras={"buffer_bytes": buffer_bytes},
+                name=name)
+
+
 if __name__ == "__main__":
   test.main()
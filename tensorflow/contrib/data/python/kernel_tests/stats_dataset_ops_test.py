@@ -49,6 +49,15 @@ class StatsDatasetTest(test.TestCase):
         return
     self.fail("Expected tag %r not found in summary %r" % (tag, summary_proto))
 
+  def _assertSummaryHasScalar(self, summary_str, tag, expected_value):
+    summary_proto = summary_pb2.Summary()
+    summary_proto.ParseFromString(summary_str)
+    for value in summary_proto.value:
+      if tag == value.tag:
+        self.assertEqual(expected_value, value.simple_value)
+        return
+    self.fail("Expected tag %r not found in summary %r" % (tag, summary_proto))
+
   def testBytesProduced(self):
     stats_aggregator = stats_ops.StatsAggregator()
     dataset = dataset_ops.Dataset.range(100).map(
@@ -192,6 +201,26 @@ class StatsDatasetTest(test.TestCase):
         sess.run(next_element)
       self._assertSummaryHasCount(sess.run(summary_t), "record_latency", 200.0)
 
+  def testShuffleBufferBytes(self):
+    stats_aggregator = stats_ops.StatsAggregator()
+    dataset = dataset_ops.Dataset.range(100).shuffle(10, seed=42).apply(
+        stats_ops.set_stats_aggregator(stats_aggregator))
+    iterator = dataset.make_initializable_iterator()
+    next_element = iterator.get_next()
+    summary_t = stats_aggregator.get_summary()
+    tag = "Iterator::SetStatsAggregator::Shuffle::buffer_bytes"
+
+    with self.test_session() as sess:
+      sess.run(iterator.initializer)
+      # The buffer stays full of 8 byte elements until the input runs out.
+      for i in range(100):
+        sess.run(next_element)
+        self._assertSummaryHasScalar(
+            sess.run(summary_t), tag, 8.0 * min(9, 99 - i))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(next_element)
+      self._assertSummaryHasScalar(sess.run(summary_t), tag, 0.0)
+
 
 class StatsDatasetSerializationTest(
     dataset_serialization_test_base.DatasetSerializationTestBase):
@@ -18,6 +18,8 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/copy_tensor.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 #include "tensorflow/core/lib/core/notification.h"
@@ -25,6 +27,13 @@ limitations under the License.
 #define VALUE_IN_DEBUG_STRING false
 
 namespace tensorflow {
+namespace {
+// Values of at most this many bytes are all-reduced by recursive halving
+// and doubling, which takes fewer and smaller steps than a ring and so has
+// lower latency when per-transfer overhead dominates.
+const int64 kMaxHalvingDoublingBytes = 64 << 10;
+}  // namespace
+
 /*static*/
 int64 CollectiveAdapter::AlignedChunkElts(int64 elt_bytes, int64 total_elts,
                                           int64 num_chunks) {
@@ -97,19 +106,26 @@ class CollectiveAdapterImpl : public CollectiveAdapter {
   }
 
   // Number of T elements in a particular chunk.
-  inline int64 ChunkElts(int i) const {
-    DCHECK_LT(i, num_chunks_);
-    const T* chunk_start = std::min(data_end_, data_start_ + i * chunk_elts_);
-    const T* chunk_end = std::min(data_end_, chunk_start + chunk_elts_);
-    return chunk_end - chunk_start;
+  inline int64 ChunkElts(int i) const { return ChunkRangeElts(i, i + 1); }
+
+  // Number of T elements in the chunks [begin, end).
+  inline int64 ChunkRangeElts(int begin, int end) const {
+    DCHECK_LE(begin, end);
+    DCHECK_LE(end, num_chunks_);
+    const T* range_start =
+        std::min(data_end_, data_start_ + begin * chunk_elts_);
+    const T* range_end = std::min(data_end_, data_start_ + end * chunk_elts_);
+    return range_end - range_start;
   }
 
   int64 ChunkBytes(int i) const override { return sizeof(T) * ChunkElts(i); }
 
   // Returns a new Tensor that aliases the required chunk.
-  Tensor ChunkAlias(int i) override {
-    int64 start = chunk_elts_ * i;
-    int64 num_elts = ChunkElts(i);
+  Tensor ChunkAlias(int i) override { return ChunkRangeAlias(i, i + 1); }
+
+  Tensor ChunkRangeAlias(int begin, int end) override {
+    int64 start = chunk_elts_ * begin;
+    int64 num_elts = ChunkRangeElts(begin, end);
     // If this chunk is empty the prior chunk might also be short
     // so always take an empty slice from the front of the tensor
     // to avoid an illegal offset check failure somewhere.
@@ -117,9 +133,11 @@ class CollectiveAdapterImpl : public CollectiveAdapter {
                           : output_.Slice(0, 0);
   }
 
-  Tensor TempChunk(int i) const override {
+  Tensor TempChunk(int i) const override { return TempChunkRange(i, i + 1); }
+
+  Tensor TempChunkRange(int begin, int end) const override {
     AllocationAttributes empty;
-    return Tensor(allocator_, dt_, {ChunkElts(i)}, empty);
+    return Tensor(allocator_, dt_, {ChunkRangeElts(begin, end)}, empty);
   }
 
   string DebugString() const override {
@@ -182,11 +200,31 @@ CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
   }
 }
 
+BaseCollectiveExecutor::BaseCollectiveExecutor(
+    CollectiveExecutorMgrInterface* cem,
+    PerStepCollectiveRemoteAccess* remote_access, int64 step_id,
+    const DeviceMgr* dev_mgr, const CollectiveFusionOptions& fusion_options)
+    : CollectiveExecutor(cem),
+      step_id_(step_id),
+      dev_mgr_(dev_mgr),
+      remote_access_(remote_access) {
+  if (fusion_options.window_micros > 0) {
+    fuser_.reset(new CollectiveFuser(
+        fusion_options, this, dev_mgr_,
+        [this](OpKernelContext* ctx, const CollectiveParams& col_params,
+               const string& exec_key, const Tensor* input, Tensor* output,
+               const StatusCallback& done) {
+          RunReducer(ctx, col_params, exec_key, input, output, done);
+        }));
+  }
+}
+
 BaseCollectiveExecutor::~BaseCollectiveExecutor() {}
 
 void BaseCollectiveExecutor::StartAbort(const Status& s) {
   LOG(WARNING) << "BaseCollectiveExecutor::StartAbort " << s;
   remote_access_->StartAbort(s);
+  if (fuser_) fuser_->StartAbort(s);
 }
 
 void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
@@ -214,10 +252,16 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
   string error;
   switch (col_params.instance.type) {
     case REDUCTION_COLLECTIVE: {
+      if (fuser_ && fuser_->CanFuse(ctx, col_params)) {
+        fuser_->Enqueue(ctx, col_params, done_safe);
+        return;
+      }
+      // CreateReducer picks the algorithm from the size of the value and
+      // the layout of the group.
       // TODO(tucker): support other reduction algorithms,
-      // e.g. tree-reduce, hybrid tree/ring, delegate-to-NCCL, etc.
+      // e.g. tree-reduce, delegate-to-NCCL, etc.
       const Tensor* input = &ctx->input(0);
-      RingReducer* reducer =
+      CollectiveImplementationInterface* reducer =
           CreateReducer(ctx, CtxParams(ctx), col_params, exec_key, step_id_,
                         input, output, &error);
       if (!reducer) {
@@ -258,7 +302,26 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
   }
 }
 
-RingReducer* BaseCollectiveExecutor::CreateReducer(
+void BaseCollectiveExecutor::RunReducer(OpKernelContext* ctx,
+                                        const CollectiveParams& col_params,
+                                        const string& exec_key,
+                                        const Tensor* input, Tensor* output,
+                                        const StatusCallback& done) {
+  string error;
+  CollectiveImplementationInterface* reducer =
+      CreateReducer(ctx, CtxParams(ctx), col_params, exec_key, step_id_, input,
+                    output, &error);
+  if (!reducer) {
+    done(errors::Internal(error));
+    return;
+  }
+  reducer->Run([reducer, done](const Status& s) {
+    done(s);
+    delete reducer;
+  });
+}
+
+CollectiveImplementationInterface* BaseCollectiveExecutor::CreateReducer(
     OpKernelContext* ctx, OpKernelContext::Params* params,
     const CollectiveParams& col_params, const string& exec_key, int64 step_id,
     const Tensor* input, Tensor* output, string* error) {
@@ -274,6 +337,21 @@ RingReducer* BaseCollectiveExecutor::CreateReducer(
     case DT_FLOAT:
     case DT_DOUBLE:
     case DT_INT64:
+      // Only RingReducer implements compression.  Every member of the group
+      // reduces a value of the same size, so they all choose alike.
+      if (col_params.instance.compression == COMPRESSION_NONE &&
+          col_params.group.group_size > 2 &&
+          input->TotalBytes() <= kMaxHalvingDoublingBytes) {
+        return new HalvingDoublingReducer(this, dev_mgr_, ctx, params,
+                                          col_params, exec_key, step_id, input,
+                                          output);
+      }
+      if (col_params.instance.impl_details.reduction_algorithm ==
+              REDUCTION_HIERARCHICAL &&
+          col_params.instance.compression == COMPRESSION_NONE) {
+        return new HierarchicalReducer(this, dev_mgr_, ctx, params, col_params,
+                                       exec_key, step_id, input, output);
+      }
       return new RingReducer(this, dev_mgr_, ctx, params, col_params, exec_key,
                              step_id, input, output);
       break;
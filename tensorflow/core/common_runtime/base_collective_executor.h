@@ -17,13 +17,13 @@ limitations under the License.
 
 #include <string>
 #include "tensorflow/core/common_runtime/buf_rendezvous.h"
+#include "tensorflow/core/common_runtime/collective_fuser.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 
 namespace tensorflow {
 class Broadcaster;
 class DeviceMgr;
-class RingReducer;
 
 // Helper interface that aliases regular subfields of a Tensor as separate
 // Tensors for in-place update.
@@ -50,6 +50,11 @@ class CollectiveAdapter {
   // Bytes in chunk i
   virtual int64 ChunkBytes(int i) const = 0;
 
+  // Like ChunkAlias and TempChunk, but for the adjacent chunks [begin, end)
+  // taken together.
+  virtual Tensor ChunkRangeAlias(int begin, int end) = 0;
+  virtual Tensor TempChunkRange(int begin, int end) const = 0;
+
   // Generate a CPU RAM scalar tensor of the same DataType as the
   // backing tensor with the given integer value.
   virtual Tensor Scalar(int v) const = 0;
@@ -75,6 +80,17 @@ class CollectiveAdapter {
                                 int64 num_chunks);
 };
 
+// Interface of the classes that carry out a single execution of a
+// collective op on one device, e.g. RingReducer or Broadcaster.
+class CollectiveImplementationInterface {
+ public:
+  virtual ~CollectiveImplementationInterface() {}
+
+  // Executes the collective, then calls 'done'.  May block, so must run
+  // in a thread that can be blocked.
+  virtual void Run(StatusCallback done) = 0;
+};
+
 // Create a CollectiveAdaptor wrapping 'output', specialized to its
 // data-type and shape.
 CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
@@ -87,11 +103,9 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
  public:
   BaseCollectiveExecutor(CollectiveExecutorMgrInterface* cem,
                          PerStepCollectiveRemoteAccess* remote_access,
-                         int64 step_id, const DeviceMgr* dev_mgr)
-      : CollectiveExecutor(cem),
-        step_id_(step_id),
-        dev_mgr_(dev_mgr),
-        remote_access_(remote_access) {}
+                         int64 step_id, const DeviceMgr* dev_mgr,
+                         const CollectiveFusionOptions& fusion_options =
+                             CollectiveFusionOptions());
 
   ~BaseCollectiveExecutor() override;
 
@@ -133,18 +147,23 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
   std::unique_ptr<PerStepCollectiveRemoteAccess> remote_access_;
 
  private:
-  RingReducer* CreateReducer(OpKernelContext* ctx,
-                             OpKernelContext::Params* params,
-                             const CollectiveParams& col_params,
-                             const string& exec_key, int64 step_id,
-                             const Tensor* input, Tensor* output,
-                             string* error);
+  // Creates a reducer for 'col_params' and runs it in the calling thread.
+  void RunReducer(OpKernelContext* ctx, const CollectiveParams& col_params,
+                  const string& exec_key, const Tensor* input, Tensor* output,
+                  const StatusCallback& done);
+
+  CollectiveImplementationInterface* CreateReducer(
+      OpKernelContext* ctx, OpKernelContext::Params* params,
+      const CollectiveParams& col_params, const string& exec_key,
+      int64 step_id, const Tensor* input, Tensor* output, string* error);
 
   Broadcaster* CreateBroadcaster(OpKernelContext* ctx,
                                  OpKernelContext::Params* params,
                                  const CollectiveParams& col_params,
                                  const string& exec_key, int64 step_id,
                                  Tensor* output, string* error);
+
+  std::unique_ptr<CollectiveFuser> fuser_;
 };
 
 }  // namespace tensorflow
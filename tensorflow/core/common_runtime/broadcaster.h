@@ -23,14 +23,14 @@ limitations under the License.
 namespace tensorflow {
 
 // Tree-algorithm implementation of collective broadcast.
-class Broadcaster {
+class Broadcaster : public CollectiveImplementationInterface {
  public:
   Broadcaster(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
               OpKernelContext* ctx, OpKernelContext::Params* params,
               const CollectiveParams& col_params, const string& exec_key,
               int64 step_id, Tensor* output);
 
-  void Run(StatusCallback done);
+  void Run(StatusCallback done) override;
 
   // Returns the rank of the device from which this device should receive
   // its value, -1 if no value should be received.
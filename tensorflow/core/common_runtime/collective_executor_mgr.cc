@@ -29,7 +29,14 @@ CollectiveExecutorMgr::CollectiveExecutorMgr(
     ParamResolverInterface* param_resolver)
     : dev_mgr_(dev_mgr),
       dev_resolver_(dev_resolver),
-      param_resolver_(param_resolver) {}
+      param_resolver_(param_resolver) {
+  fusion_options_.window_micros =
+      config.experimental().collective_fusion_window_micros();
+  if (config.experimental().collective_fusion_max_bytes() > 0) {
+    fusion_options_.max_bytes =
+        config.experimental().collective_fusion_max_bytes();
+  }
+}
 
 CollectiveExecutorMgr::~CollectiveExecutorMgr() {
   for (auto iter : executor_table_) {
@@ -47,7 +54,8 @@ CollectiveExecutor* CollectiveExecutorMgr::FindOrCreate(int64 step_id) {
     } else {
       CollectiveRemoteAccessLocal* rma = new CollectiveRemoteAccessLocal(
           dev_mgr_, dev_resolver_.get(), step_id);
-      ce = new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_);
+      ce = new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_,
+                                      fusion_options_);
       executor_table_[step_id] = ce;
     }
     ce->Ref();
@@ -0,0 +1,563 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fuser.h"
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+// Most reductions in one batch.  Bounds the size of the manifest that the
+// group leader sends to the other members.
+const int kMaxFusedOps = 128;
+
+// BufRendezvous key for the manifest of batch 'seq' sent to 'dst_rank'.
+string ManifestKey(const string& queue_key, int64 seq, int dst_rank) {
+  return strings::StrCat("fuse(", queue_key, "):", seq, ":", dst_rank);
+}
+
+// BufRendezvous key for the keys of the reductions queued on 'src_rank',
+// sent to the leader before batch 'seq'.
+string QueuedKey(const string& queue_key, int64 seq, int src_rank) {
+  return strings::StrCat("fuseq(", queue_key, "):", seq, ":", src_rank);
+}
+
+// Encodes up to kMaxFusedOps instance keys in a host tensor, preceded by
+// their number.
+Tensor EncodeKeys(const std::vector<int64>& instance_keys) {
+  CHECK_LE(instance_keys.size(), static_cast<size_t>(kMaxFusedOps));
+  Tensor keys(DT_INT64, TensorShape({kMaxFusedOps + 1}));
+  auto flat = keys.flat<int64>();
+  flat.setZero();
+  flat(0) = instance_keys.size();
+  for (int i = 0; i < static_cast<int>(instance_keys.size()); ++i) {
+    flat(i + 1) = instance_keys[i];
+  }
+  return keys;
+}
+
+// Inverse of EncodeKeys.
+Status DecodeKeys(const Tensor& keys, const string& queue_key,
+                  std::vector<int64>* instance_keys) {
+  auto flat = keys.flat<int64>();
+  if (flat(0) < 0 || flat(0) > kMaxFusedOps) {
+    return errors::Internal("Invalid list of ", flat(0),
+                            " fused reductions for ", queue_key);
+  }
+  instance_keys->assign(flat.data() + 1, flat.data() + 1 + flat(0));
+  return Status::OK();
+}
+
+// Element offsets of the reductions of a batch within the fused value.
+// Each one starts on an aligned address, so that its slice is a valid
+// Tensor.
+int64 FusedOffsets(DataType dtype, const std::vector<const Tensor*>& inputs,
+                   std::vector<int64>* offsets) {
+  const int64 align_elts =
+      std::max<int64>(1, EIGEN_MAX_ALIGN_BYTES / DataTypeSize(dtype));
+  int64 total = 0;
+  for (const Tensor* t : inputs) {
+    offsets->push_back(total);
+    total += (t->NumElements() + align_elts - 1) / align_elts * align_elts;
+  }
+  return total;
+}
+
+// Collects the status of a set of concurrent callbacks.
+class StatusCollector {
+ public:
+  explicit StatusCollector(int num_callbacks) : counter_(num_callbacks) {}
+
+  StatusCallback Add() {
+    return [this](const Status& s) {
+      {
+        mutex_lock l(mu_);
+        status_.Update(s);
+      }
+      counter_.DecrementCount();
+    };
+  }
+
+  Status Wait() {
+    counter_.Wait();
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+ private:
+  BlockingCounter counter_;
+  mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+};
+
+// Posts 'keys' from the device of 'cp' to each member of the group in
+// 'dst_ranks', under the BufRendezvous key returned by 'buf_key' for the
+// member, and waits until all of them have it.
+Status PostKeys(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                OpKernelContext* ctx, const CollectiveParams& cp,
+                const std::vector<int>& dst_ranks,
+                const std::function<string(int)>& buf_key,
+                const Tensor& keys) {
+  Device* device = nullptr;
+  TF_RETURN_IF_ERROR(dev_mgr->LookupDevice(
+      cp.instance.device_names[cp.default_rank], &device));
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  StatusCollector collector(dst_ranks.size());
+  for (int rank : dst_ranks) {
+    col_exec->PostToPeer(cp.instance.device_names[rank],
+                         cp.instance.task_names[rank], buf_key(rank), device,
+                         ctx->op_device_context(), attr, &keys,
+                         device->attributes().locality(), collector.Add());
+  }
+  return collector.Wait();
+}
+
+// Receives into '*keys' a tensor of instance keys from each member of the
+// group in 'src_ranks', posted under the key returned by 'buf_key'.
+Status RecvKeys(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                OpKernelContext* ctx, const CollectiveParams& cp,
+                const std::vector<int>& src_ranks,
+                const std::function<string(int)>& buf_key,
+                std::vector<Tensor>* keys) {
+  Device* device = nullptr;
+  TF_RETURN_IF_ERROR(dev_mgr->LookupDevice(
+      cp.instance.device_names[cp.default_rank], &device));
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  keys->clear();
+  for (int i = 0; i < static_cast<int>(src_ranks.size()); ++i) {
+    keys->emplace_back(DT_INT64, TensorShape({kMaxFusedOps + 1}));
+  }
+  StatusCollector collector(src_ranks.size());
+  for (int i = 0; i < static_cast<int>(src_ranks.size()); ++i) {
+    const int rank = src_ranks[i];
+    col_exec->RecvFromPeer(
+        cp.instance.device_names[rank], cp.instance.task_names[rank],
+        cp.task.is_local[rank], buf_key(rank), device,
+        ctx->op_device_context(), attr, &(*keys)[i],
+        device->attributes().locality(), collector.Add());
+  }
+  return collector.Wait();
+}
+
+}  // namespace
+
+CollectiveFuser::CollectiveFuser(const CollectiveFusionOptions& options,
+                                 CollectiveExecutor* col_exec,
+                                 const DeviceMgr* dev_mgr, ReduceFn reduce_fn)
+    : options_(options),
+      col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      reduce_fn_(std::move(reduce_fn)) {}
+
+bool CollectiveFuser::CanFuse(OpKernelContext* ctx,
+                              const CollectiveParams& col_params) const {
+  if (options_.window_micros <= 0 ||
+      col_params.instance.type != REDUCTION_COLLECTIVE ||
+      col_params.instance.compression != COMPRESSION_NONE ||
+      col_params.group.group_size < 2 || !col_params.merge_op) {
+    return false;
+  }
+  switch (col_params.instance.data_type) {
+    case DT_INT32:
+      if (col_params.group.device_type == DEVICE_GPU) return false;
+      break;
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_INT64:
+      break;
+    default:
+      return false;
+  }
+  const int64 bytes = ctx->input(0).TotalBytes();
+  return bytes > 0 && bytes <= options_.max_bytes;
+}
+
+void CollectiveFuser::Enqueue(OpKernelContext* ctx,
+                              const CollectiveParams& col_params,
+                              const StatusCallback& done) {
+  // Every member of the group computes the same key for the same batches.
+  const string key = strings::StrCat(
+      col_params.group.group_key, ":",
+      DataTypeString(col_params.instance.data_type), ":",
+      col_params.merge_op->type_string(), ":",
+      col_params.final_op ? col_params.final_op->type_string() : "Id", ":",
+      ctx->frame_iter().frame_id, ":", ctx->frame_iter().iter_id);
+  Queue* q = nullptr;
+  bool start = false;
+  Status status;
+  {
+    mutex_lock l(mu_);
+    status = status_;
+    if (status.ok()) {
+      std::unique_ptr<Queue>& slot = queues_[strings::StrCat(
+          col_params.instance.device_names[col_params.default_rank], "|",
+          key)];
+      if (!slot) {
+        slot.reset(new Queue);
+        slot->key = key;
+      }
+      q = slot.get();
+      q->pending.push_back({ctx, &col_params, done});
+      start = !q->busy;
+      q->busy = true;
+      queue_cv_.notify_all();
+    }
+  }
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  if (!start) return;
+  // Keep the executor, and so this object, alive until the queue drains.
+  col_exec_->Ref();
+  // Every member gives the reductions still to come a window to be queued
+  // before its first batch, so that the leader finds them queued on the
+  // followers too.
+  const bool lead = col_params.default_rank == 0;
+  SchedNonBlockingClosureAfter(options_.window_micros, [this, q, lead]() {
+    SchedClosure([this, q, lead]() {
+      if (lead) {
+        LeadBatches(q);
+      } else {
+        FollowBatches(q);
+      }
+      col_exec_->Unref();
+    });
+  });
+}
+
+void CollectiveFuser::StartAbort(const Status& s) {
+  std::vector<Item> failed;
+  {
+    mutex_lock l(mu_);
+    if (status_.ok()) status_ = s;
+    for (auto& it : queues_) {
+      Queue* q = it.second.get();
+      failed.insert(failed.end(), q->pending.begin(), q->pending.end());
+      q->pending.clear();
+    }
+    queue_cv_.notify_all();
+  }
+  for (const Item& item : failed) {
+    item.done(s);
+  }
+}
+
+bool CollectiveFuser::StopBatches(Queue* q) {
+  std::vector<Item> failed;
+  Status status;
+  {
+    mutex_lock l(mu_);
+    status = status_;
+    if (status.ok() && !q->pending.empty()) return false;
+    failed.assign(q->pending.begin(), q->pending.end());
+    q->pending.clear();
+    q->busy = false;
+  }
+  for (const Item& item : failed) {
+    item.done(status);
+  }
+  return true;
+}
+
+void CollectiveFuser::LeadBatches(Queue* q) {
+  while (!StopBatches(q)) {
+    Item sample;
+    int64 seq;
+    {
+      mutex_lock l(mu_);
+      // An abort may have emptied the queue since StopBatches.
+      if (q->pending.empty()) continue;
+      sample = q->pending.front();
+      seq = q->next_seq++;
+    }
+    std::unordered_set<int64> ready;
+    Status s = RecvQueued(q, seq, sample, &ready);
+    std::vector<Item> batch;
+    std::vector<int64> instance_keys;
+    if (s.ok()) {
+      mutex_lock l(mu_);
+      // Take the reductions queued on every member, in the order they were
+      // queued here, and leave the others for later batches.
+      int64 bytes = 0;
+      for (auto it = q->pending.begin();
+           it != q->pending.end() &&
+           static_cast<int>(batch.size()) < kMaxFusedOps;) {
+        const int64 instance_key = it->col_params->instance.instance_key;
+        const int64 item_bytes = it->ctx->input(0).TotalBytes();
+        if (ready.count(instance_key) == 0 ||
+            (!batch.empty() && bytes + item_bytes > options_.max_bytes)) {
+          ++it;
+          continue;
+        }
+        bytes += item_bytes;
+        batch.push_back(*it);
+        instance_keys.push_back(instance_key);
+        it = q->pending.erase(it);
+      }
+    }
+    if (s.ok()) s = SendManifest(q, seq, sample, instance_keys);
+    if (!s.ok()) {
+      for (const Item& item : batch) item.done(s);
+      col_exec_->StartAbort(s);
+      continue;
+    }
+    VLOG(2) << "CollectiveFuser leading batch " << seq << " of " << q->key
+            << " with " << batch.size() << " reductions";
+    if (batch.empty()) {
+      // Nothing queued here is queued on every member yet.  Give the
+      // reductions still to come a window to arrive before asking again.
+      mutex_lock l(mu_);
+      if (status_.ok()) {
+        queue_cv_.wait_for(l,
+                           std::chrono::microseconds(options_.window_micros));
+      }
+      continue;
+    }
+    RunBatch(q, seq, &batch);
+  }
+}
+
+void CollectiveFuser::FollowBatches(Queue* q) {
+  while (!StopBatches(q)) {
+    Item sample;
+    int64 seq;
+    std::vector<int64> queued;
+    {
+      mutex_lock l(mu_);
+      if (q->pending.empty()) continue;
+      sample = q->pending.front();
+      seq = q->next_seq++;
+      for (const Item& item : q->pending) {
+        if (static_cast<int>(queued.size()) == kMaxFusedOps) break;
+        queued.push_back(item.col_params->instance.instance_key);
+      }
+    }
+    std::vector<int64> instance_keys;
+    Status s = SendQueued(q, seq, sample, queued);
+    if (s.ok()) s = RecvManifest(q, seq, sample, &instance_keys);
+    if (!s.ok()) {
+      col_exec_->StartAbort(s);
+      continue;
+    }
+    VLOG(2) << "CollectiveFuser following batch " << seq << " of " << q->key
+            << " with " << instance_keys.size() << " reductions";
+    if (instance_keys.empty()) {
+      // Like the leader, wait for more reductions before sending the next
+      // list.
+      mutex_lock l(mu_);
+      if (status_.ok()) {
+        queue_cv_.wait_for(l,
+                           std::chrono::microseconds(options_.window_micros));
+      }
+      continue;
+    }
+    // The leader only picks reductions that were queued here when we sent
+    // 'queued', and only this thread dequeues them.
+    std::vector<Item> batch;
+    {
+      mutex_lock l(mu_);
+      for (int64 instance_key : instance_keys) {
+        auto it = q->pending.begin();
+        while (it != q->pending.end() &&
+               it->col_params->instance.instance_key != instance_key) {
+          ++it;
+        }
+        if (it == q->pending.end()) break;
+        batch.push_back(*it);
+        q->pending.erase(it);
+      }
+    }
+    if (batch.size() != instance_keys.size()) {
+      // Only possible if an abort emptied the queue.
+      s = errors::Internal("Fused reductions of batch ", seq, " of ", q->key,
+                           " are not queued");
+      for (const Item& item : batch) item.done(s);
+      col_exec_->StartAbort(s);
+      continue;
+    }
+    RunBatch(q, seq, &batch);
+  }
+}
+
+Status CollectiveFuser::SendQueued(Queue* q, int64 seq, const Item& sample,
+                                   const std::vector<int64>& instance_keys) {
+  const CollectiveParams& cp = *sample.col_params;
+  return PostKeys(col_exec_, dev_mgr_, sample.ctx, cp, {0},
+                  [q, seq, &cp](int) {
+                    return QueuedKey(q->key, seq, cp.default_rank);
+                  },
+                  EncodeKeys(instance_keys));
+}
+
+Status CollectiveFuser::RecvQueued(Queue* q, int64 seq, const Item& sample,
+                                   std::unordered_set<int64>* ready) {
+  const CollectiveParams& cp = *sample.col_params;
+  std::vector<int> followers;
+  for (int rank = 1; rank < cp.group.group_size; ++rank) {
+    followers.push_back(rank);
+  }
+  std::vector<Tensor> keys;
+  TF_RETURN_IF_ERROR(RecvKeys(
+      col_exec_, dev_mgr_, sample.ctx, cp, followers,
+      [q, seq](int rank) { return QueuedKey(q->key, seq, rank); }, &keys));
+  for (int i = 0; i < static_cast<int>(keys.size()); ++i) {
+    std::vector<int64> queued;
+    TF_RETURN_IF_ERROR(DecodeKeys(keys[i], q->key, &queued));
+    if (i == 0) {
+      ready->insert(queued.begin(), queued.end());
+      continue;
+    }
+    std::unordered_set<int64> queued_set(queued.begin(), queued.end());
+    for (auto it = ready->begin(); it != ready->end();) {
+      if (queued_set.count(*it) == 0) {
+        it = ready->erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status CollectiveFuser::SendManifest(Queue* q, int64 seq, const Item& sample,
+                                     const std::vector<int64>& instance_keys) {
+  const CollectiveParams& cp = *sample.col_params;
+  std::vector<int> followers;
+  for (int rank = 1; rank < cp.group.group_size; ++rank) {
+    followers.push_back(rank);
+  }
+  return PostKeys(
+      col_exec_, dev_mgr_, sample.ctx, cp, followers,
+      [q, seq](int rank) { return ManifestKey(q->key, seq, rank); },
+      EncodeKeys(instance_keys));
+}
+
+Status CollectiveFuser::RecvManifest(Queue* q, int64 seq, const Item& sample,
+                                     std::vector<int64>* instance_keys) {
+  const CollectiveParams& cp = *sample.col_params;
+  std::vector<Tensor> keys;
+  TF_RETURN_IF_ERROR(RecvKeys(
+      col_exec_, dev_mgr_, sample.ctx, cp, {0},
+      [q, seq, &cp](int) {
+        return ManifestKey(q->key, seq, cp.default_rank);
+      },
+      &keys));
+  return DecodeKeys(keys[0], q->key, instance_keys);
+}
+
+void CollectiveFuser::RunBatch(Queue* q, int64 seq, std::vector<Item>* batch) {
+  // The first reduction of the batch stands in for all of them.
+  const CollectiveParams& cp = *(*batch)[0].col_params;
+  OpKernelContext* ctx = (*batch)[0].ctx;
+  Device* device = nullptr;
+  Status status = dev_mgr_->LookupDevice(
+      cp.instance.device_names[cp.default_rank], &device);
+  std::vector<const Tensor*> inputs;
+  for (const Item& item : *batch) inputs.push_back(&item.ctx->input(0));
+  std::vector<int64> offsets;
+  const int64 total_elts =
+      FusedOffsets(cp.instance.data_type, inputs, &offsets);
+  Tensor fused;
+  // Aliases of the slices of 'fused', shaped like the inputs.
+  std::vector<Tensor> slices(batch->size());
+
+  // The padding between slices, which is reduced along with them, and so
+  // must not hold garbage such as signaling NaNs.
+  std::vector<std::pair<int64, int64>> padding;
+  for (int i = 0; i < static_cast<int>(batch->size()); ++i) {
+    const int64 start = offsets[i] + inputs[i]->NumElements();
+    const int64 limit =
+        i + 1 < static_cast<int>(batch->size()) ? offsets[i + 1] : total_elts;
+    if (start < limit) padding.emplace_back(start, limit);
+  }
+  Tensor zeros;
+  // Aliases of the padding of 'fused', and of as many of 'zeros'.
+  std::vector<Tensor> padding_slices(padding.size());
+  std::vector<Tensor> zero_slices(padding.size());
+  AllocatorAttributes host_attr;
+  host_attr.set_on_host(true);
+
+  if (status.ok()) {
+    fused = Tensor(device->GetAllocator(ctx->output_alloc_attr(0)),
+                   cp.instance.data_type, TensorShape({total_elts}));
+    StatusCollector collector(batch->size() + padding.size());
+    if (!padding.empty()) {
+      int64 max_padding = 0;
+      for (const auto& p : padding) {
+        max_padding = std::max(max_padding, p.second - p.first);
+      }
+      zeros = Tensor(cpu_allocator(), cp.instance.data_type,
+                     TensorShape({max_padding}));
+      memset(DMAHelper::base(&zeros), 0, zeros.TotalBytes());
+    }
+    for (int i = 0; i < static_cast<int>(padding.size()); ++i) {
+      zero_slices[i] = zeros.Slice(0, padding[i].second - padding[i].first);
+      padding_slices[i] = fused.Slice(padding[i].first, padding[i].second);
+      CollectiveRemoteAccessLocal::MemCpyAsync(
+          ctx->op_device_context(), ctx->op_device_context(), device, device,
+          host_attr, ctx->output_alloc_attr(0), &zero_slices[i],
+          &padding_slices[i], collector.Add());
+    }
+    for (int i = 0; i < static_cast<int>(batch->size()); ++i) {
+      const Tensor* input = inputs[i];
+      CHECK(slices[i].CopyFrom(
+          fused.Slice(offsets[i], offsets[i] + input->NumElements()),
+          input->shape()));
+      OpKernelContext* item_ctx = (*batch)[i].ctx;
+      CollectiveRemoteAccessLocal::MemCpyAsync(
+          item_ctx->input_device_context(0), ctx->op_device_context(), device,
+          device, item_ctx->input_alloc_attr(0), ctx->output_alloc_attr(0),
+          input, &slices[i], collector.Add());
+    }
+    status = collector.Wait();
+  }
+  if (status.ok()) {
+    StatusCollector collector(1);
+    reduce_fn_(ctx, cp, strings::StrCat("fused(", q->key, "):", seq), &fused,
+               &fused, collector.Add());
+    status = collector.Wait();
+  }
+  if (status.ok()) {
+    StatusCollector collector(batch->size());
+    for (int i = 0; i < static_cast<int>(batch->size()); ++i) {
+      CHECK(slices[i].CopyFrom(
+          fused.Slice(offsets[i], offsets[i] + inputs[i]->NumElements()),
+          inputs[i]->shape()));
+      OpKernelContext* item_ctx = (*batch)[i].ctx;
+      CollectiveRemoteAccessLocal::MemCpyAsync(
+          ctx->op_device_context(), item_ctx->op_device_context(), device,
+          device, ctx->output_alloc_attr(0), item_ctx->output_alloc_attr(0),
+          &slices[i], item_ctx->mutable_output(0), collector.Add());
+    }
+    status = collector.Wait();
+  }
+  if (!status.ok()) col_exec_->StartAbort(status);
+  for (const Item& item : *batch) {
+    item.done(status);
+  }
+}
+
+}  // namespace tensorflow
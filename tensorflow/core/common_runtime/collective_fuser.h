@@ -0,0 +1,141 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+class Device;
+class DeviceMgr;
+
+struct CollectiveFusionOptions {
+  // How long the first reduction queued on a device waits for others to
+  // fuse with.
+  // Fusion is disabled if zero.
+  int64 window_micros = 0;
+  // Upper bound on the size of a fused value.  Larger values are never
+  // fused.
+  int64 max_bytes = 4 << 20;
+};
+
+// Fuses concurrent collective reductions of small values, so that many of
+// them share the per-transfer cost of a single larger reduction.
+//
+// Reductions can be fused if they are run on the same device in the same
+// step, frame and iteration, with the same group, data type, merge_op and
+// final_op.  Every member of a group must fuse the same reductions, in the
+// same order, so the device with rank 0 in the group decides.  Each member
+// waits window_micros after its first reduction is queued, so that others
+// can join it.  Then for each batch, every other member sends the leader
+// the instance keys of the reductions queued on that member, and the
+// leader picks those that are queued on every member and sends their
+// instance keys back.  Beyond the window, no member waits for a reduction
+// to be queued, since it may depend on the result of one that is.  Each
+// member then copies the inputs of the batch into one buffer, reduces it
+// as if it were the input of the first reduction of the batch, and copies
+// the slices of the result back out.
+class CollectiveFuser {
+ public:
+  // Runs a single, possibly fused, reduction and calls 'done'.
+  typedef std::function<void(OpKernelContext* ctx,
+                             const CollectiveParams& col_params,
+                             const string& exec_key, const Tensor* input,
+                             Tensor* output, const StatusCallback& done)>
+      ReduceFn;
+
+  CollectiveFuser(const CollectiveFusionOptions& options,
+                  CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                  ReduceFn reduce_fn);
+
+  // Returns true if the reduction of the input of 'ctx' with 'col_params'
+  // may be passed to Enqueue.
+  bool CanFuse(OpKernelContext* ctx, const CollectiveParams& col_params) const;
+
+  // Reduces the input of 'ctx' into its output as part of a fused batch,
+  // then calls 'done'.
+  void Enqueue(OpKernelContext* ctx, const CollectiveParams& col_params,
+               const StatusCallback& done);
+
+  // Fails all queued reductions, and all later ones, with 's'.  Errors
+  // within the fuser go through CollectiveExecutor::StartAbort, which must
+  // call this.
+  void StartAbort(const Status& s);
+
+ private:
+  struct Item {
+    OpKernelContext* ctx;
+    const CollectiveParams* col_params;
+    StatusCallback done;
+  };
+
+  // The reductions waiting on one device to be fused with each other.
+  struct Queue {
+    // Identifies the batches of this queue across the group.
+    string key;
+    std::deque<Item> pending;
+    // True while a thread is forming or running batches of this queue.
+    bool busy = false;
+    // Sequence number of the next batch.
+    int64 next_seq = 0;
+  };
+
+  // Form and run batches until 'q' is empty.
+  void LeadBatches(Queue* q);
+  void FollowBatches(Queue* q);
+
+  // Returns true, after clearing q->busy, if the thread forming batches of
+  // 'q' should stop.  Fails the pending items of 'q' if aborted.
+  bool StopBatches(Queue* q);
+
+  // Sends the instance keys of the reductions queued on a follower to the
+  // leader, before batch 'seq' of 'q'.  The leader receives them from every
+  // follower and keeps in '*ready' the ones queued on all of them.
+  Status SendQueued(Queue* q, int64 seq, const Item& sample,
+                    const std::vector<int64>& instance_keys);
+  Status RecvQueued(Queue* q, int64 seq, const Item& sample,
+                    std::unordered_set<int64>* ready);
+
+  // Sends or receives the instance keys of batch 'seq' of 'q', which may be
+  // empty if no reduction is queued on every member.
+  Status SendManifest(Queue* q, int64 seq, const Item& sample,
+                      const std::vector<int64>& instance_keys);
+  Status RecvManifest(Queue* q, int64 seq, const Item& sample,
+                      std::vector<int64>* instance_keys);
+
+  // Reduces 'batch' and calls the done callback of each of its items.
+  void RunBatch(Queue* q, int64 seq, std::vector<Item>* batch);
+
+  const CollectiveFusionOptions options_;
+  CollectiveExecutor* col_exec_;  // Not owned
+  const DeviceMgr* dev_mgr_;      // Not owned
+  const ReduceFn reduce_fn_;
+
+  mutex mu_;
+  condition_variable queue_cv_;
+  Status status_ GUARDED_BY(mu_);
+  std::unordered_map<string, std::unique_ptr<Queue>> queues_ GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
@@ -0,0 +1,372 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fuser.h"
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_testlib.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+class CollectiveFuserTest : public ::testing::Test {
+ protected:
+  ~CollectiveFuserTest() override {
+    for (auto op : ops_) {
+      delete op;
+    }
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  // Sets up num_devices CPU devices, and an executor that fuses reductions
+  // if window_micros is positive.
+  void Init(int num_devices, int64 window_micros, int fail_after) {
+    std::vector<Device*> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int di = 0; di < num_devices; ++di) {
+      string dev_name =
+          strings::StrCat("/job:worker/replica:0/task:0/cpu:", di);
+      local_devices.push_back(new ThreadPoolDevice(
+          sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+    }
+    dev_mgr_.reset(new DeviceMgr(local_devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    rma_ = new test::CountingRMA(dev_mgr_.get(), dev_resolver_.get(),
+                                 kStepId, fail_after);
+    CollectiveFusionOptions options;
+    options.window_micros = window_micros;
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get(), options);
+    num_devices_ = num_devices;
+  }
+
+  // Adds a reduction with 'instance_key' of 'tensor_len' elements on every
+  // device.
+  template <typename T>
+  void AddReduction(DataType dtype, int instance_key, int tensor_len) {
+    std::vector<T> expected(tensor_len, 0);
+    std::vector<Tensor> tensors;
+    for (int di = 0; di < num_devices_; ++di) {
+      Tensor t(dtype, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        T value = static_cast<T>(di * 10 + i + instance_key);
+        t.flat<T>()(i) = value;
+        expected[i] += value;
+      }
+      tensors.push_back(t);
+    }
+    Tensor expected_t(dtype, TensorShape({tensor_len}));
+    for (int i = 0; i < tensor_len; ++i) {
+      expected_t.flat<T>()(i) = expected[i] / static_cast<T>(num_devices_);
+    }
+    for (int di = 0; di < num_devices_; ++di) {
+      ops_.push_back(
+          new OpInstance(this, di, dtype, instance_key, tensors[di]));
+      ops_.back()->expected_ = expected_t;
+    }
+  }
+
+  // Starts every reduction, then waits for all of them.
+  void Run() {
+    for (auto op : ops_) op->Start();
+    for (auto op : ops_) op->done_.WaitForNotification();
+  }
+
+  template <typename T>
+  void CheckResults() {
+    for (auto op : ops_) {
+      TF_EXPECT_OK(op->status_);
+      const Tensor& actual = *op->ctx_->mutable_output(0);
+      ASSERT_EQ(op->expected_.NumElements(), actual.NumElements());
+      for (int i = 0; i < actual.NumElements(); ++i) {
+        EXPECT_EQ(op->expected_.flat<T>()(i), actual.flat<T>()(i))
+            << "Mismatch in instance " << op->col_params_.instance.instance_key
+            << " rank " << op->col_params_.default_rank << " index " << i;
+      }
+    }
+  }
+
+  // One collective reduction on one device, run through
+  // BaseCollectiveExecutor::ExecuteAsync like CollectiveReduceOpKernel.
+  class OpInstance {
+   public:
+    OpInstance(CollectiveFuserTest* parent, int rank, DataType dtype,
+               int instance_key, const Tensor& tensor)
+        : parent_(parent), tensor_(tensor) {
+      col_params_.name = strings::StrCat("reduce_", instance_key);
+      col_params_.group.group_key = 5;
+      col_params_.group.device_type = DEVICE_CPU;
+      col_params_.group.group_size = parent_->num_devices_;
+      col_params_.group.num_tasks = 1;
+      col_params_.instance.instance_key = instance_key;
+      col_params_.instance.type = REDUCTION_COLLECTIVE;
+      col_params_.instance.data_type = dtype;
+      col_params_.instance.impl_details.subdiv_offsets = {0};
+      col_params_.instance.impl_details.subdiv_permutations.resize(1);
+      for (int di = 0; di < parent_->num_devices_; ++di) {
+        col_params_.instance.device_names.push_back(
+            strings::StrCat("/job:worker/replica:0/task:0/cpu:", di));
+        col_params_.instance.task_names.push_back(
+            "/job:worker/replica:0/task:0");
+        col_params_.task.is_local.push_back(true);
+        col_params_.instance.impl_details.subdiv_permutations[0].push_back(
+            di);
+      }
+      col_params_.default_rank = rank;
+      col_params_.subdiv_rank = {rank};
+      TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(
+          col_params_.instance.device_names[rank], &device_));
+      col_params_.merge_op = test::GetBinOp("Add", dtype, DEVICE_CPU, device_);
+      col_params_.final_op = test::GetBinOp("Div", dtype, DEVICE_CPU, device_);
+    }
+
+    ~OpInstance() { dev_ctx_->Unref(); }
+
+    void Start() {
+      op_params_.step_id = kStepId;
+      op_params_.device = device_;
+      inputs_.push_back(TensorValue(&tensor_));
+      op_params_.inputs = &inputs_;
+      input_aa_.push_back(AllocatorAttributes());
+      op_params_.input_alloc_attrs = &input_aa_;
+      dev_ctx_ = new DeviceContext;
+      input_dc_.push_back(dev_ctx_);
+      op_params_.input_device_contexts = &input_dc_;
+      op_params_.op_device_context = dev_ctx_;
+      op_params_.forward_from_array = &forward_from_;
+      op_params_.output_attr_array = &generic_alloc_attr_;
+      op_ = test::GetBinOp("Add", col_params_.instance.data_type, DEVICE_CPU,
+                           device_);
+      op_params_.op_kernel = op_.get();
+      ctx_.reset(new OpKernelContext(&op_params_, 1));
+      Tensor* output = nullptr;
+      TF_CHECK_OK(ctx_->forward_input_or_allocate_output({0}, 0,
+                                                         tensor_.shape(),
+                                                         &output));
+      string exec_key =
+          strings::StrCat(col_params_.instance.instance_key, ":0:0");
+      parent_->col_exec_->ExecuteAsync(ctx_.get(), col_params_, exec_key,
+                                       [this](const Status& s) {
+                                         status_ = s;
+                                         done_.Notify();
+                                       });
+    }
+
+    CollectiveFuserTest* parent_;
+    Device* device_ = nullptr;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Tensor expected_;
+    Status status_;
+    Notification done_;
+    OpKernelContext::Params op_params_;
+    gtl::InlinedVector<TensorValue, 4> inputs_;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_aa_;
+    gtl::InlinedVector<DeviceContext*, 4> input_dc_;
+    DeviceContext* dev_ctx_ = nullptr;
+    int forward_from_ = 0;
+    AllocatorAttributes generic_alloc_attr_;
+    std::unique_ptr<OpKernel> op_;
+    std::unique_ptr<OpKernelContext> ctx_;
+  };
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  BaseCollectiveExecutor* col_exec_ = nullptr;
+  test::CountingRMA* rma_ = nullptr;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::vector<OpInstance*> ops_;
+  int num_devices_ = 0;
+};
+
+// Runs reductions outside of a test, e.g. to compare with or to time them.
+class CollectiveFuserRunner : public CollectiveFuserTest {
+ public:
+  using CollectiveFuserTest::AddReduction;
+  using CollectiveFuserTest::Init;
+  using CollectiveFuserTest::ops_;
+  using CollectiveFuserTest::rma_;
+  using CollectiveFuserTest::Run;
+
+  void TestBody() override {}
+};
+
+// Transfers posted by each batch of reductions over 4 devices: the follower
+// lists sent to the leader, the manifests sent back, and 2 * log2(4)
+// transfers of recursive halving and doubling on each device.
+const int64 kPostsPerBatch = 2 * 3 + 4 * 2 * 2;
+
+TEST_F(CollectiveFuserTest, FusesConcurrentReductions) {
+  const int kNumDevices = 4;
+  const int kNumReductions = 16;
+  Init(kNumDevices, 100000, 0);
+  CollectiveFuserRunner unfused;
+  unfused.Init(kNumDevices, 0, 0);
+  for (int k = 0; k < kNumReductions; ++k) {
+    AddReduction<float>(DT_FLOAT, 100 + k, 1 + 37 * k);
+    unfused.AddReduction<float>(DT_FLOAT, 100 + k, 1 + 37 * k);
+  }
+  Run();
+  unfused.Run();
+  CheckResults<float>();
+  // All of them are queued on every device within the window, so they
+  // form a single batch.
+  EXPECT_EQ(kPostsPerBatch, rma_->num_posted());
+  for (int i = 0; i < static_cast<int>(ops_.size()); ++i) {
+    const Tensor& fused_output = *ops_[i]->ctx_->mutable_output(0);
+    const Tensor& unfused_output = *unfused.ops_[i]->ctx_->mutable_output(0);
+    ASSERT_EQ(unfused_output.NumElements(), fused_output.NumElements());
+    for (int j = 0; j < fused_output.NumElements(); ++j) {
+      EXPECT_EQ(unfused_output.flat<float>()(j), fused_output.flat<float>()(j))
+          << "Mismatch in instance "
+          << ops_[i]->col_params_.instance.instance_key << " rank "
+          << ops_[i]->col_params_.default_rank << " index " << j;
+    }
+  }
+}
+
+TEST_F(CollectiveFuserTest, FollowersWaitForWindow) {
+  const int kNumDevices = 4;
+  const int kNumReductions = 4;
+  Init(kNumDevices, 100000, 0);
+  for (int k = 0; k < kNumReductions; ++k) {
+    AddReduction<float>(DT_FLOAT, 100 + k, 64);
+  }
+  // The leader queues every reduction at once, the other members one by
+  // one, well within the window.
+  for (int k = 0; k < kNumReductions; ++k) {
+    ops_[k * kNumDevices]->Start();
+  }
+  for (int k = 0; k < kNumReductions; ++k) {
+    for (int di = 1; di < kNumDevices; ++di) {
+      ops_[k * kNumDevices + di]->Start();
+    }
+    Env::Default()->SleepForMicroseconds(2000);
+  }
+  for (auto op : ops_) op->done_.WaitForNotification();
+  CheckResults<float>();
+  EXPECT_EQ(kPostsPerBatch, rma_->num_posted());
+}
+
+TEST_F(CollectiveFuserTest, NoFusionWithoutWindow) {
+  const int kNumDevices = 4;
+  const int kNumReductions = 4;
+  Init(kNumDevices, 0, 0);
+  for (int k = 0; k < kNumReductions; ++k) {
+    AddReduction<float>(DT_FLOAT, 100 + k, 1024);
+  }
+  Run();
+  CheckResults<float>();
+  // Recursive halving and doubling takes 2 * log2(kNumDevices) transfers
+  // on each device.
+  EXPECT_EQ(kNumReductions * kNumDevices * 2 * 2, rma_->num_posted());
+}
+
+TEST_F(CollectiveFuserTest, FusesOnlyMatchingTypes) {
+  const int kNumDevices = 3;
+  Init(kNumDevices, 10000, 0);
+  AddReduction<float>(DT_FLOAT, 100, 1001);
+  AddReduction<double>(DT_DOUBLE, 101, 17);
+  AddReduction<float>(DT_FLOAT, 102, 4);
+  AddReduction<double>(DT_DOUBLE, 103, 4095);
+  Run();
+  for (auto op : ops_) {
+    TF_EXPECT_OK(op->status_);
+    const Tensor& actual = *op->ctx_->mutable_output(0);
+    ASSERT_EQ(op->expected_.NumElements(), actual.NumElements());
+    for (int i = 0; i < actual.NumElements(); ++i) {
+      if (actual.dtype() == DT_FLOAT) {
+        EXPECT_EQ(op->expected_.flat<float>()(i), actual.flat<float>()(i));
+      } else {
+        EXPECT_EQ(op->expected_.flat<double>()(i), actual.flat<double>()(i));
+      }
+    }
+  }
+}
+
+TEST_F(CollectiveFuserTest, DoesNotWaitForDependentReductions) {
+  const int kNumDevices = 3;
+  Init(kNumDevices, 10000, 0);
+  AddReduction<float>(DT_FLOAT, 100, 64);
+  AddReduction<float>(DT_FLOAT, 101, 64);
+  // The leader queues both reductions at once.  The other members only
+  // start the second one once the first is done, as if it consumed its
+  // result, so the two must not be fused.
+  ops_[0]->Start();
+  ops_[kNumDevices]->Start();
+  for (int di = 1; di < kNumDevices; ++di) ops_[di]->Start();
+  for (int di = 1; di < kNumDevices; ++di) {
+    ops_[di]->done_.WaitForNotification();
+    ops_[kNumDevices + di]->Start();
+  }
+  for (auto op : ops_) op->done_.WaitForNotification();
+  CheckResults<float>();
+}
+
+TEST_F(CollectiveFuserTest, Abort) {
+  const int kNumDevices = 4;
+  Init(kNumDevices, 10000, 5);
+  for (int k = 0; k < 8; ++k) {
+    AddReduction<float>(DT_FLOAT, 100 + k, 512);
+  }
+  Run();
+  for (auto op : ops_) {
+    EXPECT_EQ("Deliberate failure", op->status_.error_message());
+  }
+}
+
+// Measures the time to run the reductions of one step, 'num_reductions'
+// small gradients over 4 devices, with fusion if 'fuse' is 1.
+static void BM_StepTime(int iters, int fuse, int num_reductions) {
+  testing::StopTiming();
+  const int kNumDevices = 4;
+  for (int i = 0; i < iters; ++i) {
+    CollectiveFuserRunner bm;
+    bm.Init(kNumDevices, fuse ? 100 : 0, 0);
+    for (int k = 0; k < num_reductions; ++k) {
+      bm.AddReduction<float>(DT_FLOAT, 100 + k, 256);
+    }
+    testing::StartTiming();
+    bm.Run();
+    testing::StopTiming();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_reductions);
+}
+BENCHMARK(BM_StepTime)
+    ->ArgPair(0, 16)
+    ->ArgPair(1, 16)
+    ->ArgPair(0, 128)
+    ->ArgPair(1, 128);
+
+}  // namespace
+}  // namespace tensorflow
@@ -411,6 +411,19 @@ void GenerateSubdivPerms(const string& device, int source_rank,
   }
 }
 
+// Chooses the algorithm for a reduction from the distribution of devices
+// over tasks.  When the group spans several tasks with more than one device
+// each, reducing within each task first means that only one device per
+// shard of the value takes part in the ring between tasks.
+void SetReductionAlgorithm(CollectiveParams* cp) {
+  cp->instance.impl_details.reduction_algorithm = REDUCTION_RING;
+  if (cp->instance.type == REDUCTION_COLLECTIVE && cp->group.num_tasks > 1 &&
+      cp->instance.same_num_devices_per_task &&
+      cp->group.group_size > cp->group.num_tasks) {
+    cp->instance.impl_details.reduction_algorithm = REDUCTION_HIERARCHICAL;
+  }
+}
+
 }  // namespace
 
 void CollectiveParamResolverLocal::CompleteTaskIsLocal(const string& task_name,
@@ -676,6 +689,7 @@ void CollectiveParamResolverLocal::CompleteInstanceFromInitializedIRec(
     return;
   } else {
     GenerateSubdivPerms(device, 0, cp);
+    SetReductionAlgorithm(cp);
   }
   done(Status::OK());
 }
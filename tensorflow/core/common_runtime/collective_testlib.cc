@@ -0,0 +1,128 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_testlib.h"
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace test {
+
+bool CountingRMA::MaybeFail(const StatusCallback& done) {
+  bool fail_now = false;
+  {
+    mutex_lock l(mu_);
+    if (fail_after_ > 0) {
+      fail_now = (--fail_after_ == 0);
+    }
+  }
+  if (fail_now) {
+    done(errors::Internal("Deliberate failure"));
+    return true;
+  }
+  return false;
+}
+
+void CountingRMA::RecvFromPeer(const string& peer_device,
+                               const string& peer_task, bool peer_is_local,
+                               const string& key, Device* to_device,
+                               DeviceContext* to_device_ctx,
+                               const AllocatorAttributes& to_alloc_attr,
+                               Tensor* to_tensor,
+                               const DeviceLocality& client_locality,
+                               const StatusCallback& done) {
+  if (MaybeFail(done)) return;
+  CollectiveRemoteAccessLocal::RecvFromPeer(
+      peer_device, peer_task, peer_is_local, key, to_device, to_device_ctx,
+      to_alloc_attr, to_tensor, client_locality, done);
+}
+
+void CountingRMA::PostToPeer(const string& peer_device,
+                             const string& peer_task, const string& key,
+                             Device* from_device,
+                             DeviceContext* from_device_ctx,
+                             const AllocatorAttributes& from_alloc_attr,
+                             const Tensor* from_tensor,
+                             const DeviceLocality& client_locality,
+                             const StatusCallback& done) {
+  if (MaybeFail(done)) return;
+  string from_task, unused;
+  CHECK(DeviceNameUtils::SplitDeviceName(from_device->name(), &from_task,
+                                         &unused));
+  {
+    mutex_lock l(mu_);
+    ++num_posted_;
+    if (from_task == peer_task) {
+      bytes_within_tasks_ += from_tensor->TotalBytes();
+    } else {
+      bytes_across_tasks_ += from_tensor->TotalBytes();
+    }
+  }
+  CollectiveRemoteAccessLocal::PostToPeer(
+      peer_device, peer_task, key, from_device, from_device_ctx,
+      from_alloc_attr, from_tensor, client_locality, done);
+}
+
+int64 CountingRMA::num_posted() {
+  mutex_lock l(mu_);
+  return num_posted_;
+}
+
+int64 CountingRMA::bytes_posted() {
+  mutex_lock l(mu_);
+  return bytes_within_tasks_ + bytes_across_tasks_;
+}
+
+int64 CountingRMA::bytes_within_tasks() {
+  mutex_lock l(mu_);
+  return bytes_within_tasks_;
+}
+
+int64 CountingRMA::bytes_across_tasks() {
+  mutex_lock l(mu_);
+  return bytes_across_tasks_;
+}
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node,
+                                    const DeviceType& device_type,
+                                    DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      device_type, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  if (!status.ok()) {
+    LOG(FATAL) << status;
+  }
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DataType dtype,
+                                   const DeviceType& device_type,
+                                   DeviceBase* device) {
+  NodeDef node_def;
+  NodeDefBuilder builder(strings::StrCat(op, "_node"), op);
+  TF_CHECK_OK(builder.Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device_type, device);
+}
+
+}  // namespace test
+}  // namespace tensorflow
@@ -0,0 +1,85 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_TESTLIB_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_TESTLIB_H_
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace test {
+
+// Wraps CollectiveRemoteAccessLocal with the ability to return an
+// error status to the N'th action, and counts the transfers posted.
+class CountingRMA : public CollectiveRemoteAccessLocal {
+ public:
+  // A 'fail_after' of 0 never fails.
+  CountingRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
+              int64 step_id, int fail_after)
+      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, step_id),
+        fail_after_(fail_after) {}
+
+  void RecvFromPeer(const string& peer_device, const string& peer_task,
+                    bool peer_is_local, const string& key, Device* to_device,
+                    DeviceContext* to_device_ctx,
+                    const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
+                    const DeviceLocality& client_locality,
+                    const StatusCallback& done) override;
+
+  void PostToPeer(const string& peer_device, const string& peer_task,
+                  const string& key, Device* from_device,
+                  DeviceContext* from_device_ctx,
+                  const AllocatorAttributes& from_alloc_attr,
+                  const Tensor* from_tensor,
+                  const DeviceLocality& client_locality,
+                  const StatusCallback& done) override;
+
+  int64 num_posted();
+  int64 bytes_posted();
+  // Bytes posted to a device of the same task as the sender, and to one of
+  // another task.
+  int64 bytes_within_tasks();
+  int64 bytes_across_tasks();
+
+ private:
+  // Calls 'done' with an error and returns true if this action should fail.
+  bool MaybeFail(const StatusCallback& done);
+
+  mutex mu_;
+  int fail_after_ GUARDED_BY(mu_);
+  int64 num_posted_ GUARDED_BY(mu_) = 0;
+  int64 bytes_within_tasks_ GUARDED_BY(mu_) = 0;
+  int64 bytes_across_tasks_ GUARDED_BY(mu_) = 0;
+};
+
+// Returns the kernel for 'node' on 'device'.  CHECK-fails on error.
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node,
+                                    const DeviceType& device_type,
+                                    DeviceBase* device);
+
+// Returns the kernel of the binary Op 'op', e.g. "Add" or "Div", with two
+// inputs of type 'dtype', for use as a merge_op or final_op.
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DataType dtype,
+                                   const DeviceType& device_type,
+                                   DeviceBase* device);
+
+}  // namespace test
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_TESTLIB_H_
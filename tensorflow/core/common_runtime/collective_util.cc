@@ -0,0 +1,128 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_util.h"
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/lib/core/notification.h"
+
+namespace tensorflow {
+namespace collective_util {
+
+SubContext::SubContext(OpKernelContext* ctx, OpKernelContext::Params* params,
+                       OpKernel* op, Tensor* output, Tensor* input)
+    : sub_params_(*params),
+      sub_inputs_({output, input}),
+      sub_input_attr_({ctx->input_alloc_attr(0), ctx->input_alloc_attr(0)}),
+      sub_input_dc_(
+          {ctx->input_device_context(0), ctx->input_device_context(0)}) {
+  sub_params_.op_kernel = op;
+  sub_params_.inputs = &sub_inputs_;
+  sub_params_.input_alloc_attrs = &sub_input_attr_;
+  sub_params_.input_device_contexts = &sub_input_dc_;
+  sub_params_.eigen_gpu_device = nullptr;
+  sub_params_.ensure_eigen_gpu_device();
+  sub_params_.forward_from_array = &forward_from_;
+  sub_ctx_.reset(new OpKernelContext(&sub_params_, 1));
+}
+
+Status ComputeBinOp(OpKernelContext* ctx, OpKernelContext::Params* params,
+                    Device* device, OpKernel* op, Tensor* output,
+                    Tensor* input) {
+  // Prepare an OpKernelContext that is identical to that of the original Op
+  // (i.e. the collective), except for the input output sizes and identities
+  // and the Op itself.
+  // TODO(tucker): Is it possible to cache and reuse these objects?  They're
+  // mostly identical inside one device execution.
+  SubContext sub_ctx(ctx, params, op, output, input);
+  device->Compute(op, sub_ctx.sub_ctx());
+  return sub_ctx.sub_ctx()->status();
+}
+
+Status CopyInputToOutput(OpKernelContext* ctx, Device* device,
+                         const Tensor* input, Tensor* output) {
+  if ((input == output) ||
+      (DMAHelper::base(input) == DMAHelper::base(output))) {
+    return Status::OK();
+  }
+  Status status;
+  Notification note;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      ctx->input_device_context(0), ctx->op_device_context(), device, device,
+      ctx->input_alloc_attr(0), ctx->output_alloc_attr(0), input, output,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status MakeGroupSizeTensor(OpKernelContext* ctx, Device* device,
+                           const CollectiveParams& col_params,
+                           CollectiveAdapter* ca, Tensor* group_size_tensor) {
+  // TODO(tucker): Cache and reuse across invocations? Or maybe the scalar
+  // can be provided to the kernel in host memory?
+  Tensor group_size_val = ca->Scalar(col_params.group.group_size);
+  if (col_params.group.device_type == DEVICE_CPU) {
+    *group_size_tensor = group_size_val;
+    return Status::OK();
+  }
+  *group_size_tensor =
+      ca->Scalar(device->GetAllocator(ctx->input_alloc_attr(0)));
+  Status status;
+  Notification note;
+  ctx->op_device_context()->CopyCPUTensorToDevice(
+      &group_size_val, device, group_size_tensor,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+void CollectiveStatus::StartAbort(const Status& s) {
+  bool abort_started = false;
+  {
+    mutex_lock l(mu_);
+    if (status_.ok()) {
+      LOG(ERROR) << "Aborting " << name_ << " with " << s;
+      abort_started = true;
+      status_.Update(s);
+    }
+  }
+  // If this is the initial entry to abort mode then invoke StartAbort
+  // on the CollectiveExecutor that invoked us.  That should start
+  // cancellation on all of the outstanding CollectiveRemoteAccess
+  // actions.
+  if (abort_started) {
+    col_exec_->StartAbort(s);
+  }
+}
+
+bool CollectiveStatus::aborted() {
+  mutex_lock l(mu_);
+  return !status_.ok();
+}
+
+Status CollectiveStatus::status() {
+  mutex_lock l(mu_);
+  return status_;
+}
+
+}  // namespace collective_util
+}  // namespace tensorflow
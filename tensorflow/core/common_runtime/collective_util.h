@@ -0,0 +1,92 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_UTIL_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_UTIL_H_
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace collective_util {
+
+// Used for executing a sub-operation, e.g. a merge_op instance, with
+// an OpKernelContext based on the one passed into a collective Op.
+class SubContext {
+ public:
+  SubContext(OpKernelContext* ctx, OpKernelContext::Params* params,
+             OpKernel* op, Tensor* output, Tensor* input);
+
+  OpKernelContext* sub_ctx() { return sub_ctx_.get(); }
+
+ private:
+  OpKernelContext::Params sub_params_;
+  gtl::InlinedVector<TensorValue, 4> sub_inputs_;
+  gtl::InlinedVector<AllocatorAttributes, 4> sub_input_attr_;
+  gtl::InlinedVector<DeviceContext*, 4> sub_input_dc_;
+  // Used only for Binary and Unary Ops for which we require
+  // the calculation to be in-place on the first input.
+  int forward_from_ = 0;
+  std::unique_ptr<OpKernelContext> sub_ctx_;
+};
+
+// Computes the binary Op 'op' on 'device' in-place on 'output', with
+// 'input' as the second operand.
+Status ComputeBinOp(OpKernelContext* ctx, OpKernelContext::Params* params,
+                    Device* device, OpKernel* op, Tensor* output,
+                    Tensor* input);
+
+// Copies 'input' to 'output' unless they share a buffer, i.e. unless the
+// collective computes in-place on its input.  Blocks until the copy is
+// done, so it must not run in a thread which cannot be blocked.
+Status CopyInputToOutput(OpKernelContext* ctx, Device* device,
+                         const Tensor* input, Tensor* output);
+
+// Sets '*group_size_tensor' to an on-device scalar holding the group size,
+// of the type of the values of 'ca', for use as the second operand of the
+// final_op.  Blocks until the value is on the device.
+Status MakeGroupSizeTensor(OpKernelContext* ctx, Device* device,
+                           const CollectiveParams& col_params,
+                           CollectiveAdapter* ca, Tensor* group_size_tensor);
+
+// Holds the status of one collective instance.  The first error recorded
+// starts abort on the CollectiveExecutor, which cancels the outstanding
+// CollectiveRemoteAccess actions of every collective of the step, so
+// implementations can stop issuing transfers and wait for the callbacks
+// of the ones in flight.
+class CollectiveStatus {
+ public:
+  // 'name' identifies the implementation in log messages.
+  CollectiveStatus(CollectiveExecutor* col_exec, const string& name)
+      : col_exec_(col_exec), name_(name) {}
+
+  void StartAbort(const Status& s);
+  bool aborted();
+  Status status();
+
+ private:
+  CollectiveExecutor* col_exec_;  // Not owned
+  const string name_;
+  mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+};
+
+}  // namespace collective_util
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_UTIL_H_
@@ -0,0 +1,255 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+// Phases of the algorithm, distinguished in BufRendezvous keys.
+enum Phase {
+  kFold = 0,
+  kReduceScatter,
+  kAllGather,
+  kUnfold,
+};
+
+// BufRendezvous key for the transfer from device 'src_rank' to device
+// 'dst_rank' in step 'step' of 'phase'.
+string HalvingDoublingBufKey(const string& exec_key, int phase, int step,
+                             int src_rank, int dst_rank) {
+  return strings::StrCat("hdred(", exec_key, "):", phase, ":", step, ":",
+                         src_rank, ":", dst_rank);
+}
+
+}  // namespace
+
+HalvingDoublingReducer::HalvingDoublingReducer(
+    CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+    OpKernelContext* ctx, OpKernelContext::Params* op_params,
+    const CollectiveParams& col_params, const string& exec_key, int64 step_id,
+    const Tensor* input, Tensor* output)
+    : col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      ctx_(ctx),
+      op_params_(op_params),
+      col_params_(col_params),
+      exec_key_(exec_key),
+      input_(input),
+      output_(output),
+      device_(nullptr),
+      status_(col_exec, "HalvingDoublingReduce") {
+  CHECK_GT(col_params_.group.group_size, 0);
+}
+
+/*static*/
+int HalvingDoublingReducer::PowerOfTwoBelow(int group_size) {
+  int p = 1;
+  while (2 * p <= group_size) p *= 2;
+  return p;
+}
+
+/*static*/
+int HalvingDoublingReducer::VirtualRank(int group_size, int rank) {
+  const int num_folded = group_size - PowerOfTwoBelow(group_size);
+  if (rank < 2 * num_folded) {
+    return (rank % 2 == 1) ? rank / 2 : -1;
+  }
+  return rank - num_folded;
+}
+
+/*static*/
+int HalvingDoublingReducer::GroupRank(int group_size, int vrank) {
+  const int num_folded = group_size - PowerOfTwoBelow(group_size);
+  return (vrank < num_folded) ? 2 * vrank + 1 : vrank + num_folded;
+}
+
+void HalvingDoublingReducer::Run(StatusCallback done) {
+  CHECK(dev_mgr_);
+  Status status = dev_mgr_->LookupDevice(
+      col_params_.instance.device_names[col_params_.default_rank], &device_);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to find device "
+               << col_params_.instance.device_names[col_params_.default_rank];
+    done(status);
+    return;
+  }
+  device_locality_ = device_->attributes().locality();
+  const int group_size = col_params_.group.group_size;
+  const int rank = col_params_.default_rank;
+  const int num_vranks = PowerOfTwoBelow(group_size);
+  const int vrank = VirtualRank(group_size, rank);
+  const bool folded = rank < 2 * (group_size - num_vranks);
+  VLOG(1) << "HalvingDoublingReducer::Run for device "
+          << col_params_.instance.device_names[rank] << " rank " << rank
+          << " virtual rank " << vrank << " of " << num_vranks;
+
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  status = collective_util::CopyInputToOutput(ctx_, device_, input_, output_);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+
+  AllocatorAttributes attr = ctx_->output_alloc_attr(0);
+  ca_.reset(
+      MakeCollectiveAdapter(output_, num_vranks, device_->GetAllocator(attr)));
+  if (col_params_.final_op) {
+    status = collective_util::MakeGroupSizeTensor(
+        ctx_, device_, col_params_, ca_.get(), &group_size_tensor_);
+    if (!status.ok()) {
+      done(status);
+      return;
+    }
+  }
+
+  Tensor value = ca_->ChunkRangeAlias(0, num_vranks);
+  const bool empty = value.TotalBytes() == 0;
+  bool ok = true;
+  if (folded && vrank < 0) {
+    // Hand our value to the odd partner, then wait for the result.
+    ok = empty || (Exchange(rank + 1, kFold, 0, &value, nullptr) &&
+                   Exchange(rank + 1, kUnfold, 0, nullptr, &value));
+  } else {
+    if (folded && !empty) {
+      Tensor tmp = ca_->TempChunkRange(0, num_vranks);
+      ok = Exchange(rank - 1, kFold, 0, nullptr, &tmp) &&
+           ComputeBinOp(col_params_.merge_op.get(), &value, &tmp);
+    }
+    ok = ok && ReduceScatter(vrank, num_vranks);
+    if (ok && col_params_.final_op && ca_->ChunkBytes(vrank) > 0) {
+      Tensor chunk = ca_->ChunkAlias(vrank);
+      ok = ComputeBinOp(col_params_.final_op.get(), &chunk,
+                        &group_size_tensor_);
+    }
+    ok = ok && AllGather(vrank, num_vranks);
+    if (ok && folded && !empty) {
+      ok = Exchange(rank - 1, kUnfold, 0, &value, nullptr);
+    }
+  }
+  if (ok) {
+    ca_->ConsumeFinalValue(output_);
+  }
+  done(status_.status());
+}
+
+bool HalvingDoublingReducer::Exchange(int peer, int phase, int step,
+                                      const Tensor* send, Tensor* recv) {
+  const int rank = col_params_.default_rank;
+  Notification send_done;
+  Notification recv_done;
+  if (send) {
+    VLOG(3) << "Exchange rank=" << rank << " sends phase " << phase
+            << " step " << step << " to " << peer;
+    col_exec_->PostToPeer(
+        col_params_.instance.device_names[peer],
+        col_params_.instance.task_names[peer],
+        HalvingDoublingBufKey(exec_key_, phase, step, rank, peer), device_,
+        ctx_->op_device_context(), ctx_->output_alloc_attr(0), send,
+        device_locality_, [this, &send_done](const Status& s) {
+          if (!s.ok()) status_.StartAbort(s);
+          send_done.Notify();
+        });
+  }
+  if (recv) {
+    VLOG(3) << "Exchange rank=" << rank << " receives phase " << phase
+            << " step " << step << " from " << peer;
+    col_exec_->RecvFromPeer(
+        col_params_.instance.device_names[peer],
+        col_params_.instance.task_names[peer],
+        col_params_.task.is_local[peer],
+        HalvingDoublingBufKey(exec_key_, phase, step, peer, rank), device_,
+        ctx_->op_device_context(), ctx_->output_alloc_attr(0), recv,
+        device_locality_, [this, &recv_done](const Status& s) {
+          if (!s.ok()) status_.StartAbort(s);
+          recv_done.Notify();
+        });
+  }
+  if (send) send_done.WaitForNotification();
+  if (recv) recv_done.WaitForNotification();
+  return !status_.aborted();
+}
+
+bool HalvingDoublingReducer::ComputeBinOp(OpKernel* op, Tensor* output,
+                                          Tensor* input) {
+  Status s = collective_util::ComputeBinOp(ctx_, op_params_, device_, op,
+                                          output, input);
+  if (!s.ok()) {
+    status_.StartAbort(s);
+    return false;
+  }
+  return true;
+}
+
+bool HalvingDoublingReducer::ReduceScatter(int vrank, int num_vranks) {
+  const int group_size = col_params_.group.group_size;
+  // Chunks [lo, hi) are those this device is still responsible for.  Both
+  // partners of a step agree on them, and each keeps a different half.
+  int lo = 0;
+  int hi = num_vranks;
+  int step = 0;
+  for (int mask = num_vranks / 2; mask > 0; mask /= 2, ++step) {
+    const int peer = GroupRank(group_size, vrank ^ mask);
+    const int mid = lo + (hi - lo) / 2;
+    const bool keep_upper = (vrank & mask) != 0;
+    Tensor send_range = keep_upper ? ca_->ChunkRangeAlias(lo, mid)
+                                   : ca_->ChunkRangeAlias(mid, hi);
+    if (keep_upper) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+    Tensor keep_range = ca_->ChunkRangeAlias(lo, hi);
+    Tensor tmp;
+    if (keep_range.TotalBytes() > 0) tmp = ca_->TempChunkRange(lo, hi);
+    if (!Exchange(peer, kReduceScatter, step,
+                  send_range.TotalBytes() > 0 ? &send_range : nullptr,
+                  keep_range.TotalBytes() > 0 ? &tmp : nullptr)) {
+      return false;
+    }
+    if (keep_range.TotalBytes() > 0 &&
+        !ComputeBinOp(col_params_.merge_op.get(), &keep_range, &tmp)) {
+      return false;
+    }
+  }
+  DCHECK_EQ(lo, vrank);
+  return true;
+}
+
+bool HalvingDoublingReducer::AllGather(int vrank, int num_vranks) {
+  const int group_size = col_params_.group.group_size;
+  int step = 0;
+  for (int mask = 1; mask < num_vranks; mask *= 2, ++step) {
+    // This device holds the final values of the 'mask' chunks starting at
+    // 'lo', and its partner those of the adjacent block of the same size.
+    const int peer_vrank = vrank ^ mask;
+    const int lo = vrank & ~(mask - 1);
+    const int peer_lo = peer_vrank & ~(mask - 1);
+    Tensor send_range = ca_->ChunkRangeAlias(lo, lo + mask);
+    Tensor recv_range = ca_->ChunkRangeAlias(peer_lo, peer_lo + mask);
+    if (!Exchange(GroupRank(group_size, peer_vrank), kAllGather, step,
+                  send_range.TotalBytes() > 0 ? &send_range : nullptr,
+                  recv_range.TotalBytes() > 0 ? &recv_range : nullptr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,95 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+
+namespace tensorflow {
+class DeviceMgr;
+
+// Recursive halving and doubling (Rabenseifner) implementation of
+// collective all-reduce.
+//
+// With p the largest power of 2 not above the group size, the value is
+// divided into p chunks.  A reduce-scatter by recursive halving leaves each
+// of p devices with the sum of one chunk after log2(p) exchanges, in which
+// the devices swap half of the chunks they still hold with a partner whose
+// rank differs in one bit.  An all-gather by recursive doubling then undoes
+// the exchanges in reverse order.  When the group size is not a power of 2
+// the first 2 * (group_size - p) devices pair up beforehand: the even rank
+// of each pair folds its value into the odd one, sits out, and receives the
+// final value at the end.
+//
+// This takes 2 * log2(p) steps, plus 2 if the group size is not a power of
+// 2, instead of the 2 * (group_size - 1) steps of RingReducer, so it has
+// lower latency for small values where per-transfer overhead dominates.
+class HalvingDoublingReducer : public CollectiveImplementationInterface {
+ public:
+  HalvingDoublingReducer(CollectiveExecutor* col_exec,
+                         const DeviceMgr* dev_mgr, OpKernelContext* ctx,
+                         OpKernelContext::Params* op_params,
+                         const CollectiveParams& col_params,
+                         const string& exec_key, int64 step_id,
+                         const Tensor* input, Tensor* output);
+
+  ~HalvingDoublingReducer() override {}
+
+  void Run(StatusCallback done) override;
+
+  // Returns the largest power of 2 not greater than 'group_size'.
+  static int PowerOfTwoBelow(int group_size);
+
+  // Returns the rank within the power of 2 sized subgroup that takes part
+  // in the halving and doubling steps of the device with group rank 'rank',
+  // or -1 if the device folds its value into a partner and sits out.
+  static int VirtualRank(int group_size, int rank);
+
+  // Inverse of VirtualRank.
+  static int GroupRank(int group_size, int vrank);
+
+ private:
+  // Sends 'send' to and receives 'recv' from the device with rank 'peer',
+  // concurrently, and waits for both to complete.  Either may be null.
+  // Returns false if aborted.
+  bool Exchange(int peer, int phase, int step, const Tensor* send,
+                Tensor* recv);
+
+  bool ReduceScatter(int vrank, int num_vranks);
+  bool AllGather(int vrank, int num_vranks);
+
+  bool ComputeBinOp(OpKernel* op, Tensor* output, Tensor* input);
+
+  CollectiveExecutor* col_exec_;        // Not owned
+  const DeviceMgr* dev_mgr_;            // Not owned
+  OpKernelContext* ctx_;                // Not owned
+  OpKernelContext::Params* op_params_;  // Not owned
+  const CollectiveParams& col_params_;
+  const string exec_key_;
+  const Tensor* input_;  // Not owned
+  Tensor* output_;       // Not owned
+  Device* device_;       // The device for which this instance labors
+  DeviceLocality device_locality_;
+  std::unique_ptr<CollectiveAdapter> ca_;
+  Tensor group_size_tensor_;
+
+  collective_util::CollectiveStatus status_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
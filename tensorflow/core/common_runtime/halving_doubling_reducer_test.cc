@@ -0,0 +1,352 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_testlib.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+class HalvingDoublingReducerTest : public ::testing::Test {
+ protected:
+  ~HalvingDoublingReducerTest() override {
+    for (auto i : instances_) {
+      delete i;
+    }
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  // Sets up a group of num_devices CPU devices.  If 'halving_doubling' is
+  // false the devices run a RingReducer instead, for comparison.
+  void Init(int num_devices, DataType dtype, int fail_after,
+            bool halving_doubling) {
+    std::vector<Device*> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int di = 0; di < num_devices; ++di) {
+      string dev_name =
+          strings::StrCat("/job:worker/replica:0/task:0/cpu:", di);
+      local_devices.push_back(new ThreadPoolDevice(
+          sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+    }
+    dev_mgr_.reset(new DeviceMgr(local_devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    rma_ = new test::CountingRMA(dev_mgr_.get(), dev_resolver_.get(),
+                                 kStepId, fail_after);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get());
+    halving_doubling_ = halving_doubling;
+    col_params_.name = "test_collective";
+    col_params_.group.group_key = 5;
+    col_params_.group.device_type = DEVICE_CPU;
+    col_params_.group.group_size = num_devices;
+    col_params_.group.num_tasks = 1;
+    col_params_.instance.instance_key = 17;
+    col_params_.instance.type = REDUCTION_COLLECTIVE;
+    col_params_.instance.data_type = dtype;
+    col_params_.instance.impl_details.subdiv_offsets = {0};
+    col_params_.instance.impl_details.subdiv_permutations.resize(1);
+    for (int di = 0; di < num_devices; ++di) {
+      col_params_.instance.device_names.push_back(
+          strings::StrCat("/job:worker/replica:0/task:0/cpu:", di));
+      col_params_.instance.task_names.push_back(
+          "/job:worker/replica:0/task:0");
+      // This test runs in a single process so is_local is always true.
+      col_params_.task.is_local.push_back(true);
+      col_params_.instance.impl_details.subdiv_permutations[0].push_back(di);
+    }
+    for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+      instances_.push_back(new DeviceInstance(rank, this));
+    }
+  }
+
+  void Reduce() {
+    std::atomic<int> done(0);
+    for (auto di : instances_) {
+      SchedClosure([di, &done] {
+        di->DoReduce();
+        ++done;
+      });
+    }
+    while (done < static_cast<int>(instances_.size())) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+  }
+
+  template <typename T>
+  void InitTensors(DataType dtype, int tensor_len, std::vector<T>* expected) {
+    expected->assign(tensor_len, 0);
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      Tensor* t = &instances_[di]->tensor_;
+      *t = Tensor(dtype, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        T value = static_cast<T>(di * 10 + i);
+        t->flat<T>()(i) = value;
+        (*expected)[i] += value;
+      }
+    }
+    for (int i = 0; i < tensor_len; ++i) {
+      (*expected)[i] /= static_cast<T>(instances_.size());
+    }
+  }
+
+  template <typename T>
+  void RunTest(DataType dtype, int num_devices, int tensor_len,
+               int fail_after) {
+    Init(num_devices, dtype, fail_after, true /*halving_doubling*/);
+    std::vector<T> expected;
+    InitTensors<T>(dtype, tensor_len, &expected);
+    Reduce();
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      if (fail_after > 0) {
+        EXPECT_EQ("Deliberate failure",
+                  instances_[di]->status_.error_message());
+        continue;
+      }
+      TF_EXPECT_OK(instances_[di]->status_);
+      const Tensor& actual = instances_[di]->tensor_;
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_EQ(expected[i], actual.flat<T>()(i))
+            << "Mismatch at device " << di << " index " << i;
+      }
+    }
+  }
+
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, HalvingDoublingReducerTest* parent)
+        : parent_(parent) {
+      const CollectiveParams& cp = parent_->col_params_;
+      TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(
+          cp.instance.device_names[rank], &device_));
+      col_params_.name = cp.name;
+      col_params_.group = cp.group;
+      col_params_.instance = cp.instance;
+      col_params_.task.is_local = cp.task.is_local;
+      col_params_.default_rank = rank;
+      col_params_.subdiv_rank = {rank};
+    }
+
+    void DoReduce() {
+      const DataType dtype = col_params_.instance.data_type;
+      col_params_.merge_op = test::GetBinOp("Add", dtype, DEVICE_CPU, device_);
+      col_params_.final_op = test::GetBinOp("Div", dtype, DEVICE_CPU, device_);
+
+      // Prepare an OpKernelContext.
+      OpKernelContext::Params op_params;
+      op_params.step_id = kStepId;
+      op_params.device = device_;
+      gtl::InlinedVector<TensorValue, 4> inputs;
+      inputs.push_back(TensorValue(&tensor_));
+      op_params.inputs = &inputs;
+      gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+          {AllocatorAttributes()});
+      op_params.input_alloc_attrs = &input_aa;
+      DeviceContext* dev_ctx = new DeviceContext;
+      gtl::InlinedVector<DeviceContext*, 4> input_dc({dev_ctx});
+      op_params.input_device_contexts = &input_dc;
+      op_params.op_device_context = dev_ctx;
+      int forward_from = 0;
+      op_params.forward_from_array = &forward_from;
+      AllocatorAttributes generic_alloc_attr;
+      op_params.output_attr_array = &generic_alloc_attr;
+      std::unique_ptr<OpKernel> op =
+          test::GetBinOp("Add", dtype, DEVICE_CPU, device_);
+      op_params.op_kernel = op.get();
+      OpKernelContext ctx(&op_params, 1);
+      Tensor* output_tensor_ptr = nullptr;
+      TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor_.shape(),
+                                                       &output_tensor_ptr));
+
+      string exec_key =
+          strings::StrCat(col_params_.instance.instance_key, ":0:0");
+      std::unique_ptr<CollectiveImplementationInterface> reducer;
+      if (parent_->halving_doubling_) {
+        reducer.reset(new HalvingDoublingReducer(
+            parent_->col_exec_, parent_->dev_mgr_.get(), &ctx, &op_params,
+            col_params_, exec_key, kStepId, &tensor_, &tensor_));
+      } else {
+        reducer.reset(new RingReducer(
+            parent_->col_exec_, parent_->dev_mgr_.get(), &ctx, &op_params,
+            col_params_, exec_key, kStepId, &tensor_, &tensor_));
+      }
+      Notification notification;
+      SchedClosure([this, &notification, &reducer]() {
+        reducer->Run([this, &notification](Status s) {
+          status_ = s;
+          notification.Notify();
+        });
+      });
+      notification.WaitForNotification();
+      CHECK(tensor_.CopyFrom(*ctx.mutable_output(0), tensor_.shape()));
+      dev_ctx->Unref();
+    }
+
+    HalvingDoublingReducerTest* parent_;
+    Device* device_;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Status status_;
+  };
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  test::CountingRMA* rma_ = nullptr;
+  bool halving_doubling_ = true;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::vector<DeviceInstance*> instances_;
+  CollectiveParams col_params_;
+};
+
+
+TEST(HalvingDoublingReducerRankTest, VirtualRanks) {
+  EXPECT_EQ(1, HalvingDoublingReducer::PowerOfTwoBelow(1));
+  EXPECT_EQ(4, HalvingDoublingReducer::PowerOfTwoBelow(7));
+  EXPECT_EQ(8, HalvingDoublingReducer::PowerOfTwoBelow(8));
+  // With 6 devices ranks 0 and 2 fold into ranks 1 and 3.
+  const std::vector<int> expected = {-1, 0, -1, 1, 2, 3};
+  for (int rank = 0; rank < 6; ++rank) {
+    EXPECT_EQ(expected[rank], HalvingDoublingReducer::VirtualRank(6, rank));
+    if (expected[rank] >= 0) {
+      EXPECT_EQ(rank, HalvingDoublingReducer::GroupRank(6, expected[rank]));
+    }
+  }
+  for (int rank = 0; rank < 8; ++rank) {
+    EXPECT_EQ(rank, HalvingDoublingReducer::VirtualRank(8, rank));
+  }
+}
+
+#define DEF_TEST(B, D, L, A)                                \
+  TEST_F(HalvingDoublingReducerTest,                        \
+         DaTy##B##_Dev##D##_Len##L##_Abrt##A) {             \
+    DataType dtype = DT_##B;                                \
+    switch (dtype) {                                        \
+      case DT_FLOAT: {                                      \
+        RunTest<float>(dtype, D, L, A);                     \
+      } break;                                              \
+      case DT_DOUBLE: {                                     \
+        RunTest<double>(dtype, D, L, A);                    \
+      } break;                                              \
+      case DT_INT32: {                                      \
+        RunTest<int32>(dtype, D, L, A);                     \
+      } break;                                              \
+      case DT_INT64: {                                      \
+        RunTest<int64>(dtype, D, L, A);                     \
+      } break;                                              \
+      default:                                              \
+        LOG(FATAL) << "Unimplemented";                      \
+    }                                                       \
+  }
+
+// Success tests
+DEF_TEST(FLOAT, 1, 8, 0)
+DEF_TEST(FLOAT, 2, 1, 0)
+DEF_TEST(FLOAT, 2, 1001, 0)
+DEF_TEST(FLOAT, 3, 1001, 0)
+DEF_TEST(FLOAT, 4, 1, 0)
+DEF_TEST(FLOAT, 4, 1001, 0)
+DEF_TEST(FLOAT, 5, 1001, 0)
+DEF_TEST(FLOAT, 6, 4095, 0)
+DEF_TEST(FLOAT, 7, 9408, 0)
+DEF_TEST(FLOAT, 8, 8, 0)
+DEF_TEST(FLOAT, 8, 4096, 0)
+DEF_TEST(DOUBLE, 6, 1001, 0)
+DEF_TEST(INT32, 5, 4095, 0)
+DEF_TEST(INT64, 8, 1001, 0)
+
+// Failure tests
+DEF_TEST(FLOAT, 4, 1001, 3)
+DEF_TEST(FLOAT, 7, 9408, 10)
+
+TEST_F(HalvingDoublingReducerTest, FewerTransfersThanRing) {
+  const int kNumDevices = 8;
+  const int kTensorLen = 1024;
+  RunTest<float>(DT_FLOAT, kNumDevices, kTensorLen, 0);
+  // log2(kNumDevices) steps each of reduce-scatter and all-gather.
+  EXPECT_EQ(kNumDevices * 2 * 3, rma_->num_posted());
+}
+
+TEST_F(HalvingDoublingReducerTest, RingTakesMoreTransfers) {
+  const int kNumDevices = 8;
+  const int kTensorLen = 1024;
+  Init(kNumDevices, DT_FLOAT, 0, false /*halving_doubling*/);
+  std::vector<float> expected;
+  InitTensors<float>(DT_FLOAT, kTensorLen, &expected);
+  Reduce();
+  for (auto di : instances_) TF_EXPECT_OK(di->status_);
+  EXPECT_EQ(kNumDevices * 2 * (kNumDevices - 1), rma_->num_posted());
+}
+
+class HalvingDoublingReducerBenchmark : public HalvingDoublingReducerTest {
+ public:
+  using HalvingDoublingReducerTest::Init;
+  using HalvingDoublingReducerTest::InitTensors;
+  using HalvingDoublingReducerTest::Reduce;
+
+  void TestBody() override {}
+};
+
+// Measures the latency of all-reducing a small value over 'num_devices'
+// devices, with recursive halving and doubling or, if 'halving_doubling' is
+// 0, with a ring.
+static void BM_SmallAllReduce(int iters, int halving_doubling,
+                              int num_devices) {
+  testing::StopTiming();
+  const int kTensorLen = 256;
+  for (int i = 0; i < iters; ++i) {
+    HalvingDoublingReducerBenchmark bm;
+    bm.Init(num_devices, DT_FLOAT, 0, halving_doubling);
+    std::vector<float> expected;
+    bm.InitTensors<float>(DT_FLOAT, kTensorLen, &expected);
+    testing::StartTiming();
+    bm.Reduce();
+    testing::StopTiming();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters));
+}
+BENCHMARK(BM_SmallAllReduce)
+    ->ArgPair(0, 4)
+    ->ArgPair(1, 4)
+    ->ArgPair(0, 8)
+    ->ArgPair(1, 8)
+    ->ArgPair(0, 16)
+    ->ArgPair(1, 16)
+    ->ArgPair(0, 32)
+    ->ArgPair(1, 32);
+
+}  // namespace
+}  // namespace tensorflow
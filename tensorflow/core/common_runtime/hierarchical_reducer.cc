@@ -0,0 +1,385 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace tensorflow {
+namespace {
+
+// Phases of the algorithm, distinguished in BufRendezvous keys.
+enum Phase {
+  kReduceWithinTask = 0,
+  kReduceScatterAcrossTasks,
+  kAllGatherAcrossTasks,
+  kGatherWithinTask,
+};
+
+// BufRendezvous key for chunk 'chunk_idx' sent from device 'src_rank' to
+// device 'dst_rank' in 'phase'.
+string HierReduceBufKey(const string& exec_key, Phase phase, int chunk_idx,
+                        int src_rank, int dst_rank) {
+  return strings::StrCat("hred(", exec_key, "):", phase, ":", chunk_idx, ":",
+                         src_rank, ":", dst_rank);
+}
+
+// Tracks a batch of transfers that are started together, so that the
+// caller can wait for all of them to complete.
+class TransferBatch {
+ public:
+  // 'on_error' is called with the first error of any transfer, as soon as
+  // it happens, so that the other transfers of the batch can be aborted.
+  explicit TransferBatch(std::function<void(const Status&)> on_error)
+      : on_error_(std::move(on_error)) {}
+
+  // Returns the callback for a new transfer of the batch.
+  StatusCallback Add() {
+    mutex_lock l(mu_);
+    ++pending_;
+    return [this](const Status& s) {
+      bool first_error = false;
+      {
+        mutex_lock l(mu_);
+        first_error = status_.ok() && !s.ok();
+        status_.Update(s);
+      }
+      if (first_error) on_error_(s);
+      mutex_lock l(mu_);
+      if (--pending_ == 0) cv_.notify_all();
+    };
+  }
+
+  // Blocks until every transfer of the batch has completed, and returns
+  // the first error of any of them.
+  Status Wait() {
+    mutex_lock l(mu_);
+    while (pending_ > 0) cv_.wait(l);
+    return status_;
+  }
+
+ private:
+  std::function<void(const Status&)> on_error_;
+  mutex mu_;
+  condition_variable cv_;
+  int pending_ GUARDED_BY(mu_) = 0;
+  Status status_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+HierarchicalReducer::HierarchicalReducer(
+    CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+    OpKernelContext* ctx, OpKernelContext::Params* op_params,
+    const CollectiveParams& col_params, const string& exec_key, int64 step_id,
+    const Tensor* input, Tensor* output)
+    : col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      ctx_(ctx),
+      op_params_(op_params),
+      col_params_(col_params),
+      exec_key_(exec_key),
+      input_(input),
+      output_(output),
+      device_(nullptr),
+      task_idx_(-1),
+      local_idx_(-1),
+      num_tasks_(0),
+      num_local_(0),
+      status_(col_exec, "HierarchicalReduce") {
+  CHECK_GT(col_params_.group.group_size, 0);
+}
+
+/*static*/
+Status HierarchicalReducer::TaskLayout(const CollectiveParams& col_params,
+                                       int rank, int* task_idx,
+                                       int* local_idx,
+                                       std::vector<std::vector<int>>* peers) {
+  const std::vector<string>& task_names = col_params.instance.task_names;
+  if (static_cast<int>(task_names.size()) != col_params.group.group_size) {
+    return errors::Internal("Expected ", col_params.group.group_size,
+                            " task names, got ", task_names.size());
+  }
+  peers->clear();
+  *task_idx = -1;
+  *local_idx = -1;
+  for (int r = 0; r < static_cast<int>(task_names.size()); ++r) {
+    if (r == 0 || task_names[r] != task_names[r - 1]) {
+      peers->emplace_back();
+    }
+    if (r == rank) {
+      *task_idx = peers->size() - 1;
+      *local_idx = peers->back().size();
+    }
+    peers->back().push_back(r);
+  }
+  for (const auto& task_peers : *peers) {
+    if (task_peers.size() != peers->front().size()) {
+      return errors::Internal(
+          "HierarchicalReducer requires the same number of devices in every "
+          "task");
+    }
+  }
+  if (*task_idx < 0) {
+    return errors::Internal("Rank ", rank, " is not in group of size ",
+                            task_names.size());
+  }
+  return Status::OK();
+}
+
+void HierarchicalReducer::Run(StatusCallback done) {
+  CHECK(dev_mgr_);
+  Status status = dev_mgr_->LookupDevice(
+      col_params_.instance.device_names[col_params_.default_rank], &device_);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to find device "
+               << col_params_.instance.device_names[col_params_.default_rank];
+    done(status);
+    return;
+  }
+  device_locality_ = device_->attributes().locality();
+  status = TaskLayout(col_params_, col_params_.default_rank, &task_idx_,
+                      &local_idx_, &peers_);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  num_tasks_ = peers_.size();
+  num_local_ = peers_[0].size();
+  VLOG(1) << "HierarchicalReducer::Run for device "
+          << col_params_.instance.device_names[col_params_.default_rank]
+          << " task " << task_idx_ << " of " << num_tasks_ << " local index "
+          << local_idx_ << " of " << num_local_;
+
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  status = collective_util::CopyInputToOutput(ctx_, device_, input_, output_);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+
+  // Chunk (s * num_tasks_ + t) is chunk t of shard s.
+  AllocatorAttributes attr = ctx_->output_alloc_attr(0);
+  ca_.reset(MakeCollectiveAdapter(output_, num_local_ * num_tasks_,
+                                  device_->GetAllocator(attr)));
+  if (col_params_.final_op) {
+    status = collective_util::MakeGroupSizeTensor(
+        ctx_, device_, col_params_, ca_.get(), &group_size_tensor_);
+    if (!status.ok()) {
+      done(status);
+      return;
+    }
+  }
+
+  if (ReduceWithinTask() && AllReduceAcrossTasks() && GatherWithinTask()) {
+    ca_->ConsumeFinalValue(output_);
+  }
+  done(status_.status());
+}
+
+void HierarchicalReducer::DispatchSend(int dst_rank, const string& key,
+                                       const Tensor* src,
+                                       const StatusCallback& done) {
+  VLOG(3) << "DispatchSend rank=" << col_params_.default_rank << " key "
+          << key << " to " << dst_rank;
+  col_exec_->PostToPeer(col_params_.instance.device_names[dst_rank],
+                        col_params_.instance.task_names[dst_rank], key,
+                        device_, ctx_->op_device_context(),
+                        ctx_->output_alloc_attr(0), src, device_locality_,
+                        done);
+}
+
+void HierarchicalReducer::DispatchRecv(int src_rank, const string& key,
+                                       Tensor* dst,
+                                       const StatusCallback& done) {
+  VLOG(3) << "DispatchRecv rank=" << col_params_.default_rank << " key "
+          << key << " from " << src_rank;
+  col_exec_->RecvFromPeer(col_params_.instance.device_names[src_rank],
+                          col_params_.instance.task_names[src_rank],
+                          col_params_.task.is_local[src_rank], key, device_,
+                          ctx_->op_device_context(),
+                          ctx_->output_alloc_attr(0), dst, device_locality_,
+                          done);
+}
+
+bool HierarchicalReducer::ComputeBinOp(OpKernel* op, Tensor* output,
+                                       Tensor* input) {
+  Status s = collective_util::ComputeBinOp(ctx_, op_params_, device_, op,
+                                          output, input);
+  if (!s.ok()) {
+    status_.StartAbort(s);
+    return false;
+  }
+  return true;
+}
+
+bool HierarchicalReducer::FinalizeChunk(int chunk_idx) {
+  if (!col_params_.final_op || ca_->ChunkBytes(chunk_idx) == 0) return true;
+  Tensor chunk = ca_->ChunkAlias(chunk_idx);
+  return ComputeBinOp(col_params_.final_op.get(), &chunk, &group_size_tensor_);
+}
+
+bool HierarchicalReducer::ReduceWithinTask() {
+  if (num_local_ == 1) return true;
+  const int rank = col_params_.default_rank;
+  const std::vector<int>& task_peers = peers_[task_idx_];
+  // Every tensor passed to a transfer must outlive it, so reserve up front
+  // to keep the vectors from reallocating.
+  std::vector<Tensor> sends;
+  sends.reserve((num_local_ - 1) * num_tasks_);
+  std::vector<std::pair<int, Tensor>> recvs;
+  recvs.reserve((num_local_ - 1) * num_tasks_);
+  TransferBatch batch([this](const Status& s) { status_.StartAbort(s); });
+  for (int li = 0; li < num_local_; ++li) {
+    if (li == local_idx_) continue;
+    const int peer = task_peers[li];
+    for (int ti = 0; ti < num_tasks_; ++ti) {
+      // Send our part of the shard that li reduces.
+      int chunk_idx = li * num_tasks_ + ti;
+      if (ca_->ChunkBytes(chunk_idx) > 0) {
+        sends.push_back(ca_->ChunkAlias(chunk_idx));
+        DispatchSend(peer,
+                     HierReduceBufKey(exec_key_, kReduceWithinTask, chunk_idx,
+                                      rank, peer),
+                     &sends.back(), batch.Add());
+      }
+      // Receive li's part of the shard that we reduce.
+      chunk_idx = local_idx_ * num_tasks_ + ti;
+      if (ca_->ChunkBytes(chunk_idx) > 0) {
+        recvs.emplace_back(chunk_idx, ca_->TempChunk(chunk_idx));
+        DispatchRecv(peer,
+                     HierReduceBufKey(exec_key_, kReduceWithinTask, chunk_idx,
+                                      peer, rank),
+                     &recvs.back().second, batch.Add());
+      }
+    }
+  }
+  if (!batch.Wait().ok()) return false;
+  for (auto& recv : recvs) {
+    Tensor chunk = ca_->ChunkAlias(recv.first);
+    if (!ComputeBinOp(col_params_.merge_op.get(), &chunk, &recv.second)) {
+      return false;
+    }
+  }
+  return !status_.aborted();
+}
+
+bool HierarchicalReducer::AllReduceAcrossTasks() {
+  const int shard_base = local_idx_ * num_tasks_;
+  if (num_tasks_ == 1) {
+    for (int ti = 0; ti < num_tasks_; ++ti) {
+      if (!FinalizeChunk(shard_base + ti)) return false;
+    }
+    return true;
+  }
+  const int rank = col_params_.default_rank;
+  const int send_to = peers_[(task_idx_ + 1) % num_tasks_][local_idx_];
+  const int recv_from =
+      peers_[(task_idx_ + num_tasks_ - 1) % num_tasks_][local_idx_];
+
+  // Reduce-scatter: after num_tasks_ - 1 steps this device holds the sum
+  // over all tasks of chunk (task_idx_ + 1) of its shard.
+  for (int step = 0; step < num_tasks_ - 1; ++step) {
+    const int send_idx =
+        shard_base + (task_idx_ - step + num_tasks_) % num_tasks_;
+    const int recv_idx =
+        shard_base + (task_idx_ - step - 1 + 2 * num_tasks_) % num_tasks_;
+    Tensor send_chunk = ca_->ChunkAlias(send_idx);
+    Tensor recv_chunk;
+    TransferBatch batch([this](const Status& s) { status_.StartAbort(s); });
+    if (ca_->ChunkBytes(send_idx) > 0) {
+      DispatchSend(send_to,
+                   HierReduceBufKey(exec_key_, kReduceScatterAcrossTasks,
+                                    send_idx, rank, send_to),
+                   &send_chunk, batch.Add());
+    }
+    if (ca_->ChunkBytes(recv_idx) > 0) {
+      recv_chunk = ca_->TempChunk(recv_idx);
+      DispatchRecv(recv_from,
+                   HierReduceBufKey(exec_key_, kReduceScatterAcrossTasks,
+                                    recv_idx, recv_from, rank),
+                   &recv_chunk, batch.Add());
+    }
+    if (!batch.Wait().ok()) return false;
+    if (ca_->ChunkBytes(recv_idx) > 0) {
+      Tensor chunk = ca_->ChunkAlias(recv_idx);
+      if (!ComputeBinOp(col_params_.merge_op.get(), &chunk, &recv_chunk)) {
+        return false;
+      }
+    }
+  }
+  if (!FinalizeChunk(shard_base + (task_idx_ + 1) % num_tasks_)) return false;
+
+  // All-gather: pass each final chunk around the ring.
+  for (int step = 0; step < num_tasks_ - 1; ++step) {
+    const int send_idx =
+        shard_base + (task_idx_ + 1 - step + num_tasks_) % num_tasks_;
+    const int recv_idx =
+        shard_base + (task_idx_ - step + num_tasks_) % num_tasks_;
+    Tensor send_chunk = ca_->ChunkAlias(send_idx);
+    Tensor recv_chunk = ca_->ChunkAlias(recv_idx);
+    TransferBatch batch([this](const Status& s) { status_.StartAbort(s); });
+    if (ca_->ChunkBytes(send_idx) > 0) {
+      DispatchSend(send_to,
+                   HierReduceBufKey(exec_key_, kAllGatherAcrossTasks, send_idx,
+                                    rank, send_to),
+                   &send_chunk, batch.Add());
+    }
+    if (ca_->ChunkBytes(recv_idx) > 0) {
+      DispatchRecv(recv_from,
+                   HierReduceBufKey(exec_key_, kAllGatherAcrossTasks, recv_idx,
+                                    recv_from, rank),
+                   &recv_chunk, batch.Add());
+    }
+    if (!batch.Wait().ok()) return false;
+  }
+  return !status_.aborted();
+}
+
+bool HierarchicalReducer::GatherWithinTask() {
+  if (num_local_ == 1) return true;
+  const int rank = col_params_.default_rank;
+  const std::vector<int>& task_peers = peers_[task_idx_];
+  std::vector<Tensor> chunks;
+  chunks.reserve(2 * (num_local_ - 1) * num_tasks_);
+  TransferBatch batch([this](const Status& s) { status_.StartAbort(s); });
+  for (int li = 0; li < num_local_; ++li) {
+    if (li == local_idx_) continue;
+    const int peer = task_peers[li];
+    for (int ti = 0; ti < num_tasks_; ++ti) {
+      int chunk_idx = local_idx_ * num_tasks_ + ti;
+      if (ca_->ChunkBytes(chunk_idx) > 0) {
+        chunks.push_back(ca_->ChunkAlias(chunk_idx));
+        DispatchSend(peer,
+                     HierReduceBufKey(exec_key_, kGatherWithinTask, chunk_idx,
+                                      rank, peer),
+                     &chunks.back(), batch.Add());
+      }
+      chunk_idx = li * num_tasks_ + ti;
+      if (ca_->ChunkBytes(chunk_idx) > 0) {
+        chunks.push_back(ca_->ChunkAlias(chunk_idx));
+        DispatchRecv(peer,
+                     HierReduceBufKey(exec_key_, kGatherWithinTask, chunk_idx,
+                                      peer, rank),
+                     &chunks.back(), batch.Add());
+      }
+    }
+  }
+  return batch.Wait().ok() && !status_.aborted();
+}
+
+}  // namespace tensorflow
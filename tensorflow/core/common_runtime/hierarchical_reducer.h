@@ -0,0 +1,102 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+
+namespace tensorflow {
+class DeviceMgr;
+
+// Two-level implementation of collective all-reduce, for groups whose
+// devices are spread evenly over several tasks.
+//
+// The value is divided into one shard per device of a task, and each
+// shard into one chunk per task.  The reduction then runs in three
+// phases:
+//   1. Within each task, every device sends shard i to the device with
+//      local index i, which reduces the shard over the task.
+//   2. The devices with the same local index, one per task, all-reduce
+//      their shard with a ring over the tasks.
+//   3. Within each task, every device sends its now final shard to all of
+//      the other devices.
+// Only phase 2 moves data between tasks, and it moves 1/(devices per task)
+// of the value on each of the rings, which run in parallel.
+class HierarchicalReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
+                      OpKernelContext* ctx, OpKernelContext::Params* op_params,
+                      const CollectiveParams& col_params,
+                      const string& exec_key, int64 step_id,
+                      const Tensor* input, Tensor* output);
+
+  ~HierarchicalReducer() override {}
+
+  void Run(StatusCallback done) override;
+
+  // Sets *task_idx to the index of the task of device 'rank', *local_idx to
+  // the index of the device within that task and *peers to the ranks of all
+  // devices, indexed by [task_idx][local_idx].  Requires devices of the same
+  // task to be adjacent in col_params.instance.device_names.
+  static Status TaskLayout(const CollectiveParams& col_params, int rank,
+                           int* task_idx, int* local_idx,
+                           std::vector<std::vector<int>>* peers);
+
+ private:
+  // Sends or receives one chunk, as part of a batch of transfers that are
+  // started together and awaited with WaitForTransfers().
+  void DispatchSend(int dst_rank, const string& key, const Tensor* src,
+                    const StatusCallback& done);
+  void DispatchRecv(int src_rank, const string& key, Tensor* dst,
+                    const StatusCallback& done);
+
+  // The three phases of the algorithm.  Each returns false if aborted.
+  bool ReduceWithinTask();
+  bool AllReduceAcrossTasks();
+  bool GatherWithinTask();
+
+  // Applies final_op to chunk 'chunk_idx', if there is a final_op.
+  bool FinalizeChunk(int chunk_idx);
+  bool ComputeBinOp(OpKernel* op, Tensor* output, Tensor* input);
+
+  CollectiveExecutor* col_exec_;        // Not owned
+  const DeviceMgr* dev_mgr_;            // Not owned
+  OpKernelContext* ctx_;                // Not owned
+  OpKernelContext::Params* op_params_;  // Not owned
+  const CollectiveParams& col_params_;
+  const string exec_key_;
+  const Tensor* input_;  // Not owned
+  Tensor* output_;       // Not owned
+  Device* device_;       // The device for which this instance labors
+  DeviceLocality device_locality_;
+  std::unique_ptr<CollectiveAdapter> ca_;
+  Tensor group_size_tensor_;
+
+  int task_idx_;
+  int local_idx_;
+  int num_tasks_;
+  int num_local_;
+  std::vector<std::vector<int>> peers_;  // rank of [task_idx][local_idx]
+
+  collective_util::CollectiveStatus status_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
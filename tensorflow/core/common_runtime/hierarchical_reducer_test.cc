@@ -0,0 +1,370 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_testlib.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+class HierarchicalReducerTest : public ::testing::Test {
+ protected:
+  ~HierarchicalReducerTest() override {
+    for (auto i : instances_) {
+      delete i;
+    }
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  // Sets up num_workers tasks of num_devices CPU devices each.  If
+  // 'hierarchical' is false the devices run a RingReducer instead, for
+  // comparison.
+  void Init(int num_workers, int num_devices, DataType dtype, int fail_after,
+            bool hierarchical) {
+    std::vector<Device*> local_devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    Bytes mem_limit(4 << 20);
+    DeviceLocality dev_locality;
+    for (int wi = 0; wi < num_workers; ++wi) {
+      for (int di = 0; di < num_devices; ++di) {
+        string dev_name =
+            strings::StrCat("/job:worker/replica:0/task:", wi, "/cpu:", di);
+        local_devices.push_back(new ThreadPoolDevice(
+            sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+      }
+    }
+    dev_mgr_.reset(new DeviceMgr(local_devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    rma_ = new test::CountingRMA(dev_mgr_.get(), dev_resolver_.get(),
+                                 kStepId, fail_after);
+    col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                           dev_mgr_.get());
+    col_params_.name = "test_collective";
+    col_params_.group.group_key = 5;
+    col_params_.group.device_type = DEVICE_CPU;
+    col_params_.group.group_size = num_workers * num_devices;
+    col_params_.group.num_tasks = num_workers;
+    col_params_.instance.instance_key = 17;
+    col_params_.instance.type = REDUCTION_COLLECTIVE;
+    col_params_.instance.data_type = dtype;
+    col_params_.instance.same_num_devices_per_task = true;
+    col_params_.instance.impl_details.reduction_algorithm =
+        hierarchical ? REDUCTION_HIERARCHICAL : REDUCTION_RING;
+    col_params_.instance.impl_details.subdiv_offsets = {0};
+    col_params_.instance.impl_details.subdiv_permutations.resize(1);
+    for (int wi = 0; wi < num_workers; ++wi) {
+      string task_name = strings::StrCat("/job:worker/replica:0/task:", wi);
+      for (int di = 0; di < num_devices; ++di) {
+        col_params_.instance.device_names.push_back(
+            strings::StrCat(task_name, "/cpu:", di));
+        col_params_.instance.task_names.push_back(task_name);
+        // This test runs in a single process so is_local is always true.
+        col_params_.task.is_local.push_back(true);
+        col_params_.instance.impl_details.subdiv_permutations[0].push_back(
+            wi * num_devices + di);
+      }
+    }
+    for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+      instances_.push_back(new DeviceInstance(rank, this));
+    }
+  }
+
+  void Reduce() {
+    std::atomic<int> done(0);
+    for (auto di : instances_) {
+      SchedClosure([di, &done] {
+        di->DoReduce();
+        ++done;
+      });
+    }
+    while (done < static_cast<int>(instances_.size())) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+  }
+
+  template <typename T>
+  void InitTensors(DataType dtype, int tensor_len, std::vector<T>* expected) {
+    expected->assign(tensor_len, 0);
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      Tensor* t = &instances_[di]->tensor_;
+      *t = Tensor(dtype, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        T value = static_cast<T>(di * 10 + i);
+        t->flat<T>()(i) = value;
+        (*expected)[i] += value;
+      }
+    }
+    for (int i = 0; i < tensor_len; ++i) {
+      (*expected)[i] /= static_cast<T>(instances_.size());
+    }
+  }
+
+  template <typename T>
+  void RunTest(DataType dtype, int num_workers, int num_devices,
+               int tensor_len, int fail_after) {
+    Init(num_workers, num_devices, dtype, fail_after, true /*hierarchical*/);
+    std::vector<T> expected;
+    InitTensors<T>(dtype, tensor_len, &expected);
+    Reduce();
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      if (fail_after > 0) {
+        EXPECT_EQ("Deliberate failure",
+                  instances_[di]->status_.error_message());
+        continue;
+      }
+      TF_EXPECT_OK(instances_[di]->status_);
+      const Tensor& actual = instances_[di]->tensor_;
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_EQ(expected[i], actual.flat<T>()(i))
+            << "Mismatch at device " << di << " index " << i;
+      }
+    }
+  }
+
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, HierarchicalReducerTest* parent)
+        : parent_(parent) {
+      const CollectiveParams& cp = parent_->col_params_;
+      TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(
+          cp.instance.device_names[rank], &device_));
+      col_params_.name = cp.name;
+      col_params_.group = cp.group;
+      col_params_.instance = cp.instance;
+      col_params_.task.is_local = cp.task.is_local;
+      col_params_.default_rank = rank;
+      col_params_.subdiv_rank = {rank};
+    }
+
+    void DoReduce() {
+      const DataType dtype = col_params_.instance.data_type;
+      col_params_.merge_op = test::GetBinOp("Add", dtype, DEVICE_CPU, device_);
+      col_params_.final_op = test::GetBinOp("Div", dtype, DEVICE_CPU, device_);
+
+      // Prepare an OpKernelContext.
+      OpKernelContext::Params op_params;
+      op_params.step_id = kStepId;
+      op_params.device = device_;
+      gtl::InlinedVector<TensorValue, 4> inputs;
+      inputs.push_back(TensorValue(&tensor_));
+      op_params.inputs = &inputs;
+      gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+          {AllocatorAttributes()});
+      op_params.input_alloc_attrs = &input_aa;
+      DeviceContext* dev_ctx = new DeviceContext;
+      gtl::InlinedVector<DeviceContext*, 4> input_dc({dev_ctx});
+      op_params.input_device_contexts = &input_dc;
+      op_params.op_device_context = dev_ctx;
+      int forward_from = 0;
+      op_params.forward_from_array = &forward_from;
+      AllocatorAttributes generic_alloc_attr;
+      op_params.output_attr_array = &generic_alloc_attr;
+      std::unique_ptr<OpKernel> op =
+          test::GetBinOp("Add", dtype, DEVICE_CPU, device_);
+      op_params.op_kernel = op.get();
+      OpKernelContext ctx(&op_params, 1);
+      Tensor* output_tensor_ptr = nullptr;
+      TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor_.shape(),
+                                                       &output_tensor_ptr));
+
+      string exec_key =
+          strings::StrCat(col_params_.instance.instance_key, ":0:0");
+      std::unique_ptr<CollectiveImplementationInterface> reducer;
+      if (col_params_.instance.impl_details.reduction_algorithm ==
+          REDUCTION_HIERARCHICAL) {
+        reducer.reset(new HierarchicalReducer(
+            parent_->col_exec_, parent_->dev_mgr_.get(), &ctx, &op_params,
+            col_params_, exec_key, kStepId, &tensor_, &tensor_));
+      } else {
+        reducer.reset(new RingReducer(
+            parent_->col_exec_, parent_->dev_mgr_.get(), &ctx, &op_params,
+            col_params_, exec_key, kStepId, &tensor_, &tensor_));
+      }
+      Notification notification;
+      SchedClosure([this, &notification, &reducer]() {
+        reducer->Run([this, &notification](Status s) {
+          status_ = s;
+          notification.Notify();
+        });
+      });
+      notification.WaitForNotification();
+      CHECK(tensor_.CopyFrom(*ctx.mutable_output(0), tensor_.shape()));
+      dev_ctx->Unref();
+    }
+
+    HierarchicalReducerTest* parent_;
+    Device* device_;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Status status_;
+  };
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  test::CountingRMA* rma_ = nullptr;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::vector<DeviceInstance*> instances_;
+  CollectiveParams col_params_;
+};
+
+TEST(HierarchicalReducerLayoutTest, TaskLayout) {
+  CollectiveParams cp;
+  cp.group.group_size = 6;
+  cp.instance.task_names = {"/job:w/task:0", "/job:w/task:0",
+                            "/job:w/task:0", "/job:w/task:1",
+                            "/job:w/task:1", "/job:w/task:1"};
+  int task_idx, local_idx;
+  std::vector<std::vector<int>> peers;
+  TF_ASSERT_OK(
+      HierarchicalReducer::TaskLayout(cp, 4, &task_idx, &local_idx, &peers));
+  EXPECT_EQ(1, task_idx);
+  EXPECT_EQ(1, local_idx);
+  ASSERT_EQ(2, peers.size());
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), peers[0]);
+  EXPECT_EQ(std::vector<int>({3, 4, 5}), peers[1]);
+
+  cp.instance.task_names[2] = "/job:w/task:1";
+  EXPECT_FALSE(
+      HierarchicalReducer::TaskLayout(cp, 4, &task_idx, &local_idx, &peers)
+          .ok());
+}
+
+#define DEF_TEST(B, W, D, L, A)                                      \
+  TEST_F(HierarchicalReducerTest,                                    \
+         DaTy##B##_Wkr##W##_Dev##D##_Len##L##_Abrt##A) {             \
+    DataType dtype = DT_##B;                                         \
+    switch (dtype) {                                                 \
+      case DT_FLOAT: {                                               \
+        RunTest<float>(dtype, W, D, L, A);                           \
+      } break;                                                       \
+      case DT_DOUBLE: {                                              \
+        RunTest<double>(dtype, W, D, L, A);                          \
+      } break;                                                       \
+      case DT_INT32: {                                               \
+        RunTest<int32>(dtype, W, D, L, A);                           \
+      } break;                                                       \
+      case DT_INT64: {                                               \
+        RunTest<int64>(dtype, W, D, L, A);                           \
+      } break;                                                       \
+      default:                                                       \
+        LOG(FATAL) << "Unimplemented";                               \
+    }                                                                \
+  }
+
+// Success tests
+DEF_TEST(FLOAT, 2, 2, 1, 0)
+DEF_TEST(FLOAT, 2, 2, 8, 0)
+DEF_TEST(FLOAT, 2, 4, 1001, 0)
+DEF_TEST(FLOAT, 3, 4, 4095, 0)
+DEF_TEST(FLOAT, 4, 2, 9408, 0)
+DEF_TEST(FLOAT, 1, 4, 1001, 0)
+DEF_TEST(FLOAT, 4, 1, 1001, 0)
+DEF_TEST(DOUBLE, 2, 4, 1001, 0)
+DEF_TEST(INT32, 3, 2, 4095, 0)
+DEF_TEST(INT64, 2, 4, 1001, 0)
+
+// Failure tests
+DEF_TEST(FLOAT, 2, 4, 9408, 7)
+DEF_TEST(FLOAT, 3, 4, 9408, 20)
+
+TEST_F(HierarchicalReducerTest, SendsLessAcrossTasksThanRing) {
+  const int kNumWorkers = 2;
+  const int kNumDevices = 4;
+  const int kTensorLen = 4096;
+  const int64 value_bytes = kTensorLen * sizeof(float);
+  RunTest<float>(DT_FLOAT, kNumWorkers, kNumDevices, kTensorLen, 0);
+  // Each of the kNumDevices rings between tasks all-reduces one shard.
+  EXPECT_EQ(2 * (kNumWorkers - 1) * value_bytes, rma_->bytes_across_tasks());
+  // Within a task, each shard is sent to its owner and back from every
+  // other device.
+  EXPECT_EQ(kNumWorkers * 2 * (kNumDevices - 1) * value_bytes,
+            rma_->bytes_within_tasks());
+}
+
+TEST_F(HierarchicalReducerTest, RingSendsMoreAcrossTasks) {
+  const int kNumWorkers = 2;
+  const int kNumDevices = 4;
+  const int kTensorLen = 4096;
+  const int64 value_bytes = kTensorLen * sizeof(float);
+  Init(kNumWorkers, kNumDevices, DT_FLOAT, 0, false /*hierarchical*/);
+  std::vector<float> expected;
+  InitTensors<float>(DT_FLOAT, kTensorLen, &expected);
+  Reduce();
+  for (auto di : instances_) TF_EXPECT_OK(di->status_);
+  // Each of the kNumWorkers links between tasks carries all but one chunk
+  // of the value in each pass, more than the hierarchical reduction sends
+  // over all of them.
+  EXPECT_GT(rma_->bytes_across_tasks(), 2 * (kNumWorkers - 1) * value_bytes);
+}
+
+class HierarchicalReducerBenchmark : public HierarchicalReducerTest {
+ public:
+  using HierarchicalReducerTest::Init;
+  using HierarchicalReducerTest::InitTensors;
+  using HierarchicalReducerTest::Reduce;
+  using HierarchicalReducerTest::rma_;
+
+  void TestBody() override {}
+};
+
+static void BM_AllReduce(int iters, int hierarchical, int tensor_len) {
+  testing::StopTiming();
+  const int kNumWorkers = 2;
+  const int kNumDevices = 4;
+  int64 bytes_across_tasks = 0;
+  for (int i = 0; i < iters; ++i) {
+    HierarchicalReducerBenchmark bm;
+    bm.Init(kNumWorkers, kNumDevices, DT_FLOAT, 0, hierarchical);
+    std::vector<float> expected;
+    bm.InitTensors<float>(DT_FLOAT, tensor_len, &expected);
+    testing::StartTiming();
+    bm.Reduce();
+    testing::StopTiming();
+    bytes_across_tasks += bm.rma_->bytes_across_tasks();
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * tensor_len *
+                          sizeof(float));
+  testing::SetLabel(
+      strings::StrCat("across_tasks/iter=", bytes_across_tasks / iters));
+}
+BENCHMARK(BM_AllReduce)
+    ->ArgPair(0, 1 << 16)
+    ->ArgPair(1, 1 << 16)
+    ->ArgPair(0, 1 << 20)
+    ->ArgPair(1, 1 << 20);
+
+}  // namespace
+}  // namespace tensorflow
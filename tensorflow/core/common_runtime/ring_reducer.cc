@@ -14,10 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 
-#include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/common_runtime/copy_tensor.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
-#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/numeric_types.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/env.h"
@@ -41,6 +40,97 @@ string RingReduceBufKey(const string& exec_key, int pass, int section,
   }
 }
 
+// Number of bytes that 'num_elements' floats take once compressed.
+int64 CompressedBytes(CollectiveCompression compression, int64 num_elements) {
+  switch (compression) {
+    case COMPRESSION_FP16:
+    case COMPRESSION_BF16:
+      return num_elements * 2;
+    case COMPRESSION_INT8:
+      // The scale, followed by one signed byte per element.
+      return sizeof(float) + num_elements;
+    default:
+      return num_elements * sizeof(float);
+  }
+}
+
+// Encodes the floats of 'src' into the DT_UINT8 tensor 'dst', which must
+// have CompressedBytes() elements.
+void Compress(CollectiveCompression compression, const Tensor& src,
+              Tensor* dst) {
+  const float* in = src.flat<float>().data();
+  const int64 n = src.NumElements();
+  char* out = reinterpret_cast<char*>(dst->flat<uint8>().data());
+  switch (compression) {
+    case COMPRESSION_FP16: {
+      Eigen::half* half_out = reinterpret_cast<Eigen::half*>(out);
+      for (int64 i = 0; i < n; ++i) {
+        half_out[i] = Eigen::half(in[i]);
+      }
+      break;
+    }
+    case COMPRESSION_BF16: {
+      bfloat16* bf16_out = reinterpret_cast<bfloat16*>(out);
+      for (int64 i = 0; i < n; ++i) {
+        bf16_out[i] = bfloat16::round_to_bfloat16(in[i]);
+      }
+      break;
+    }
+    case COMPRESSION_INT8: {
+      float max_abs = 0;
+      for (int64 i = 0; i < n; ++i) {
+        max_abs = std::max(max_abs, std::abs(in[i]));
+      }
+      const float scale = max_abs / 127;
+      const float inv_scale = (scale > 0) ? 1 / scale : 0;
+      memcpy(out, &scale, sizeof(scale));
+      int8* int8_out = reinterpret_cast<int8*>(out + sizeof(scale));
+      for (int64 i = 0; i < n; ++i) {
+        int8_out[i] = static_cast<int8>(
+            std::max(-127.0f, std::min(127.0f, std::round(in[i] * inv_scale))));
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unsupported compression " << compression;
+  }
+}
+
+// Inverse of Compress().
+void Decompress(CollectiveCompression compression, const Tensor& src,
+                Tensor* dst) {
+  const char* in = reinterpret_cast<const char*>(src.flat<uint8>().data());
+  float* out = dst->flat<float>().data();
+  const int64 n = dst->NumElements();
+  switch (compression) {
+    case COMPRESSION_FP16: {
+      const Eigen::half* half_in = reinterpret_cast<const Eigen::half*>(in);
+      for (int64 i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(half_in[i]);
+      }
+      break;
+    }
+    case COMPRESSION_BF16: {
+      const bfloat16* bf16_in = reinterpret_cast<const bfloat16*>(in);
+      for (int64 i = 0; i < n; ++i) {
+        out[i] = static_cast<float>(bf16_in[i]);
+      }
+      break;
+    }
+    case COMPRESSION_INT8: {
+      float scale;
+      memcpy(&scale, in, sizeof(scale));
+      const int8* int8_in = reinterpret_cast<const int8*>(in + sizeof(scale));
+      for (int64 i = 0; i < n; ++i) {
+        out[i] = int8_in[i] * scale;
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unsupported compression " << compression;
+  }
+}
+
 }  // namespace
 
 void RingReducer::PCQueue::Enqueue(RingField* rf) {
@@ -87,13 +177,12 @@ RingReducer::RingReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
       done_(nullptr),
       device_(nullptr),
       device_name_(
-          col_params_.instance.device_names[col_params_.default_rank]) {
+          col_params_.instance.device_names[col_params_.default_rank]),
+      status_(col_exec, "RingReduce") {
   CHECK_GT(group_size_, 0);
   CHECK_GT(num_subdivs_, 0);
 }
 
-RingReducer::~RingReducer() { group_size_tensor_ready_.WaitForNotification(); }
-
 string RingReducer::TensorDebugString(Tensor tensor) {
   const DeviceBase::GpuDeviceInfo* gpu_device_info =
       ctx_->device()->tensorflow_gpu_device_info();
@@ -149,29 +238,26 @@ void RingReducer::Run(StatusCallback done) {
   }
   CHECK(device_);
   device_locality_ = device_->attributes().locality();
+  if (col_params_.instance.compression != COMPRESSION_NONE &&
+      (col_params_.instance.data_type != DT_FLOAT ||
+       col_params_.group.device_type != DEVICE_CPU)) {
+    done_(errors::Unimplemented(
+        "RingReducer only compresses float values on CPU, got ",
+        DataTypeString(col_params_.instance.data_type), " on ",
+        col_params_.group.device_type.type()));
+    return;
+  }
 
   VLOG(1) << this << " default_rank " << col_params_.default_rank << " cp "
           << &col_params_ << ": " << col_params_.ToString();
 
   // Start by copying input to output if they're not already the same, i.e. if
-  // we're not computing in-place on the input tensor.
-  if ((input_ != output_) &&
-      (DMAHelper::base(input_) != DMAHelper::base(output_))) {
-    // We are running in a blockable thread and the callback can't block so
-    // just wait here on the copy.
-    Notification note;
-    CollectiveRemoteAccessLocal::MemCpyAsync(
-        ctx_->input_device_context(0), ctx_->op_device_context(), device_,
-        device_, ctx_->input_alloc_attr(0), ctx_->output_alloc_attr(0), input_,
-        output_, [this, &note, &status](const Status& s) {
-          status.Update(s);
-          note.Notify();
-        });
-    note.WaitForNotification();
-    if (!status.ok()) {
-      done_(status);
-      return;
-    }
+  // we're not computing in-place on the input tensor.  We are running in a
+  // blockable thread, so just wait here on the copy.
+  status = collective_util::CopyInputToOutput(ctx_, device_, input_, output_);
+  if (!status.ok()) {
+    done_(status);
+    return;
   }
   ContinueAfterInputCopy();
 }
@@ -186,94 +272,31 @@ void RingReducer::ContinueAfterInputCopy() {
   if (col_params_.final_op) {
     // Create an on-device scalar value from group_size_ that may be needed
     // later.
-    // TODO(tucker): Cache and reuse across invocations? Or maybe the scalar
-    // can be provided to the kernel in host memory?
-    Tensor group_size_val = ca_->Scalar(group_size_);
-    if (col_params_.group.device_type != "CPU") {
-      group_size_tensor_ =
-          ca_->Scalar(device_->GetAllocator(ctx_->input_alloc_attr(0)));
-      DeviceContext* op_dev_ctx = ctx_->op_device_context();
-      op_dev_ctx->CopyCPUTensorToDevice(&group_size_val, device_,
-                                        &group_size_tensor_,
-                                        [this](const Status& s) {
-                                          if (!s.ok()) {
-                                            StartAbort(s);
-                                          }
-                                          group_size_tensor_ready_.Notify();
-                                        });
-    } else {
-      group_size_tensor_ = group_size_val;
-      group_size_tensor_ready_.Notify();
+    Status s = collective_util::MakeGroupSizeTensor(
+        ctx_, device_, col_params_, ca_.get(), &group_size_tensor_);
+    if (!s.ok()) {
+      status_.StartAbort(s);
+      Finish(false);
+      return;
     }
   }
   Finish(RunAsyncParts());
 }
 
-void RingReducer::StartAbort(const Status& s) {
-  // In abort mode we stop issuing additional ProvideBuf
-  // and ConsumeBuf calls, but we need to wait for all of the
-  // outstanding callbacks to be invoked before quitting.
-  bool abort_started = false;
-  {
-    mutex_lock l(status_mu_);
-    if (status_.ok()) {
-      LOG(ERROR) << "Aborting RingReduce with " << s;
-      abort_started = true;
-      status_.Update(s);
-    }
-  }
-  // If this is the initial entry to abort mode then invoke StartAbort
-  // on the CollectiveExecutor that invoked us.  That should start
-  // cancellation on all of the outstanding CollectiveRemoteAccess
-  // actions.
-  if (abort_started) {
-    col_exec_->StartAbort(s);
-  }
-}
-
 void RingReducer::Finish(bool ok) {
   if (ok) {
     // Recover the output from the adaptor.
     ca_->ConsumeFinalValue(output_);
   }
-  Status s;
-  {
-    mutex_lock l(status_mu_);
-    s = status_;
-  }
+  Status s = status_.status();
   rfv_.clear();  // Give up Refs on output tensor.
   done_(s);
 }
 
-RingReducer::SubContext::SubContext(OpKernelContext* ctx,
-                                    OpKernelContext::Params* params,
-                                    OpKernel* op, Tensor* output, Tensor* input)
-    : sub_params_(*params),
-      sub_inputs_({output, input}),
-      sub_input_attr_({ctx->input_alloc_attr(0), ctx->input_alloc_attr(0)}),
-      sub_input_dc_(
-          {ctx->input_device_context(0), ctx->input_device_context(0)}) {
-  sub_params_.op_kernel = op;
-  sub_params_.inputs = &sub_inputs_;
-  sub_params_.input_alloc_attrs = &sub_input_attr_;
-  sub_params_.input_device_contexts = &sub_input_dc_;
-  sub_params_.eigen_gpu_device = nullptr;
-  sub_params_.ensure_eigen_gpu_device();
-  sub_params_.forward_from_array = &forward_from_;
-  sub_ctx_ = new OpKernelContext(&sub_params_, 1);
-}
-
-Status RingReducer::ComputeBinOp(Device* device, OpKernel* op, Tensor* output,
+Status RingReducer::ComputeBinOp(OpKernel* op, Tensor* output,
                                  Tensor* input) {
-  // Prepare an OpKernelContext that is identical to that of the original Op
-  // (i.e. the collective), except for the input output sizes and identities and
-  // the Op itself.
-  // TODO(tucker): Is it possible to cache and reuse these objects?  They're
-  // mostly identical inside one device execution.
-  std::unique_ptr<SubContext> sub_ctx(
-      new SubContext(ctx_, op_params_, op, output, input));
-  device->Compute(op, sub_ctx->sub_ctx_);
-  return sub_ctx->sub_ctx_->status();
+  return collective_util::ComputeBinOp(ctx_, op_params_, device_, op, output,
+                                       input);
 }
 
 // At the beginning of the algorithm initialize a RingField struct for
@@ -315,6 +338,15 @@ void RingReducer::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
   if (rf->do_send || rf->do_recv) {
     rf->chunk = ca_->ChunkAlias(rf->sc_idx);
     CHECK(rf->chunk.IsAligned()) << rf->DebugString();
+    if (col_params_.instance.compression != COMPRESSION_NONE) {
+      // Both passes move this field, so allocate both buffers up front.
+      const TensorShape buf_shape({CompressedBytes(
+          col_params_.instance.compression, rf->chunk.NumElements())});
+      Allocator* allocator =
+          device_->GetAllocator(ctx_->output_alloc_attr(0));
+      rf->send_buf = Tensor(allocator, DT_UINT8, buf_shape);
+      rf->recv_buf = Tensor(allocator, DT_UINT8, buf_shape);
+    }
   }
   if (rf->do_recv) {
     rf->tmp_chunk = ca_->TempChunk(rf->sc_idx);
@@ -364,10 +396,15 @@ void RingReducer::DispatchSend(RingField* rf, const StatusCallback& done) {
   int send_to_rank = (rf->rank + 1) % group_size_;
   int send_to_dev_idx = col_params_.instance.impl_details
                             .subdiv_permutations[rf->subdiv_idx][send_to_rank];
+  const Tensor* src_tensor = &rf->chunk;
+  if (col_params_.instance.compression != COMPRESSION_NONE) {
+    src_tensor = (rf->second_pass && rf->do_recv) ? &rf->recv_buf
+                                                  : &rf->send_buf;
+  }
   col_exec_->PostToPeer(col_params_.instance.device_names[send_to_dev_idx],
                         col_params_.instance.task_names[send_to_dev_idx],
                         send_buf_key, device_, ctx_->op_device_context(),
-                        ctx_->output_alloc_attr(0), &rf->chunk,
+                        ctx_->output_alloc_attr(0), src_tensor,
                         device_locality_, done);
 }
 
@@ -382,6 +419,9 @@ void RingReducer::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_.merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  if (col_params_.instance.compression != COMPRESSION_NONE) {
+    dst_tensor = &rf->recv_buf;
+  }
   col_exec_->RecvFromPeer(col_params_.instance.device_names[rf->recv_dev_idx],
                           col_params_.instance.task_names[rf->recv_dev_idx],
                           col_params_.task.is_local[rf->recv_dev_idx],
@@ -390,6 +430,27 @@ void RingReducer::DispatchRecv(RingField* rf, const StatusCallback& done) {
                           device_locality_, done);
 }
 
+void RingReducer::CompressForSend(RingField* rf) {
+  if (rf->second_pass && rf->do_recv) {
+    // Forward the final value exactly as received, so that it is not
+    // requantized at every hop.
+    return;
+  }
+  Compress(col_params_.instance.compression, rf->chunk, &rf->send_buf);
+  if (rf->second_pass) {
+    // This device owns the final value of the field: keep the same lossy
+    // value that all of the other devices will receive.
+    Decompress(col_params_.instance.compression, rf->send_buf, &rf->chunk);
+  }
+}
+
+void RingReducer::DecompressRecv(RingField* rf) {
+  Tensor* dst_tensor = (!rf->second_pass && (col_params_.merge_op != nullptr))
+                           ? &rf->tmp_chunk
+                           : &rf->chunk;
+  Decompress(col_params_.instance.compression, rf->recv_buf, dst_tensor);
+}
+
 string RingReducer::FieldState() {
   string s = strings::StrCat("RingReducer ",
                              strings::Hex(reinterpret_cast<uint64>(this)),
@@ -449,7 +510,7 @@ bool RingReducer::RunAsyncParts() {
               const bool bad_status = !s.ok();
               if (bad_status) aborted = true;
               ready_queue.Enqueue(rf);
-              if (bad_status) StartAbort(s);
+              if (bad_status) status_.StartAbort(s);
             };
             DispatchRecv(rf, requeue);
             dispatched = true;
@@ -461,13 +522,18 @@ bool RingReducer::RunAsyncParts() {
         case RF_RECV:
           CHECK_GT(recv_pending_count, 0);
           --recv_pending_count;
+          if (col_params_.instance.compression != COMPRESSION_NONE) {
+            // Decoding here, on this loop's thread, overlaps with the
+            // transfers still pending for the other fields.
+            DecompressRecv(rf);
+          }
           if (!rf->second_pass) {
             rf->action = RF_REDUCE;
-            Status s = ComputeBinOp(device_, col_params_.merge_op.get(),
-                                    &rf->chunk, &rf->tmp_chunk);
+            Status s = ComputeBinOp(col_params_.merge_op.get(), &rf->chunk,
+                                    &rf->tmp_chunk);
             if (!s.ok()) {
               aborted = true;
-              StartAbort(s);
+              status_.StartAbort(s);
             }
           } else {
             rf->action = RF_SEND_READY;
@@ -476,12 +542,11 @@ bool RingReducer::RunAsyncParts() {
         case RF_REDUCE:
           if (!rf->second_pass && col_params_.final_op.get() && rf->is_final) {
             rf->action = RF_FINALIZE;
-            group_size_tensor_ready_.WaitForNotification();
-            Status s = ComputeBinOp(device_, col_params_.final_op.get(),
-                                    &rf->chunk, &group_size_tensor_);
+            Status s = ComputeBinOp(col_params_.final_op.get(), &rf->chunk,
+                                    &group_size_tensor_);
             if (!s.ok()) {
               aborted = true;
-              StartAbort(s);
+              status_.StartAbort(s);
             }
           } else {
             rf->action = RF_SEND_READY;
@@ -493,11 +558,14 @@ bool RingReducer::RunAsyncParts() {
         case RF_SEND_READY:
           if (rf->do_send) {
             rf->action = RF_SEND;
+            if (col_params_.instance.compression != COMPRESSION_NONE) {
+              CompressForSend(rf);
+            }
             auto send_complete = [this, rf, &ready_queue, &aborted](Status s) {
               const bool bad_status = !s.ok();
               if (bad_status) aborted = true;
               ready_queue.Enqueue(rf);
-              if (bad_status) StartAbort(s);
+              if (bad_status) status_.StartAbort(s);
             };
             DispatchSend(rf, send_complete);
             dispatched = true;
@@ -18,6 +18,7 @@ limitations under the License.
 #include <deque>
 
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 
@@ -25,44 +26,23 @@ namespace tensorflow {
 class DeviceMgr;
 
 // Ring-algorithm implementation of collective all-reduce.
-class RingReducer {
+class RingReducer : public CollectiveImplementationInterface {
  public:
   RingReducer(CollectiveExecutor* col_exec, const DeviceMgr* dev_mgr,
               OpKernelContext* ctx, OpKernelContext::Params* op_params,
               const CollectiveParams& col_params, const string& exec_key,
               int64 step_id, const Tensor* input, Tensor* output);
 
-  virtual ~RingReducer();
+  ~RingReducer() override {}
 
-  void Run(StatusCallback done);
+  void Run(StatusCallback done) override;
 
  private:
-  // Called when a bad status is received that implies we should terminate
-  // execution and return a bad status.
-  void StartAbort(const Status& s);
   void ContinueAfterInputCopy();
   void Finish(bool ok);
-  Status ComputeBinOp(Device* device, OpKernel* op, Tensor* output,
-                      Tensor* input);
+  Status ComputeBinOp(OpKernel* op, Tensor* output, Tensor* input);
   bool RunAsyncParts();
 
-  // Used for executing a sub-operation, e.g. a merge_op instance, with
-  // an OpKernelContext based on the one passed into this Op.
-  class SubContext {
-   public:
-    OpKernelContext::Params sub_params_;
-    gtl::InlinedVector<TensorValue, 4> sub_inputs_;
-    gtl::InlinedVector<AllocatorAttributes, 4> sub_input_attr_;
-    gtl::InlinedVector<DeviceContext*, 4> sub_input_dc_;
-    // Used only for Binary and Unary Ops for which we require
-    // the calculation to be in-place on the first input.
-    int forward_from_ = 0;
-    OpKernelContext* sub_ctx_;
-    SubContext(OpKernelContext* ctx, OpKernelContext::Params* params,
-               OpKernel* op, Tensor* output, Tensor* input);
-    ~SubContext() { delete sub_ctx_; }
-  };
-
   // Current status of a RingField
   enum RingFieldAction {
     RF_INIT = 0,    // Just initialized for a pass
@@ -90,6 +70,8 @@ class RingReducer {
     bool is_final = false;  // is the last field in the pass for this rank
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    Tensor send_buf;  // compressed value to send, if compressing
+    Tensor recv_buf;  // compressed value received, if compressing
     Status status;
     string DebugString() const;
   };
@@ -98,6 +80,12 @@ class RingReducer {
                      int field_idx);
   void DispatchSend(RingField* rf, const StatusCallback& done);
   void DispatchRecv(RingField* rf, const StatusCallback& done);
+  // Encodes rf->chunk into rf->send_buf unless rf forwards a value received
+  // in the second pass as is.
+  void CompressForSend(RingField* rf);
+  // Decodes rf->recv_buf into the tensor that DispatchRecv would otherwise
+  // have received into.
+  void DecompressRecv(RingField* rf);
 
   // For constructing log messages for debugging.
   string FieldState();
@@ -129,15 +117,14 @@ class RingReducer {
   const int group_size_;
   const int num_subdivs_;
   Tensor group_size_tensor_;
-  Notification group_size_tensor_ready_;
   std::unique_ptr<CollectiveAdapter> ca_;
   StatusCallback done_;
   Device* device_;  // The device for which this instance labors
   const string device_name_;
   DeviceLocality device_locality_;
 
-  mutex status_mu_;
-  Status status_ GUARDED_BY(status_mu_);
+  // A bad status implies we should terminate execution and return it.
+  collective_util::CollectiveStatus status_;
 
   std::vector<RingField> rfv_;
 };
@@ -17,6 +17,7 @@ limitations under the License.
 #include <algorithm>
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_testlib.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_resolver_local.h"
@@ -33,100 +34,12 @@ limitations under the License.
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
-#include "tensorflow/core/public/version.h"
 
 namespace tensorflow {
 namespace {
 
-// Wraps CollectiveRemoteAccessLocal with the ability to return an
-// error status to the N'th action.
-class FailTestRMA : public CollectiveRemoteAccessLocal {
- public:
-  FailTestRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
-              int64 step_id, int fail_after)
-      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, step_id),
-        fail_after_(fail_after) {}
-
-  bool MaybeFail(const StatusCallback& done) {
-    bool fail_now = false;
-    {
-      mutex_lock l(mu_);
-      if (fail_after_ > 0) {
-        fail_now = (--fail_after_ == 0);
-      }
-    }
-    if (fail_now) {
-      done(errors::Internal("Deliberate failure"));
-      return true;
-    }
-    return false;
-  }
-
-  void RecvFromPeer(const string& peer_device, const string& peer_task,
-                    bool peer_is_local, const string& key, Device* to_device,
-                    DeviceContext* to_device_ctx,
-                    const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
-                    const DeviceLocality& client_locality,
-                    const StatusCallback& done) override {
-    if (MaybeFail(done)) return;
-    CollectiveRemoteAccessLocal::RecvFromPeer(
-        peer_device, peer_task, peer_is_local, key, to_device, to_device_ctx,
-        to_alloc_attr, to_tensor, client_locality, done);
-  }
-
-  void PostToPeer(const string& peer_device, const string& peer_task,
-                  const string& key, Device* from_device,
-                  DeviceContext* from_device_ctx,
-                  const AllocatorAttributes& from_alloc_attr,
-                  const Tensor* from_tensor,
-                  const DeviceLocality& client_locality,
-                  const StatusCallback& done) override {
-    if (MaybeFail(done)) return;
-    CollectiveRemoteAccessLocal::PostToPeer(
-        peer_device, peer_task, key, from_device, from_device_ctx,
-        from_alloc_attr, from_tensor, client_locality, done);
-  }
-
-  mutex mu_;
-  int fail_after_ GUARDED_BY(mu_);
-};
-
-std::unique_ptr<OpKernel> GetKernel(const NodeDef& node,
-                                    const DeviceType& device_type,
-                                    DeviceBase* device) {
-  Status status;
-  std::unique_ptr<OpKernel> k = CreateOpKernel(
-      device_type, device, device->GetAllocator(AllocatorAttributes()), node,
-      TF_GRAPH_DEF_VERSION, &status);
-  if (!status.ok()) {
-    LOG(FATAL) << status;
-  }
-  return k;
-}
-
-std::unique_ptr<OpKernel> GetAdd(DataType dtype, const DeviceType& device_type,
-                                 DeviceBase* device) {
-  NodeDef node_def;
-  NodeDefBuilder builder("add_node", "Add");
-  TF_CHECK_OK(builder.Attr("T", dtype)
-                  .Input(FakeInput(dtype))
-                  .Input(FakeInput(dtype))
-                  .Finalize(&node_def));
-  return GetKernel(node_def, device_type, device);
-}
-
-std::unique_ptr<OpKernel> GetDiv(DataType dtype, const DeviceType& device_type,
-                                 DeviceBase* device) {
-  NodeDef node_def;
-  NodeDefBuilder builder("add_node", "Div");
-  TF_CHECK_OK(builder.Attr("T", dtype)
-                  .Input(FakeInput(dtype))
-                  .Input(FakeInput(dtype))
-                  .Finalize(&node_def));
-  return GetKernel(node_def, device_type, device);
-}
-
 static int64 kStepId = 123;
 
 class RingReducerTest : public ::testing::Test {
@@ -153,7 +66,8 @@ class RingReducerTest : public ::testing::Test {
   }
 
   void Init(int num_workers, int num_devices, DataType dtype,
-            const DeviceType& device_type, int num_subdivs, int fail_after) {
+            const DeviceType& device_type, int num_subdivs, int fail_after,
+            CollectiveCompression compression = COMPRESSION_NONE) {
     device_type_ = device_type;
     std::vector<Device*> local_devices;
     SessionOptions sess_opts;
@@ -186,8 +100,8 @@ class RingReducerTest : public ::testing::Test {
       dev_mgr_.reset(new DeviceMgr(local_devices));
     }
     dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
-    rma_ = new FailTestRMA(dev_mgr_.get(), dev_resolver_.get(), kStepId,
-                           fail_after);
+    rma_ = new test::CountingRMA(dev_mgr_.get(), dev_resolver_.get(),
+                                 kStepId, fail_after);
     col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
                                            dev_mgr_.get());
     col_params_.name = "test_collective";
@@ -200,6 +114,7 @@ class RingReducerTest : public ::testing::Test {
     col_params_.instance.impl_details.subdiv_offsets.clear();
     col_params_.instance.type = REDUCTION_COLLECTIVE;
     col_params_.instance.data_type = dtype;
+    col_params_.instance.compression = compression;
     col_params_.instance.impl_details.subdiv_permutations.resize(num_subdivs);
     col_params_.subdiv_rank.resize(num_subdivs);
     int subdiv_stride = num_devices / num_subdivs;
@@ -349,6 +264,49 @@ class RingReducerTest : public ::testing::Test {
     }
   }
 
+  // Initializes each device with float values in [-1, 1] and returns the
+  // expected mean.
+  std::vector<float> InitBoundedTensors(int tensor_len) {
+    std::vector<float> expected(tensor_len, 0.0);
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      instances_[di]->InitTensor(
+          DT_FLOAT, TensorShape({tensor_len}), [&expected, di](Tensor* t) {
+            for (size_t i = 0; i < t->NumElements(); ++i) {
+              float value =
+                  (static_cast<int>((di * 7 + i * 13) % 201) - 100) / 100.0f;
+              t->flat<float>()(i) = value;
+              expected[i] += value;
+            }
+          });
+    }
+    for (int i = 0; i < tensor_len; ++i) {
+      expected[i] /= instances_.size();
+    }
+    return expected;
+  }
+
+  // Runs a compressed reduction of float values and checks that every device
+  // got the same value, within 'tolerance' of the exact mean.
+  void RunCompressedTest(CollectiveCompression compression, int num_workers,
+                         int num_devices, int num_subdivs, int tensor_len,
+                         float tolerance) {
+    Init(num_workers, num_devices, DT_FLOAT, DEVICE_CPU, num_subdivs,
+         0 /*fail_after*/, compression);
+    std::vector<float> expected = InitBoundedTensors(tensor_len);
+    Reduce();
+    const Tensor& first = instances_[0]->tensor_;
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      TF_EXPECT_OK(instances_[di]->status_);
+      const Tensor& actual = instances_[di]->tensor_;
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_NEAR(expected[i], actual.flat<float>()(i), tolerance)
+            << "Mismatch at device " << di << " index " << i;
+        EXPECT_EQ(first.flat<float>()(i), actual.flat<float>()(i))
+            << "Devices disagree at device " << di << " index " << i;
+      }
+    }
+  }
+
   std::unique_ptr<OpKernel> GetCollectiveReduce(const CollectiveParams& params,
                                                 Tensor* input,
                                                 const DeviceType& device_type,
@@ -368,7 +326,7 @@ class RingReducerTest : public ::testing::Test {
             .Attr("subdiv_offsets", params.instance.impl_details.subdiv_offsets)
             .Input(FakeInput(params.instance.data_type))
             .Finalize(&node_def));
-    return GetKernel(node_def, device_type, device);
+    return test::GetKernel(node_def, device_type, device);
   }
 
   class DeviceInstance {
@@ -437,10 +395,10 @@ class RingReducerTest : public ::testing::Test {
     }
 
     void DoReduce() {
-      col_params_.merge_op =
-          GetAdd(col_params_.instance.data_type, device_type_, device_);
-      col_params_.final_op =
-          GetDiv(col_params_.instance.data_type, device_type_, device_);
+      col_params_.merge_op = test::GetBinOp(
+          "Add", col_params_.instance.data_type, device_type_, device_);
+      col_params_.final_op = test::GetBinOp(
+          "Div", col_params_.instance.data_type, device_type_, device_);
 
       // Prepare an OpKernelContext.
       OpKernelContext::Params op_params;
@@ -519,7 +477,7 @@ class RingReducerTest : public ::testing::Test {
   DeviceType device_type_;
   TestCollectiveExecutorMgr col_exec_mgr_;
   CollectiveExecutor* col_exec_;
-  CollectiveRemoteAccessLocal* rma_;
+  test::CountingRMA* rma_;
   std::unique_ptr<DeviceResolverLocal> dev_resolver_;
   std::vector<DeviceInstance*> instances_;
   CollectiveParams col_params_;
@@ -551,6 +509,11 @@ class RingReducerTest : public ::testing::Test {
     }                                                                         \
   }
 
+#define DEF_COMPRESSION_TEST(C, W, D, S, L, TOL)                             \
+  TEST_F(RingReducerTest, Compress##C##_Wkr##W##_Dev##D##_Sdiv##S##_Len##L) { \
+    RunCompressedTest(COMPRESSION_##C, W, D, S, L, TOL);                    \
+  }
+
 #ifndef GOOGLE_CUDA
 // Success tests
 DEF_TEST(FLOAT, CPU, 1, 2, 1, 1, 0)
@@ -575,6 +538,38 @@ DEF_TEST(INT64, CPU, 2, 8, 3, 4095, 0)
 // Failure tests
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
+
+// Compression tests
+DEF_COMPRESSION_TEST(FP16, 1, 2, 1, 1, 1e-3)
+DEF_COMPRESSION_TEST(FP16, 1, 2, 1, 1001, 1e-3)
+DEF_COMPRESSION_TEST(FP16, 2, 8, 3, 4095, 1e-2)
+DEF_COMPRESSION_TEST(BF16, 1, 2, 1, 1001, 1e-2)
+DEF_COMPRESSION_TEST(BF16, 2, 8, 3, 4095, 5e-2)
+DEF_COMPRESSION_TEST(INT8, 1, 2, 1, 1001, 2e-2)
+DEF_COMPRESSION_TEST(INT8, 2, 8, 1, 9408, 5e-2)
+DEF_COMPRESSION_TEST(INT8, 2, 8, 3, 4095, 5e-2)
+
+TEST_F(RingReducerTest, CompressionReducesBytesPosted) {
+  const int kNumDevices = 8;
+  const int kTensorLen = 4096;
+  RunCompressedTest(COMPRESSION_FP16, 1, kNumDevices, 1, kTensorLen, 1e-2);
+  // Each value crosses (group_size - 1) links in each of the two passes.
+  const int64 num_values_sent = 2 * (kNumDevices - 1) * kTensorLen;
+  EXPECT_EQ(num_values_sent * 2, rma_->bytes_posted());
+}
+
+TEST_F(RingReducerTest, CompressionRequiresFloat) {
+  Init(1, 2, DT_DOUBLE, DEVICE_CPU, 1, 0, COMPRESSION_FP16);
+  for (auto di : instances_) {
+    di->InitTensor(DT_DOUBLE, TensorShape({16}), [](Tensor* t) {
+      t->flat<double>().setZero();
+    });
+  }
+  Reduce();
+  for (auto di : instances_) {
+    EXPECT_EQ(error::UNIMPLEMENTED, di->status_.code());
+  }
+}
 #endif
 
 #ifdef GOOGLE_CUDA
@@ -602,5 +597,44 @@ DEF_TEST(FLOAT, GPU, 1, 8, 1, 9408, 2)
 DEF_TEST(FLOAT, GPU, 1, 8, 2, 9408, 5)
 #endif
 
+class RingReducerBenchmark : public RingReducerTest {
+ public:
+  using RingReducerTest::Init;
+  using RingReducerTest::InitBoundedTensors;
+  using RingReducerTest::Reduce;
+  using RingReducerTest::rma_;
+
+  void TestBody() override {}
+};
+
+static void BM_RingReduceCompressed(int iters, int compression,
+                                    int tensor_len) {
+  testing::StopTiming();
+  const int kNumDevices = 8;
+  int64 bytes_posted = 0;
+  for (int i = 0; i < iters; ++i) {
+    RingReducerBenchmark bm;
+    bm.Init(1, kNumDevices, DT_FLOAT, DEVICE_CPU, 1, 0,
+            static_cast<CollectiveCompression>(compression));
+    bm.InitBoundedTensors(tensor_len);
+    testing::StartTiming();
+    bm.Reduce();
+    testing::StopTiming();
+    bytes_posted += bm.rma_->bytes_posted();
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * tensor_len *
+                          sizeof(float));
+  testing::SetLabel(strings::StrCat("posted/iter=", bytes_posted / iters));
+}
+BENCHMARK(BM_RingReduceCompressed)
+    ->ArgPair(COMPRESSION_NONE, 1 << 16)
+    ->ArgPair(COMPRESSION_FP16, 1 << 16)
+    ->ArgPair(COMPRESSION_BF16, 1 << 16)
+    ->ArgPair(COMPRESSION_INT8, 1 << 16)
+    ->ArgPair(COMPRESSION_NONE, 1 << 20)
+    ->ArgPair(COMPRESSION_FP16, 1 << 20)
+    ->ArgPair(COMPRESSION_BF16, 1 << 20)
+    ->ArgPair(COMPRESSION_INT8, 1 << 20);
+
 }  // namespace
 }  // namespace tensorflow
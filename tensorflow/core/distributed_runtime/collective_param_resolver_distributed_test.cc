@@ -257,6 +257,11 @@ class DeviceResDistTest : public ::testing::Test {
     // Verify that all cp_ values get the same set of task and device
     // names, with unique default_rank in the expected order.
     const int dev_count = num_workers * num_devices;
+    // Reductions over several tasks with several devices each reduce within
+    // each task first.
+    const CollectiveReductionAlgorithm expected_algorithm =
+        (num_workers > 1 && num_devices > 1) ? REDUCTION_HIERARCHICAL
+                                             : REDUCTION_RING;
     for (int wi = 0; wi < num_workers; ++wi) {
       string task_name = strings::StrCat("/job:worker/replica:0/task:", wi);
       for (int di = 0; di < num_devices; ++di) {
@@ -267,6 +272,8 @@ class DeviceResDistTest : public ::testing::Test {
         EXPECT_EQ(cp_[idx].instance.device_names.size(), dev_count);
         EXPECT_EQ(cp_[idx].instance.device_names[idx], device_name);
         EXPECT_EQ(cp_[idx].instance.task_names[idx], task_name);
+        EXPECT_EQ(expected_algorithm,
+                  cp_[idx].instance.impl_details.reduction_algorithm);
         if (idx > 0) {
           for (int i = 0; i < dev_count; ++i) {
             EXPECT_EQ(cp_[0].instance.device_names[i],
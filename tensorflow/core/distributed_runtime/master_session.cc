@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/master_session.h"
 
+#include <algorithm>
+#include <list>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -41,12 +44,16 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -55,6 +62,233 @@ limitations under the License.
 
 namespace tensorflow {
 
+namespace {
+
+auto* partition_cache_hits = monitoring::Counter<0>::New(
+    "/tensorflow/core/master_session_partition_cache_hits",
+    "The number of partitions that MasterSession did not register because "
+    "an identical graph was already registered on the worker.");
+
+auto* partition_cache_misses = monitoring::Counter<0>::New(
+    "/tensorflow/core/master_session_partition_cache_misses",
+    "The number of partitions that MasterSession registered on workers.");
+
+auto* partition_cache_evictions = monitoring::Counter<0>::New(
+    "/tensorflow/core/master_session_partition_cache_evictions",
+    "The number of unused partitions that MasterSession deregistered to "
+    "bound the size of its partition cache.");
+
+// The number of registered partitions that no client graph uses which a
+// session keeps for reuse.
+const int kMaxUnusedPartitions = 64;
+
+// Combines the fingerprint of "msg" into "*fp". Returns false if "msg"
+// can't be serialized, e.g. because it is over 2GB.
+bool FingerprintMessage(const protobuf::MessageLite& msg, uint64* fp) {
+  string buf;
+  if (!SerializeToStringDeterministic(msg, &buf)) return false;
+  *fp = FingerprintCat64(*fp, Fingerprint64(buf));
+  return true;
+}
+
+// Sets "*fp" to a fingerprint of the graph that "req" registers, ignoring
+// the names in "new_names" that the partitioner generated for it. Those
+// names are unique within a session, but do not change what the graph
+// computes: rendezvous keys come from the attrs of the send and recv nodes.
+// The graph is hashed one field at a time rather than copied and renamed,
+// since it may be large. Returns false if part of it can't be serialized.
+bool PartitionFingerprint(const RegisterGraphRequest& req,
+                          const std::unordered_set<string>& new_names,
+                          uint64* fp) {
+  const GraphDef& def = req.graph_def();
+  // Generated names are replaced by their index in the order of the nodes.
+  std::unordered_map<StringPiece, int, StringPieceHasher> renamed;
+  for (const NodeDef& ndef : def.node()) {
+    if (new_names.count(ndef.name()) > 0) {
+      renamed.emplace(ndef.name(), renamed.size());
+    }
+  }
+  auto name_fp = [&renamed](StringPiece name) {
+    auto iter = renamed.find(name);
+    if (iter == renamed.end()) return Fingerprint64(name);
+    return FingerprintCat64(0, iter->second);
+  };
+  *fp = Fingerprint64(strings::StrCat(def.node_size()));
+  for (const NodeDef& ndef : def.node()) {
+    *fp = FingerprintCat64(*fp, name_fp(ndef.name()));
+    *fp = FingerprintCat64(*fp, Fingerprint64(ndef.op()));
+    *fp = FingerprintCat64(*fp, Fingerprint64(ndef.device()));
+    *fp = FingerprintCat64(*fp, ndef.input_size());
+    for (const string& input : ndef.input()) {
+      const TensorId id = ParseTensorName(input);
+      *fp = FingerprintCat64(*fp, name_fp(id.first));
+      *fp = FingerprintCat64(*fp, id.second);
+    }
+    std::vector<std::pair<StringPiece, const AttrValue*>> attrs;
+    attrs.reserve(ndef.attr_size());
+    for (const auto& attr : ndef.attr()) {
+      attrs.emplace_back(attr.first, &attr.second);
+    }
+    std::sort(attrs.begin(), attrs.end());
+    *fp = FingerprintCat64(*fp, attrs.size());
+    for (const auto& attr : attrs) {
+      *fp = FingerprintCat64(*fp, Fingerprint64(attr.first));
+      if (!FingerprintMessage(*attr.second, fp)) return false;
+    }
+  }
+  return FingerprintMessage(def.versions(), fp) &&
+         FingerprintMessage(def.library(), fp) &&
+         FingerprintMessage(req.graph_options(), fp) &&
+         FingerprintMessage(req.debug_options(), fp);
+}
+
+// Asynchronously deregisters "graph_handle" on the worker "w" named "name",
+// without waiting for the result, and then releases "w".
+void DeregisterGraphAsync(WorkerCacheInterface* worker_cache,
+                          const string& name, WorkerInterface* w,
+                          const string& session_handle,
+                          bool create_worker_session_called,
+                          const string& graph_handle) {
+  struct Call {
+    DeregisterGraphRequest req;
+    DeregisterGraphResponse resp;
+  };
+  Call* c = new Call;
+  c->req.set_session_handle(session_handle);
+  c->req.set_create_worker_session_called(create_worker_session_called);
+  c->req.set_graph_handle(graph_handle);
+  auto cb = [worker_cache, c, name, w](const Status& s) {
+    if (!s.ok()) {
+      // This error is potentially benign, so we don't log at the
+      // error level.
+      LOG(INFO) << "DeregisterGraph error: " << s;
+    }
+    delete c;
+    worker_cache->ReleaseWorker(name, w);
+  };
+  w->DeregisterGraphAsync(&c->req, &c->resp, cb);
+}
+
+}  // namespace
+
+// The partitions registered on workers by the ReffedClientGraphs of a
+// session, keyed by worker name and PartitionFingerprint(). A graph that no
+// ReffedClientGraph uses stays registered until it is evicted in LRU order,
+// so that a new signature whose subgraph on some worker did not change
+// reuses the graph registered there instead of registering it again.
+class MasterSession::PartitionCache : public core::RefCounted {
+ public:
+  PartitionCache(const string& session_handle,
+                 WorkerCacheInterface* worker_cache, bool should_deregister)
+      : session_handle_(session_handle),
+        worker_cache_(worker_cache),
+        should_deregister_(should_deregister) {}
+
+  // If a graph with fingerprint "fp" is registered on "worker", sets
+  // "*graph_handle" to its handle, takes a reference on it and returns true.
+  bool Lookup(const string& worker, uint64 fp, string* graph_handle) {
+    mutex_lock l(mu_);
+    auto iter = entries_.find({worker, fp});
+    if (iter == entries_.end()) return false;
+    Entry* e = &iter->second;
+    if (e->refs++ == 0) unused_.erase(e->lru);
+    *graph_handle = e->graph_handle;
+    return true;
+  }
+
+  // Adds "graph_handle", just registered on "worker", with one reference.
+  // Returns false, leaving the cache unchanged, if the cache is closed or
+  // a graph with fingerprint "fp" was added in the meantime.
+  bool Insert(const string& worker, uint64 fp, const string& graph_handle) {
+    mutex_lock l(mu_);
+    if (closed_) return false;
+    auto result = entries_.insert({{worker, fp}, Entry()});
+    if (!result.second) return false;
+    result.first->second.graph_handle = graph_handle;
+    result.first->second.refs = 1;
+    return true;
+  }
+
+  // Drops a reference taken by Lookup() or Insert().
+  void Release(const string& worker, uint64 fp) {
+    std::vector<std::pair<string, string>> evicted;
+    bool deregister;
+    {
+      mutex_lock l(mu_);
+      auto iter = entries_.find({worker, fp});
+      CHECK(iter != entries_.end());
+      Entry* e = &iter->second;
+      if (--e->refs > 0) return;
+      e->lru = unused_.insert(unused_.begin(), iter->first);
+      deregister = Evict(closed_ ? 0 : kMaxUnusedPartitions, &evicted);
+    }
+    Deregister(deregister, evicted);
+  }
+
+  // Evicts all unused graphs. Graphs released after this are evicted at
+  // once. When the worker sessions of the session are deleted, which
+  // deregisters their graphs, the evicted graphs are not deregistered.
+  void Close() {
+    std::vector<std::pair<string, string>> evicted;
+    bool deregister;
+    {
+      mutex_lock l(mu_);
+      closed_ = true;
+      deregister = Evict(0, &evicted);
+    }
+    Deregister(deregister, evicted);
+  }
+
+ private:
+  typedef std::pair<string, uint64> Key;
+
+  struct Entry {
+    string graph_handle;
+    int refs = 0;
+    // Position in unused_ when refs is 0.
+    std::list<Key>::iterator lru;
+  };
+
+  // Evicts the least recently used graphs until at most "max_unused" are
+  // unused, appending their worker names and handles to "evicted". Returns
+  // true if the evicted graphs must be deregistered.
+  bool Evict(int max_unused, std::vector<std::pair<string, string>>* evicted)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    while (static_cast<int>(unused_.size()) > max_unused) {
+      auto iter = entries_.find(unused_.back());
+      evicted->emplace_back(iter->first.first, iter->second.graph_handle);
+      entries_.erase(iter);
+      unused_.pop_back();
+      if (!closed_) partition_cache_evictions->GetCell()->IncrementBy(1);
+    }
+    return should_deregister_ || !closed_;
+  }
+
+  void Deregister(bool deregister,
+                  const std::vector<std::pair<string, string>>& evicted) {
+    if (!deregister) return;
+    for (const auto& name_handle : evicted) {
+      WorkerInterface* w = worker_cache_->CreateWorker(name_handle.first);
+      if (w == nullptr) continue;
+      DeregisterGraphAsync(worker_cache_, name_handle.first, w,
+                           session_handle_, !should_deregister_,
+                           name_handle.second);
+    }
+  }
+
+  const string session_handle_;
+  WorkerCacheInterface* const worker_cache_;  // Not owned.
+  const bool should_deregister_;
+
+  mutex mu_;
+  std::map<Key, Entry> entries_ GUARDED_BY(mu_);
+  // Keys of the unused entries, most recently released first.
+  std::list<Key> unused_ GUARDED_BY(mu_);
+  bool closed_ GUARDED_BY(mu_) = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PartitionCache);
+};
+
 // MasterSession wraps ClientGraph in a reference counted object.
 // This way, MasterSession can clear up the cache mapping Run requests to
 // compiled graphs while the compiled graph is still being used.
@@ -67,14 +301,16 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
                     const SessionOptions& session_opts,
                     const StatsPublisherFactory& stats_publisher_factory,
                     bool is_partial, WorkerCacheInterface* worker_cache,
-                    bool should_deregister)
+                    PartitionCache* partition_cache, bool should_deregister)
       : session_handle_(handle),
         client_graph_(std::move(cg)),
         session_opts_(session_opts),
         is_partial_(is_partial),
         callable_opts_(bopts.callable_options),
         worker_cache_(worker_cache),
+        partition_cache_(partition_cache),
         should_deregister_(should_deregister) {
+    partition_cache_->Ref();
     VLOG(1) << "Created ReffedClientGraph for node with "
             << client_graph()->graph.num_node_ids();
 
@@ -87,6 +323,11 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
   }
 
   ~ReffedClientGraph() override {
+    for (Part& part : partitions_) {
+      if (part.cached) {
+        partition_cache_->Release(part.name, part.fingerprint);
+      }
+    }
     if (should_deregister_) {
       DeregisterPartitions();
     } else {
@@ -94,6 +335,7 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
         worker_cache_->ReleaseWorker(part.name, part.worker);
       }
     }
+    partition_cache_->Unref();
   }
 
   const ClientGraph* client_graph() { return client_graph_.get(); }
@@ -231,6 +473,7 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
   const bool is_partial_;
   const CallableOptions callable_opts_;
   WorkerCacheInterface* const worker_cache_;  // Not owned.
+  PartitionCache* const partition_cache_;
   std::unordered_map<StringPiece, Node*, StringPieceHasher> name_to_node_;
   const bool should_deregister_;
   std::atomic<int64> execution_count_ = {0};
@@ -253,6 +496,12 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
     // this partition on the worker.
     string graph_handle;
 
+    // Fingerprint of the registered graph. If cached, graph_handle may be
+    // shared with other client graphs through the session's PartitionCache,
+    // which deregisters it.
+    uint64 fingerprint = 0;
+    bool cached = false;
+
     Part() : feed_key(3), key_fetch(3) {}
   };
 
@@ -281,11 +530,13 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
                                    const PartitionOptions& popts);
 
   // The actual graph partitioning and registration implementation.
+  // "new_names" collects the node names generated by "popts.new_name".
   Status DoBuildPartitions(
-      PartitionOptions pots,
+      PartitionOptions pots, std::unordered_set<string>* new_names,
       std::unordered_map<string, GraphDef>* out_partitions);
   Status DoRegisterPartitions(
       const PartitionOptions& popts,
+      const std::unordered_set<string>& new_names,
       std::unordered_map<string, GraphDef> graph_partitions);
 
   // Prepares a number of calls to workers. One call per partition.
@@ -313,8 +564,9 @@ Status MasterSession::ReffedClientGraph::RegisterPartitions(
     if (!init_started_) {
       init_started_ = true;
       mu_.unlock();
+      std::unordered_set<string> new_names;
       std::unordered_map<string, GraphDef> graph_defs;
-      Status s = DoBuildPartitions(popts, &graph_defs);
+      Status s = DoBuildPartitions(popts, &new_names, &graph_defs);
       if (s.ok()) {
         // NOTE(mrry): The pointers in `graph_defs_for_publishing` do not remain
         // valid after the call to DoRegisterPartitions begins, so
@@ -326,7 +578,7 @@ Status MasterSession::ReffedClientGraph::RegisterPartitions(
           graph_defs_for_publishing.push_back(&name_def.second);
         }
         stats_publisher_->PublishGraphProto(graph_defs_for_publishing);
-        s = DoRegisterPartitions(popts, std::move(graph_defs));
+        s = DoRegisterPartitions(popts, new_names, std::move(graph_defs));
       }
       mu_.lock();
       init_result_ = s;
@@ -390,8 +642,14 @@ void MasterSession::ReffedClientGraph::TrackFeedsAndFetches(
 }
 
 Status MasterSession::ReffedClientGraph::DoBuildPartitions(
-    PartitionOptions popts,
+    PartitionOptions popts, std::unordered_set<string>* new_names,
     std::unordered_map<string, GraphDef>* out_partitions) {
+  auto new_name = popts.new_name;
+  popts.new_name = [new_name, new_names](const string& prefix) {
+    string name = new_name(prefix);
+    new_names->insert(name);
+    return name;
+  };
   if (popts.need_to_record_start_times) {
     CostModel cost_model(true);
     cost_model.InitFromGraph(client_graph()->graph);
@@ -406,7 +664,7 @@ Status MasterSession::ReffedClientGraph::DoBuildPartitions(
 }
 
 Status MasterSession::ReffedClientGraph::DoRegisterPartitions(
-    const PartitionOptions& popts,
+    const PartitionOptions& popts, const std::unordered_set<string>& new_names,
     std::unordered_map<string, GraphDef> graph_partitions) {
   partitions_.reserve(graph_partitions.size());
   Status s;
@@ -432,31 +690,52 @@ Status MasterSession::ReffedClientGraph::DoRegisterPartitions(
     RegisterGraphRequest req;
     RegisterGraphResponse resp;
     Status status;
+    bool cacheable = false;
   };
   const int num = partitions_.size();
   gtl::InlinedVector<Call, 4> calls(num);
   BlockingCounter done(num);
   for (int i = 0; i < num; ++i) {
-    const Part& part = partitions_[i];
+    Part* part = &partitions_[i];
     Call* c = &calls[i];
     c->req.set_session_handle(session_handle_);
     c->req.set_create_worker_session_called(!should_deregister_);
-    c->req.mutable_graph_def()->Swap(&graph_partitions[part.name]);
+    c->req.mutable_graph_def()->Swap(&graph_partitions[part->name]);
     *c->req.mutable_graph_options() = session_opts_.config.graph_options();
     *c->req.mutable_debug_options() =
         callable_opts_.run_options().debug_options();
+    // Another signature may have registered the same graph on this worker.
+    c->cacheable = PartitionFingerprint(c->req, new_names, &part->fingerprint);
+    if (!c->cacheable) {
+      LOG(WARNING) << "Not caching a partition for " << part->name
+                   << " that can't be fingerprinted";
+    } else if (partition_cache_->Lookup(part->name, part->fingerprint,
+                                        &part->graph_handle)) {
+      VLOG(2) << "Reuse graph " << part->graph_handle << " on " << part->name;
+      partition_cache_hits->GetCell()->IncrementBy(1);
+      part->cached = true;
+      done.DecrementCount();
+      continue;
+    }
+    partition_cache_misses->GetCell()->IncrementBy(1);
     VLOG(2) << "Register " << c->req.graph_def().DebugString();
     auto cb = [c, &done](const Status& s) {
       c->status = s;
       done.DecrementCount();
     };
-    part.worker->RegisterGraphAsync(&c->req, &c->resp, cb);
+    part->worker->RegisterGraphAsync(&c->req, &c->resp, cb);
   }
   done.Wait();
   for (int i = 0; i < num; ++i) {
+    Part* part = &partitions_[i];
+    if (part->cached) continue;
     Call* c = &calls[i];
     s.Update(c->status);
-    partitions_[i].graph_handle = c->resp.graph_handle();
+    part->graph_handle = c->resp.graph_handle();
+    if (c->status.ok() && c->cacheable) {
+      part->cached = partition_cache_->Insert(part->name, part->fingerprint,
+                                              part->graph_handle);
+    }
   }
   return s;
 }
@@ -1005,33 +1284,18 @@ Status MasterSession::ReffedClientGraph::CheckFetches(
 // Asynchronously deregisters subgraphs on the workers, without waiting for the
 // result.
 void MasterSession::ReffedClientGraph::DeregisterPartitions() {
-  struct Call {
-    DeregisterGraphRequest req;
-    DeregisterGraphResponse resp;
-  };
   for (Part& part : partitions_) {
-    // The graph handle may be empty if we failed during partition registration.
-    if (!part.graph_handle.empty()) {
-      Call* c = new Call;
-      c->req.set_session_handle(session_handle_);
-      c->req.set_create_worker_session_called(!should_deregister_);
-      c->req.set_graph_handle(part.graph_handle);
-      // NOTE(mrry): We must capture `worker_cache_` since `this`
-      // could be deleted before the callback is called.
-      WorkerCacheInterface* worker_cache = worker_cache_;
-      const string name = part.name;
-      WorkerInterface* w = part.worker;
-      CHECK_NOTNULL(w);
-      auto cb = [worker_cache, c, name, w](const Status& s) {
-        if (!s.ok()) {
-          // This error is potentially benign, so we don't log at the
-          // error level.
-          LOG(INFO) << "DeregisterGraph error: " << s;
-        }
-        delete c;
-        worker_cache->ReleaseWorker(name, w);
-      };
-      w->DeregisterGraphAsync(&c->req, &c->resp, cb);
+    if (part.cached) {
+      // The PartitionCache deregisters the graph once no client graph uses
+      // it.
+      worker_cache_->ReleaseWorker(part.name, part.worker);
+    } else if (!part.graph_handle.empty()) {
+      // The graph handle may be empty if we failed during partition
+      // registration.
+      CHECK_NOTNULL(part.worker);
+      DeregisterGraphAsync(worker_cache_, part.name, part.worker,
+                           session_handle_, !should_deregister_,
+                           part.graph_handle);
     }
   }
 }
@@ -1154,6 +1418,10 @@ MasterSession::MasterSession(
 MasterSession::~MasterSession() {
   for (const auto& iter : run_graphs_) iter.second->Unref();
   for (const auto& iter : partial_run_graphs_) iter.second->Unref();
+  if (partition_cache_ != nullptr) {
+    partition_cache_->Close();
+    partition_cache_->Unref();
+  }
 }
 
 void MasterSession::UpdateLastAccessTime() {
@@ -1183,6 +1451,8 @@ Status MasterSession::Create(GraphDef* graph_def,
         graph_def, execution_options, &execution_state_));
   }
   should_delete_worker_sessions_ = true;
+  partition_cache_ = new PartitionCache(handle_, get_worker_cache(),
+                                        !should_delete_worker_sessions_);
   return CreateWorkerSessions(options);
 }
 
@@ -1406,7 +1676,7 @@ Status MasterSession::StartStep(const BuildGraphOptions& opts, bool is_partial,
       auto entry = new ReffedClientGraph(
           handle_, opts, std::move(client_graph), session_opts_,
           stats_publisher_factory_, is_partial, worker_cache,
-          !should_delete_worker_sessions_);
+          partition_cache_, !should_delete_worker_sessions_);
       iter = m->insert({hash, entry}).first;
       VLOG(1) << "Preparing to execute new graph";
     }
@@ -1835,6 +2105,7 @@ Status MasterSession::MakeCallable(const MakeCallableRequest& req,
     callable = new ReffedClientGraph(handle_, opts, std::move(client_graph),
                                      session_opts_, stats_publisher_factory_,
                                      false /* is_partial */, get_worker_cache(),
+                                     partition_cache_,
                                      !should_delete_worker_sessions_);
   }
 
@@ -1948,6 +2219,7 @@ Status MasterSession::Close() {
     ClearRunsTable(&to_unref, &callables_);
   }
   for (ReffedClientGraph* rcg : to_unref) rcg->Unref();
+  if (partition_cache_ != nullptr) partition_cache_->Close();
   if (should_delete_worker_sessions_) {
     Status s = DeleteWorkerSessions();
     if (!s.ok()) {
@@ -157,6 +157,11 @@ class MasterSession : public core::RefCounted {
   int64 next_callable_handle_ GUARDED_BY(mu_) = 0;
   RCGMap callables_ GUARDED_BY(mu_);
 
+  // Partitions registered on workers, shared by the ReffedClientGraphs of
+  // this session. Created by Create().
+  class PartitionCache;
+  PartitionCache* partition_cache_ = nullptr;
+
   struct PerStepState {
     bool collect_costs = false;
     bool collect_timeline = false;
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_testlib.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
@@ -24,11 +25,14 @@ limitations under the License.
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/util/port.h"
 
@@ -457,6 +461,101 @@ TEST(GrpcSessionTest, LargeTensorSend) {
   TF_CHECK_OK(session->Close());
 }
 
+// Builds a graph that fills a tensor of 'num_mb' megabytes of ones on
+// 'src_device' and reduces it to its maximum on 'dst_device'.
+static void MakeTransferGraph(int num_mb, const string& src_device,
+                              const string& dst_device, GraphDef* def,
+                              string* fetch) {
+  Graph graph(OpRegistry::Global());
+  Tensor fill_shape_tensor(DT_INT32, TensorShape({3}));
+  fill_shape_tensor.vec<int32>()(0) = num_mb;
+  fill_shape_tensor.vec<int32>()(1) = 256;
+  fill_shape_tensor.vec<int32>()(2) = 1024;
+  Node* fill_shape_node = test::graph::Constant(&graph, fill_shape_tensor);
+  Tensor fill_val_tensor(DT_FLOAT, TensorShape({}));
+  fill_val_tensor.flat<float>()(0) = 1.0;
+  Node* fill_val_node = test::graph::Constant(&graph, fill_val_tensor);
+  Node* fill_node =
+      test::graph::Binary(&graph, "Fill", fill_shape_node, fill_val_node);
+
+  Tensor max_axes_tensor(DT_INT32, TensorShape({3}));
+  max_axes_tensor.vec<int32>()(0) = 0;
+  max_axes_tensor.vec<int32>()(1) = 1;
+  max_axes_tensor.vec<int32>()(2) = 2;
+  Node* max_axes_node = test::graph::Constant(&graph, max_axes_tensor);
+  Node* max_node = test::graph::Reduce(&graph, "Max", fill_node, max_axes_node);
+
+  test::graph::ToGraphDef(&graph, def);
+  SetDevice(def, fill_node->name(), src_device);
+  SetDevice(def, max_node->name(), dst_device);
+  *fetch = max_node->name();
+}
+
+// Sends a tensor with more content than RpcRendezvousMgr fetches in one
+// message, so that the receiving worker fetches it in chunks.
+TEST(GrpcSessionTest, ChunkedTensorSend) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+
+  GraphDef def;
+  string fetch;
+  MakeTransferGraph(100, cluster->devices()[0].name(),
+                    cluster->devices()[1].name(), &def, &fetch);
+
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1000)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  for (int i = 0; i < 2; ++i) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 1.0);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
+// Receives on the second worker a tensor that the first worker computes
+// from a tensor it receives from the second worker, together with tensors
+// that don't depend on it.  Receives of tensors that are ready must not
+// wait for that one, even though they are batched.
+TEST(GrpcSessionTest, BatchedRecvsWithDependencies) {
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  const string dev0 = cluster->devices()[0].name();
+  const string dev1 = cluster->devices()[1].name();
+
+  Graph graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Tensor two(DT_FLOAT, TensorShape({}));
+  two.scalar<float>()() = 2.0;
+  Node* a = test::graph::Constant(&graph, one);
+  Node* b = test::graph::Identity(&graph, a);
+  Node* c = test::graph::Identity(&graph, b);
+  Node* e = test::graph::Constant(&graph, two);
+  Node* d = test::graph::Add(&graph, c, e);
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), dev0);
+  SetDevice(&def, b->name(), dev1);
+  SetDevice(&def, c->name(), dev0);
+  SetDevice(&def, e->name(), dev0);
+  SetDevice(&def, d->name(), dev1);
+
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1000)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(def));
+  for (int i = 0; i < 2; ++i) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {d->name()}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    IsSingleFloatValue(outputs[0], 3.0);
+  }
+  TF_CHECK_OK(session->Close());
+}
+
 TEST(GrpcSessionTest, MultiDevices_String) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 1), 2, &cluster));
@@ -558,6 +657,112 @@ TEST(GrpcSessionTest, SendRecv_Node_Naming) {
   TF_CHECK_OK(session->Close());
 }
 
+// Two tasks with one CPU each, run in this process rather than in
+// subprocesses like test::TestCluster, so that tests can read the metrics
+// of the master.
+struct InProcessCluster {
+  string target;  // Of the master, task 0
+  std::vector<string> devices;
+  std::vector<std::unique_ptr<ServerInterface>> servers;
+};
+
+// Started servers can't be shut down, so the cluster is shared and lives
+// until the process exits.
+static const InProcessCluster& GetInProcessCluster() {
+  static InProcessCluster* cluster = [] {
+    const int kNumTasks = 2;
+    InProcessCluster* ret = new InProcessCluster;
+    ServerDef def;
+    def.set_protocol("grpc");
+    def.set_job_name("localhost");
+    JobDef* job = def.mutable_cluster()->add_job();
+    job->set_name("localhost");
+    for (int i = 0; i < kNumTasks; ++i) {
+      (*job->mutable_tasks())[i] =
+          strings::StrCat("localhost:", testing::PickUnusedPortOrDie());
+      ret->devices.push_back(strings::StrCat(
+          "/job:localhost/replica:0/task:", i, "/device:CPU:0"));
+    }
+    ret->target = job->tasks().at(0);
+    *def.mutable_default_session_config() = Devices(1, 0).config;
+    for (int i = 0; i < kNumTasks; ++i) {
+      def.set_task_index(i);
+      std::unique_ptr<ServerInterface> server;
+      TF_CHECK_OK(NewServer(def, &server));
+      TF_CHECK_OK(server->Start());
+      ret->servers.push_back(std::move(server));
+    }
+    return ret;
+  }();
+  return *cluster;
+}
+
+// Returns the number of partitions that master sessions in this process did
+// not register because an identical graph was already registered on the
+// worker.
+static int64 PartitionCacheHits() {
+  monitoring::CollectionRegistry::CollectMetricsOptions options;
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics(options);
+  const auto& point_set = metrics->point_set_map.at(
+      "/tensorflow/core/master_session_partition_cache_hits");
+  // The counter has no point until it is first incremented.
+  if (point_set->points.empty()) return 0;
+  return point_set->points[0]->int64_value;
+}
+
+TEST(GrpcSessionTest, ReusePartitionsAcrossSignatures) {
+  const InProcessCluster& cluster = GetInProcessCluster();
+  std::unique_ptr<Session> session(NewRemote(Options(cluster.target, 1)));
+  ASSERT_TRUE(session != nullptr);
+
+  // Feeds and fetches go through the client device, on the task of the
+  // master, so only partitions on the other task can be shared.
+  const string& master = cluster.devices[0];
+  const string& worker = cluster.devices[1];
+
+  // a and b on 'worker', and c and d on 'master' read b. e on 'master'
+  // comes first, so that fetching it shifts the ids of all other edges.
+  Graph graph(OpRegistry::Global());
+  Tensor a_tensor(DT_FLOAT, TensorShape({1, 1}));
+  a_tensor.flat<float>()(0) = 100;
+  Node* e = test::graph::Constant(&graph, a_tensor);
+  Node* a = test::graph::Constant(&graph, a_tensor);
+  Node* b = test::graph::Identity(&graph, a);
+  Node* c = test::graph::Identity(&graph, b);
+  Node* d = test::graph::Identity(&graph, b);
+
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  SetDevice(&def, a->name(), worker);
+  SetDevice(&def, b->name(), worker);
+  SetDevice(&def, c->name(), master);
+  SetDevice(&def, d->name(), master);
+  SetDevice(&def, e->name(), master);
+  TF_CHECK_OK(session->Create(def));
+
+  // Feeding a keeps the graph optimizer from folding b into a constant on
+  // 'worker'.
+  Tensor feed(DT_FLOAT, TensorShape({1, 1}));
+  feed.flat<float>()(0) = 7;
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run({{a->name(), feed}}, {c->name()}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  IsSingleFloatValue(outputs[0], 7);
+
+  // Fetching d and e instead of c changes the partition on 'master', but the
+  // one on 'worker' is the graph registered by the first step.
+  const int64 hits = PartitionCacheHits();
+  TF_CHECK_OK(session->Run({{a->name(), feed}}, {d->name(), e->name()}, {},
+                           &outputs));
+  ASSERT_EQ(2, outputs.size());
+  IsSingleFloatValue(outputs[0], 7);
+  IsSingleFloatValue(outputs[1], 100);
+  EXPECT_EQ(hits + 1, PartitionCacheHits());
+
+  TF_CHECK_OK(session->Close());
+}
+
 TEST(GrpcSessionTest, Error) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
@@ -1006,6 +1211,135 @@ TEST(SessionTest, RunTimeoutWithSessionOptions) {
               error::INTERNAL == status.code());
 }
 
+// Measures the throughput of sending a tensor of 'num_mb' megabytes between
+// two workers of the loopback test cluster.  Tensors of more than 32MB are
+// fetched in chunks.
+static void BM_RemoteTensorTransfer(int iters, int num_mb) {
+  testing::StopTiming();
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  GraphDef def;
+  string fetch;
+  MakeTransferGraph(num_mb, cluster->devices()[0].name(),
+                    cluster->devices()[1].name(), &def, &fetch);
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1000)));
+  TF_CHECK_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  // Warm up.
+  TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+  testing::BytesProcessed(static_cast<int64>(iters) * num_mb << 20);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_RemoteTensorTransfer)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
+// Makes a graph that sums 'num_edges' scalars computed on 'src_device' on
+// 'dst_device', so that each step receives 'num_edges' tensors.
+static void MakeManyEdgeGraph(int num_edges, const string& src_device,
+                              const string& dst_device, GraphDef* def,
+                              string* fetch) {
+  Graph graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* x = test::graph::Constant(&graph, one);
+  std::vector<Node*> srcs;
+  Node* sum = nullptr;
+  for (int i = 0; i < num_edges; ++i) {
+    Node* src = test::graph::Identity(&graph, x);
+    srcs.push_back(src);
+    sum = sum == nullptr ? test::graph::Identity(&graph, src)
+                         : test::graph::Add(&graph, sum, src);
+  }
+  test::graph::ToGraphDef(&graph, def);
+  for (NodeDef& node : *def->mutable_node()) {
+    node.set_device(dst_device);
+  }
+  SetDevice(def, x->name(), src_device);
+  for (Node* src : srcs) {
+    SetDevice(def, src->name(), src_device);
+  }
+  *fetch = sum->name();
+}
+
+// Measures the latency of a step that receives 'num_edges' small tensors
+// from another worker.
+static void BM_ManyEdgeStep(int iters, int num_edges) {
+  testing::StopTiming();
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  GraphDef def;
+  string fetch;
+  MakeManyEdgeGraph(num_edges, cluster->devices()[0].name(),
+                    cluster->devices()[1].name(), &def, &fetch);
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1000)));
+  TF_CHECK_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  // Warm up.
+  TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+  IsSingleFloatValue(outputs[0], num_edges);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_edges);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_ManyEdgeStep)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
+// Measures the latency of the first step of a new signature, which fetches
+// a tensor on the task of the master that depends on 'num_nodes' nodes on
+// the other task. The partition on the other task is the same for every
+// signature, so only the first one registers it.
+static void BM_SignatureChangeFirstStep(int iters, int num_nodes) {
+  testing::StopTiming();
+  const InProcessCluster& cluster = GetInProcessCluster();
+  Graph graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* x = test::graph::Constant(&graph, one);
+  Node* sum = x;
+  std::vector<Node*> srcs = {x};
+  for (int i = 0; i < num_nodes; ++i) {
+    sum = test::graph::Add(&graph, sum, x);
+    srcs.push_back(sum);
+  }
+  Node* y = test::graph::Identity(&graph, sum);
+  // One fetch per signature, plus one to warm up.
+  std::vector<string> fetches;
+  for (int i = 0; i <= iters; ++i) {
+    fetches.push_back(test::graph::Identity(&graph, y)->name());
+  }
+  GraphDef def;
+  test::graph::ToGraphDef(&graph, &def);
+  for (NodeDef& node : *def.mutable_node()) {
+    node.set_device(cluster.devices[0]);
+  }
+  for (Node* src : srcs) {
+    SetDevice(&def, src->name(), cluster.devices[1]);
+  }
+  std::unique_ptr<Session> session(NewRemote(Options(cluster.target, 1000)));
+  TF_CHECK_OK(session->Create(def));
+  // Feeding x keeps the graph optimizer from folding the sum.
+  const std::vector<std::pair<string, Tensor>> feeds = {{x->name(), one}};
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run(feeds, {fetches[iters]}, {}, &outputs));
+  IsSingleFloatValue(outputs[0], num_nodes + 1);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(session->Run(feeds, {fetches[i]}, {}, &outputs));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_SignatureChangeFirstStep)->Arg(16)->Arg(256)->Arg(4096);
+
 // Tests that Run() with "timeout_in_ms" set times out.
 TEST(SessionTest, RunTimeoutWithRunOptions) {
   std::unique_ptr<test::TestCluster> cluster;
@@ -17,15 +17,38 @@ limitations under the License.
 
 #include "grpc++/support/byte_buffer.h"
 #include "grpc++/support/slice.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
 
+class CpuDevice : public DeviceBase {
+ public:
+  explicit CpuDevice(Env* env) : DeviceBase(env) {
+    attr_.set_device_type("CPU");
+  }
+
+  const DeviceAttributes& attributes() const override { return attr_; }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+ private:
+  DeviceAttributes attr_;
+};
+
 class GrpcTensorCodingTest : public ::testing::Test {
  public:
   void Validate(const Tensor& t, bool is_dead) {
@@ -100,4 +123,64 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, ParseFromByteBuffer) {
+  CpuDevice cpu_device(Env::Default());
+  for (int elems : {0, 1, 1000, 1 << 20}) {
+    Tensor t(DT_FLOAT, TensorShape({elems}));
+    test::FillFn<float>(&t, [](int i) { return i * 0.25f; });
+    ::grpc::ByteBuffer buf;
+    grpc::EncodeTensorToByteBuffer(false, t, &buf);
+
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    GrpcByteSource source(&buf);
+    TF_EXPECT_OK(response.ParseFrom(&source));
+    test::ExpectTensorEqual<float>(t, response.tensor());
+  }
+}
+
+// Encodes a float tensor of 'num_mb' megabytes into a ByteBuffer, as sent
+// in reply to RecvTensor.
+static void MakeRecvTensorByteBuffer(int num_mb, ::grpc::ByteBuffer* buf) {
+  Tensor t(DT_FLOAT, TensorShape({static_cast<int64>(num_mb) << 18}));
+  t.flat<float>().setConstant(1.0f);
+  grpc::EncodeTensorToByteBuffer(false, t, buf);
+}
+
+// Parses the reply straight from the ByteBuffer slices into the tensor.
+static void BM_RecvTensorFromByteBuffer(int iters, int num_mb) {
+  testing::StopTiming();
+  ::grpc::ByteBuffer buf;
+  MakeRecvTensorByteBuffer(num_mb, &buf);
+  CpuDevice cpu_device(Env::Default());
+  testing::BytesProcessed(static_cast<int64>(iters) * num_mb << 20);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    GrpcByteSource source(&buf);
+    TF_CHECK_OK(response.ParseFrom(&source));
+  }
+}
+BENCHMARK(BM_RecvTensorFromByteBuffer)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
+// Parses the reply into a RecvTensorResponse proto, then the tensor.
+static void BM_RecvTensorViaTensorProto(int iters, int num_mb) {
+  testing::StopTiming();
+  ::grpc::ByteBuffer buf;
+  MakeRecvTensorByteBuffer(num_mb, &buf);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_mb << 20);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    RecvTensorResponse proto;
+    GrpcByteSource source(&buf);
+    protobuf::io::CodedInputStream input(source.contents());
+    input.SetTotalBytesLimit(INT_MAX, INT_MAX);
+    CHECK(proto.ParseFromCodedStream(&input));
+    Tensor t;
+    CHECK(t.FromProto(proto.tensor()));
+  }
+}
+BENCHMARK(BM_RecvTensorViaTensorProto)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
 }  // namespace tensorflow
@@ -162,6 +162,9 @@ class GrpcWorkerService : public AsyncServiceInterface {
       for (int i = 0; i < 1000; ++i) {
         EnqueueRecvTensorRequestRaw();
       }
+      for (int i = 0; i < 100; ++i) {
+        ENQUEUE_REQUEST(RecvTensors, true);
+      }
       for (int i = 0; i < 500; ++i) {
         ENQUEUE_REQUEST(RecvBuf, true);
       }
@@ -303,6 +306,21 @@ class GrpcWorkerService : public AsyncServiceInterface {
       EnqueueRecvTensorRequestRaw();
     }
 
+    void RecvTensorsHandler(
+        WorkerCall<RecvTensorsRequest, RecvTensorsResponse>* call) {
+      Schedule([this, call]() {
+        CallOptions* call_opts = new CallOptions;
+        call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
+        worker_->RecvTensorsAsync(call_opts, &call->request, &call->response,
+                                  [call, call_opts](const Status& s) {
+                                    call->ClearCancelCallback();
+                                    delete call_opts;
+                                    call->SendResponse(ToGrpcStatus(s));
+                                  });
+      });
+      ENQUEUE_REQUEST(RecvTensors, true);
+    }
+
     void CleanupGraphHandler(
         WorkerCall<CleanupGraphRequest, CleanupGraphResponse>* call) {
       Schedule([this, call]() {
@@ -435,6 +453,13 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
     return;
   }
 
+  RecvTensorChunkReqExtra chunk_extra;
+  if (request->transport_options().UnpackTo(&chunk_extra) &&
+      chunk_extra.transfer_id() != 0) {
+    done(EncodeRecvTensorChunk(chunk_extra, response));
+    return;
+  }
+
   const int64 step_id = request->step_id();
   const string& key = request->rendezvous_key();
   TRACEPRINTF("RecvTensor: %lld %s", step_id, key.c_str());
@@ -454,9 +479,8 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
   // of execution of the callback lambda body below, an RPC
   // cancellation should abort the rendezvous.
   opts->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
-  env_->rendezvous_mgr->RecvLocalAsync(
-      step_id, parsed,
-      [opts, response, done, src_dev, request](
+  Rendezvous::DoneCallback recv_done =
+      [this, opts, response, done, src_dev, request](
           const Status& status, const Rendezvous::Args& send_args,
           const Rendezvous::Args& recv_args, const Tensor& val,
           const bool is_dead) {
@@ -483,10 +507,10 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
                   << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
               // "val" is on an accelerator device. Uses the device_context to
               // fill the copy on host.
-              StatusCallback copy_ready = [response, done, copy,
+              StatusCallback copy_ready = [this, request, response, done, copy,
                                            is_dead](const Status& s) {
                 // The value is now ready to be returned on the wire.
-                grpc::EncodeTensorToByteBuffer(is_dead, *copy, response);
+                EncodeRecvTensor(request, is_dead, *copy, response);
                 done(s);
                 delete copy;
               };
@@ -494,7 +518,7 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
               send_dev_context->CopyDeviceTensorToCPU(
                   &val, request->rendezvous_key(), src_dev, copy, copy_ready);
             } else {
-              grpc::EncodeTensorToByteBuffer(is_dead, val, response);
+              EncodeRecvTensor(request, is_dead, val, response);
               done(Status::OK());
             }
           }
@@ -502,7 +526,358 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
           //  !s.ok()
           done(status);
         }
-      });
+      };
+
+  // A RecvTensors call may already have received the tensor, either
+  // because it was too large to batch or because the call responded
+  // without it.
+  Status held_status;
+  Rendezvous::Args held_send_args;
+  Tensor held_val;
+  bool held_is_dead = false;
+  bool held = false;
+  {
+    mutex_lock l(batched_mu_);
+    auto it = batched_recvs_.find(std::make_pair(step_id, key));
+    if (it != batched_recvs_.end()) {
+      BatchedRecv* recv = &it->second;
+      if (!recv->ready) {
+        recv->recv_tensor_done = std::move(recv_done);
+        return;
+      }
+      held = true;
+      held_status = recv->status;
+      held_send_args = recv->send_args;
+      held_val = recv->val;
+      held_is_dead = recv->is_dead;
+      batched_recvs_.erase(it);
+    }
+  }
+  if (held) {
+    recv_done(held_status, held_send_args, Rendezvous::Args(), held_val,
+              held_is_dead);
+    return;
+  }
+  env_->rendezvous_mgr->RecvLocalAsync(step_id, parsed, std::move(recv_done));
+}
+
+void GrpcWorker::EncodeRecvTensor(const RecvTensorRequest* request,
+                                  bool is_dead, const Tensor& val,
+                                  ::grpc::ByteBuffer* response) {
+  RecvTensorChunkReqExtra extra;
+  if (is_dead || request->request_id() == 0 ||
+      !request->transport_options().UnpackTo(&extra) ||
+      extra.max_chunk_bytes() <= 0 || !DataTypeCanUseMemcpy(val.dtype()) ||
+      val.TotalBytes() <= static_cast<size_t>(extra.max_chunk_bytes())) {
+    grpc::EncodeTensorToByteBuffer(is_dead, val, response);
+    return;
+  }
+  {
+    mutex_lock l(chunked_mu_);
+    ChunkedTensor& chunked = chunked_tensors_[request->request_id()];
+    chunked.step_id = request->step_id();
+    chunked.val = val;
+    chunked.bytes_left = val.TotalBytes();
+  }
+  RecvTensorResponse proto;
+  proto.mutable_tensor()->set_dtype(val.dtype());
+  val.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  proto.set_send_start_micros(env_->env->NowMicros());
+  RecvTensorChunkRespExtra resp_extra;
+  resp_extra.set_total_bytes(val.TotalBytes());
+  proto.mutable_transport_options()->PackFrom(resp_extra);
+  grpc::EncodeRecvTensorResponseToByteBuffer(proto, response);
+}
+
+Status GrpcWorker::EncodeRecvTensorChunk(const RecvTensorChunkReqExtra& extra,
+                                         ::grpc::ByteBuffer* response) {
+  Tensor chunk;
+  {
+    mutex_lock l(chunked_mu_);
+    auto it = chunked_tensors_.find(extra.transfer_id());
+    if (it == chunked_tensors_.end()) {
+      return errors::NotFound("No tensor is held for chunked RecvTensor ",
+                              extra.transfer_id());
+    }
+    ChunkedTensor* chunked = &it->second;
+    const Tensor& val = chunked->val;
+    const int64 elem_bytes = DataTypeSize(val.dtype());
+    const int64 begin = extra.offset();
+    const int64 end = extra.offset() + extra.num_bytes();
+    if (begin < 0 || begin >= end ||
+        end > static_cast<int64>(val.TotalBytes()) ||
+        begin % elem_bytes != 0 || end % elem_bytes != 0) {
+      return errors::InvalidArgument("Invalid chunk [", begin, ", ", end,
+                                     ") of a tensor of ", val.TotalBytes(),
+                                     " bytes");
+    }
+    Tensor flat;
+    CHECK(flat.CopyFrom(val, TensorShape({val.NumElements()})));
+    chunk = flat.Slice(begin / elem_bytes, end / elem_bytes);
+    chunked->bytes_left -= extra.num_bytes();
+    if (chunked->bytes_left <= 0) {
+      chunked_tensors_.erase(it);
+    }
+  }
+  // The encoding shares the buffer of 'chunk', which keeps it alive.
+  grpc::EncodeTensorToByteBuffer(false, chunk, response);
+  return Status::OK();
+}
+
+struct GrpcWorker::RecvTensorsCall {
+  CallOptions* opts;
+  const RecvTensorsRequest* request;
+  RecvTensorsResponse* response;
+  StatusCallback done;
+
+  // Whether every requested tensor has been looked up.
+  bool issued = false;
+  bool responded = false;
+  Status status;
+
+  struct Result {
+    int key_index;
+    Tensor val;
+    bool is_dead;
+  };
+  std::vector<Result> results;
+  // The key indices of the tensors held for RecvTensor because they are
+  // larger than request->max_tensor_bytes().
+  std::vector<int> large;
+
+  // Returns true if 'val' should be fetched by RecvTensor rather than
+  // encoded in the response.
+  bool IsLarge(const Status& s, const Tensor& val, bool is_dead) const {
+    return s.ok() && !is_dead && request->max_tensor_bytes() > 0 &&
+           val.TotalBytes() > static_cast<size_t>(request->max_tensor_bytes());
+  }
+
+  // Returns true, once, when the call has a response to send.
+  bool ReadyToRespond() {
+    if (responded || !issued ||
+        (results.empty() && large.empty() && status.ok())) {
+      return false;
+    }
+    responded = true;
+    return true;
+  }
+};
+
+void GrpcWorker::RecvTensorsAsync(CallOptions* opts,
+                                  const RecvTensorsRequest* request,
+                                  RecvTensorsResponse* response,
+                                  StatusCallback done) {
+  Status s = recv_tensor_recent_request_ids_.TrackUnique(
+      request->request_id(), "RecvTensors (GrpcWorker)", *request);
+  if (!s.ok()) {
+    done(s);
+    return;
+  }
+
+  const int64 step_id = request->step_id();
+  std::vector<Rendezvous::ParsedKey> parsed(request->rendezvous_key_size());
+  for (int i = 0; i < request->rendezvous_key_size(); ++i) {
+    s = Rendezvous::ParseKey(request->rendezvous_key(i), &parsed[i]);
+    Device* src_dev = nullptr;
+    if (s.ok()) {
+      s = PrepareRecvTensor(parsed[i], &src_dev);
+    }
+    if (s.ok() && src_dev->tensorflow_gpu_device_info() != nullptr) {
+      s = errors::InvalidArgument("RecvTensors does not support tensors from ",
+                                  src_dev->name());
+    }
+    if (!s.ok()) {
+      done(s);
+      return;
+    }
+  }
+
+  std::shared_ptr<RecvTensorsCall> call(new RecvTensorsCall);
+  call->opts = opts;
+  call->request = request;
+  call->response = response;
+  call->done = std::move(done);
+  if (request->rendezvous_key_size() == 0) {
+    call->done(Status::OK());
+    return;
+  }
+
+  // Take the tensors that arrived after an earlier call responded, and
+  // wait for the rest.  A tensor may already have a receive pending on
+  // behalf of an earlier call, in which case it is redirected here.
+  std::vector<int> to_recv;
+  {
+    mutex_lock l(batched_mu_);
+    for (int i = 0; i < request->rendezvous_key_size(); ++i) {
+      auto key = std::make_pair(step_id, request->rendezvous_key(i));
+      auto it = batched_recvs_.find(key);
+      if (it == batched_recvs_.end()) {
+        BatchedRecv& recv = batched_recvs_[key];
+        recv.call = call;
+        recv.key_index = i;
+        to_recv.push_back(i);
+      } else if (it->second.ready) {
+        const BatchedRecv& recv = it->second;
+        if (call->IsLarge(recv.status, recv.val, recv.is_dead)) {
+          call->large.push_back(i);
+          continue;
+        }
+        call->status.Update(recv.status);
+        call->results.push_back({i, recv.val, recv.is_dead});
+        batched_recvs_.erase(it);
+      } else {
+        it->second.call = call;
+        it->second.key_index = i;
+      }
+    }
+  }
+
+  opts->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
+  for (int i : to_recv) {
+    const string& key = request->rendezvous_key(i);
+    env_->rendezvous_mgr->RecvLocalAsync(
+        step_id, parsed[i],
+        [this, step_id, key](const Status& status,
+                             const Rendezvous::Args& send_args,
+                             const Rendezvous::Args& recv_args,
+                             const Tensor& val, const bool is_dead) {
+          BatchedRecvDone(step_id, key, status, send_args, val, is_dead);
+        });
+  }
+
+  bool respond;
+  {
+    mutex_lock l(batched_mu_);
+    call->issued = true;
+    respond = call->ReadyToRespond();
+  }
+  if (respond) {
+    FinishRecvTensors(call);
+  }
+}
+
+void GrpcWorker::BatchedRecvDone(int64 step_id, const string& key,
+                                 const Status& s,
+                                 const Rendezvous::Args& send_args,
+                                 const Tensor& val, bool is_dead) {
+  std::shared_ptr<RecvTensorsCall> respond;
+  Rendezvous::DoneCallback recv_tensor_done;
+  {
+    mutex_lock l(batched_mu_);
+    auto it = batched_recvs_.find(std::make_pair(step_id, key));
+    if (it == batched_recvs_.end()) {
+      // The step has been cleaned up.
+      return;
+    }
+    BatchedRecv* recv = &it->second;
+    std::shared_ptr<RecvTensorsCall> call = std::move(recv->call);
+    bool hold = true;
+    if (recv->recv_tensor_done) {
+      recv_tensor_done = std::move(recv->recv_tensor_done);
+      hold = false;
+    } else if (call != nullptr && !call->responded) {
+      if (call->IsLarge(s, val, is_dead)) {
+        call->large.push_back(recv->key_index);
+      } else {
+        call->status.Update(s);
+        call->results.push_back({recv->key_index, val, is_dead});
+        hold = false;
+      }
+      if (call->ReadyToRespond()) {
+        respond = std::move(call);
+      }
+    }
+    if (hold) {
+      // Hold the tensor for the next call that requests it.
+      recv->ready = true;
+      recv->status = s;
+      recv->send_args = send_args;
+      recv->val = val;
+      recv->is_dead = is_dead;
+    } else {
+      batched_recvs_.erase(it);
+    }
+  }
+  if (recv_tensor_done) {
+    recv_tensor_done(s, send_args, Rendezvous::Args(), val, is_dead);
+  }
+  if (respond != nullptr) {
+    FinishRecvTensors(respond);
+  }
+}
+
+void GrpcWorker::FinishRecvTensors(
+    const std::shared_ptr<RecvTensorsCall>& call) {
+  if (call->status.ok()) {
+    const int64 send_start_micros = env_->env->NowMicros();
+    for (const RecvTensorsCall::Result& result : call->results) {
+      call->response->add_key_index(result.key_index);
+      RecvTensorResponse* tensor = call->response->add_tensor();
+      tensor->set_is_dead(result.is_dead);
+      tensor->set_send_start_micros(send_start_micros);
+      if (!result.is_dead) {
+        result.val.AsProtoTensorContent(tensor->mutable_tensor());
+      }
+    }
+    for (int key_index : call->large) {
+      call->response->add_large_key_index(key_index);
+    }
+  }
+  call->results.clear();
+  call->opts->ClearCancelCallback();
+  call->done(call->status);
+}
+
+void GrpcWorker::CleanupGraphAsync(const CleanupGraphRequest* request,
+                                   CleanupGraphResponse* response,
+                                   StatusCallback done) {
+  // Drop tensors whose receivers gave up before fetching all chunks.
+  {
+    mutex_lock l(chunked_mu_);
+    for (auto it = chunked_tensors_.begin(); it != chunked_tensors_.end();) {
+      if (it->second.step_id == request->step_id()) {
+        it = chunked_tensors_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  // Drop the tensors held for RecvTensors calls, and fail the calls still
+  // waiting, whose receives won't complete once they are forgotten.
+  std::vector<std::shared_ptr<RecvTensorsCall>> aborted;
+  std::vector<Rendezvous::DoneCallback> aborted_recvs;
+  {
+    mutex_lock l(batched_mu_);
+    auto begin = batched_recvs_.lower_bound(
+        std::make_pair(request->step_id(), string()));
+    auto end = begin;
+    for (; end != batched_recvs_.end() &&
+           end->first.first == request->step_id();
+         ++end) {
+      const std::shared_ptr<RecvTensorsCall>& call = end->second.call;
+      if (call != nullptr && !call->responded) {
+        call->status.Update(
+            errors::Aborted("Step ", request->step_id(), " was cleaned up"));
+        if (call->ReadyToRespond()) {
+          aborted.push_back(call);
+        }
+      }
+      if (end->second.recv_tensor_done) {
+        aborted_recvs.push_back(std::move(end->second.recv_tensor_done));
+      }
+    }
+    batched_recvs_.erase(begin, end);
+  }
+  for (const auto& call : aborted) {
+    FinishRecvTensors(call);
+  }
+  const Status aborted_status =
+      errors::Aborted("Step ", request->step_id(), " was cleaned up");
+  for (const auto& recv_done : aborted_recvs) {
+    recv_done(aborted_status, Rendezvous::Args(), Rendezvous::Args(), Tensor(),
+              false);
+  }
+  Worker::CleanupGraphAsync(request, response, std::move(done));
 }
 
 void GrpcWorker::RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
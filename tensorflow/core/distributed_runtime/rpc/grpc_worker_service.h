@@ -16,8 +16,16 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
 #include "tensorflow/core/distributed_runtime/recent_request_ids.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace grpc {
 class ByteBuffer;
@@ -27,6 +35,7 @@ class ServerBuilder;
 namespace tensorflow {
 
 class AsyncServiceInterface;
+class RecvTensorChunkReqExtra;
 struct WorkerEnv;
 struct WorkerSession;
 
@@ -35,21 +44,95 @@ class GrpcWorker : public Worker {
   GrpcWorker(WorkerEnv* env);
 
   // Specialized version of RecvTensor for gRPC, which avoids a copy.
+  //
+  // If the request carries a RecvTensorChunkReqExtra with max_chunk_bytes,
+  // a tensor with more content than that is returned as metadata only and
+  // held by the worker, so that its content can be fetched by later
+  // requests for chunks of it, none bigger than max_chunk_bytes.
   virtual void GrpcRecvTensorAsync(CallOptions* opts,
                                    const RecvTensorRequest* request,
                                    ::grpc::ByteBuffer* response,
                                    StatusCallback done);
 
+  // Receives the tensors of 'request' that have been produced, waiting for
+  // the first one if none has.  A tensor produced after the response is
+  // sent is held until it is requested again, or the step is cleaned up.
+  // Only tensors produced on devices without GPU info are supported.
+  void RecvTensorsAsync(CallOptions* opts, const RecvTensorsRequest* request,
+                        RecvTensorsResponse* response,
+                        StatusCallback done) override;
+
   virtual void LoggingAsync(const LoggingRequest* request,
                             LoggingResponse* response, StatusCallback done);
 
   virtual void RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                             RecvBufResponse* response, StatusCallback done);
 
+  void CleanupGraphAsync(const CleanupGraphRequest* request,
+                         CleanupGraphResponse* response,
+                         StatusCallback done) override;
+
   WorkerEnv* env();
 
+ protected:
+  // Encodes the response to 'request' for a tensor 'val'.
+  virtual void EncodeRecvTensor(const RecvTensorRequest* request,
+                                bool is_dead, const Tensor& val,
+                                ::grpc::ByteBuffer* response);
+
  private:
+  // Encodes the requested chunk of a tensor held for a chunked transfer.
+  Status EncodeRecvTensorChunk(const RecvTensorChunkReqExtra& extra,
+                               ::grpc::ByteBuffer* response);
+
   RecentRequestIds recv_tensor_recent_request_ids_;
+
+  // The state of a RecvTensors call.
+  struct RecvTensorsCall;
+
+  // Called when the tensor for 'key' of step 'step_id' requested by
+  // RecvTensors is available.
+  void BatchedRecvDone(int64 step_id, const string& key, const Status& s,
+                       const Rendezvous::Args& send_args, const Tensor& val,
+                       bool is_dead);
+
+  // Encodes the tensors received by 'call' and calls its done callback.
+  void FinishRecvTensors(const std::shared_ptr<RecvTensorsCall>& call);
+
+  // A tensor requested by RecvTensors.
+  struct BatchedRecv {
+    // The call waiting for the tensor, if it is not ready.
+    std::shared_ptr<RecvTensorsCall> call;
+    int key_index = 0;
+    // A RecvTensor call waiting for the tensor, which is served in
+    // preference to 'call'.
+    Rendezvous::DoneCallback recv_tensor_done;
+    // The tensor, if it is ready but no call is waiting for it, or if it
+    // is too large for RecvTensors and is held for RecvTensor.
+    bool ready = false;
+    Status status;
+    Rendezvous::Args send_args;
+    Tensor val;
+    bool is_dead = false;
+  };
+
+  mutex batched_mu_;
+  // Keyed by step_id and rendezvous key.
+  std::map<std::pair<int64, string>, BatchedRecv> batched_recvs_
+      GUARDED_BY(batched_mu_);
+
+  // A tensor whose content is being fetched in chunks.
+  struct ChunkedTensor {
+    int64 step_id;
+    Tensor val;
+    int64 bytes_left;
+  };
+
+  mutex chunked_mu_;
+  // Keyed by the request_id of the RecvTensorRequest that returned the
+  // metadata.
+  std::unordered_map<int64, ChunkedTensor> chunked_tensors_
+      GUARDED_BY(chunked_mu_);
 };
 
 std::unique_ptr<GrpcWorker> NewGrpcWorker(WorkerEnv* worker_env);
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <unordered_map>
 #include <unordered_set>
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -32,15 +33,28 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 
 namespace tensorflow {
 
 namespace {
 
+// The number of chunks of a tensor that may be fetched at once.
+const int kMaxChunksInFlight = 4;
+
+// Tensors larger than this are not returned by RecvTensors, which encodes
+// them as protos, but fetched by RecvTensor.
+const int64 kMaxBatchedTensorBytes = 64 << 10;
+
+class RpcRecvTensorsCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      int64 recv_tensor_chunk_bytes, bool batch_recv_tensors)
+      : BaseRemoteRendezvous(env, step_id),
+        recv_tensor_chunk_bytes_(recv_tensor_chunk_bytes),
+        batch_recv_tensors_(batch_recv_tensors) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -48,8 +62,42 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
                            DoneCallback done) override;
 
  private:
+  friend class RpcRecvTensorsCall;
+
+  // A receive whose tensor is fetched by a RecvTensors call, along with
+  // other receives from the same worker.
+  struct BatchedRecv {
+    Rendezvous::ParsedKey parsed;
+    Device* dst_device;
+    Rendezvous::Args recv_args;
+    DoneCallback done;
+  };
+
   ~RpcRemoteRendezvous() override {}
 
+  // Receives the tensor for 'parsed' with its own RecvTensor call.
+  void RecvTensorAsync(const Rendezvous::ParsedKey& parsed,
+                       const Rendezvous::Args& recv_args, DoneCallback done);
+
+  // Queues 'recv' for the next RecvTensors call to 'src_worker'.
+  void QueueBatchedRecv(const string& src_worker, BatchedRecv* recv);
+
+  // Starts a RecvTensors call to 'src_worker' for 'recvs', and further
+  // calls for those of them that it does not return.
+  void StartRecvTensors(const string& src_worker,
+                        std::vector<BatchedRecv*> recvs);
+
+  // Completes the receives of 'call', and returns those that are left.
+  std::vector<BatchedRecv*> FinishRecvTensors(RpcRecvTensorsCall* call);
+
+  const int64 recv_tensor_chunk_bytes_;
+  const bool batch_recv_tensors_;
+
+  mutex batch_mu_;
+  // Keyed by the name of the source worker.
+  std::unordered_map<string, std::vector<BatchedRecv*>> queued_recvs_
+      GUARDED_BY(batch_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -60,10 +108,12 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   void Init(WorkerInterface* wi, int64 step_id, StringPiece key,
             AllocatorAttributes alloc_attrs, Device* dst_device,
-            const Rendezvous::Args& recv_args, Rendezvous::DoneCallback done) {
+            const Rendezvous::Args& recv_args, int64 max_chunk_bytes,
+            Rendezvous::DoneCallback done) {
     wi_ = wi;
     alloc_attrs_ = alloc_attrs;
     dst_device_ = dst_device;
+    max_chunk_bytes_ = max_chunk_bytes;
     recv_args_ = recv_args;
     done_ = std::move(done);
     req_.set_step_id(step_id);
@@ -80,9 +130,14 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     // opts_ appropriately.
     req_.Clear();
     resp_.Clear();
+    for (ChunkCall& chunk : chunk_calls_) {
+      chunk.req.Clear();
+      chunk.resp.Clear();
+    }
     {
       mutex_lock l(mu_);
       status_ = Status::OK();
+      chunks_done_ = nullptr;
     }
     done_ = nullptr;
   }
@@ -106,6 +161,9 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
       status_.Update(s);
     }
     opts_.StartCancel();
+    for (ChunkCall& chunk : chunk_calls_) {
+      chunk.opts.StartCancel();
+    }
   }
 
   Status status() const override {
@@ -124,14 +182,36 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
  private:
   friend class RpcRemoteRendezvous;
 
+  // One of the calls fetching a chunk of the content of a tensor.
+  struct ChunkCall {
+    CallOptions opts;
+    RecvTensorRequest req;
+    TensorResponse resp;
+  };
+
   // Start the main RecvTensor call, checking for an async abort.
   void StartRTCall(std::function<void()> recv_done) {
     resp_.InitAlloc(dst_device_, alloc_attrs_);
+    // Chunks are copied straight into the tensor, so it must be on the host.
+    if (max_chunk_bytes_ > 0 &&
+        (alloc_attrs_.on_host() ||
+         dst_device_->attributes().device_type() == "CPU")) {
+      RecvTensorChunkReqExtra extra;
+      extra.set_max_chunk_bytes(max_chunk_bytes_);
+      req_.mutable_transport_options()->PackFrom(extra);
+    }
     using namespace std::placeholders;
     StatusCallback cb = std::bind(
         [this](std::function<void()> recv_done,
                // Begin unbound arguments.
                const Status& s) {
+          RecvTensorChunkRespExtra extra;
+          if (s.ok() &&
+              resp_.metadata().transport_options().UnpackTo(&extra)) {
+            // Only the metadata was returned.
+            StartChunkCalls(extra.total_bytes(), std::move(recv_done));
+            return;
+          }
           if (!s.ok()) {
             mutex_lock l(mu_);
             status_.Update(s);
@@ -142,6 +222,91 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     wi_->RecvTensorAsync(&opts_, &req_, &resp_, std::move(cb));
   }
 
+  // Fetch the content of the tensor allocated by resp_ in chunks of at most
+  // max_chunk_bytes_, with up to kMaxChunksInFlight calls at a time, then
+  // call 'recv_done'.
+  void StartChunkCalls(int64 total_bytes, std::function<void()> recv_done) {
+    const Tensor& val = resp_.tensor();
+    const int64 elem_bytes = DataTypeSize(val.dtype());
+    std::vector<ChunkCall*> started;
+    {
+      mutex_lock l(mu_);
+      if (!DataTypeCanUseMemcpy(val.dtype()) ||
+          static_cast<int64>(val.TotalBytes()) != total_bytes) {
+        status_.Update(errors::Internal(
+            "Chunked RecvTensor response does not match tensor of type ",
+            DataTypeString(val.dtype()), " and shape ",
+            val.shape().DebugString()));
+      }
+      chunk_bytes_ = std::max(elem_bytes, max_chunk_bytes_ / elem_bytes *
+                                              elem_bytes);
+      next_chunk_offset_ = 0;
+      num_chunk_calls_ = 0;
+      for (ChunkCall& chunk : chunk_calls_) {
+        if (!NextChunk(&chunk)) break;
+        started.push_back(&chunk);
+      }
+      if (!started.empty()) {
+        chunks_done_ = std::move(recv_done);
+      }
+    }
+    if (started.empty()) {
+      recv_done();
+      return;
+    }
+    for (ChunkCall* chunk : started) {
+      StartChunkCall(chunk);
+    }
+  }
+
+  // Prepare 'chunk' to fetch the next chunk, if any is left and no call has
+  // failed.
+  bool NextChunk(ChunkCall* chunk) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int64 total_bytes = resp_.tensor().TotalBytes();
+    if (!status_.ok() || next_chunk_offset_ >= total_bytes) {
+      return false;
+    }
+    const int64 num_bytes =
+        std::min(chunk_bytes_, total_bytes - next_chunk_offset_);
+    RecvTensorChunkReqExtra extra;
+    extra.set_transfer_id(req_.request_id());
+    extra.set_offset(next_chunk_offset_);
+    extra.set_num_bytes(num_bytes);
+    chunk->req.Clear();
+    chunk->req.set_step_id(req_.step_id());
+    chunk->req.set_rendezvous_key(req_.rendezvous_key());
+    chunk->req.set_request_id(GetUniqueRequestId());
+    chunk->req.mutable_transport_options()->PackFrom(extra);
+    chunk->resp.InitChunk(resp_.tensor(), next_chunk_offset_);
+    next_chunk_offset_ += num_bytes;
+    ++num_chunk_calls_;
+    return true;
+  }
+
+  void StartChunkCall(ChunkCall* chunk) {
+    wi_->RecvTensorAsync(
+        &chunk->opts, &chunk->req, &chunk->resp,
+        [this, chunk](const Status& s) {
+          bool more;
+          std::function<void()> recv_done;
+          {
+            mutex_lock l(mu_);
+            status_.Update(s);
+            --num_chunk_calls_;
+            more = NextChunk(chunk);
+            if (!more && num_chunk_calls_ == 0) {
+              recv_done = std::move(chunks_done_);
+              chunks_done_ = nullptr;
+            }
+          }
+          if (more) {
+            StartChunkCall(chunk);
+          } else if (recv_done) {
+            recv_done();
+          }
+        });
+  }
+
   string src_worker_;
   string src_rel_device_;
   WorkerInterface* wi_;
@@ -152,13 +317,82 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   TensorResponse resp_;
   Rendezvous::Args recv_args_;
   Rendezvous::DoneCallback done_;
+  int64 max_chunk_bytes_ = 0;
+  ChunkCall chunk_calls_[kMaxChunksInFlight];
 
   mutable mutex mu_;
   Status status_ GUARDED_BY(mu_);
+  int64 chunk_bytes_ GUARDED_BY(mu_) = 0;
+  int64 next_chunk_offset_ GUARDED_BY(mu_) = 0;
+  int num_chunk_calls_ GUARDED_BY(mu_) = 0;
+  std::function<void()> chunks_done_ GUARDED_BY(mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRecvTensorCall);
 };
 
+// A RecvTensors call, which receives the tensors of several receives from
+// the same worker.
+class RpcRecvTensorsCall : public BaseRecvTensorCall {
+ public:
+  RpcRecvTensorsCall(WorkerInterface* wi, int64 step_id,
+                     std::vector<RpcRemoteRendezvous::BatchedRecv*> recvs)
+      : wi_(wi), recvs_(std::move(recvs)) {
+    req_.set_step_id(step_id);
+    for (const RpcRemoteRendezvous::BatchedRecv* recv : recvs_) {
+      const StringPiece key = recv->parsed.FullKey();
+      req_.add_rendezvous_key(key.data(), key.size());
+    }
+    req_.set_max_tensor_bytes(kMaxBatchedTensorBytes);
+    req_.set_request_id(GetUniqueRequestId());
+  }
+
+  void Start(std::function<void()> recv_done) override {
+    {
+      // The call may have been aborted when it was registered.
+      mutex_lock l(mu_);
+      if (!status_.ok()) {
+        recv_done();
+        return;
+      }
+    }
+    wi_->RecvTensorsAsync(&opts_, &req_, &resp_,
+                          [this, recv_done](const Status& s) {
+                            if (!s.ok()) {
+                              mutex_lock l(mu_);
+                              status_.Update(s);
+                            }
+                            recv_done();
+                          });
+  }
+
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+    opts_.StartCancel();
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+ private:
+  friend class RpcRemoteRendezvous;
+
+  WorkerInterface* wi_;
+  std::vector<RpcRemoteRendezvous::BatchedRecv*> recvs_;
+  CallOptions opts_;
+  RecvTensorsRequest req_;
+  RecvTensorsResponse resp_;
+
+  mutable mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RpcRecvTensorsCall);
+};
+
 class RpcRecvTensorFreeList {
  public:
   RpcRecvTensorFreeList() {}
@@ -208,6 +442,162 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
     DoneCallback done) {
   CHECK(is_initialized());
+  // Batched tensors are returned as protos, which are decoded into host
+  // memory.  The sender copies tensors from GPUs to the host one at a
+  // time, so those are not batched.  Receives from a worker are only
+  // batched when several are queued, and the sender holds back tensors
+  // larger than kMaxBatchedTensorBytes for RecvTensor.
+  string src_worker;
+  string src_rel_device;
+  Device* dst_device;
+  if (!batch_recv_tensors_ || parsed.src.type != DEVICE_CPU ||
+      !(parsed.dst.type == DEVICE_CPU || recv_args.alloc_attrs.on_host()) ||
+      !DeviceNameUtils::SplitDeviceName(parsed.src_device, &src_worker,
+                                        &src_rel_device) ||
+      !session()->device_mgr()->LookupDevice(parsed.dst_device, &dst_device)
+           .ok()) {
+    RecvTensorAsync(parsed, recv_args, std::move(done));
+    return;
+  }
+  QueueBatchedRecv(src_worker,
+                   new BatchedRecv{parsed, dst_device, recv_args,
+                                   std::move(done)});
+}
+
+void RpcRemoteRendezvous::QueueBatchedRecv(const string& src_worker,
+                                           BatchedRecv* recv) {
+  bool schedule;
+  {
+    mutex_lock l(batch_mu_);
+    std::vector<BatchedRecv*>* queued = &queued_recvs_[src_worker];
+    schedule = queued->empty();
+    queued->push_back(recv);
+  }
+  if (!schedule) return;
+  // Give the executor a chance to queue the other receives that became
+  // ready at the same time before starting the call.
+  Ref();
+  env_->compute_pool->Schedule([this, src_worker]() {
+    std::vector<BatchedRecv*> recvs;
+    {
+      mutex_lock l(batch_mu_);
+      recvs.swap(queued_recvs_[src_worker]);
+    }
+    StartRecvTensors(src_worker, std::move(recvs));
+    Unref();
+  });
+}
+
+void RpcRemoteRendezvous::StartRecvTensors(const string& src_worker,
+                                           std::vector<BatchedRecv*> recvs) {
+  if (recvs.size() == 1) {
+    // Nothing to batch with.
+    BatchedRecv* recv = recvs[0];
+    RecvTensorAsync(recv->parsed, recv->recv_args, std::move(recv->done));
+    delete recv;
+    return;
+  }
+  WorkerInterface* rwi = session()->worker_cache->CreateWorker(src_worker);
+  if (rwi == nullptr) {
+    Status s = errors::Internal("No worker known as ", src_worker);
+    for (BatchedRecv* recv : recvs) {
+      recv->done(s, Args(), recv->recv_args, Tensor{}, false);
+      delete recv;
+    }
+    return;
+  }
+
+  RpcRecvTensorsCall* call =
+      new RpcRecvTensorsCall(rwi, step_id_, std::move(recvs));
+
+  // Record "call" in active_ so that it can be aborted cleanly.
+  RegisterCall(call);
+
+  // Start "call".
+  Ref();
+  call->Start([this, call, src_worker]() {
+    // Removes "call" from active_. Prevent StartAbort().
+    DeregisterCall(call);
+    session()->worker_cache->ReleaseWorker(src_worker, call->wi_);
+    std::vector<BatchedRecv*> left = FinishRecvTensors(call);
+    delete call;
+    // Each call returns at least one tensor, and waits for the rest again,
+    // so that no tensor waits on another that depends on it.
+    if (!left.empty()) {
+      StartRecvTensors(src_worker, std::move(left));
+    }
+    Unref();
+  });
+}
+
+std::vector<RpcRemoteRendezvous::BatchedRecv*>
+RpcRemoteRendezvous::FinishRecvTensors(RpcRecvTensorsCall* call) {
+  std::vector<BatchedRecv*> recvs = std::move(call->recvs_);
+  const RecvTensorsResponse& resp = call->resp_;
+  Status s = call->status();
+  if (errors::IsUnimplemented(s)) {
+    // The source worker does not support RecvTensors.
+    for (BatchedRecv* recv : recvs) {
+      RecvTensorAsync(recv->parsed, recv->recv_args, std::move(recv->done));
+      delete recv;
+    }
+    return {};
+  }
+  if (s.ok() &&
+      ((resp.key_index_size() == 0 && resp.large_key_index_size() == 0) ||
+       resp.key_index_size() != resp.tensor_size())) {
+    s = errors::Internal("Invalid RecvTensors response");
+  }
+  for (int i = 0; s.ok() && i < resp.large_key_index_size(); ++i) {
+    const int index = resp.large_key_index(i);
+    if (index < 0 || index >= static_cast<int>(recvs.size()) ||
+        recvs[index] == nullptr) {
+      s = errors::Internal("Invalid RecvTensors response");
+      break;
+    }
+    // The sender holds the tensor for a RecvTensor call.
+    BatchedRecv* recv = recvs[index];
+    recvs[index] = nullptr;
+    RecvTensorAsync(recv->parsed, recv->recv_args, std::move(recv->done));
+    delete recv;
+  }
+  for (int i = 0; s.ok() && i < resp.key_index_size(); ++i) {
+    const int index = resp.key_index(i);
+    if (index < 0 || index >= static_cast<int>(recvs.size()) ||
+        recvs[index] == nullptr) {
+      s = errors::Internal("Invalid RecvTensors response");
+      break;
+    }
+    BatchedRecv* recv = recvs[index];
+    recvs[index] = nullptr;
+    const RecvTensorResponse& tensor = resp.tensor(i);
+    Allocator* allocator =
+        recv->dst_device->GetAllocator(recv->recv_args.alloc_attrs);
+    Tensor val;
+    Status recv_status;
+    if (!tensor.is_dead() && !val.FromProto(allocator, tensor.tensor())) {
+      recv_status = errors::Internal("Invalid tensor received for ",
+                                     recv->parsed.FullKey());
+    }
+    recv->done(recv_status, Args(), recv->recv_args, val, tensor.is_dead());
+    delete recv;
+  }
+  std::vector<BatchedRecv*> left;
+  for (BatchedRecv* recv : recvs) {
+    if (recv == nullptr) continue;
+    if (s.ok()) {
+      left.push_back(recv);
+    } else {
+      recv->done(s, Args(), recv->recv_args, Tensor{}, false);
+      delete recv;
+    }
+  }
+  return left;
+}
+
+void RpcRemoteRendezvous::RecvTensorAsync(const Rendezvous::ParsedKey& parsed,
+                                          const Rendezvous::Args& recv_args,
+                                          DoneCallback done) {
   Status s;
 
   // Prepare a RecvTensor call that can handle being aborted.
@@ -239,7 +629,7 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   }
 
   call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
-             recv_args, std::move(done));
+             recv_args, recv_tensor_chunk_bytes_, std::move(done));
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call);
@@ -262,12 +652,17 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 
 }  // namespace
 
-RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env,
+                                   int64 recv_tensor_chunk_bytes,
+                                   bool batch_recv_tensors)
+    : BaseRendezvousMgr(env),
+      recv_tensor_chunk_bytes_(recv_tensor_chunk_bytes),
+      batch_recv_tensors_(batch_recv_tensors) {}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id, recv_tensor_chunk_bytes_,
+                                 batch_recv_tensors_);
 }
 
 }  // end namespace tensorflow
@@ -42,14 +42,29 @@ class DeviceMgr;
 //
 // Tensors sent and recved through rendezvous managed by this
 // RendezvousMgr must have keys generated by Rendezvous::CreateKey.
+//
+// Tensors received into host memory with more than
+// 'recv_tensor_chunk_bytes' of content are fetched in chunks of at most
+// that size, which bounds the size of each RPC message, if the sending
+// worker supports it.  Chunking is disabled if 'recv_tensor_chunk_bytes'
+// is zero.
+//
+// If 'batch_recv_tensors' is true, receives of tensors from CPU devices
+// into host memory that become ready together are coalesced into one
+// RecvTensors call per source worker, if the source worker supports it.
 class RpcRendezvousMgr : public BaseRendezvousMgr {
  public:
-  explicit RpcRendezvousMgr(const WorkerEnv* env);
+  explicit RpcRendezvousMgr(const WorkerEnv* env,
+                            int64 recv_tensor_chunk_bytes = 32 << 20,
+                            bool batch_recv_tensors = true);
 
  protected:
   BaseRemoteRendezvous* Create(int64 step_id, const WorkerEnv* worker_env);
 
  private:
+  const int64 recv_tensor_chunk_bytes_;
+  const bool batch_recv_tensors_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRendezvousMgr);
 };
 
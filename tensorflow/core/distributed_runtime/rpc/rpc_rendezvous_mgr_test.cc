@@ -15,14 +15,24 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <algorithm>
+#include <set>
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/test_utils.h"
 #include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -198,6 +208,188 @@ TEST_F(RpcRendezvousMgrTest, TransferDummyDeviceContext) {
   dc->Unref();
 }
 
+// A worker that returns only the first tensor requested by each RecvTensors
+// call, or, if 'batched' is false, does not support RecvTensors.  The
+// tensors for 'large_keys' are held for RecvTensor instead.
+class FakeRecvWorker : public TestWorkerInterface {
+ public:
+  explicit FakeRecvWorker(bool batched,
+                          const std::set<string>& large_keys = {})
+      : batched_(batched), large_keys_(large_keys) {}
+
+  void RecvTensorsAsync(CallOptions* opts, const RecvTensorsRequest* request,
+                        RecvTensorsResponse* response,
+                        StatusCallback done) override {
+    if (!batched_) {
+      TestWorkerInterface::RecvTensorsAsync(opts, request, response, done);
+      return;
+    }
+    {
+      mutex_lock l(mu_);
+      requests_.emplace_back(request->rendezvous_key().begin(),
+                             request->rendezvous_key().end());
+    }
+    EXPECT_GT(request->max_tensor_bytes(), 0);
+    bool returned = false;
+    for (int i = 0; i < request->rendezvous_key_size(); ++i) {
+      const string& key = request->rendezvous_key(i);
+      if (large_keys_.count(key) > 0) {
+        response->add_large_key_index(i);
+      } else if (!returned) {
+        response->add_key_index(i);
+        V(key).AsProtoTensorContent(response->add_tensor()->mutable_tensor());
+        returned = true;
+      }
+    }
+    done(Status::OK());
+  }
+
+  void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) override {
+    {
+      mutex_lock l(mu_);
+      requests_.push_back({request->rendezvous_key()});
+      recv_tensor_keys_.push_back(request->rendezvous_key());
+    }
+    RecvTensorResponse proto;
+    V(request->rendezvous_key()).AsProtoTensorContent(proto.mutable_tensor());
+    done(response->InitFrom(&proto));
+  }
+
+  std::vector<std::vector<string>> requests() {
+    mutex_lock l(mu_);
+    return requests_;
+  }
+
+  // The keys requested by RecvTensor calls.
+  std::vector<string> recv_tensor_keys() {
+    mutex_lock l(mu_);
+    return recv_tensor_keys_;
+  }
+
+ private:
+  const bool batched_;
+  const std::set<string> large_keys_;
+  mutex mu_;
+  std::vector<std::vector<string>> requests_ GUARDED_BY(mu_);
+  std::vector<string> recv_tensor_keys_ GUARDED_BY(mu_);
+};
+
+class RpcRendezvousMgrBatchTest : public ::testing::Test {
+ protected:
+  RpcRendezvousMgrBatchTest() : pool_(Env::Default(), "test", 1) {
+    env_.env = Env::Default();
+    env_.compute_pool = &pool_;
+  }
+
+  // Receives tensors from keys 'keys' from a worker 'wi', and returns the
+  // calls 'wi' received.
+  std::vector<std::vector<string>> Recv(FakeRecvWorker* wi,
+                                        const std::vector<string>& keys) {
+    TestWorkerCache* cache = new TestWorkerCache;
+    cache->AddWorker("/job:mnist/replica:1/task:0", wi);
+    std::vector<Device*> devices = {new ThreadPoolDevice(
+        SessionOptions(), "/job:mnist/replica:1/task:2/device:CPU:0",
+        Bytes(256 << 20), DeviceLocality(), cpu_allocator())};
+    WorkerSession session("rpc_session", "/job:mnist/replica:1/task:2",
+                          std::unique_ptr<WorkerCacheInterface>(cache),
+                          std::unique_ptr<DeviceMgr>(new DeviceMgr(devices)),
+                          std::unique_ptr<GraphMgr>());
+    RpcRendezvousMgr rmgr(&env_);
+    const int64 step_id = 123;
+    RemoteRendezvous* rendez = rmgr.Find(step_id);
+    TF_CHECK_OK(rendez->Initialize(&session));
+
+    // Hold the pool until every receive is queued, so that they are
+    // batched.
+    Notification start;
+    pool_.Schedule([&start]() { start.WaitForNotification(); });
+    BlockingCounter counter(keys.size());
+    for (const string& key : keys) {
+      rendez->RecvAsync(
+          MakeKey(key), Rendezvous::Args(),
+          [&counter, key](const Status& s, const Rendezvous::Args& send_args,
+                          const Rendezvous::Args& recv_args, const Tensor& val,
+                          bool is_dead) {
+            TF_EXPECT_OK(s);
+            EXPECT_EQ(key, V(val));
+            counter.DecrementCount();
+          });
+    }
+    start.Notify();
+    counter.Wait();
+    // The fake worker responds inline, so the calls are finished once the
+    // pool has run everything scheduled so far.
+    Notification drained;
+    pool_.Schedule([&drained]() { drained.Notify(); });
+    drained.WaitForNotification();
+    rendez->Unref();
+    rmgr.Cleanup(step_id);
+    return wi->requests();
+  }
+
+  thread::ThreadPool pool_;
+  WorkerEnv env_;
+};
+
+TEST_F(RpcRendezvousMgrBatchTest, BatchesRecvs) {
+  std::vector<string> keys;
+  for (const string& name : {"foo", "bar", "baz"}) {
+    keys.push_back(Rendezvous::CreateKey("/job:mnist/replica:1/task:0/cpu:0",
+                                         7890,
+                                         "/job:mnist/replica:1/task:2/cpu:0",
+                                         name, FrameAndIter(0, 0)));
+  }
+  FakeRecvWorker wi(true);
+  // Each call returns one tensor, and the rest are requested again.  The
+  // last one is requested alone, by RecvTensor.
+  std::vector<std::vector<string>> expected = {
+      {keys[0], keys[1], keys[2]}, {keys[1], keys[2]}, {keys[2]}};
+  EXPECT_EQ(expected, Recv(&wi, keys));
+  EXPECT_EQ(std::vector<string>({keys[2]}), wi.recv_tensor_keys());
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, SingleRecvUsesRecvTensor) {
+  const string key = Rendezvous::CreateKey(
+      "/job:mnist/replica:1/task:0/cpu:0", 7890,
+      "/job:mnist/replica:1/task:2/cpu:0", "foo", FrameAndIter(0, 0));
+  FakeRecvWorker wi(true);
+  std::vector<std::vector<string>> expected = {{key}};
+  EXPECT_EQ(expected, Recv(&wi, {key}));
+  EXPECT_EQ(std::vector<string>({key}), wi.recv_tensor_keys());
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, LargeTensorsUseRecvTensor) {
+  std::vector<string> keys;
+  for (const string& name : {"foo", "bar", "baz"}) {
+    keys.push_back(Rendezvous::CreateKey("/job:mnist/replica:1/task:0/cpu:0",
+                                         7890,
+                                         "/job:mnist/replica:1/task:2/cpu:0",
+                                         name, FrameAndIter(0, 0)));
+  }
+  FakeRecvWorker wi(true, {keys[1]});
+  std::vector<std::vector<string>> expected = {
+      {keys[0], keys[1], keys[2]}, {keys[1]}, {keys[2]}};
+  EXPECT_EQ(expected, Recv(&wi, keys));
+  EXPECT_EQ(std::vector<string>({keys[1], keys[2]}), wi.recv_tensor_keys());
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, FallsBackToRecvTensor) {
+  std::vector<string> keys;
+  for (const string& name : {"foo", "bar"}) {
+    keys.push_back(Rendezvous::CreateKey("/job:mnist/replica:1/task:0/cpu:0",
+                                         7890,
+                                         "/job:mnist/replica:1/task:2/cpu:0",
+                                         name, FrameAndIter(0, 0)));
+  }
+  FakeRecvWorker wi(false);
+  std::vector<std::vector<string>> requests = Recv(&wi, keys);
+  std::vector<std::vector<string>> expected = {{keys[0]}, {keys[1]}};
+  std::sort(requests.begin(), requests.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, requests);
+}
+
 // NOTE: Remote Send/Recv is better tested in worker_test.cc
 
 }  // namespace tensorflow
@@ -0,0 +1,375 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <atomic>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Records, and the header of the segment, are aligned to this.
+const int64 kAlignment = 64;
+const uint64 kMagic = 0x54467368526e6731ull;
+
+// States of a record.  A record being read is in state kReadingBy | slot,
+// where slot is that of the reader, so that the writer can tell whether
+// the reader died before freeing it.
+enum : uint32 {
+  kWriting = 1,
+  kReady = 2,
+  kFree = 4,  // Read, expired or padding.
+  kReadingBy = 0x80000000u,
+};
+
+int64 RoundUp(int64 n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+Status ErrnoError(const char* op, const string& name) {
+  return errors::Internal(op, " of shared memory segment ", name,
+                          " failed: ", strerror(errno));
+}
+
+// Liveness of the processes using a segment is tracked with locks on
+// single bytes of it: byte kOwnerLock is held by the writer, and byte
+// kFirstReaderLock + slot by the reader with that slot.  The locks belong
+// to open file descriptions, so the kernel drops them when the process
+// exits, however it exits, and unlike a pid they mean the same in every
+// pid namespace that shares the segment.
+const int64 kOwnerLock = 0;
+const int64 kFirstReaderLock = 1;
+
+#if !defined(PLATFORM_WINDOWS)
+// Takes a lock on byte 'pos' of the segment open as 'fd', held until 'fd'
+// is closed.  Returns false if it is held by another open file
+// description, after waiting for it to be released if 'wait'.
+bool LockByte(int fd, int64 pos, bool wait) {
+#if defined(F_OFD_SETLK)
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = pos;
+  lock.l_len = 1;
+  return fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lock) == 0;
+#else
+  return true;
+#endif
+}
+
+// Returns true if byte 'pos' of the segment open as 'fd' is locked by
+// another open file description.  Without such locks, a process is never
+// known to have exited.
+bool ByteLocked(int fd, int64 pos) {
+#if defined(F_OFD_GETLK)
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = pos;
+  lock.l_len = 1;
+  return fcntl(fd, F_OFD_GETLK, &lock) != 0 || lock.l_type != F_UNLCK;
+#else
+  return true;
+#endif
+}
+#endif
+
+}  // namespace
+
+struct SharedMemoryRing::Header {
+  uint64 magic;
+  int64 capacity;
+  // Slots handed out to the processes that opened the ring, which are
+  // never reused.
+  std::atomic<uint32> num_readers;
+};
+
+struct SharedMemoryRing::Record {
+  std::atomic<uint32> state;
+  uint32 unused;
+  int64 size;  // Bytes of the record, including this header.
+  int64 num_bytes;
+  int64 tag;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "SharedMemoryRing needs lock-free atomics to share them across "
+              "processes");
+
+SharedMemoryRing::SharedMemoryRing(const string& name, bool owner, int fd,
+                                   uint32 reader_slot, char* base, int64 size)
+    : name_(name),
+      owner_(owner),
+      fd_(fd),
+      reader_slot_(reader_slot),
+      base_(base),
+      size_(size) {
+  static_assert(sizeof(Header) <= kAlignment, "Header is too big");
+  static_assert(sizeof(Record) <= kAlignment, "Record is too big");
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+#if !defined(PLATFORM_WINDOWS)
+  munmap(base_, size_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+  close(fd_);
+#endif
+}
+
+/* static */
+Status SharedMemoryRing::Create(const string& name, int64 capacity,
+                                std::unique_ptr<SharedMemoryRing>* ring) {
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented("Shared memory rings are not supported");
+#else
+  if (capacity <= 0) {
+    return errors::InvalidArgument("Invalid shared memory ring capacity ",
+                                   capacity);
+  }
+  capacity = RoundUp(capacity);
+  const int64 size = kAlignment + capacity;
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return ErrnoError("shm_open", name);
+  }
+  // Taken before the segment has a size, so that RemoveAbandoned never
+  // takes one being created for abandoned.
+  if (!LockByte(fd, kOwnerLock, true /*wait*/)) {
+    Status s = ErrnoError("fcntl", name);
+    close(fd);
+    shm_unlink(name.c_str());
+    return s;
+  }
+  if (ftruncate(fd, size) != 0) {
+    Status s = ErrnoError("ftruncate", name);
+    close(fd);
+    shm_unlink(name.c_str());
+    return s;
+  }
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    Status s = ErrnoError("mmap", name);
+    close(fd);
+    shm_unlink(name.c_str());
+    return s;
+  }
+  Header* header = static_cast<Header*>(base);
+  header->capacity = capacity;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kMagic;
+  ring->reset(new SharedMemoryRing(name, true /*owner*/, fd, 0 /*reader_slot*/,
+                                   static_cast<char*>(base), size));
+  return Status::OK();
+#endif
+}
+
+/* static */
+void SharedMemoryRing::RemoveAbandoned(const string& prefix) {
+#if defined(__linux__) && defined(F_OFD_SETLK)
+  // POSIX shared memory segments are the files of /dev/shm on Linux.
+  std::vector<string> children;
+  if (!Env::Default()->GetChildren("/dev/shm", &children).ok()) return;
+  const StringPiece file_prefix =
+      str_util::StartsWith(prefix, "/") ? StringPiece(prefix).substr(1)
+                                        : StringPiece(prefix);
+  for (const string& child : children) {
+    if (!str_util::StartsWith(child, file_prefix)) continue;
+    const string name = strings::StrCat("/", child);
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) continue;
+    struct stat st;
+    // Creators lock their segment before sizing it, so a sized segment
+    // whose lock is free has outlived its creator.
+    if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+        LockByte(fd, kOwnerLock, false /*wait*/)) {
+      LOG(INFO) << "Removing abandoned shared memory segment " << name;
+      shm_unlink(name.c_str());
+    }
+    close(fd);
+  }
+#endif
+}
+
+/* static */
+Status SharedMemoryRing::Open(const string& name,
+                              std::unique_ptr<SharedMemoryRing>* ring) {
+#if defined(PLATFORM_WINDOWS)
+  return errors::Unimplemented("Shared memory rings are not supported");
+#else
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return ErrnoError("shm_open", name);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    Status s = ErrnoError("fstat", name);
+    close(fd);
+    return s;
+  }
+  const int64 size = st.st_size;
+  if (size <= kAlignment) {
+    close(fd);
+    return errors::InvalidArgument("Shared memory segment ", name,
+                                   " is too small to be a ring");
+  }
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    Status s = ErrnoError("mmap", name);
+    close(fd);
+    return s;
+  }
+  Header* header = static_cast<Header*>(base);
+  if (header->magic != kMagic || header->capacity != size - kAlignment) {
+    munmap(base, size);
+    close(fd);
+    return errors::InvalidArgument("Shared memory segment ", name,
+                                   " is not a ring");
+  }
+  const uint32 reader_slot = header->num_readers.fetch_add(1);
+  if ((reader_slot & kReadingBy) != 0 ||
+      !LockByte(fd, kFirstReaderLock + reader_slot, false /*wait*/)) {
+    munmap(base, size);
+    close(fd);
+    return errors::ResourceExhausted("Shared memory segment ", name,
+                                     " has no reader slots left");
+  }
+  ring->reset(new SharedMemoryRing(name, false /*owner*/, fd, reader_slot,
+                                   static_cast<char*>(base), size));
+  return Status::OK();
+#endif
+}
+
+int64 SharedMemoryRing::capacity() const { return size_ - kAlignment; }
+
+SharedMemoryRing::Record* SharedMemoryRing::record(int64 offset) const {
+  return reinterpret_cast<Record*>(base_ + kAlignment + offset);
+}
+
+bool SharedMemoryRing::Write(StringPiece data, int64 tag, int64* offset) {
+  DCHECK(owner_);
+  const int64 record_bytes = kAlignment + RoundUp(data.size());
+  Record* r;
+  {
+    mutex_lock l(mu_);
+    if (record_bytes > capacity()) return false;
+    Reclaim();
+    // A record does not wrap around the end of the data area, so the
+    // space up to the end is padded if it is too small.
+    const int64 to_end = capacity() - head_ % capacity();
+    const int64 padding = record_bytes > to_end ? to_end : 0;
+    if (head_ - tail_ + padding + record_bytes > capacity()) return false;
+    if (padding > 0) {
+      Record* pad = record(head_ % capacity());
+      pad->size = padding;
+      pad->num_bytes = 0;
+      pad->tag = 0;
+      pad->state.store(kFree, std::memory_order_release);
+      head_ += padding;
+    }
+    *offset = head_ % capacity();
+    r = record(*offset);
+    r->size = record_bytes;
+    r->num_bytes = data.size();
+    r->tag = tag;
+    r->state.store(kWriting, std::memory_order_relaxed);
+    head_ += record_bytes;
+  }
+  // Records are only reclaimed in order, so r stays ours while copying.
+  memcpy(reinterpret_cast<char*>(r) + kAlignment, data.data(), data.size());
+  r->state.store(kReady, std::memory_order_release);
+  return true;
+}
+
+Status SharedMemoryRing::Read(int64 offset, int64 num_bytes, int64 tag,
+                              char* dst) {
+  if (offset < 0 || offset % kAlignment != 0 || num_bytes < 0 ||
+      offset + kAlignment + num_bytes > capacity()) {
+    return errors::InvalidArgument("Invalid record [", offset, ", +",
+                                   num_bytes, ") of shared memory ring ",
+                                   name_);
+  }
+  Record* r = record(offset);
+  uint32 state = kReady;
+  if (!r->state.compare_exchange_strong(state, kReadingBy | reader_slot_,
+                                        std::memory_order_acquire)) {
+    return errors::FailedPrecondition("Record ", offset,
+                                      " of shared memory ring ", name_,
+                                      " has been read or expired");
+  }
+  if (r->num_bytes != num_bytes || r->tag != tag) {
+    r->state.store(kReady, std::memory_order_release);
+    return errors::InvalidArgument("Record ", offset, " of shared memory ring ",
+                                   name_, " does not match the request");
+  }
+  memcpy(dst, reinterpret_cast<const char*>(r) + kAlignment, num_bytes);
+  r->state.store(kFree, std::memory_order_release);
+  return Status::OK();
+}
+
+void SharedMemoryRing::Expire(int64 tag) {
+  DCHECK(owner_);
+  mutex_lock l(mu_);
+  for (uint64 pos = tail_; pos < head_;) {
+    Record* r = record(pos % capacity());
+    if (r->tag == tag) {
+      uint32 state = r->state.load(std::memory_order_acquire);
+      // A record whose reader died while copying it would never be freed.
+      if (state == kReady ||
+          ((state & kReadingBy) != 0 && ReaderExited(state & ~kReadingBy))) {
+        r->state.compare_exchange_strong(state, kFree);
+      }
+    }
+    pos += r->size;
+  }
+  Reclaim();
+}
+
+bool SharedMemoryRing::ReaderExited(uint32 reader_slot) const {
+#if defined(PLATFORM_WINDOWS)
+  return false;
+#else
+  return !ByteLocked(fd_, kFirstReaderLock + reader_slot);
+#endif
+}
+
+void SharedMemoryRing::Reclaim() {
+  while (tail_ < head_) {
+    const Record* r = record(tail_ % capacity());
+    if (r->state.load(std::memory_order_acquire) != kFree) break;
+    tail_ += r->size;
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,114 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
+
+#include <memory>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A ring buffer of records in a POSIX shared memory segment, through which
+// one process passes data to others on the same host.
+//
+// Only the process that creates the ring writes records.  Each record is
+// read at most once, by a process that opened the ring and learned the
+// offset of the record by other means, e.g. an RPC response.  Reading a
+// record frees its space; the writer reclaims space in the order records
+// were written, so a record that is never read holds up the reuse of the
+// space after it until it is expired.
+//
+// The segment is removed when the writer destroys the ring.  If the writer
+// is killed instead, the segment outlives it until RemoveAbandoned is
+// called, e.g. by the next process on the host to create a ring.
+class SharedMemoryRing {
+ public:
+  ~SharedMemoryRing();
+
+  // Creates a new segment called 'name' with room for 'capacity' bytes of
+  // records, and maps it for writing.  The segment is removed when the
+  // returned ring is destroyed.
+  static Status Create(const string& name, int64 capacity,
+                       std::unique_ptr<SharedMemoryRing>* ring);
+
+  // Maps the existing segment called 'name' for reading.
+  static Status Open(const string& name,
+                     std::unique_ptr<SharedMemoryRing>* ring);
+
+  // Removes the segments whose names start with 'prefix' and whose writer
+  // exited without removing them.  Only does anything on Linux.
+  static void RemoveAbandoned(const string& prefix);
+
+  const string& name() const { return name_; }
+
+  // Copies 'data' into a new record tagged 'tag', and sets '*offset' to
+  // the offset of the record.  Returns false, without blocking, if there
+  // is no room for it.  Requires that this process created the ring.
+  bool Write(StringPiece data, int64 tag, int64* offset);
+
+  // Copies the 'num_bytes' bytes of the record at 'offset', which must be
+  // tagged 'tag', to 'dst', and frees the record.
+  Status Read(int64 offset, int64 num_bytes, int64 tag, char* dst);
+
+  // Frees the records tagged 'tag' that have not been read yet, so that
+  // reading them fails, and those whose reader exited while reading them.
+  // Requires that this process created the ring.
+  void Expire(int64 tag);
+
+ private:
+  struct Header;
+  struct Record;
+
+  SharedMemoryRing(const string& name, bool owner, int fd, uint32 reader_slot,
+                   char* base, int64 size);
+
+  int64 capacity() const;
+  Record* record(int64 offset) const;
+
+  // Returns true if the process that opened the ring with 'reader_slot'
+  // has exited.
+  bool ReaderExited(uint32 reader_slot) const;
+
+  // Advances tail_ past the records that have been read or expired.
+  void Reclaim() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const string name_;
+  const bool owner_;
+  // The segment, kept open to hold the lock that shows this process is
+  // alive.
+  const int fd_;
+  // Identifies this process among those that opened the ring.
+  const uint32 reader_slot_;
+  char* const base_;  // Start of the mapped segment
+  const int64 size_;  // Size of the mapped segment
+
+  // Positions of the writer.  The record at position p is at offset
+  // p % capacity() of the data area.
+  mutex mu_;
+  uint64 head_ GUARDED_BY(mu_) = 0;
+  uint64 tail_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
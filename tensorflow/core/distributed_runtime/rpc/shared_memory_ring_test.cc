@@ -0,0 +1,261 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "grpc++/support/byte_buffer.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+static string UniqueName() {
+  return strings::StrCat("/tf_shared_memory_ring_test_",
+                         strings::Hex(random::New64()));
+}
+
+class SharedMemoryRingTest : public ::testing::Test {
+ protected:
+  void Init(int64 capacity) {
+    const string name = UniqueName();
+    TF_ASSERT_OK(SharedMemoryRing::Create(name, capacity, &writer_));
+    TF_ASSERT_OK(SharedMemoryRing::Open(name, &reader_));
+  }
+
+  // Reads the record at 'offset', expected to hold 'expected'.
+  void ExpectRead(int64 offset, const string& expected, int64 tag) {
+    string data(expected.size(), '\0');
+    TF_EXPECT_OK(reader_->Read(offset, data.size(), tag, &data[0]));
+    EXPECT_EQ(expected, data);
+  }
+
+  std::unique_ptr<SharedMemoryRing> writer_;
+  std::unique_ptr<SharedMemoryRing> reader_;
+};
+
+TEST_F(SharedMemoryRingTest, WriteRead) {
+  Init(1 << 20);
+  std::vector<int64> offsets(3);
+  std::vector<string> data = {"a", string(1000, 'b'), ""};
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(writer_->Write(data[i], 7, &offsets[i]));
+  }
+  // Records may be read in any order.
+  ExpectRead(offsets[1], data[1], 7);
+  ExpectRead(offsets[0], data[0], 7);
+  ExpectRead(offsets[2], data[2], 7);
+}
+
+TEST_F(SharedMemoryRingTest, ReadOnce) {
+  Init(1 << 20);
+  int64 offset;
+  ASSERT_TRUE(writer_->Write("abc", 7, &offset));
+  char buf[3];
+  // The size and tag must match.
+  EXPECT_FALSE(reader_->Read(offset, 2, 7, buf).ok());
+  EXPECT_FALSE(reader_->Read(offset, 3, 8, buf).ok());
+  EXPECT_FALSE(reader_->Read(offset + 1, 3, 7, buf).ok());
+  ExpectRead(offset, "abc", 7);
+  EXPECT_FALSE(reader_->Read(offset, 3, 7, buf).ok());
+}
+
+TEST_F(SharedMemoryRingTest, ReclaimsInOrder) {
+  Init(1024);
+  const string data(200, 'x');
+  std::vector<int64> offsets;
+  int64 offset;
+  while (writer_->Write(data, 1, &offset)) {
+    offsets.push_back(offset);
+  }
+  ASSERT_EQ(3, offsets.size());
+  // Freeing a record other than the oldest makes no room.
+  ExpectRead(offsets[1], data, 1);
+  EXPECT_FALSE(writer_->Write(data, 1, &offset));
+  ExpectRead(offsets[0], data, 1);
+  ASSERT_TRUE(writer_->Write(data, 1, &offset));
+  // The new record wraps around to the start of the ring.
+  EXPECT_EQ(0, offset);
+  ExpectRead(offsets[2], data, 1);
+  ExpectRead(offset, data, 1);
+
+  // Many more records, each read before the next is written, wrap around
+  // the ring repeatedly.
+  for (int i = 0; i < 100; ++i) {
+    const string value(i * 7 % 500, 'a' + i % 26);
+    ASSERT_TRUE(writer_->Write(value, i, &offset));
+    ExpectRead(offset, value, i);
+  }
+}
+
+TEST_F(SharedMemoryRingTest, Expire) {
+  Init(1024);
+  const string data(400, 'x');
+  int64 offset1, offset2;
+  ASSERT_TRUE(writer_->Write(data, 1, &offset1));
+  ASSERT_TRUE(writer_->Write(data, 2, &offset2));
+  EXPECT_FALSE(writer_->Write(data, 3, &offset2));
+  writer_->Expire(1);
+  char buf[400];
+  EXPECT_FALSE(reader_->Read(offset1, data.size(), 1, buf).ok());
+  int64 offset3;
+  EXPECT_TRUE(writer_->Write(data, 3, &offset3));
+  ExpectRead(offset2, data, 2);
+}
+
+TEST_F(SharedMemoryRingTest, ExpireAfterReaderDies) {
+  Init(1024);
+  const string data(400, 'x');
+  int64 offset1, offset2;
+  ASSERT_TRUE(writer_->Write(data, 1, &offset1));
+  ASSERT_TRUE(writer_->Write(data, 2, &offset2));
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Crashes while reading the record, leaving it claimed.
+    std::unique_ptr<SharedMemoryRing> reader;
+    if (SharedMemoryRing::Open(writer_->name(), &reader).ok()) {
+      reader->Read(offset1, data.size(), 1, nullptr).IgnoreError();
+    }
+    _exit(0);
+  }
+  int wstatus;
+  ASSERT_EQ(pid, waitpid(pid, &wstatus, 0));
+  ASSERT_TRUE(WIFSIGNALED(wstatus));
+  char buf[400];
+  EXPECT_FALSE(reader_->Read(offset1, data.size(), 1, buf).ok());
+  int64 offset3;
+  EXPECT_FALSE(writer_->Write(data, 3, &offset3));
+  writer_->Expire(1);
+  EXPECT_TRUE(writer_->Write(data, 3, &offset3));
+  ExpectRead(offset2, data, 2);
+}
+
+TEST_F(SharedMemoryRingTest, RemoveAbandoned) {
+  const string prefix = UniqueName();
+  const string live = strings::StrCat(prefix, "_live");
+  const string killed = strings::StrCat(prefix, "_killed");
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(live, 1024, &ring));
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Dies without removing its ring.
+    std::unique_ptr<SharedMemoryRing> killed_ring;
+    SharedMemoryRing::Create(killed, 1024, &killed_ring).IgnoreError();
+    kill(getpid(), SIGKILL);
+    _exit(0);
+  }
+  int wstatus;
+  ASSERT_EQ(pid, waitpid(pid, &wstatus, 0));
+  ASSERT_TRUE(WIFSIGNALED(wstatus));
+  std::unique_ptr<SharedMemoryRing> reader;
+  TF_ASSERT_OK(SharedMemoryRing::Open(killed, &reader));
+  reader.reset();
+  SharedMemoryRing::RemoveAbandoned(prefix);
+  EXPECT_FALSE(SharedMemoryRing::Open(killed, &reader).ok());
+  TF_EXPECT_OK(SharedMemoryRing::Open(live, &reader));
+}
+
+TEST_F(SharedMemoryRingTest, OpenFails) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  EXPECT_FALSE(SharedMemoryRing::Open(UniqueName(), &ring).ok());
+  Init(1024);
+  EXPECT_FALSE(SharedMemoryRing::Create(writer_->name(), 1024, &ring).ok());
+}
+
+// Passes a tensor of 'num_mb' megabytes through a shared memory ring, as
+// ShmRendezvousMgr receives it from a worker on the same host.
+static void BM_SharedMemoryRing(int iters, int num_mb) {
+  testing::StopTiming();
+  std::unique_ptr<SharedMemoryRing> writer;
+  std::unique_ptr<SharedMemoryRing> reader;
+  const string name = UniqueName();
+  TF_CHECK_OK(SharedMemoryRing::Create(name, 2 * num_mb << 20, &writer));
+  TF_CHECK_OK(SharedMemoryRing::Open(name, &reader));
+  Tensor src(DT_FLOAT, TensorShape({static_cast<int64>(num_mb) << 18}));
+  src.flat<float>().setConstant(1.0f);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_mb << 20);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    int64 offset;
+    CHECK(writer->Write(src.tensor_data(), 1, &offset));
+    Tensor dst(DT_FLOAT, src.shape());
+    TF_CHECK_OK(reader->Read(offset, src.TotalBytes(), 1,
+                             const_cast<char*>(dst.tensor_data().data())));
+  }
+}
+BENCHMARK(BM_SharedMemoryRing)->Arg(1)->Arg(16)->Arg(256);
+
+class CpuDevice : public DeviceBase {
+ public:
+  explicit CpuDevice(Env* env) : DeviceBase(env) {
+    attr_.set_device_type("CPU");
+  }
+
+  const DeviceAttributes& attributes() const override { return attr_; }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+ private:
+  DeviceAttributes attr_;
+};
+
+// Passes the same tensor through the gRPC message encoding, as
+// RpcRendezvousMgr receives it, for comparison.
+static void BM_GrpcByteBuffer(int iters, int num_mb) {
+  testing::StopTiming();
+  Tensor src(DT_FLOAT, TensorShape({static_cast<int64>(num_mb) << 18}));
+  src.flat<float>().setConstant(1.0f);
+  CpuDevice cpu_device(Env::Default());
+  testing::BytesProcessed(static_cast<int64>(iters) * num_mb << 20);
+  testing::StartTiming();
+  while (--iters >= 0) {
+    ::grpc::ByteBuffer buf;
+    grpc::EncodeTensorToByteBuffer(false, src, &buf);
+    // Sending over loopback copies the message into a new buffer.
+    std::vector<::grpc::Slice> slices;
+    (void)buf.Dump(&slices);
+    ::grpc::Slice received(buf.Length());
+    char* dst = reinterpret_cast<char*>(const_cast<uint8*>(received.begin()));
+    for (const auto& s : slices) {
+      memcpy(dst, s.begin(), s.size());
+      dst += s.size();
+    }
+    ::grpc::ByteBuffer received_buf(&received, 1);
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    GrpcByteSource source(&received_buf);
+    TF_CHECK_OK(response.ParseFrom(&source));
+  }
+}
+BENCHMARK(BM_GrpcByteBuffer)->Arg(1)->Arg(16)->Arg(256);
+
+}  // namespace tensorflow
@@ -0,0 +1,295 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shm_rendezvous_mgr.h"
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/distributed_runtime/request_id.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/worker_cache.h"
+#include "tensorflow/core/distributed_runtime/worker_interface.h"
+#include "tensorflow/core/distributed_runtime/worker_session.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+
+namespace {
+
+// How long a receiver sends a worker's tensors over gRPC after failing to
+// map its ring.
+const uint64 kMapRetryMicros = 60 * 1000 * 1000;
+
+class ShmRecvTensorCall : public BaseRecvTensorCall {
+ public:
+  ShmRecvTensorCall(WorkerInterface* wi, Device* dst_device,
+                    ShmRendezvousMgr* rendezvous_mgr,
+                    const string& src_worker,
+                    const Rendezvous::Args& recv_args, int64 step_id,
+                    StringPiece key)
+      : wi_(wi),
+        dst_device_(dst_device),
+        rendezvous_mgr_(rendezvous_mgr),
+        src_worker_(src_worker),
+        recv_args_(recv_args) {
+    req_.set_step_id(step_id);
+    req_.set_rendezvous_key(key.data(), key.size());
+    req_.set_request_id(GetUniqueRequestId());
+  }
+
+  ~ShmRecvTensorCall() override {}
+
+  void Start(std::function<void()> recv_done) override {
+    resp_.InitAlloc(dst_device_, recv_args_.alloc_attrs);
+    // The content is copied straight into the tensor, so it must be on the
+    // host.
+    const bool on_host =
+        (dst_device_->tensorflow_gpu_device_info() == nullptr) ||
+        recv_args_.alloc_attrs.on_host();
+    ShmRecvTensorReqExtra extra;
+    if (on_host && rendezvous_mgr_->PrepareRequest(src_worker_, &extra)) {
+      req_.mutable_transport_options()->PackFrom(extra);
+    }
+    StatusCallback cb = [this, recv_done](const Status& s) {
+      ShmRecvTensorRespExtra extra;
+      if (s.ok() && resp_.metadata().transport_options().UnpackTo(&extra)) {
+        if (extra.num_bytes() > 0) {
+          ReadContent(extra);
+        } else {
+          rendezvous_mgr_->MapRing(src_worker_, extra.segment());
+        }
+      }
+      if (errors::IsUnavailable(s)) {
+        // The sender may have been killed, so stop keeping its memory.
+        rendezvous_mgr_->UnmapRing(src_worker_);
+      }
+      if (!s.ok()) {
+        mutex_lock l(mu_);
+        status_.Update(s);
+      }
+      recv_done();
+    };
+    wi_->RecvTensorAsync(&opts_, &req_, &resp_, std::move(cb));
+  }
+
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+    opts_.StartCancel();
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+  const Tensor& tensor() const { return resp_.tensor(); }
+
+  bool is_dead() const { return resp_.metadata().is_dead(); }
+
+  const Rendezvous::Args& recv_args() const { return recv_args_; }
+
+ private:
+  // Copies the content of the tensor allocated by resp_ from the record
+  // described by 'extra'.
+  void ReadContent(const ShmRecvTensorRespExtra& extra) {
+    Status s;
+    std::shared_ptr<SharedMemoryRing> ring =
+        rendezvous_mgr_->FindRing(src_worker_, extra.segment());
+    const Tensor& val = tensor();
+    if (ring == nullptr) {
+      s = errors::Internal("Shared memory segment ", extra.segment(), " of ",
+                           src_worker_, " is not mapped");
+    } else if (!DataTypeCanUseMemcpy(val.dtype()) ||
+               static_cast<int64>(val.TotalBytes()) != extra.num_bytes()) {
+      s = errors::Internal(
+          "Shared memory RecvTensor response does not match tensor of type ",
+          DataTypeString(val.dtype()), " and shape ",
+          val.shape().DebugString());
+    } else {
+      s = ring->Read(extra.offset(), extra.num_bytes(), req_.step_id(),
+                     const_cast<char*>(val.tensor_data().data()));
+    }
+    if (!s.ok()) {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+  }
+
+  WorkerInterface* wi_;
+  Device* dst_device_;
+  ShmRendezvousMgr* rendezvous_mgr_;  // Not owned
+  const string src_worker_;
+  CallOptions opts_;
+  RecvTensorRequest req_;
+  TensorResponse resp_;
+  Rendezvous::Args recv_args_;
+
+  mutable mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmRecvTensorCall);
+};
+
+class ShmRemoteRendezvous : public BaseRemoteRendezvous {
+ public:
+  ShmRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      ShmRendezvousMgr* rendezvous_mgr)
+      : BaseRemoteRendezvous(env, step_id), rendezvous_mgr_(rendezvous_mgr) {}
+
+ protected:
+  void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
+                           const Rendezvous::Args& recv_args,
+                           DoneCallback done) override {
+    CHECK(is_initialized());
+
+    string src_worker;
+    string src_rel_device;
+    if (!DeviceNameUtils::SplitDeviceName(parsed.src_device, &src_worker,
+                                          &src_rel_device)) {
+      Status s = errors::Internal(parsed.src_device,
+                                  " is invalid remote source device.");
+      done(s, Args(), recv_args, Tensor{}, false);
+      return;
+    }
+
+    WorkerSession* sess = session();
+    WorkerInterface* rwi = sess->worker_cache->CreateWorker(src_worker);
+    if (rwi == nullptr) {
+      Status s = errors::Internal("No worker known as ", src_worker);
+      done(s, Args(), recv_args, Tensor{}, false);
+      return;
+    }
+
+    Device* dst_device;
+    Status s = sess->device_mgr()->LookupDevice(parsed.dst_device, &dst_device);
+    if (!s.ok()) {
+      sess->worker_cache->ReleaseWorker(src_worker, rwi);
+      done(s, Args(), recv_args, Tensor{}, false);
+      return;
+    }
+
+    // Prepare a RecvTensor call that can handle being aborted.
+    ShmRecvTensorCall* call =
+        new ShmRecvTensorCall(rwi, dst_device, rendezvous_mgr_, src_worker,
+                              recv_args, step_id_, parsed.FullKey());
+
+    // Record "call" in active_ so that it can be aborted cleanly.
+    RegisterCall(call);
+
+    // Start "call".
+    Ref();
+    call->Start([this, call, src_worker, rwi, done]() {
+      // Removes "call" from active_. Prevent StartAbort().
+      DeregisterCall(call);
+      // If StartAbort was called prior to DeregisterCall, then the
+      // current status should be bad.
+      Status s = call->status();
+      done(s, Args(), call->recv_args(), call->tensor(), call->is_dead());
+      session()->worker_cache->ReleaseWorker(src_worker, rwi);
+      delete call;
+      Unref();
+    });
+  }
+
+ private:
+  ~ShmRemoteRendezvous() override {}
+
+  ShmRendezvousMgr* rendezvous_mgr_;  // Not owned
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmRemoteRendezvous);
+};
+
+}  // namespace
+
+ShmRendezvousMgr::ShmRendezvousMgr(const WorkerEnv* env)
+    : BaseRendezvousMgr(env),
+      worker_env_(env),
+      hostname_(port::Hostname()) {}
+
+bool ShmRendezvousMgr::PrepareRequest(const string& src_worker,
+                                      ShmRecvTensorReqExtra* extra) {
+  mutex_lock l(mu_);
+  auto unreachable = unreachable_.find(src_worker);
+  if (unreachable != unreachable_.end()) {
+    if (worker_env_->env->NowMicros() < unreachable->second) return false;
+    // Ask for the name of the ring again, and try to map it.
+    unreachable_.erase(unreachable);
+  }
+  extra->set_hostname(hostname_);
+  auto it = rings_.find(src_worker);
+  if (it != rings_.end()) {
+    extra->set_segment(it->second->name());
+  }
+  return true;
+}
+
+std::shared_ptr<SharedMemoryRing> ShmRendezvousMgr::FindRing(
+    const string& src_worker, const string& segment) {
+  mutex_lock l(mu_);
+  auto it = rings_.find(src_worker);
+  if (it == rings_.end() || it->second->name() != segment) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+void ShmRendezvousMgr::MapRing(const string& src_worker,
+                               const string& segment) {
+  {
+    mutex_lock l(mu_);
+    auto it = rings_.find(src_worker);
+    if (it != rings_.end() && it->second->name() == segment) return;
+  }
+  std::unique_ptr<SharedMemoryRing> ring;
+  Status s = SharedMemoryRing::Open(segment, &ring);
+  mutex_lock l(mu_);
+  if (s.ok()) {
+    // Replaces the ring of an earlier incarnation of the worker, if any.
+    rings_[src_worker] = std::move(ring);
+    unreachable_.erase(src_worker);
+  } else {
+    LOG(INFO) << "Receiving tensors from " << src_worker
+              << " over gRPC: " << s;
+    rings_.erase(src_worker);
+    unreachable_[src_worker] =
+        worker_env_->env->NowMicros() + kMapRetryMicros;
+  }
+}
+
+void ShmRendezvousMgr::UnmapRing(const string& src_worker) {
+  std::shared_ptr<SharedMemoryRing> ring;
+  mutex_lock l(mu_);
+  auto it = rings_.find(src_worker);
+  if (it == rings_.end()) return;
+  // Unmapped outside of mu_ once no call is reading from it.
+  ring = std::move(it->second);
+  rings_.erase(it);
+}
+
+BaseRemoteRendezvous* ShmRendezvousMgr::Create(int64 step_id,
+                                               const WorkerEnv* worker_env) {
+  return new ShmRemoteRendezvous(worker_env, step_id, this);
+}
+
+}  // end namespace tensorflow
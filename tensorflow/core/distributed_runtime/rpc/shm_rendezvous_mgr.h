@@ -0,0 +1,85 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_RENDEZVOUS_MGR_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_RENDEZVOUS_MGR_H_
+
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/core/distributed_runtime/base_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+class ShmRecvTensorReqExtra;
+
+// A RendezvousMgr that receives tensors into host memory from workers on
+// the same host through their shared memory rings (see ShmWorker), and
+// over gRPC otherwise.
+//
+// A sender tells the receiver the name of its ring in the first response
+// to a request from the same host.  The receiver maps the ring, and names
+// it in later requests to show that the sender may put the content there.
+// If the ring cannot be mapped, e.g. because the sender is in another
+// container with the same hostname, the receiver stops asking for a
+// while, and then tries again in case the sender was restarted.
+class ShmRendezvousMgr : public BaseRendezvousMgr {
+ public:
+  explicit ShmRendezvousMgr(const WorkerEnv* env);
+
+  // Fills in '*extra' for a request to 'src_worker'.  Returns false if
+  // the content of tensors from 'src_worker' can't be passed through
+  // shared memory.
+  bool PrepareRequest(const string& src_worker, ShmRecvTensorReqExtra* extra);
+
+  // Returns the ring 'segment' of 'src_worker', or null if it has not been
+  // mapped.
+  std::shared_ptr<SharedMemoryRing> FindRing(const string& src_worker,
+                                             const string& segment);
+
+  // Maps the ring 'segment' advertised by 'src_worker', if it is not
+  // mapped already.
+  void MapRing(const string& src_worker, const string& segment);
+
+  // Forgets the ring of 'src_worker', e.g. because it could not be
+  // reached.  It is asked for the name of its ring again by the next
+  // request.
+  void UnmapRing(const string& src_worker);
+
+ protected:
+  BaseRemoteRendezvous* Create(int64 step_id, const WorkerEnv* worker_env);
+
+ private:
+  const WorkerEnv* const worker_env_;
+  const string hostname_;
+
+  mutex mu_;
+  // Keyed by the name of the sending worker.
+  std::unordered_map<string, std::shared_ptr<SharedMemoryRing>> rings_
+      GUARDED_BY(mu_);
+  // Workers whose rings could not be mapped, and the time in microseconds
+  // at which to try again.
+  std::unordered_map<string, uint64> unreachable_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmRendezvousMgr);
+};
+
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_RENDEZVOUS_MGR_H_
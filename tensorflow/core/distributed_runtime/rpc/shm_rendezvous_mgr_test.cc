@@ -0,0 +1,326 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shm_rendezvous_mgr.h"
+
+#include <sys/mman.h>
+#include <atomic>
+
+#include "grpc++/support/byte_buffer.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/rpc/shm_worker.h"
+#include "tensorflow/core/distributed_runtime/test_utils.h"
+#include "tensorflow/core/distributed_runtime/worker_session.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+const char kSrcTask[] = "/job:mnist/replica:1/task:0";
+const char kDstTask[] = "/job:mnist/replica:1/task:2";
+const int64 kStepId = 123;
+
+// An Env whose clock only moves when told to.
+class FakeClockEnv : public EnvWrapper {
+ public:
+  FakeClockEnv() : EnvWrapper(Env::Default()) {}
+
+  uint64 NowMicros() override { return now_micros_; }
+
+  void AdvanceByMicros(uint64 micros) { now_micros_ += micros; }
+
+ private:
+  std::atomic<uint64> now_micros_{1};
+};
+
+// How a RecvTensor response passed the content of the tensor.
+enum Transport {
+  kGrpc,       // In the response.
+  kAdvertise,  // In the response, along with the name of the ring.
+  kRing,       // In the ring.
+};
+
+// Serves RecvTensor calls with a ShmWorker, as GrpcRemoteWorker would
+// after a round trip over gRPC, and records how each response was sent.
+class ShmTestWorker : public TestWorkerInterface {
+ public:
+  explicit ShmTestWorker(ShmWorker* worker) : worker_(worker) {}
+
+  // Expires the records of the step before each response is returned, as
+  // if the step were cleaned up before the receiver read it.
+  void set_expire_before_reply(bool expire) { expire_before_reply_ = expire; }
+
+  // Fails each call as if the worker could not be reached.
+  void set_unavailable(bool unavailable) { unavailable_ = unavailable; }
+
+  void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) override {
+    if (unavailable_) {
+      done(errors::Unavailable("Worker is down"));
+      return;
+    }
+    ::grpc::ByteBuffer* buf = new ::grpc::ByteBuffer;
+    worker_->GrpcRecvTensorAsync(
+        opts, request, buf,
+        [this, request, response, buf, done](const Status& s) {
+          Status status = s;
+          if (status.ok() && !GrpcMaybeParseProto(buf, response)) {
+            status = errors::Internal("Failed to parse RecvTensorResponse");
+          }
+          delete buf;
+          if (status.ok()) {
+            Record(*response);
+          }
+          if (status.ok() && expire_before_reply_) {
+            CleanupGraphRequest req;
+            req.set_step_id(request->step_id());
+            CleanupGraphResponse resp;
+            worker_->CleanupGraphAsync(
+                &req, &resp, [](const Status& s) { TF_EXPECT_OK(s); });
+          }
+          done(status);
+        });
+  }
+
+  std::vector<Transport> transports() {
+    mutex_lock l(mu_);
+    return transports_;
+  }
+
+ private:
+  void Record(const TensorResponse& response) {
+    ShmRecvTensorRespExtra extra;
+    Transport transport = kGrpc;
+    if (response.metadata().transport_options().UnpackTo(&extra)) {
+      transport = extra.num_bytes() > 0 ? kRing : kAdvertise;
+    }
+    mutex_lock l(mu_);
+    transports_.push_back(transport);
+  }
+
+  ShmWorker* const worker_;
+  bool expire_before_reply_ = false;
+  bool unavailable_ = false;
+  mutex mu_;
+  std::vector<Transport> transports_ GUARDED_BY(mu_);
+};
+
+Device* NewDevice(const string& task) {
+  return new ThreadPoolDevice(
+      SessionOptions(), strings::StrCat(task, "/device:CPU:0"),
+      Bytes(256 << 20), DeviceLocality(), cpu_allocator());
+}
+
+Tensor MakeValue(float x) {
+  Tensor val(DT_FLOAT, TensorShape({1024}));
+  val.flat<float>().setConstant(x);
+  return val;
+}
+
+class ShmRendezvousMgrTest : public ::testing::Test {
+ protected:
+  ShmRendezvousMgrTest() : pool_(Env::Default(), "test", 1) {
+    src_env_.env = Env::Default();
+    src_env_.compute_pool = &pool_;
+    src_device_mgr_.reset(new DeviceMgr({NewDevice(kSrcTask)}));
+    src_env_.device_mgr = src_device_mgr_.get();
+    src_rmgr_.reset(new ShmRendezvousMgr(&src_env_));
+    src_env_.rendezvous_mgr = src_rmgr_.get();
+    src_session_.reset(new WorkerSession(
+        "shm_session", kSrcTask,
+        std::unique_ptr<WorkerCacheInterface>(new TestWorkerCache),
+        std::unique_ptr<DeviceMgr>(), std::unique_ptr<GraphMgr>()));
+
+    dst_env_.env = &clock_;
+    dst_env_.compute_pool = &pool_;
+    dst_rmgr_.reset(new ShmRendezvousMgr(&dst_env_));
+  }
+
+  ~ShmRendezvousMgrTest() override {
+    src_rmgr_->Cleanup(kStepId);
+    dst_rmgr_->Cleanup(kStepId);
+  }
+
+  // Starts a sender whose ring has room for 'capacity' bytes, or no ring
+  // if 'capacity' is 0.  If 'unlink' is true, the ring can't be opened.
+  void StartWorker(int64 capacity, bool unlink) {
+    std::unique_ptr<SharedMemoryRing> ring;
+    if (capacity > 0) {
+      TF_ASSERT_OK(SharedMemoryRing::Create(
+          strings::StrCat("/tf_shm_rendezvous_mgr_test_",
+                          strings::Hex(random::New64())),
+          capacity, &ring));
+      if (unlink) shm_unlink(ring->name().c_str());
+    }
+    worker_.reset(new ShmWorker(&src_env_, std::move(ring)));
+    wi_.reset(new ShmTestWorker(worker_.get()));
+    TestWorkerCache* cache = new TestWorkerCache;
+    cache->AddWorker(kSrcTask, wi_.get());
+    dst_session_.reset(new WorkerSession(
+        "shm_session", kDstTask, std::unique_ptr<WorkerCacheInterface>(cache),
+        std::unique_ptr<DeviceMgr>(new DeviceMgr({NewDevice(kDstTask)})),
+        std::unique_ptr<GraphMgr>()));
+  }
+
+  // Sends 'val' from the sender as 'name', and receives it.
+  Status SendRecv(const string& name, const Tensor& val, Tensor* received) {
+    Device* src_device;
+    TF_CHECK_OK(src_device_mgr_->LookupDevice("CPU:0", &src_device));
+    const string key = Rendezvous::CreateKey(
+        strings::StrCat(kSrcTask, "/device:CPU:0"),
+        src_device->attributes().incarnation(),
+        strings::StrCat(kDstTask, "/device:CPU:0"), name, FrameAndIter(0, 0));
+    Rendezvous::ParsedKey parsed;
+    TF_CHECK_OK(Rendezvous::ParseKey(key, &parsed));
+
+    RemoteRendezvous* src_rendez = src_rmgr_->Find(kStepId);
+    core::ScopedUnref src_unref(src_rendez);
+    TF_CHECK_OK(src_rendez->Initialize(src_session_.get()));
+    TF_CHECK_OK(src_rendez->Send(parsed, Rendezvous::Args(), val, false));
+
+    RemoteRendezvous* dst_rendez = dst_rmgr_->Find(kStepId);
+    core::ScopedUnref dst_unref(dst_rendez);
+    TF_CHECK_OK(dst_rendez->Initialize(dst_session_.get()));
+    Status status;
+    Notification n;
+    dst_rendez->RecvAsync(
+        parsed, Rendezvous::Args(),
+        [&status, &n, received](const Status& s,
+                                const Rendezvous::Args& send_args,
+                                const Rendezvous::Args& recv_args,
+                                const Tensor& v, bool is_dead) {
+          status = s;
+          *received = v;
+          n.Notify();
+        });
+    n.WaitForNotification();
+    return status;
+  }
+
+  // Sends and receives a tensor, and checks that it arrived intact.
+  void ExpectSendRecv(const string& name, float x) {
+    Tensor received;
+    TF_ASSERT_OK(SendRecv(name, MakeValue(x), &received));
+    ASSERT_EQ(1024, received.NumElements());
+    EXPECT_EQ(x, received.flat<float>()(0));
+    EXPECT_EQ(x, received.flat<float>()(1023));
+  }
+
+  thread::ThreadPool pool_;
+  FakeClockEnv clock_;
+
+  WorkerEnv src_env_;
+  std::unique_ptr<DeviceMgr> src_device_mgr_;
+  std::unique_ptr<ShmRendezvousMgr> src_rmgr_;
+  std::unique_ptr<WorkerSession> src_session_;
+  std::unique_ptr<ShmWorker> worker_;
+  std::unique_ptr<ShmTestWorker> wi_;
+
+  WorkerEnv dst_env_;
+  std::unique_ptr<ShmRendezvousMgr> dst_rmgr_;
+  std::unique_ptr<WorkerSession> dst_session_;
+};
+
+TEST_F(ShmRendezvousMgrTest, RecvThroughRing) {
+  StartWorker(1 << 20, false);
+  ExpectSendRecv("a", 1.0f);
+  ExpectSendRecv("b", 2.0f);
+  ExpectSendRecv("c", 3.0f);
+  // The first response tells the receiver the name of the ring.
+  std::vector<Transport> expected = {kAdvertise, kRing, kRing};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+TEST_F(ShmRendezvousMgrTest, NoRing) {
+  StartWorker(0, false);
+  ExpectSendRecv("a", 1.0f);
+  ExpectSendRecv("b", 2.0f);
+  std::vector<Transport> expected = {kGrpc, kGrpc};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+TEST_F(ShmRendezvousMgrTest, RingFull) {
+  // Too small for the tensor, so it is sent over gRPC.
+  StartWorker(1024, false);
+  ExpectSendRecv("a", 1.0f);
+  ExpectSendRecv("b", 2.0f);
+  ShmRecvTensorReqExtra extra;
+  EXPECT_TRUE(dst_rmgr_->PrepareRequest(kSrcTask, &extra));
+  EXPECT_FALSE(extra.segment().empty());
+  std::vector<Transport> expected = {kAdvertise, kGrpc};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+TEST_F(ShmRendezvousMgrTest, FallBackToGrpcAndRetry) {
+  StartWorker(1 << 20, true);
+  ExpectSendRecv("a", 1.0f);
+  ShmRecvTensorReqExtra extra;
+  EXPECT_FALSE(dst_rmgr_->PrepareRequest(kSrcTask, &extra));
+  ExpectSendRecv("b", 2.0f);
+  // The receiver asks again for the ring after a while.
+  clock_.AdvanceByMicros(3600ull * 1000 * 1000);
+  EXPECT_TRUE(dst_rmgr_->PrepareRequest(kSrcTask, &extra));
+  EXPECT_TRUE(extra.segment().empty());
+  ExpectSendRecv("c", 3.0f);
+  ExpectSendRecv("d", 4.0f);
+  std::vector<Transport> expected = {kAdvertise, kGrpc, kAdvertise, kGrpc};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+TEST_F(ShmRendezvousMgrTest, ExpireUnreadRecord) {
+  StartWorker(1 << 20, false);
+  ExpectSendRecv("a", 1.0f);
+  wi_->set_expire_before_reply(true);
+  Tensor received;
+  EXPECT_TRUE(
+      errors::IsFailedPrecondition(SendRecv("b", MakeValue(2.0f), &received)));
+  // The space of the expired record is reused.
+  wi_->set_expire_before_reply(false);
+  ExpectSendRecv("c", 3.0f);
+  std::vector<Transport> expected = {kAdvertise, kRing, kRing};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+TEST_F(ShmRendezvousMgrTest, UnmapRingOfUnavailableWorker) {
+  StartWorker(1 << 20, false);
+  ExpectSendRecv("a", 1.0f);
+  wi_->set_unavailable(true);
+  Tensor received;
+  EXPECT_TRUE(errors::IsUnavailable(SendRecv("b", MakeValue(2.0f), &received)));
+  ShmRecvTensorReqExtra extra;
+  EXPECT_TRUE(dst_rmgr_->PrepareRequest(kSrcTask, &extra));
+  EXPECT_TRUE(extra.segment().empty());
+  // Once the worker is back, the receiver maps its ring again.
+  wi_->set_unavailable(false);
+  ExpectSendRecv("c", 3.0f);
+  ExpectSendRecv("d", 4.0f);
+  std::vector<Transport> expected = {kAdvertise, kAdvertise, kRing};
+  EXPECT_EQ(expected, wi_->transports());
+}
+
+}  // namespace
+}  // namespace tensorflow
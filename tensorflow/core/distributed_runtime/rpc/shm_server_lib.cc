@@ -0,0 +1,93 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shm_server_lib.h"
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+#include "tensorflow/core/distributed_runtime/rpc/shm_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/rpc/shm_worker.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Bytes of tensor content that a worker may have in flight to receivers on
+// the same host.  Tensors that don't fit are sent over gRPC.
+const int64 kShmRingCapacity = 256 << 20;
+
+// Prefix of the names of the rings of all workers.
+const char kShmRingPrefix[] = "/tf_shm_";
+
+}  // namespace
+
+ShmServer::ShmServer(const ServerDef& server_def, Env* env)
+    : GrpcServer(server_def, env) {}
+
+Status ShmServer::Init() {
+  RendezvousMgrCreationFunction rendezvous_mgr_func =
+      [](const WorkerEnv* env) { return new ShmRendezvousMgr(env); };
+  WorkerCreationFunction worker_func = [](WorkerEnv* env) {
+    // Reclaim the rings of workers on this host that were killed.
+    SharedMemoryRing::RemoveAbandoned(kShmRingPrefix);
+    std::unique_ptr<SharedMemoryRing> ring;
+    const string name =
+        strings::StrCat(kShmRingPrefix, strings::Hex(random::New64()));
+    Status s = SharedMemoryRing::Create(name, kShmRingCapacity, &ring);
+    if (!s.ok()) {
+      LOG(WARNING) << "Sending all tensors over gRPC: " << s;
+    }
+    return std::unique_ptr<ShmWorker>(new ShmWorker(env, std::move(ring)));
+  };
+  return GrpcServer::Init(nullptr, rendezvous_mgr_func, worker_func);
+}
+
+/* static */
+Status ShmServer::Create(const ServerDef& server_def, Env* env,
+                         std::unique_ptr<ServerInterface>* out_server) {
+  std::unique_ptr<ShmServer> ret(
+      new ShmServer(server_def, env == nullptr ? Env::Default() : env));
+  TF_RETURN_IF_ERROR(ret->Init());
+  *out_server = std::move(ret);
+  return Status::OK();
+}
+
+namespace {
+
+class ShmServerFactory : public ServerFactory {
+ public:
+  bool AcceptsOptions(const ServerDef& server_def) override {
+    return server_def.protocol() == "grpc+shm";
+  }
+
+  Status NewServer(const ServerDef& server_def,
+                   std::unique_ptr<ServerInterface>* out_server) override {
+    return ShmServer::Create(server_def, Env::Default(), out_server);
+  }
+};
+
+// Registers a `ServerFactory` for `ShmServer` instances.
+class ShmServerRegistrar {
+ public:
+  ShmServerRegistrar() {
+    ServerFactory::Register("SHM_SERVER", new ShmServerFactory());
+  }
+};
+static ShmServerRegistrar registrar;
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,77 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shm_worker.h"
+
+#include "grpc++/support/byte_buffer.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+ShmWorker::ShmWorker(WorkerEnv* env, std::unique_ptr<SharedMemoryRing> ring)
+    : GrpcWorker(env), hostname_(port::Hostname()), ring_(std::move(ring)) {}
+
+void ShmWorker::EncodeRecvTensor(const RecvTensorRequest* request,
+                                 bool is_dead, const Tensor& val,
+                                 ::grpc::ByteBuffer* response) {
+  ShmRecvTensorReqExtra extra;
+  if (ring_ == nullptr || is_dead || !DataTypeCanUseMemcpy(val.dtype()) ||
+      !request->transport_options().UnpackTo(&extra) ||
+      extra.hostname() != hostname_) {
+    GrpcWorker::EncodeRecvTensor(request, is_dead, val, response);
+    return;
+  }
+  RecvTensorResponse proto;
+  ShmRecvTensorRespExtra resp_extra;
+  resp_extra.set_segment(ring_->name());
+  int64 offset;
+  if (extra.segment() != ring_->name()) {
+    // The receiver has not mapped the ring yet, so the content goes in the
+    // response along with the name of the ring.
+    val.AsProtoTensorContent(proto.mutable_tensor());
+  } else if (val.TotalBytes() > 0 &&
+             ring_->Write(val.tensor_data(), request->step_id(), &offset)) {
+    proto.mutable_tensor()->set_dtype(val.dtype());
+    val.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+    resp_extra.set_offset(offset);
+    resp_extra.set_num_bytes(val.TotalBytes());
+  } else {
+    // The tensor is empty, or the ring is full.
+    GrpcWorker::EncodeRecvTensor(request, is_dead, val, response);
+    return;
+  }
+  proto.set_send_start_micros(env_->env->NowMicros());
+  proto.mutable_transport_options()->PackFrom(resp_extra);
+  grpc::EncodeRecvTensorResponseToByteBuffer(proto, response);
+}
+
+void ShmWorker::CleanupGraphAsync(const CleanupGraphRequest* request,
+                                  CleanupGraphResponse* response,
+                                  StatusCallback done) {
+  // Free the records of the step that were never read, e.g. because the
+  // receiver was aborted.
+  if (ring_ != nullptr) {
+    ring_->Expire(request->step_id());
+  }
+  GrpcWorker::CleanupGraphAsync(request, response, std::move(done));
+}
+
+}  // namespace tensorflow
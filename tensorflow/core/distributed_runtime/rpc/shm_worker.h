@@ -0,0 +1,53 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_WORKER_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_WORKER_H_
+
+#include <memory>
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+
+namespace tensorflow {
+
+// A GrpcWorker that passes the content of tensors to workers on the same
+// host through a shared memory ring, leaving only the metadata in the
+// RecvTensor response.
+class ShmWorker : public GrpcWorker {
+ public:
+  // 'ring' may be null, in which case every tensor is sent over gRPC.
+  ShmWorker(WorkerEnv* env, std::unique_ptr<SharedMemoryRing> ring);
+
+  void CleanupGraphAsync(const CleanupGraphRequest* request,
+                         CleanupGraphResponse* response,
+                         StatusCallback done) override;
+
+ protected:
+  // If the request carries a ShmRecvTensorReqExtra from this host, writes
+  // the content of 'val' to the ring, or, if the receiver has not mapped
+  // the ring yet, tells it the name of the ring.
+  void EncodeRecvTensor(const RecvTensorRequest* request, bool is_dead,
+                        const Tensor& val,
+                        ::grpc::ByteBuffer* response) override;
+
+ private:
+  const string hostname_;
+  const std::unique_ptr<SharedMemoryRing> ring_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHM_WORKER_H_
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/notification.h"
 
 namespace tensorflow {
 
@@ -30,7 +31,9 @@ void TensorResponse::Clear() {
   device_ = nullptr;
   alloc_attrs_ = AllocatorAttributes();
   allocator_ = nullptr;
+  staging_allocator_ = nullptr;
   already_used_ = false;
+  chunk_offset_ = -1;
   ClearTensor();
 }
 
@@ -48,12 +51,38 @@ void TensorResponse::InitAlloc(DeviceBase* d, const AllocatorAttributes& aa) {
     on_host_ = true;
   }
   allocator_ = device_->GetAllocator(alloc_attrs_);
+  if (!on_host_) {
+    const DeviceBase::GpuDeviceInfo* info = d->tensorflow_gpu_device_info();
+    if (info != nullptr && info->default_context != nullptr) {
+      AllocatorAttributes staging_attrs;
+      staging_attrs.set_on_host(true);
+      staging_attrs.set_gpu_compatible(true);
+      staging_allocator_ = device_->GetAllocator(staging_attrs);
+    }
+  }
+}
+
+void TensorResponse::InitChunk(const Tensor& tensor, int64 offset) {
+  Clear();
+  tensor_ = tensor;
+  chunk_offset_ = offset;
 }
 
 Status TensorResponse::InitFrom(RecvTensorResponse* response) {
   Status s;
   meta_.Swap(response);
-  if (on_host_) {
+  if (chunk_offset_ >= 0) {
+    const string& content = meta_.tensor().tensor_content();
+    StringPiece buf = tensor_.tensor_data();
+    if (meta_.tensor().dtype() != tensor_.dtype() ||
+        chunk_offset_ + static_cast<int64>(content.size()) >
+            static_cast<int64>(buf.size())) {
+      s = errors::InvalidArgument("Cannot parse tensor chunk from response");
+    } else {
+      memcpy(const_cast<char*>(buf.data()) + chunk_offset_, content.data(),
+             content.size());
+    }
+  } else if (on_host_) {
     if (!tensor_.FromProto(allocator_, meta_.tensor())) {
       s = errors::InvalidArgument("Cannot parse tensor from response");
     }
@@ -79,34 +108,71 @@ void TensorResponse::InitPartial(const RecvTensorResponse& response) {
 }
 
 Status TensorResponse::ParseFrom(Source* source) {
-  if (!on_host_) {
-    protobuf::io::CodedInputStream input(source->contents());
-    input.SetTotalBytesLimit(INT_MAX, INT_MAX);  // Unlimited
-
-    // Pre-parse into local storage, then delegate to device.
-    if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
-      return errors::InvalidArgument("Cannot parse tensor from response");
-    }
-    Status s =
-        device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
-    // Reduce memory usage for big tensors.
-    {
-      TensorProto empty;
-      meta_.mutable_tensor()->Swap(&empty);
-    }
-    meta_.clear_tensor();
-    return s;
+  if (chunk_offset_ >= 0) {
+    if (ParseFast(source, nullptr)) return Status::OK();
+    return errors::InvalidArgument("Cannot parse tensor chunk from response");
   }
   if (already_used_) {
     ClearTensor();
   }
   already_used_ = true;
-  if (ParseFast(source)) return Status::OK();
+  if (!on_host_) {
+    if (staging_allocator_ != nullptr &&
+        ParseFast(source, staging_allocator_)) {
+      return CopyStagedTensorToDevice();
+    }
+    meta_.Clear();
+    return ParseViaTensorProto(source);
+  }
+  if (ParseFast(source, allocator_)) return Status::OK();
   meta_.Clear();
   if (ParseSlow(source)) return Status::OK();
   return errors::InvalidArgument("Cannot parse tensor from response");
 }
 
+Status TensorResponse::ParseViaTensorProto(Source* source) {
+  protobuf::io::CodedInputStream input(source->contents());
+  input.SetTotalBytesLimit(INT_MAX, INT_MAX);  // Unlimited
+
+  // Pre-parse into local storage, then delegate to device.
+  if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
+    return errors::InvalidArgument("Cannot parse tensor from response");
+  }
+  Status s =
+      device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
+  // Reduce memory usage for big tensors.
+  {
+    TensorProto empty;
+    meta_.mutable_tensor()->Swap(&empty);
+  }
+  meta_.clear_tensor();
+  return s;
+}
+
+Status TensorResponse::CopyStagedTensorToDevice() {
+  Tensor staged = std::move(tensor_);
+  Tensor copy(allocator_, staged.dtype(), staged.shape());
+  if (!copy.IsInitialized()) {
+    return errors::ResourceExhausted(
+        "OOM when allocating tensor of shape ", staged.shape().DebugString(),
+        " and type ", DataTypeString(staged.dtype()));
+  }
+  // Only a Device can have a GPU device context, see InitAlloc().
+  Device* device = static_cast<Device*>(device_);
+  Notification n;
+  Status status;
+  device_->tensorflow_gpu_device_info()->default_context->CopyCPUTensorToDevice(
+      &staged, device, &copy, [&n, &status](const Status& s) {
+        status = s;
+        n.Notify();
+      });
+  n.WaitForNotification();
+  if (status.ok()) {
+    tensor_ = std::move(copy);
+  }
+  return status;
+}
+
 // Define some helper routines for decoding protocol buffer wire format data
 namespace {
 // We only need some of the wiretype values for this code
@@ -144,7 +210,8 @@ bool ReadNestedMessage(protobuf::io::CodedInputStream* input,
 }  // namespace
 
 bool TensorResponse::ParseTensorSubmessage(
-    protobuf::io::CodedInputStream* input, TensorProto* tensor_meta) {
+    protobuf::io::CodedInputStream* input, TensorProto* tensor_meta,
+    Allocator* allocator) {
   bool seen_tensor_content = false;
   while (true) {
     auto p = input->ReadTagWithCutoff(127);
@@ -152,10 +219,10 @@ bool TensorResponse::ParseTensorSubmessage(
     WireType wt = GetTagWireType(p.first);
     if (!p.second) {
       bool ok = (tag == 0);
-      if (ok && !seen_tensor_content) {
+      if (ok && !seen_tensor_content && chunk_offset_ < 0) {
         // No tensor content: could be because it's a zero-length tensor
         TensorShape shape(tensor_meta->tensor_shape());
-        Tensor t(allocator_, tensor_meta->dtype(), shape);
+        Tensor t(allocator, tensor_meta->dtype(), shape);
         tensor_ = std::move(t);
       }
       return ok;
@@ -194,8 +261,21 @@ bool TensorResponse::ParseTensorSubmessage(
         int num_bytes;
         if (!ReadVarintSizeAsInt(input, &num_bytes)) return false;
         seen_tensor_content = true;
+        if (chunk_offset_ >= 0) {
+          // Copy the chunk into place in the tensor being received.
+          StringPiece buf = tensor_.tensor_data();
+          if (tensor_meta->dtype() != tensor_.dtype() ||
+              chunk_offset_ + num_bytes > static_cast<int64>(buf.size())) {
+            return false;
+          }
+          if (!input->ReadRaw(const_cast<char*>(buf.data()) + chunk_offset_,
+                              num_bytes)) {
+            return false;
+          }
+          break;
+        }
         TensorShape shape(tensor_meta->tensor_shape());
-        Tensor t(allocator_, tensor_meta->dtype(), shape);
+        Tensor t(allocator, tensor_meta->dtype(), shape);
         StringPiece buf = t.tensor_data();
         if (static_cast<size_t>(num_bytes) != buf.size()) return false;
         // TODO(jeff,sanjay): Figure out a way to avoid this copy if
@@ -215,7 +295,7 @@ bool TensorResponse::ParseTensorSubmessage(
   }
 }
 
-bool TensorResponse::ParseFast(Source* source) {
+bool TensorResponse::ParseFast(Source* source, Allocator* allocator) {
   protobuf::io::CodedInputStream input(source->contents());
   input.SetTotalBytesLimit(INT_MAX, INT_MAX);  // Unlimited
   while (true) {
@@ -234,7 +314,8 @@ bool TensorResponse::ParseFast(Source* source) {
         std::pair<protobuf::io::CodedInputStream::Limit, int> p =
             input.IncrementRecursionDepthAndPushLimit(length);
         if (p.second < 0 ||
-            !ParseTensorSubmessage(&input, meta_.mutable_tensor())) {
+            !ParseTensorSubmessage(&input, meta_.mutable_tensor(),
+                                    allocator)) {
           return false;
         }
         if (!input.DecrementRecursionDepthAndPopLimit(p.first)) {
@@ -46,6 +46,12 @@ class TensorResponse {
   // Initialize memory allocation related members.
   void InitAlloc(DeviceBase* d, const AllocatorAttributes& aa);
 
+  // Prepare to receive a chunk of the content of 'tensor', which must be
+  // on the host and of a type that can be memcpy'd.  The chunk is a
+  // response holding a 1-D slice of the flattened tensor; its content is
+  // copied into the buffer of 'tensor' starting at byte 'offset'.
+  void InitChunk(const Tensor& tensor, int64 offset);
+
   // Source provides a way for a particular RPC implementation to provide
   // received data to ParseFrom.
   class Source {
@@ -68,6 +74,11 @@ class TensorResponse {
 
   // Parse the RecvTensorResponse encoded in the data yielded by
   // source->contents() into *this.
+  //
+  // Tensor content is read straight from the source into the tensor's
+  // buffer.  For a device with a GPU device context that buffer is staged
+  // in host memory the device can DMA from, and then copied to the device,
+  // so that the content is never held in an intermediate TensorProto.
   Status ParseFrom(Source* source);
 
   // Initialize tensor from *response.
@@ -89,15 +100,22 @@ class TensorResponse {
 
  private:
   bool ParseTensorSubmessage(protobuf::io::CodedInputStream* input,
-                             TensorProto* tensor_meta);
-  bool ParseFast(Source* source);
+                             TensorProto* tensor_meta, Allocator* allocator);
+  bool ParseFast(Source* source, Allocator* allocator);
   bool ParseSlow(Source* source);
+  Status ParseViaTensorProto(Source* source);
+  Status CopyStagedTensorToDevice();
 
   bool on_host_ = false;
   DeviceBase* device_ = nullptr;
   AllocatorAttributes alloc_attrs_;
   Allocator* allocator_ = nullptr;
+  // If non-null, content destined for device_ is staged in host memory
+  // from this allocator.
+  Allocator* staging_allocator_ = nullptr;
   bool already_used_ = false;
+  // Byte offset in tensor_ of the chunk being received, or -1.
+  int64 chunk_offset_ = -1;
   Tensor tensor_;
   RecvTensorResponse meta_;
 };
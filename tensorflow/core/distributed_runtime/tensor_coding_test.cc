@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 
+#include <algorithm>
+
+#include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
@@ -46,6 +50,62 @@ class DummyDevice : public DeviceBase {
   DeviceAttributes attr_;
 };
 
+// A device with a GPU device context, whose memory is host memory.  Counts
+// the tensors copied to it through the device context.
+class FakeGpuDevice : public Device {
+ public:
+  class Context : public DeviceContext {
+   public:
+    void CopyCPUTensorToDevice(const Tensor* cpu_tensor, Device* device,
+                               Tensor* device_tensor,
+                               StatusCallback done) const override {
+      ++num_copies;
+      StringPiece from = cpu_tensor->tensor_data();
+      memcpy(const_cast<char*>(device_tensor->tensor_data().data()),
+             from.data(), from.size());
+      done(Status::OK());
+    }
+    mutable int num_copies = 0;
+  };
+
+  explicit FakeGpuDevice(Env* env) : Device(env, Attributes()) {
+    context_ = new Context;
+    gpu_device_info_.default_context = context_;
+    set_tensorflow_gpu_device_info(&gpu_device_info_);
+  }
+  ~FakeGpuDevice() override { context_->Unref(); }
+
+  Status Sync() override { return Status::OK(); }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+  Status MakeTensorFromProto(const TensorProto& tensor_proto,
+                             const AllocatorAttributes alloc_attrs,
+                             Tensor* tensor) override {
+    ++num_protos;
+    if (!tensor->FromProto(cpu_allocator(), tensor_proto)) {
+      return errors::InvalidArgument("Cannot parse tensor from proto");
+    }
+    return Status::OK();
+  }
+
+  int num_copies() const { return context_->num_copies; }
+  int num_protos = 0;
+
+ private:
+  static DeviceAttributes Attributes() {
+    DeviceAttributes attr;
+    attr.set_name("/job:a/replica:0/task:0/device:GPU:0");
+    attr.set_device_type("GPU");
+    return attr;
+  }
+
+  Context* context_;
+  GpuDeviceInfo gpu_device_info_;
+};
+
 class StringSource : public TensorResponse::Source {
  public:
   explicit StringSource(const string* s, int block_size)
@@ -156,6 +216,81 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(TensorResponseTest, StagesDeviceTensorInHostMemory) {
+  FakeGpuDevice gpu_device(Env::Default());
+  TensorResponse response;
+  response.InitAlloc(&gpu_device, AllocatorAttributes());
+  for (int elems : {0, 1, 1000, 100000}) {
+    Tensor src(DT_FLOAT, TensorShape({2, elems}));
+    test::FillFn<float>(&src, [](int i) { return i * 0.5f; });
+    RecvTensorResponse proto;
+    proto.set_send_start_micros(123456);
+    src.AsProtoTensorContent(proto.mutable_tensor());
+    string encoded;
+    proto.AppendToString(&encoded);
+
+    StringSource source(&encoded, 1024);
+    const int copies_before = gpu_device.num_copies();
+    TF_EXPECT_OK(response.ParseFrom(&source));
+    EXPECT_EQ(copies_before + 1, gpu_device.num_copies());
+    EXPECT_EQ(0, gpu_device.num_protos);
+    EXPECT_EQ(123456, response.metadata().send_start_micros());
+    test::ExpectTensorEqual<float>(src, response.tensor());
+  }
+
+  // Tensors the fast path can't parse still go through the device.
+  Tensor src = test::AsTensor<string>({"a", "bc"}, TensorShape({2}));
+  RecvTensorResponse proto;
+  src.AsProtoTensorContent(proto.mutable_tensor());
+  string encoded;
+  proto.AppendToString(&encoded);
+  StringSource source(&encoded, 1024);
+  TF_EXPECT_OK(response.ParseFrom(&source));
+  EXPECT_EQ(1, gpu_device.num_protos);
+  test::ExpectTensorEqual<string>(src, response.tensor());
+}
+
+TEST_F(TensorResponseTest, Chunks) {
+  Tensor src(DT_INT32, TensorShape({10, 1000}));
+  test::FillIota<int32>(&src, 0);
+  Tensor flat;
+  ASSERT_TRUE(flat.CopyFrom(src, TensorShape({src.NumElements()})));
+
+  Tensor dst(DT_INT32, src.shape());
+  const int64 kChunkElems = 3000;
+  for (int64 begin = 0; begin < src.NumElements(); begin += kChunkElems) {
+    const int64 end = std::min(begin + kChunkElems, src.NumElements());
+    RecvTensorResponse proto;
+    flat.Slice(begin, end).AsProtoTensorContent(proto.mutable_tensor());
+    string encoded;
+    proto.AppendToString(&encoded);
+
+    // Alternate between parsing and initializing from the proto.
+    TensorResponse response;
+    response.InitChunk(dst, begin * sizeof(int32));
+    if (begin % (2 * kChunkElems) == 0) {
+      StringSource source(&encoded, 1024);
+      TF_EXPECT_OK(response.ParseFrom(&source));
+    } else {
+      TF_EXPECT_OK(response.InitFrom(&proto));
+    }
+  }
+  test::ExpectTensorEqual<int32>(src, dst);
+
+  // A chunk must fit within the tensor and match its type.
+  RecvTensorResponse proto;
+  flat.Slice(0, kChunkElems).AsProtoTensorContent(proto.mutable_tensor());
+  string encoded;
+  proto.AppendToString(&encoded);
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  response.InitChunk(dst, (src.NumElements() - 1) * sizeof(int32));
+  EXPECT_FALSE(response.ParseFrom(&source).ok());
+  Tensor float_dst(DT_FLOAT, src.shape());
+  response.InitChunk(float_dst, 0);
+  EXPECT_FALSE(response.ParseFrom(&source).ok());
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
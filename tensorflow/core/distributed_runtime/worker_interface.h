@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/call_options.h"
 #include "tensorflow/core/distributed_runtime/message_wrappers.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/types.h"
@@ -106,6 +107,16 @@ class WorkerInterface {
                                TensorResponse* response,
                                StatusCallback done) = 0;
 
+  // Receives several tensors of a step at once; see worker.proto.  Not all
+  // workers support it, so callers must handle an Unimplemented error by
+  // falling back to RecvTensorAsync.
+  virtual void RecvTensorsAsync(CallOptions* opts,
+                                const RecvTensorsRequest* request,
+                                RecvTensorsResponse* response,
+                                StatusCallback done) {
+    done(errors::Unimplemented("RecvTensors is not supported by this worker"));
+  }
+
   virtual void LoggingAsync(const LoggingRequest* request,
                             LoggingResponse* response, StatusCallback done) = 0;
 
@@ -39,6 +39,7 @@ CollInstanceParams& CollInstanceParams::operator=(
     device_names.assign(other.device_names.begin(), other.device_names.end());
     task_names.assign(other.task_names.begin(), other.task_names.end());
     same_num_devices_per_task = other.same_num_devices_per_task;
+    compression = other.compression;
     impl_details.subdiv_offsets.assign(
         other.impl_details.subdiv_offsets.begin(),
         other.impl_details.subdiv_offsets.end());
@@ -50,6 +51,7 @@ CollInstanceParams& CollInstanceParams::operator=(
     impl_details.subdiv_source_rank.assign(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
+    impl_details.reduction_algorithm = other.impl_details.reduction_algorithm;
   }
   return *this;
 }
@@ -57,7 +59,8 @@ CollInstanceParams& CollInstanceParams::operator=(
 string CollInstanceParams::ToString() const {
   string v = strings::StrCat("CollInstanceParams { instance_key=", instance_key,
                              " type=", type, " data_type=", data_type,
-                             " shape=", shape.DebugString(), " devices {");
+                             " shape=", shape.DebugString(),
+                             " compression=", compression, " devices {");
   for (const auto& d : device_names) {
     strings::StrAppend(&v, d, ",");
   }
@@ -85,6 +88,8 @@ string CollInstanceParams::ToString() const {
     strings::StrAppend(&v, "}");
   }
   strings::StrAppend(&v, "}");  // all subdivs
+  strings::StrAppend(&v, " reduction_algorithm=",
+                     impl_details.reduction_algorithm);
   return v;
 }
 
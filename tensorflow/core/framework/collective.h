@@ -43,6 +43,23 @@ enum CollectiveType {
   UNDEFINED_COLLECTIVE,
 };
 
+// Encodings a reduction may use for the values it moves between devices,
+// trading accuracy for bandwidth.  Only supported for DT_FLOAT on CPU.
+enum CollectiveCompression {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_FP16,  // IEEE half precision.
+  COMPRESSION_BF16,  // bfloat16: float32 exponent range, 8-bit mantissa.
+  COMPRESSION_INT8,  // 8-bit linear quantization, scaled per chunk.
+};
+
+// Algorithms that may carry out a reduction.
+enum CollectiveReductionAlgorithm {
+  REDUCTION_RING = 0,
+  // Reduce within each task, all-reduce across tasks, then gather within
+  // each task.  Requires the same number of devices in every task.
+  REDUCTION_HIERARCHICAL,
+};
+
 // Data common to all members of a device group.
 // All members share the same device set but its order is
 // particular to an instance so it is stored there.
@@ -68,6 +85,8 @@ struct CollImplDetails {
   std::vector<int> subdiv_offsets;
   // broadcast only: rank of source in each subdiv
   std::vector<int> subdiv_source_rank;
+  // reduction only: algorithm used to move the data.
+  CollectiveReductionAlgorithm reduction_algorithm = REDUCTION_RING;
 };
 
 // Data common to all members of a collective instance.
@@ -83,6 +102,8 @@ struct CollInstanceParams {
   std::vector<string> task_names;
   // True if every task has the same number of devices.
   bool same_num_devices_per_task = false;
+  // reduction only: encoding of the values sent between devices.
+  CollectiveCompression compression = COMPRESSION_NONE;
   CollImplDetails impl_details;
   string ToString() const;
   CollInstanceParams& operator=(const struct CollInstanceParams& other);
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_RESOURCE_VAR_H_
 #define TENSORFLOW_CORE_FRAMEWORK_RESOURCE_VAR_H_
 
+#include <vector>
+
 #include "tensorflow/core/framework/resource_mgr.h"
 
 namespace tensorflow {
@@ -46,10 +48,61 @@ class Var : public ResourceBase {
   bool is_initialized = false;  // GUARDED_BY(mu_) but annotalysis doesn't like
                                 // it.
 
+  // Dirty-row tracking, used to write delta checkpoints that hold only the
+  // rows (slices along dimension 0) of tensor() that were written since the
+  // previous save.  Tracking is off until the first call to TakeDirtyRows(),
+  // so variables that are never saved that way pay nothing.  Kernels that
+  // write the variable without holding mu() report the rows after writing
+  // them, so that a write racing with TakeDirtyRows() is reported by the
+  // next call.
+
+  // Records that all of tensor() may have changed.
+  void MarkAllRowsDirty() {
+    mutex_lock l(dirty_rows_mu_);
+    if (tracking_dirty_rows_) all_rows_dirty_ = true;
+  }
+
+  // Records that the rows in "indices", a tensor of Tindex, may have changed.
+  // "num_rows" is the number of rows of tensor(); indices outside of
+  // [0, num_rows) are ignored.
+  template <typename Tindex>
+  void MarkRowsDirty(const Tensor& indices, int64 num_rows) {
+    mutex_lock l(dirty_rows_mu_);
+    if (!tracking_dirty_rows_ || all_rows_dirty_) return;
+    if (static_cast<int64>(dirty_rows_.size()) < num_rows) {
+      dirty_rows_.resize(num_rows);
+    }
+    const auto indices_flat = indices.flat<Tindex>();
+    for (int64 i = 0; i < indices_flat.size(); ++i) {
+      const int64 row = static_cast<int64>(indices_flat(i));
+      if (row >= 0 && row < num_rows) dirty_rows_[row] = true;
+    }
+  }
+
+  // Moves the rows changed since the previous call into "rows", indexed by
+  // row, and starts tracking anew.  Returns false if the rows are not known,
+  // because tracking just started or the whole tensor may have changed; the
+  // caller must then save all of it.  "rows" may be shorter or longer than
+  // the number of rows of tensor().
+  bool TakeDirtyRows(std::vector<bool>* rows) {
+    mutex_lock l(dirty_rows_mu_);
+    const bool known = tracking_dirty_rows_ && !all_rows_dirty_;
+    rows->clear();
+    rows->swap(dirty_rows_);
+    tracking_dirty_rows_ = true;
+    all_rows_dirty_ = false;
+    return known;
+  }
+
  private:
   mutex mu_;
   Tensor tensor_;
 
+  mutex dirty_rows_mu_;
+  bool tracking_dirty_rows_ GUARDED_BY(dirty_rows_mu_) = false;
+  bool all_rows_dirty_ GUARDED_BY(dirty_rows_mu_) = false;
+  std::vector<bool> dirty_rows_ GUARDED_BY(dirty_rows_mu_);
+
   ~Var() override {}
 };
 
@@ -175,10 +175,28 @@ void AddReadControl(const std::vector<NodeDef*>& recvs,
   }
 }
 
-void SetSendRecvAttrs(const PartitionOptions& opts, const Edge* edge,
-                      NodeDefBuilder* builder) {
-  builder->Attr("tensor_name",
-                strings::StrCat("edge_", edge->id(), "_", edge->src()->name()));
+// Returns the name under which the send/recv pair for 'edge' transfers its
+// tensor. It only depends on the endpoints of the edge rather than on its id,
+// so that partitions of different client graphs sharing these endpoints stay
+// identical. Node names can't contain ':', so the names of pairs that are not
+// collapsed into one (see DupRecvKey) differ.
+string SendRecvTensorName(const GraphInfo& info, const Edge* edge) {
+  const Node* src = edge->src();
+  if (edge->IsControlEdge()) return strings::StrCat("edge_^", src->name());
+  string name = strings::StrCat("edge_", src->name(), ":", edge->src_output());
+  if (IsRefType(src->output_type(edge->src_output()))) {
+    strings::StrAppend(&name, "->", edge->dst()->name(), ":",
+                       edge->dst_input());
+  } else if (info.device_types[edge->dst()->id()] != DEVICE_CPU &&
+             IsDstInputOnHost(edge, info)) {
+    strings::StrAppend(&name, ":host");
+  }
+  return name;
+}
+
+void SetSendRecvAttrs(const PartitionOptions& opts, const GraphInfo& g_info,
+                      const Edge* edge, NodeDefBuilder* builder) {
+  builder->Attr("tensor_name", SendRecvTensorName(g_info, edge));
   builder->Attr("send_device", edge->src()->assigned_device_name());
   builder->Attr("send_device_incarnation",
                 static_cast<int64>(
@@ -225,7 +243,7 @@ NodeDef* AddSend(const PartitionOptions& opts, const GraphInfo& g_info,
   // Add the send node.
   const string send_op = (host_memory) ? "_HostSend" : "_Send";
   NodeDefBuilder send_builder(opts.new_name(src->name()), send_op);
-  SetSendRecvAttrs(opts, edge, &send_builder);
+  SetSendRecvAttrs(opts, g_info, edge, &send_builder);
   send_builder.Device(src->assigned_device_name()).Input(send_from);
   if (opts.scheduling_for_recvs) {
     send_builder.Attr("_start_time", start_time);
@@ -260,7 +278,7 @@ NodeDef* AddRecv(const PartitionOptions& opts, const GraphInfo& g_info,
   // Add the recv node.
   const string recv_op = (host_memory) ? "_HostRecv" : "_Recv";
   NodeDefBuilder recv_builder(opts.new_name(src->name()), recv_op);
-  SetSendRecvAttrs(opts, edge, &recv_builder);
+  SetSendRecvAttrs(opts, g_info, edge, &recv_builder);
   recv_builder.Device(dst->assigned_device_name())
       .Attr("tensor_type", cast_dtype);
   NodeDef* recv = gdef->add_node();
@@ -87,6 +87,23 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
                     "final_op must be one of {\"Id\", \"Div\"} but got ",
                     final_op_name));
     OP_REQUIRES_OK(c, c->GetAttr("T", &col_params_.instance.data_type));
+    string compression;
+    OP_REQUIRES_OK(c, c->GetAttr("compression", &compression));
+    if (compression == "fp16") {
+      col_params_.instance.compression = COMPRESSION_FP16;
+    } else if (compression == "bf16") {
+      col_params_.instance.compression = COMPRESSION_BF16;
+    } else if (compression == "int8") {
+      col_params_.instance.compression = COMPRESSION_INT8;
+    }
+    OP_REQUIRES(c,
+                col_params_.instance.compression == COMPRESSION_NONE ||
+                    (col_params_.instance.data_type == DT_FLOAT &&
+                     c->device_type() == DEVICE_CPU),
+                errors::InvalidArgument(
+                    "compression is only supported for float on CPU, got ",
+                    DataTypeString(col_params_.instance.data_type), " on ",
+                    c->device_type().type()));
 
     const NodeDef& real_node = c->def();
     col_params_.name = strings::StrCat(real_node.name(), ": Reduce(",
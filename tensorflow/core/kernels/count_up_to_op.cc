@@ -90,6 +90,7 @@ class ResourceCountUpToOp : public OpKernel {
                                 dtype_, TensorShape({}), &unused, &tmp, attr));
     *variable->tensor() = *tmp;
     tmp->scalar<T>()() = before_increment.scalar<T>()() + 1;
+    variable->MarkAllRowsDirty();
     context->set_output(0, before_increment);
   }
 
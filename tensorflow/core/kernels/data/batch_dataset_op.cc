@@ -15,12 +15,17 @@ limitations under the License.
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/util/batch_util.h"
 
 namespace tensorflow {
 
 namespace {
 
+// Batches whose total size (summed across components) is at least this many
+// bytes have their per-element copies scheduled in parallel.
+constexpr int64 kParallelCopyThresholdBytes = 1 << 20;  // 1MB
+
 // See documentation in ../ops/dataset_ops.cc for a high-level
 // description of the following op.
 
@@ -147,13 +152,12 @@ class BatchDatasetOp : public UnaryDatasetOpKernel {
           const Tensor& first_element = batch_elements[0][component_index];
           TensorShape batch_component_shape({num_batch_elements});
           batch_component_shape.AppendShape(first_element.shape());
-          Tensor batch_component(ctx->allocator({}), first_element.dtype(),
-                                 batch_component_shape);
-          // Build the output tuple component by copying one slice
-          // from each input element in the batch.
+          out_tensors->emplace_back(ctx->allocator({}), first_element.dtype(),
+                                    batch_component_shape);
           for (size_t i = 0; i < num_batch_elements; ++i) {
             if (batch_elements[i][component_index].shape() !=
                 first_element.shape()) {
+              out_tensors->clear();
               return errors::InvalidArgument(
                   "Cannot batch tensors with different shapes in component ",
                   component_index, ". First element had shape ",
@@ -162,11 +166,54 @@ class BatchDatasetOp : public UnaryDatasetOpKernel {
                   batch_elements[i][component_index].shape().DebugString(),
                   ".");
             }
-            TF_RETURN_IF_ERROR(batch_util::CopyElementToSlice(
-                std::move(batch_elements[i][component_index]), &batch_component,
-                i));
           }
-          out_tensors->emplace_back(std::move(batch_component));
+        }
+
+        // Build each output tuple component by copying one slice from each
+        // input element in the batch. Slices are disjoint, so for large
+        // batches the copies are spread across the inter-op threadpool.
+        auto copy_element = [&batch_elements, out_tensors](
+                                size_t component_index, int64 i) {
+          return batch_util::CopyElementToSlice(
+              std::move(batch_elements[i][component_index]),
+              &(*out_tensors)[component_index], i);
+        };
+        int64 total_bytes = 0;
+        for (const Tensor& t : *out_tensors) {
+          total_bytes += t.TotalBytes();
+        }
+        if (total_bytes < kParallelCopyThresholdBytes ||
+            num_batch_elements == 1) {
+          for (size_t component_index = 0;
+               component_index < num_tuple_components; ++component_index) {
+            for (int64 i = 0; i < num_batch_elements; ++i) {
+              Status s = copy_element(component_index, i);
+              if (!s.ok()) {
+                out_tensors->clear();
+                return s;
+              }
+            }
+          }
+        } else {
+          std::vector<Status> statuses(num_batch_elements);
+          BlockingCounter counter(num_batch_elements);
+          for (int64 i = 0; i < num_batch_elements; ++i) {
+            (*ctx->runner())([&copy_element, &statuses, &counter,
+                              num_tuple_components, i]() {
+              for (size_t component_index = 0;
+                   component_index < num_tuple_components; ++component_index) {
+                statuses[i].Update(copy_element(component_index, i));
+              }
+              counter.DecrementCount();
+            });
+          }
+          counter.Wait();
+          for (const Status& s : statuses) {
+            if (!s.ok()) {
+              out_tensors->clear();
+              return s;
+            }
+          }
         }
         *end_of_sequence = false;
         return Status::OK();
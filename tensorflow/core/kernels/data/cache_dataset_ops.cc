@@ -12,6 +12,8 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <deque>
+
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/dataset.h"
@@ -212,6 +214,12 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
       bool iteration_completed_ GUARDED_BY(mu_);
     };  // FileWriterIterator
 
+    // FileReaderIterator produces the elements of a previously written cache.
+    //
+    // Reading from the bundle (file I/O, checksumming and tensor
+    // deserialization) happens on a background thread that stays up to
+    // `kReadAheadElements` elements ahead of the consumer, so that subsequent
+    // epochs are not serialized on the latency of each individual read.
     class FileReaderIterator : public DatasetIterator<FileDataset> {
      public:
       explicit FileReaderIterator(const Params& params)
@@ -219,40 +227,130 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
             cur_index_(0),
             reader_(dataset()->env_, dataset()->filename_) {}
 
+      ~FileReaderIterator() override {
+        // Signal the read-ahead thread to terminate. It is joined when
+        // `read_ahead_thread_` is destroyed.
+        mutex_lock l(mu_);
+        cancelled_ = true;
+        cond_var_.notify_all();
+      }
+
       Status GetNextInternal(IteratorContext* ctx,
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
         mutex_lock l(mu_);
         *end_of_sequence = false;
-        TF_RETURN_IF_ERROR(reader_.status());
-        if (!reader_.Valid()) {
+        EnsureReadAheadThreadStarted(ctx);
+        while (buffer_.empty() && !read_ahead_finished_) {
+          cond_var_.wait(l);
+        }
+        if (buffer_.empty()) {
+          // Keep reporting the error that stopped the read-ahead thread.
+          TF_RETURN_IF_ERROR(read_ahead_status_);
           return errors::Internal(
               "Cache iterator is in an invalid state. (Perhaps GetNext called "
               "after end_of_sequence?)");
         }
-        out_tensors->clear();
-        out_tensors->resize(dataset()->num_tensors_);
+        BufferElement element = std::move(buffer_.front());
+        buffer_.pop_front();
+        cond_var_.notify_all();
+        if (element.end_of_sequence) {
+          out_tensors->clear();
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        TF_RETURN_IF_ERROR(element.status);
+        *out_tensors = std::move(element.value);
+        return Status::OK();
+      }
+
+     private:
+      struct BufferElement {
+        Status status;
+        std::vector<Tensor> value;
+        bool end_of_sequence = false;
+      };
+
+      void EnsureReadAheadThreadStarted(IteratorContext* ctx)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (!read_ahead_thread_) {
+          read_ahead_thread_.reset(ctx->env()->StartThread(
+              {}, "cache_read_ahead_thread",
+              std::bind(&FileReaderIterator::ReadAheadThread, this)));
+        }
+      }
 
+      // Reads the next element from `reader_`. Only called from the
+      // read-ahead thread, which is the sole user of `reader_` and
+      // `cur_index_` once it has been started.
+      BufferElement ReadNextElement() {
+        BufferElement element;
+        element.status = reader_.status();
+        if (!element.status.ok()) return element;
+        if (!reader_.Valid()) {
+          element.status = errors::Internal(
+              "Cache iterator is in an invalid state. (Perhaps GetNext called "
+              "after end_of_sequence?)");
+          return element;
+        }
+        element.value.resize(dataset()->num_tensors_);
         for (size_t i = 0; i < dataset()->num_tensors_; ++i) {
           reader_.Next();  // The first entry in the table is a header entry.
           if (!reader_.Valid()) {
-            out_tensors->clear();
-            *end_of_sequence = true;
-            return Status::OK();
+            element.value.clear();
+            element.end_of_sequence = true;
+            return element;
           }
           StringPiece key = reader_.key();
           DCHECK_EQ(key, dataset()->FormatName(cur_index_, i));
-          TF_RETURN_IF_ERROR(reader_.ReadCurrent(&(*out_tensors)[i]));
-          TF_RETURN_IF_ERROR(reader_.status());
+          element.status = reader_.ReadCurrent(&element.value[i]);
+          if (element.status.ok()) element.status = reader_.status();
+          if (!element.status.ok()) {
+            element.value.clear();
+            return element;
+          }
         }
         cur_index_++;
-        return Status::OK();
+        return element;
       }
 
-     private:
+      void ReadAheadThread() {
+        while (true) {
+          {
+            mutex_lock l(mu_);
+            while (!cancelled_ && buffer_.size() >= kReadAheadElements) {
+              cond_var_.wait(l);
+            }
+            if (cancelled_) return;
+          }
+          BufferElement element = ReadNextElement();
+          const bool done = element.end_of_sequence || !element.status.ok();
+          mutex_lock l(mu_);
+          if (done) {
+            read_ahead_finished_ = true;
+            read_ahead_status_ = element.status;
+          }
+          buffer_.push_back(std::move(element));
+          cond_var_.notify_all();
+          if (done) return;
+        }
+      }
+
+      // Maximum number of elements buffered ahead of the consumer.
+      static constexpr size_t kReadAheadElements = 16;
+
       mutex mu_;
-      size_t cur_index_ GUARDED_BY(mu_);
-      BundleReader reader_ GUARDED_BY(mu_);
+      condition_variable cond_var_;
+      size_t cur_index_;  // Owned by the read-ahead thread.
+      BundleReader reader_;  // Owned by the read-ahead thread.
+      std::deque<BufferElement> buffer_ GUARDED_BY(mu_);
+      bool read_ahead_finished_ GUARDED_BY(mu_) = false;
+      // The error that stopped the read-ahead thread, if any.
+      Status read_ahead_status_ GUARDED_BY(mu_);
+      bool cancelled_ GUARDED_BY(mu_) = false;
+      // Must be declared last so that the thread is joined before the state
+      // it accesses is destroyed.
+      std::unique_ptr<Thread> read_ahead_thread_ GUARDED_BY(mu_);
     };  // FileReaderIterator
 
     const DatasetBase* const input_;
@@ -21,12 +21,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/captured_function.h"
 #include "tensorflow/core/kernels/data/dataset.h"
-#include "tensorflow/core/kernels/inplace_ops_functor.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/tracing.h"
+#include "tensorflow/core/util/batch_util.h"
 
 namespace tensorflow {
 
@@ -97,7 +97,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
 
     *output = new Dataset(ctx, input, batch_size, num_parallel_calls,
                           drop_remainder, output_types_, output_shapes_, func_,
-                          std::move(captured_func), &ctx->eigen_cpu_device());
+                          std::move(captured_func));
   }
 
  private:
@@ -108,8 +108,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
             const DataTypeVector& output_types,
             const std::vector<PartialTensorShape>& output_shapes,
             const NameAttrList& func,
-            std::unique_ptr<CapturedFunction> captured_func,
-            const Eigen::ThreadPoolDevice* device)
+            std::unique_ptr<CapturedFunction> captured_func)
         : GraphDatasetBase(ctx),
           input_(input),
           batch_size_(batch_size),
@@ -118,8 +117,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
           output_types_(output_types),
           output_shapes_(output_shapes),
           map_fn_(func),
-          captured_func_(std::move(captured_func)),
-          device_(device) {
+          captured_func_(std::move(captured_func)) {
       input_->Ref();
     }
 
@@ -307,7 +305,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
         if (status.ok()) {
           EnsureOutputAllocated(ctx, result, return_values);
           for (size_t i = 0; i < return_values->size(); ++i) {
-            const Tensor& tensor = return_values->at(i);
+            Tensor& tensor = return_values->at(i);
             Tensor* batch = &(result->output)[i];
             if (tensor.NumElements() !=
                 (batch->NumElements() / batch->dim_size(0))) {
@@ -320,10 +318,12 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
                   ", [batch]: ", batch_shape.DebugString()));
               break;
             }
-            // TODO(mrry): Add a version of DoParallelConcat that allows us to
-            // move `tensor` where possible, to speed up string tensor batching.
-            Status copy_status = ::tensorflow::functor::DoParallelConcat(
-                *dataset()->device_, tensor, offset, batch);
+            // The function's return value is not referenced elsewhere, so
+            // moving it lets `CopyElementToSlice()` move string and variant
+            // elements into the batch and release the per-element buffer as
+            // soon as its slice has been filled.
+            Status copy_status = batch_util::CopyElementToSlice(
+                std::move(tensor), batch, offset);
             if (!copy_status.ok()) {
               result->UpdateStatus(copy_status);
               break;
@@ -674,7 +674,6 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
     const std::vector<PartialTensorShape> output_shapes_;
     const NameAttrList map_fn_;
     const std::unique_ptr<CapturedFunction> captured_func_;
-    const Eigen::ThreadPoolDevice* device_;  // not owned
   };
 
   const int graph_def_version_;
@@ -15,9 +15,11 @@ limitations under the License.
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
+#include "tensorflow/core/lib/io/readahead_random_access_file.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
@@ -215,8 +217,19 @@ class TextLineDatasetOp : public DatasetOpKernel {
         // Actually move on to next file.
         TF_RETURN_IF_ERROR(env->NewRandomAccessFile(
             dataset()->filenames_[current_file_index_], &file_));
+        // Both the BufferedInputStream and the ZlibInputStream read the file
+        // sequentially in chunks of input_buffer_size bytes, so read the next
+        // chunk in the background while lines are split out of the current
+        // one.
+        if (!readahead_thread_pool_) {
+          readahead_thread_pool_.reset(new thread::ThreadPool(
+              env, "text_line_dataset_readahead", kReadaheadBlocks));
+        }
+        readahead_file_.reset(new io::ReadaheadRandomAccessFile(
+            file_.get(), dataset()->options_.input_buffer_size,
+            kReadaheadBlocks, readahead_thread_pool_.get()));
         input_stream_.reset(
-            new io::RandomAccessInputStream(file_.get(), false));
+            new io::RandomAccessInputStream(readahead_file_.get(), false));
 
         if (dataset()->use_compression_) {
           zlib_input_stream_.reset(new io::ZlibInputStream(
@@ -238,10 +251,15 @@ class TextLineDatasetOp : public DatasetOpKernel {
         input_stream_.reset();
         zlib_input_stream_.reset();
         buffered_input_stream_.reset();
+        readahead_file_.reset();
         file_.reset();
       }
 
       mutex mu_;
+      // Reads ahead on threads of its own rather than on the device's
+      // compute pool, which blocking file reads would hold up.
+      std::unique_ptr<thread::ThreadPool> readahead_thread_pool_
+          GUARDED_BY(mu_);  // must outlive readahead_file_
       std::unique_ptr<io::RandomAccessInputStream> input_stream_
           GUARDED_BY(mu_);
       std::unique_ptr<io::ZlibInputStream> zlib_input_stream_ GUARDED_BY(mu_);
@@ -249,9 +267,13 @@ class TextLineDatasetOp : public DatasetOpKernel {
           GUARDED_BY(mu_);
       size_t current_file_index_ GUARDED_BY(mu_) = 0;
       std::unique_ptr<RandomAccessFile> file_
+          GUARDED_BY(mu_);  // must outlive readahead_file_
+      std::unique_ptr<RandomAccessFile> readahead_file_
           GUARDED_BY(mu_);  // must outlive input_stream_
     };
 
+    static const int64 kReadaheadBlocks = 1;
+
     const std::vector<string> filenames_;
     const string compression_type_;
     const bool use_compression_;
@@ -498,7 +520,11 @@ REGISTER_KERNEL_BUILDER(Name("FixedLengthRecordDataset").Device(DEVICE_CPU),
 
 class TFRecordDatasetOp : public DatasetOpKernel {
  public:
-  using DatasetOpKernel::DatasetOpKernel;
+  explicit TFRecordDatasetOp(OpKernelConstruction* ctx)
+      : DatasetOpKernel(ctx) {
+    OP_REQUIRES_OK(
+        ctx, ctx->GetAttr("verify_data_checksum", &verify_data_checksum_));
+  }
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase** output) override {
     const Tensor* filenames_tensor;
@@ -524,22 +550,27 @@ class TFRecordDatasetOp : public DatasetOpKernel {
                 errors::InvalidArgument(
                     "`buffer_size` must be >= 0 (0 == no buffering)"));
 
-    *output =
-        new Dataset(ctx, std::move(filenames), compression_type, buffer_size);
+    *output = new Dataset(ctx, std::move(filenames), compression_type,
+                          buffer_size, verify_data_checksum_);
   }
 
  private:
   class Dataset : public GraphDatasetBase {
    public:
     explicit Dataset(OpKernelContext* ctx, std::vector<string> filenames,
-                     const string& compression_type, int64 buffer_size)
+                     const string& compression_type, int64 buffer_size,
+                     bool verify_data_checksum)
         : GraphDatasetBase(ctx),
           filenames_(std::move(filenames)),
           compression_type_(compression_type),
           options_(io::RecordReaderOptions::CreateRecordReaderOptions(
               compression_type)) {
+      options_.verify_data_checksum = verify_data_checksum;
       if (buffer_size > 0) {
         options_.buffer_size = buffer_size;
+        // Read the next buffer from the file while records are parsed out of
+        // the current one. Each iterator sets the pool to read ahead on.
+        options_.readahead_blocks = kReadaheadBlocks;
       }
     }
 
@@ -571,8 +602,11 @@ class TFRecordDatasetOp : public DatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddScalar(compression_type_, &compression_type));
       Node* buffer_size = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(options_.buffer_size, &buffer_size));
+      AttrValue verify_data_checksum;
+      b->BuildAttrValue(options_.verify_data_checksum, &verify_data_checksum);
       TF_RETURN_IF_ERROR(b->AddDataset(
-          this, {filenames, compression_type, buffer_size}, output));
+          this, {filenames, compression_type, buffer_size},
+          {{"verify_data_checksum", verify_data_checksum}}, output));
       return Status::OK();
     }
 
@@ -658,8 +692,15 @@ class TFRecordDatasetOp : public DatasetOpKernel {
         const string& next_filename =
             dataset()->filenames_[current_file_index_];
         TF_RETURN_IF_ERROR(env->NewRandomAccessFile(next_filename, &file_));
-        reader_.reset(
-            new io::SequentialRecordReader(file_.get(), dataset()->options_));
+        io::RecordReaderOptions options = dataset()->options_;
+        if (options.readahead_blocks > 0) {
+          if (!readahead_thread_pool_) {
+            readahead_thread_pool_.reset(new thread::ThreadPool(
+                env, "tf_record_dataset_readahead", kReadaheadBlocks));
+          }
+          options.readahead_thread_pool = readahead_thread_pool_.get();
+        }
+        reader_.reset(new io::SequentialRecordReader(file_.get(), options));
         return Status::OK();
       }
 
@@ -672,16 +713,26 @@ class TFRecordDatasetOp : public DatasetOpKernel {
       mutex mu_;
       size_t current_file_index_ GUARDED_BY(mu_) = 0;
 
+      // Reads ahead on threads of its own rather than on the device's
+      // compute pool, which blocking file reads would hold up. Must outlive
+      // `reader_`.
+      std::unique_ptr<thread::ThreadPool> readahead_thread_pool_
+          GUARDED_BY(mu_);
+
       // `reader_` will borrow the object that `file_` points to, so
       // we must destroy `reader_` before `file_`.
       std::unique_ptr<RandomAccessFile> file_ GUARDED_BY(mu_);
       std::unique_ptr<io::SequentialRecordReader> reader_ GUARDED_BY(mu_);
     };
 
+    static const int64 kReadaheadBlocks = 1;
+
     const std::vector<string> filenames_;
     const string compression_type_;
     io::RecordReaderOptions options_;
   };
+
+  bool verify_data_checksum_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("TFRecordDataset").Device(DEVICE_CPU),
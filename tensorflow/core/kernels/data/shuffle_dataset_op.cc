@@ -13,15 +13,19 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <deque>
 #include <vector>
 
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/stats_aggregator.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/cpu_info.h"
 
 namespace tensorflow {
 
@@ -42,11 +46,12 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
   class ShuffleDatasetBase : public GraphDatasetBase {
    public:
     ShuffleDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
-                       int64 buffer_size, int64 count)
+                       int64 buffer_size, int64 count, bool parallel_fill)
         : GraphDatasetBase(ctx),
           input_(input),
           buffer_size_(buffer_size),
-          count_(count) {
+          count_(count),
+          parallel_fill_(parallel_fill) {
       input_->Ref();
     }
 
@@ -70,9 +75,9 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
             seed2_(seed2),
             epoch_(0),
             num_elements_(0),
+            buffer_bytes_(0),
             parent_generator_(seed, seed2),
             generator_(&parent_generator_) {
-        buffer_.reset(new std::vector<Tensor>[params.dataset->buffer_size_]);
         slices_.emplace_back(new Slice{0, 0});
       }
 
@@ -88,6 +93,15 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
           TF_RETURN_IF_ERROR(
               dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
         }
+        if (input_impl_ && dataset()->parallel_fill_) {
+          const int64 num_filled = num_elements_;
+          TF_RETURN_IF_ERROR(FillBufferInParallel(ctx));
+          if (num_elements_ > num_filled) {
+            first_call = false;
+          }
+        }
+        // Fill the rest of the buffer serially, which also moves on to the
+        // next epoch when the input is exhausted.
         while (input_impl_ && num_elements_ < dataset()->buffer_size_) {
           if (ctx->env()->NowMicros() >
               ((num_log_entries + 1) * kLogIntervalMicros) + start_micros) {
@@ -119,10 +133,7 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
                 dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
           }
           if (!end_of_input_sequence) {
-            buffer_[slices_.back()->end % dataset()->buffer_size_] =
-                std::move(input_element);
-            num_elements_++;
-            slices_.back()->end++;
+            AddToBuffer(std::move(input_element));
           } else {
             input_impl_.reset();
           }
@@ -150,10 +161,17 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
                     buffer_[slices_.front()->start % dataset()->buffer_size_]);
           slices_.front()->start++;
           num_elements_--;
+          buffer_bytes_ -= ElementBytes(*out_tensors);
         } else {
           DCHECK(input_impl_ == nullptr);
           *end_of_sequence = true;
         }
+        auto stats_aggregator = ctx->stats_aggregator();
+        if (stats_aggregator) {
+          stats_aggregator->AddScalar(
+              strings::StrCat(prefix(), "::buffer_bytes"),
+              static_cast<float>(buffer_bytes_));
+        }
         return Status::OK();
       }
 
@@ -231,7 +249,8 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
               reader->ReadScalar(full_name("slices_size"), &temp));
           slices_size = static_cast<size_t>(temp);
         }
-        buffer_.reset(new std::vector<Tensor>[dataset()->buffer_size_]);
+        buffer_.clear();
+        buffer_bytes_ = 0;
         for (size_t i = 0; i < slices_size; ++i) {
           int64 start;
           TF_RETURN_IF_ERROR(reader->ReadScalar(
@@ -240,6 +259,10 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
           TF_RETURN_IF_ERROR(reader->ReadScalar(
               full_name(strings::StrCat("slices_end_", i)), &end));
           slices_.emplace_back(new Slice{start, end});
+          // Only grow the buffer as far as the restored slices reach.
+          if (static_cast<int64>(buffer_.size()) < dataset()->buffer_size_) {
+            buffer_.resize(std::min(end, dataset()->buffer_size_));
+          }
           for (size_t j = start; j < end; ++j) {
             size_t index = j % dataset()->buffer_size_;
             int64 list_size;
@@ -252,6 +275,7 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
                   full_name(strings::StrCat("buffer_", index, "_", k)),
                   &buffer_[index][k]));
             }
+            buffer_bytes_ += ElementBytes(buffer_[index]);
           }
         }
 
@@ -271,6 +295,90 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
         int64 end;
       };
 
+      // Stores `element` at the end of the last slice. The buffer is grown
+      // lazily, so that an iterator whose input has fewer than `buffer_size`
+      // elements only pays for the slots it actually uses. It is a deque, so
+      // growing it never copies the existing slots.
+      void AddToBuffer(std::vector<Tensor>&& element)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        buffer_bytes_ += ElementBytes(element);
+        // Slots are first visited in increasing order, so a slot is either
+        // already allocated or the next one to be appended.
+        const size_t index = slices_.back()->end % dataset()->buffer_size_;
+        if (index == buffer_.size()) {
+          buffer_.emplace_back(std::move(element));
+        } else {
+          DCHECK_LT(index, buffer_.size());
+          buffer_[index] = std::move(element);
+        }
+        num_elements_++;
+        slices_.back()->end++;
+      }
+
+      // Fills the empty part of the buffer with concurrent calls to
+      // `input_impl_->GetNext()`, one per schedulable CPU. Elements are added
+      // in the order in which they arrive, so this is only used when no seed
+      // was given. Stops at the end of the current epoch, and leaves moving
+      // on to the next one to the caller.
+      Status FillBufferInParallel(IteratorContext* ctx)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const int64 num_missing = dataset()->buffer_size_ - num_elements_;
+        const int num_threads = static_cast<int>(
+            std::min<int64>(port::NumSchedulableCPUs(), num_missing));
+        if (num_threads <= 1) {
+          return Status::OK();
+        }
+        IteratorBase* const input_impl = input_impl_.get();
+        mutex fill_mu;
+        int64 num_requested = 0;
+        bool done = false;
+        Status status;
+        std::deque<std::vector<Tensor>> elements;
+        auto fill = [&]() {
+          while (true) {
+            {
+              mutex_lock l(fill_mu);
+              if (done || num_requested == num_missing) {
+                return;
+              }
+              num_requested++;
+            }
+            std::vector<Tensor> element;
+            bool end_of_input_sequence = false;
+            Status s =
+                input_impl->GetNext(ctx, &element, &end_of_input_sequence);
+            mutex_lock l(fill_mu);
+            if (!s.ok() || end_of_input_sequence) {
+              status.Update(s);
+              done = true;
+              return;
+            }
+            elements.push_back(std::move(element));
+          }
+        };
+        {
+          thread::ThreadPool pool(ctx->env(), "shuffle_fill", num_threads - 1);
+          for (int i = 0; i < num_threads - 1; ++i) {
+            pool.Schedule(fill);
+          }
+          fill();
+          // Destroying `pool` waits for the scheduled calls to return.
+        }
+        for (std::vector<Tensor>& element : elements) {
+          AddToBuffer(std::move(element));
+        }
+        return status;
+      }
+
+      // Returns the number of bytes of tensor data held by `element`.
+      static int64 ElementBytes(const std::vector<Tensor>& element) {
+        int64 bytes = 0;
+        for (const Tensor& t : element) {
+          bytes += t.TotalBytes();
+        }
+        return bytes;
+      }
+
       random::SingleSampleAdapter<random::PhiloxRandom>::ResultType Random()
           EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         num_random_samples_++;
@@ -287,12 +395,14 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
       }
 
       mutex mu_;
-      std::unique_ptr<std::vector<Tensor>[]> buffer_ GUARDED_BY(mu_);
+      std::deque<std::vector<Tensor>> buffer_ GUARDED_BY(mu_);
       std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
       const int64 seed_ GUARDED_BY(mu_);
       const int64 seed2_ GUARDED_BY(mu_);
       int64 epoch_ GUARDED_BY(mu_);
       int64 num_elements_ GUARDED_BY(mu_);
+      // Bytes of tensor data currently held in `buffer_`.
+      int64 buffer_bytes_ GUARDED_BY(mu_);
       std::deque<std::unique_ptr<Slice>> slices_ GUARDED_BY(mu_);
       random::PhiloxRandom parent_generator_ GUARDED_BY(mu_);
       random::SingleSampleAdapter<random::PhiloxRandom> generator_
@@ -303,6 +413,9 @@ class ShuffleDatasetOpBase : public UnaryDatasetOpKernel {
     const DatasetBase* const input_;
     const int64 buffer_size_;
     const int64 count_;
+    // True if the buffer may be filled out of order, because no seed was
+    // given.
+    const bool parallel_fill_;
   };
 };
 
@@ -331,18 +444,19 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
 
     // By TensorFlow convention, passing 0 for both seeds indicates
     // that the shuffling should be seeded non-deterministically.
-    if (seed == 0 && seed2 == 0) {
+    const bool parallel_fill = seed == 0 && seed2 == 0;
+    if (parallel_fill) {
       seed = random::New64();
       seed2 = random::New64();
     }
 
     int64 count = 1;
     if (reshuffle_each_iteration_) {
-      *output =
-          new ReshufflingDataset(ctx, input, buffer_size, seed, seed2, count);
+      *output = new ReshufflingDataset(ctx, input, buffer_size, seed, seed2,
+                                       count, parallel_fill);
     } else {
-      *output =
-          new FixedSeedDataset(ctx, input, buffer_size, seed, seed2, count);
+      *output = new FixedSeedDataset(ctx, input, buffer_size, seed, seed2,
+                                     count, parallel_fill);
     }
   }
 
@@ -352,8 +466,9 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
   class ReshufflingDataset : public ShuffleDatasetBase {
    public:
     ReshufflingDataset(OpKernelContext* ctx, const DatasetBase* input,
-                       int64 buffer_size, int64 seed, int64 seed2, int64 count)
-        : ShuffleDatasetBase(ctx, input, buffer_size, count),
+                       int64 buffer_size, int64 seed, int64 seed2, int64 count,
+                       bool parallel_fill)
+        : ShuffleDatasetBase(ctx, input, buffer_size, count, parallel_fill),
           seed_(seed),
           seed2_(seed2),
           parent_generator_(seed, seed2),
@@ -409,8 +524,9 @@ class ShuffleDatasetOp : public ShuffleDatasetOpBase {
   class FixedSeedDataset : public ShuffleDatasetBase {
    public:
     FixedSeedDataset(OpKernelContext* ctx, const DatasetBase* input,
-                     int64 buffer_size, int64 seed, int64 seed2, int64 count)
-        : ShuffleDatasetBase(ctx, input, buffer_size, count),
+                     int64 buffer_size, int64 seed, int64 seed2, int64 count,
+                     bool parallel_fill)
+        : ShuffleDatasetBase(ctx, input, buffer_size, count, parallel_fill),
           seed_(seed),
           seed2_(seed) {}
 
@@ -480,20 +596,22 @@ class ShuffleAndRepeatDatasetOp : public ShuffleDatasetOpBase {
 
     // By TensorFlow convention, if both seeds are 0, then shuffling should be
     // seeded non-deterministically.
-    if (seed == 0 && seed2 == 0) {
+    const bool parallel_fill = seed == 0 && seed2 == 0;
+    if (parallel_fill) {
       seed = random::New64();
       seed2 = random::New64();
     }
 
-    *output = new Dataset(ctx, input, buffer_size, seed, seed2, count);
+    *output =
+        new Dataset(ctx, input, buffer_size, seed, seed2, count, parallel_fill);
   }
 
  private:
   class Dataset : public ShuffleDatasetBase {
    public:
     Dataset(OpKernelContext* ctx, const DatasetBase* input, int64 buffer_size,
-            int64 seed, int64 seed2, int64 count)
-        : ShuffleDatasetBase(ctx, input, buffer_size, count),
+            int64 seed, int64 seed2, int64 count, bool parallel_fill)
+        : ShuffleDatasetBase(ctx, input, buffer_size, count, parallel_fill),
           seed_(seed),
           seed2_(seed2) {}
 
@@ -62,10 +62,16 @@ class ToTFRecordOp : public AsyncOpKernel {
       std::unique_ptr<WritableFile> file;
       OP_REQUIRES_OK_ASYNC(ctx, ctx->env()->NewWritableFile(filename, &file),
                            done);
+      io::RecordWriterOptions options =
+          io::RecordWriterOptions::CreateRecordWriterOptions(compression_type);
+#if !defined(IS_SLIM_BUILD)
+      // Compress on the intra-op pool so that deflate does not serialize the
+      // write behind this op's single thread.
+      options.compression_thread_pool =
+          ctx->device()->tensorflow_cpu_worker_threads()->workers;
+#endif  // IS_SLIM_BUILD
       std::unique_ptr<io::RecordWriter> writer;
-      writer.reset(new io::RecordWriter(
-          file.get(), io::RecordWriterOptions::CreateRecordWriterOptions(
-                          compression_type)));
+      writer.reset(new io::RecordWriter(file.get(), options));
 
       DatasetBase* dataset;
       OP_REQUIRES_OK_ASYNC(
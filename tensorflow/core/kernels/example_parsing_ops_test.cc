@@ -97,6 +97,7 @@ struct ExampleStore {
       AddExample(&serialized_example, 10, 512, 1);
       AddExample(&serialized_example, 100, 512, 1);
       AddExample(&serialized_example, 1000, 512, 1);
+      AddExample(&serialized_example, 10, 128, 128);
       AddExample(&serialized_example, 1, 1, 1000000);
     });
     return serialized_example;
@@ -276,6 +277,7 @@ typedef BenchmarkOptions<ExampleStore<FloatFiller>, kVarLenDense>
   BM_ParseExample(Type, 1, 1000, 1);   \
   BM_ParseExample(Type, 128, 1000, 1); \
   BM_ParseExample(Type, 512, 1000, 1); \
+  BM_ParseExample(Type, 128, 10, 128); \
   BM_ParseExample(Type, 1, 1, 1000000);
 
 BM_AllParseExample(SparseString);
@@ -258,6 +258,7 @@ class AssignVariableOp : public OpKernel {
         value.shape(), DEVICE_MEMORY, attr);
     mutex_lock ml(*variable->mu());
     variable->is_initialized = true;
+    variable->MarkAllRowsDirty();
     if (input_alias) {
       *variable->tensor() = *input_alias;
       return;
@@ -330,6 +331,7 @@ class AssignVariableOp<Device, Variant> : public OpKernel {
 
     mutex_lock ml(*variable->mu());
     variable->is_initialized = true;
+    variable->MarkAllRowsDirty();
     *variable->tensor() = Tensor(DT_VARIANT, value.shape());
 
     if (input_alias) {
@@ -404,6 +406,7 @@ class AssignUpdateVariableOp : public OpKernel {
     Tensor* var_tensor = variable->tensor();
     OP_REQUIRES_OK(context,
                    PrepareToUpdateVariable<Device, T>(context, var_tensor));
+    variable->MarkAllRowsDirty();
     functor::DenseUpdate<Device, T, Op> update_functor;
     update_functor(context->eigen_device<Device>(), var_tensor->flat<T>(),
                    value.flat<T>());
@@ -475,6 +478,47 @@ REGISTER_KERNEL_BUILDER(Name("VarIsInitializedOp")
                         IsResourceInitialized<Var>);
 #endif  // GOOGLE_CUDA
 
+// Outputs the rows of a variable written since the previous call, for delta
+// checkpoints.  See Var::TakeDirtyRows().
+class TakeVariableDirtyRowsOp : public OpKernel {
+ public:
+  explicit TakeVariableDirtyRowsOp(OpKernelConstruction* c) : OpKernel(c) {}
+
+  void Compute(OpKernelContext* context) override {
+    Var* variable = nullptr;
+    OP_REQUIRES_OK(context, LookupResource(context, HandleFromInput(context, 0),
+                                           &variable));
+    core::ScopedUnref su(variable);
+    std::vector<bool> dirty_rows;
+    const bool known = variable->TakeDirtyRows(&dirty_rows);
+
+    Tensor* known_t = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &known_t));
+    known_t->scalar<bool>()() = known;
+    std::vector<int64> rows;
+    for (size_t i = 0; i < dirty_rows.size(); ++i) {
+      if (dirty_rows[i]) rows.push_back(i);
+    }
+    Tensor* rows_t = nullptr;
+    const TensorShape rows_shape({static_cast<int64>(rows.size())});
+    OP_REQUIRES_OK(context, context->allocate_output(1, rows_shape, &rows_t));
+    std::copy(rows.begin(), rows.end(), rows_t->vec<int64>().data());
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("TakeVariableDirtyRows").Device(DEVICE_CPU),
+                        TakeVariableDirtyRowsOp);
+
+#if GOOGLE_CUDA
+REGISTER_KERNEL_BUILDER(Name("TakeVariableDirtyRows")
+                            .Device(DEVICE_GPU)
+                            .HostMemory("resource")
+                            .HostMemory("known")
+                            .HostMemory("rows"),
+                        TakeVariableDirtyRowsOp);
+#endif  // GOOGLE_CUDA
+
 template <typename Device, typename T, typename Index>
 class ResourceGatherOp : public OpKernel {
  public:
@@ -604,6 +648,7 @@ class ResourceScatterUpdateOp : public OpKernel {
     OP_REQUIRES_OK(c, PrepareToUpdateVariable<Device, T>(c, params));
     const Tensor& indices = c->input(1);
     const Tensor& updates = c->input(2);
+    v->MarkRowsDirty<Index>(indices, params->dim_size(0));
 
     // Check that we have enough index space
     const int64 N_big = indices.NumElements();
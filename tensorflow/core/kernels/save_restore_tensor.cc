@@ -243,11 +243,15 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
               return tensor_names_flat(a) < tensor_names_flat(b);
             });
 
-  BundleReader reader(Env::Default(), prefix_string);
+  // Reads and checksums large tensors in parallel on the worker threads.
+  BundleReader::Options options;
+  options.thread_pool =
+      context->device()->tensorflow_cpu_worker_threads()->workers;
+  BundleReader reader(Env::Default(), prefix_string, options);
   TF_RETURN_IF_ERROR(reader.status());
 
   // TODO(zongheng): potential optimization: one Seek() in first lookup.
-  // TODO(zongheng): consider measuring speed and issuing concurrent lookups
+  // TODO(zongheng): consider issuing concurrent lookups of small tensors
   // within a fixed memory budget.
   TensorShape restored_full_shape;
   Tensor* restored_tensor = nullptr;
@@ -105,7 +105,11 @@ class SaveV2 : public OpKernel {
     const auto& tensor_names_flat = tensor_names.flat<string>();
     const auto& shape_and_slices_flat = shape_and_slices.flat<string>();
 
-    BundleWriter writer(Env::Default(), prefix_string);
+    // Copies and checksums large tensors in parallel on the worker threads.
+    BundleWriter::Options options;
+    options.thread_pool =
+        context->device()->tensorflow_cpu_worker_threads()->workers;
+    BundleWriter writer(Env::Default(), prefix_string, options);
     OP_REQUIRES_OK(context, writer.status());
     VLOG(1) << "BundleWriter, prefix_string: " << prefix_string;
 
@@ -190,6 +194,198 @@ class RestoreV2 : public OpKernel {
 };
 REGISTER_KERNEL_BUILDER(Name("RestoreV2").Device(DEVICE_CPU), RestoreV2);
 
+// Saves a list of named tensors as a delta bundle relative to the checkpoint
+// "base_prefix", storing only the changed rows of tensors whose changed rows
+// are known.  An empty "base_prefix" saves every tensor in full.
+class SaveDeltaV2 : public OpKernel {
+ public:
+  explicit SaveDeltaV2(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& prefix = context->input(0);
+    const Tensor& base_prefix = context->input(1);
+    const Tensor& tensor_names = context->input(2);
+    const Tensor& shape_and_slices = context->input(3);
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsScalar(prefix.shape()) &&
+                    TensorShapeUtils::IsScalar(base_prefix.shape()),
+                errors::InvalidArgument(
+                    "Inputs prefix and base_prefix should be scalars, got ",
+                    prefix.shape().DebugString(), " and ",
+                    base_prefix.shape().DebugString(), " instead."));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVector(tensor_names.shape()) &&
+                    shape_and_slices.shape() == tensor_names.shape(),
+                errors::InvalidArgument(
+                    "Inputs tensor_names and shape_and_slices should be 1-D "
+                    "tensors of the same size, got ",
+                    tensor_names.shape().DebugString(), " and ",
+                    shape_and_slices.shape().DebugString(), " instead."));
+    const int kFixedInputs = 4;  // Prefixes, names and shape_and_slices.
+    const int num_tensors = static_cast<int>(tensor_names.NumElements());
+    OP_REQUIRES(context,
+                context->num_inputs() == kFixedInputs + 2 * num_tensors + 1,
+                errors::InvalidArgument(
+                    "Expected ", num_tensors, " tensors and ", num_tensors,
+                    " changed rows for ", num_tensors, " tensor names, got ",
+                    context->num_inputs(), " inputs in total"));
+    const Tensor& rows_known = context->input(kFixedInputs + num_tensors);
+    OP_REQUIRES(context, rows_known.shape() == tensor_names.shape(),
+                errors::InvalidArgument(
+                    "Input rows_known should have shape ",
+                    tensor_names.shape().DebugString(), ", got ",
+                    rows_known.shape().DebugString(), " instead."));
+
+    const string& prefix_string = prefix.scalar<string>()();
+    const string& base_prefix_string = base_prefix.scalar<string>()();
+    const bool is_delta = !base_prefix_string.empty();
+    if (is_delta) {
+      OP_REQUIRES(
+          context,
+          io::Dirname(base_prefix_string) == io::Dirname(prefix_string),
+          errors::InvalidArgument("The base of a delta checkpoint must be in "
+                                  "the same directory, got ",
+                                  base_prefix_string, " for ", prefix_string));
+    }
+    const auto& tensor_names_flat = tensor_names.flat<string>();
+    const auto& shape_and_slices_flat = shape_and_slices.flat<string>();
+    const auto& rows_known_flat = rows_known.flat<bool>();
+
+    // Copies and checksums large tensors in parallel on the worker threads.
+    BundleWriter::Options options;
+    options.thread_pool =
+        context->device()->tensorflow_cpu_worker_threads()->workers;
+    BundleWriter writer(Env::Default(), prefix_string, options);
+    OP_REQUIRES_OK(context, writer.status());
+    if (is_delta) {
+      OP_REQUIRES_OK(context,
+                     AddDeltaBase(&writer, io::Basename(base_prefix_string)));
+    }
+
+    for (int i = 0; i < num_tensors; ++i) {
+      const string& tensor_name = tensor_names_flat(i);
+      const Tensor& tensor = context->input(i + kFixedInputs);
+      const Tensor& changed_rows =
+          context->input(kFixedInputs + num_tensors + 1 + i);
+      OP_REQUIRES(context, TensorShapeUtils::IsVector(changed_rows.shape()),
+                  errors::InvalidArgument(
+                      "Changed rows of ", tensor_name,
+                      " should be a 1-D tensor, got ",
+                      changed_rows.shape().DebugString(), " instead."));
+
+      string key = tensor_name;
+      TensorShape shape;
+      TensorSlice slice(tensor.dims());
+      const bool is_slice = !shape_and_slices_flat(i).empty();
+      if (is_slice) {
+        const string& shape_spec = shape_and_slices_flat(i);
+        TensorShape slice_shape;
+        OP_REQUIRES_OK(context, checkpoint::ParseShapeAndSlice(
+                                    shape_spec, &shape, &slice, &slice_shape));
+        OP_REQUIRES(context, slice_shape.IsSameSize(tensor.shape()),
+                    errors::InvalidArgument("Slice in shape_and_slice "
+                                            "specification does not match the "
+                                            "shape of the tensor to save: ",
+                                            shape_spec, ", tensor: ",
+                                            tensor.shape().DebugString()));
+        key = DeltaSliceKey(tensor_name, slice);
+      }
+
+      if (!is_delta) {
+        // A base checkpoint, which RestoreV2 can read too.
+        if (is_slice) {
+          OP_REQUIRES_OK(context,
+                         writer.AddSlice(tensor_name, shape, slice, tensor));
+        } else {
+          OP_REQUIRES_OK(context, writer.Add(tensor_name, tensor));
+        }
+      } else if (rows_known_flat(i) && tensor.dims() > 0) {
+        std::vector<bool> rows(tensor.dim_size(0));
+        const auto changed_rows_flat = changed_rows.flat<int64>();
+        for (int64 j = 0; j < changed_rows_flat.size(); ++j) {
+          const int64 row = changed_rows_flat(j);
+          OP_REQUIRES(context, row >= 0 && row < tensor.dim_size(0),
+                      errors::InvalidArgument(
+                          "Changed row ", row, " of ", tensor_name,
+                          " is out of range [0, ", tensor.dim_size(0), ")"));
+          rows[row] = true;
+        }
+        OP_REQUIRES_OK(context, AddDeltaRows(&writer, key, tensor, rows));
+      } else {
+        OP_REQUIRES_OK(context, writer.Add(key, tensor));
+      }
+    }
+    OP_REQUIRES_OK(context, writer.Finish());
+  }
+};
+REGISTER_KERNEL_BUILDER(Name("SaveDeltaV2").Device(DEVICE_CPU), SaveDeltaV2);
+
+// Restores a list of named tensors from a checkpoint written by SaveDeltaV2,
+// following its chain of bases.
+class RestoreDeltaV2 : public OpKernel {
+ public:
+  explicit RestoreDeltaV2(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("dtypes", &dtypes_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& prefix = context->input(0);
+    const Tensor& tensor_names = context->input(1);
+    const Tensor& shape_and_slices = context->input(2);
+    OP_REQUIRES(context, tensor_names.NumElements() == dtypes_.size(),
+                errors::InvalidArgument("Got ", tensor_names.NumElements(),
+                                        " tensor names, but ", dtypes_.size(),
+                                        " expected dtypes."));
+    ValidateInputs(false /* not save op */, context, prefix, tensor_names,
+                   shape_and_slices);
+    if (!context->status().ok()) return;
+
+    std::vector<std::unique_ptr<BundleReader>> readers;
+    OP_REQUIRES_OK(context, OpenDeltaChain(Env::Default(),
+                                           prefix.flat<string>()(0), &readers));
+    BundleReader* base = readers.front().get();
+    std::vector<BundleReader*> deltas;
+    for (size_t i = 1; i < readers.size(); ++i) {
+      deltas.push_back(readers[i].get());
+    }
+
+    const auto& tensor_names_flat = tensor_names.flat<string>();
+    const auto& shape_and_slices_flat = shape_and_slices.flat<string>();
+    for (int i = 0; i < dtypes_.size(); ++i) {
+      const string& tensor_name = tensor_names_flat(i);
+      const string& shape_and_slice = shape_and_slices_flat(i);
+      Tensor restored;
+      if (shape_and_slice.empty()) {
+        OP_REQUIRES_OK(context, LookupWithDeltas(base, deltas, tensor_name,
+                                                 &restored));
+      } else {
+        TensorShape shape;
+        TensorSlice slice;
+        TensorShape slice_shape;
+        OP_REQUIRES_OK(context,
+                       checkpoint::ParseShapeAndSlice(shape_and_slice, &shape,
+                                                      &slice, &slice_shape));
+        restored = Tensor(dtypes_[i], slice_shape);
+        OP_REQUIRES_OK(context,
+                       LookupSliceWithDeltas(base, deltas, tensor_name, slice,
+                                             &restored));
+      }
+      OP_REQUIRES(context, restored.dtype() == dtypes_[i],
+                  errors::InvalidArgument(
+                      "tensor_name = ", tensor_name, "; expected dtype ",
+                      DataTypeString(dtypes_[i]), " does not equal restored ",
+                      "dtype ", DataTypeString(restored.dtype())));
+      context->set_output(i, restored);
+    }
+  }
+
+ private:
+  // Expected dtypes of the to-restore tensors.
+  std::vector<DataType> dtypes_;
+};
+REGISTER_KERNEL_BUILDER(Name("RestoreDeltaV2").Device(DEVICE_CPU),
+                        RestoreDeltaV2);
+
 // The final step in saving sharded V2 checkpoints: merges metadata files.
 class MergeV2Checkpoints : public OpKernel {
  public:
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -339,5 +340,96 @@ TEST_F(SaveV2OpTest, Simple) {
   }
 }
 
+class SaveDeltaV2OpTest : public OpsTestBase {
+ protected:
+  // Saves a 4x2 float "embedding" with known changed rows "rows", a 2x2 slice
+  // of a 4x2 float "part" with unknown changed rows, and an int64 "step".
+  Status Save(const string& prefix, const string& base_prefix,
+              const Tensor& embedding, const std::vector<int64>& rows,
+              const Tensor& part, int64 step) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("myop", "SaveDeltaV2")
+                     .Input(FakeInput())  // prefix
+                     .Input(FakeInput())  // base_prefix
+                     .Input(FakeInput())  // tensor_names
+                     .Input(FakeInput())  // shape_and_slices
+                     .Input(FakeInput({DT_FLOAT, DT_FLOAT, DT_INT64}))
+                     .Input(FakeInput())   // rows_known
+                     .Input(FakeInput(3))  // changed_rows
+                     .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    AddInputFromArray<string>(TensorShape({}), {prefix});
+    AddInputFromArray<string>(TensorShape({}), {base_prefix});
+    AddInputFromArray<string>(TensorShape({3}), {"embedding", "part", "step"});
+    AddInputFromArray<string>(TensorShape({3}), {"", "4 2 2,2:-", ""});
+    AddInputFromArray<float>(
+        embedding.shape(),
+        gtl::ArraySlice<float>(embedding.flat<float>().data(),
+                               embedding.NumElements()));
+    AddInputFromArray<float>(
+        part.shape(),
+        gtl::ArraySlice<float>(part.flat<float>().data(), part.NumElements()));
+    AddInputFromArray<int64>(TensorShape({}), {step});
+    AddInputFromArray<bool>(TensorShape({3}), {true, false, false});
+    AddInputFromArray<int64>(TensorShape({static_cast<int64>(rows.size())}),
+                             rows);
+    AddInputFromArray<int64>(TensorShape({0}), {});
+    AddInputFromArray<int64>(TensorShape({0}), {});
+    return RunOpKernel();
+  }
+};
+
+TEST_F(SaveDeltaV2OpTest, Chain) {
+  const string base_prefix = io::JoinPath(testing::TmpDir(), "delta_base");
+  const string delta_prefix = io::JoinPath(testing::TmpDir(), "delta_1");
+  Tensor embedding = test::AsTensor<float>({0, 1, 2, 3, 4, 5, 6, 7}, {4, 2});
+  Tensor part = test::AsTensor<float>({8, 9, 10, 11}, {2, 2});
+  // Without a base, everything is saved in full, whatever the known rows.
+  TF_ASSERT_OK(Save(base_prefix, "", embedding, {}, part, 1));
+  {
+    BundleReader reader(Env::Default(), base_prefix);
+    TF_ASSERT_OK(reader.status());
+    Tensor val(DT_FLOAT, TensorShape({4, 2}));
+    TF_ASSERT_OK(reader.Lookup("embedding", &val));
+    test::ExpectTensorEqual<float>(embedding, val);
+  }
+
+  Tensor embedding1 = test::AsTensor<float>({0, 1, 20, 30, 4, 5, 6, 7}, {4, 2});
+  Tensor part1 = test::AsTensor<float>({80, 9, 10, 11}, {2, 2});
+  TF_ASSERT_OK(Save(delta_prefix, base_prefix, embedding1, {1}, part1, 2));
+  {
+    BundleReader reader(Env::Default(), delta_prefix);
+    TF_ASSERT_OK(reader.status());
+    EXPECT_FALSE(reader.Contains("embedding"));
+    TensorShape shape;
+    TF_ASSERT_OK(reader.LookupTensorShape("embedding/.DELTA_ROWS", &shape));
+    EXPECT_EQ(TensorShape({1, 2}), shape);
+  }
+
+  std::vector<std::unique_ptr<BundleReader>> readers;
+  TF_ASSERT_OK(OpenDeltaChain(Env::Default(), delta_prefix, &readers));
+  ASSERT_EQ(2, readers.size());
+  Tensor val;
+  TF_ASSERT_OK(LookupWithDeltas(readers[0].get(), {readers[1].get()},
+                                "embedding", &val));
+  test::ExpectTensorEqual<float>(embedding1, val);
+  TF_ASSERT_OK(
+      LookupWithDeltas(readers[0].get(), {readers[1].get()}, "step", &val));
+  test::ExpectTensorEqual<int64>(test::AsScalar<int64>(2), val);
+  TensorSlice slice;
+  TF_ASSERT_OK(TensorSlice::Parse("2,2:-", &slice));
+  val = Tensor(DT_FLOAT, TensorShape({2, 2}));
+  TF_ASSERT_OK(LookupSliceWithDeltas(readers[0].get(), {readers[1].get()},
+                                     "part", slice, &val));
+  test::ExpectTensorEqual<float>(part1, val);
+
+  // Changed rows must be in range, and bases in the same directory.
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      Save(delta_prefix, base_prefix, embedding1, {4}, part1, 2)));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      Save(delta_prefix, io::JoinPath(testing::TmpDir(), "other", "base"),
+           embedding1, {1}, part1, 2)));
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -16,7 +16,13 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_SPARSE_CONDITIONAL_ACCUMULATOR_H_
 #define TENSORFLOW_KERNELS_SPARSE_CONDITIONAL_ACCUMULATOR_H_
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
 #include "tensorflow/core/kernels/typed_conditional_accumulator_base.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -68,9 +74,15 @@ class SparseConditionalAccumulator
   };
 
  protected:
+  // The indices of the accumulated rows, in the order they were first
+  // added, and the number of gradients added to each row.
   std::vector<int64>* accum_idx_vec_ = nullptr;
   std::vector<int>* count_element_ = nullptr;
+  // Position of each index in accum_idx_vec_.
+  std::unordered_map<int64, int64> accum_idx_map_;
 
+  // Row i holds the sum for index (*accum_idx_vec_)[i]; rows past the end
+  // of accum_idx_vec_ are spare capacity.
   Tensor* accum_val_ = nullptr;
   PersistentTensor* accum_val_persistent_ = nullptr;
 
@@ -158,162 +170,92 @@ class SparseConditionalAccumulator
   void AllocateAndAssignToAccumGradFunction(
       OpKernelContext* ctx,
       std::tuple<const Tensor*, const Tensor*, const Tensor*>* grad) override {
-    const Tensor* grad_idx = std::get<0>(*grad);
-    const Tensor* grad_val = std::get<1>(*grad);
-
-    const int64 nnz = grad_idx->dim_size(0);
-
-    // Assign indices
-    if (accum_idx_vec_ != nullptr) delete accum_idx_vec_;
-    accum_idx_vec_ = new std::vector<int64>();
-    accum_idx_vec_->reserve(nnz);
-    for (int i = 0; i < nnz; i++) {
-      accum_idx_vec_->push_back(grad_idx->vec<int64>()(i));
-    }
-
-    // Assign values to accum_val_tensor
-    // TODO(b/32704451): Don't just ignore the ::tensorflow::Status object!
-    ctx->allocate_persistent(dtype_, grad_val->shape(), accum_val_persistent_,
-                             &accum_val_)
-        .IgnoreError();
-    accum_val_->flat<T>().device(ctx->template eigen_device<Device>()) =
-        grad_val->flat<T>();
-
-    // Assign count_element_
-    if (count_element_ != nullptr) {
-      delete count_element_;
-    }
-    count_element_ = new std::vector<int>(nnz, 1);
-
-    // Do not need shape; Assume that the op has checked that the shapes match,
-    // so grad's shape == shape_
+    // Start a new accumulated gradient, keeping the buffer of the last one
+    // if the new gradient's slices fit in it.
+    if (accum_idx_vec_ == nullptr) accum_idx_vec_ = new std::vector<int64>();
+    if (count_element_ == nullptr) count_element_ = new std::vector<int>();
+    accum_idx_vec_->clear();
+    count_element_->clear();
+    accum_idx_map_.clear();
+    AddToAccumGradFunction(ctx, grad);
   }
 
   void AddToAccumGradFunction(
       OpKernelContext* ctx,
       std::tuple<const Tensor*, const Tensor*, const Tensor*>* grad) override {
-    // Modeled after third_party/tensorflow/core/kernels/sparse_add_op
-
     const Tensor* grad_idx = std::get<0>(*grad);
     const Tensor* grad_val = std::get<1>(*grad);
 
     const int64 accum_nnz = accum_idx_vec_->size();
     const int64 grad_nnz = grad_idx->dim_size(0);
-
-    // Source enumerates the origin of a non-zero element: whether it is from
-    // the new gradient, the accumulated gradient, or the sum of both.
-    enum Source { from_accum, from_grad, from_accum_and_grad };
-
-    // (1) do a pass over inputs, and append values and indices to vectors
-    std::vector<std::tuple<Source, int64, int64>> entries_to_copy;
-    entries_to_copy.reserve(accum_nnz + grad_nnz);
-
-    // Pass over all non-zero elements of both the gradient and the accumulated
-    // value, to identify where each non-zero element of the sum comes from.
-    // The input and output indexed slices are assumed to be ordered along
-    // increasing dimension number.
-    int64 i = 0, j = 0;
-    int64 sum_nnz = 0;
-    while (i < accum_nnz && j < grad_nnz) {
-      sum_nnz++;
-      switch (cmp(accum_idx_vec_, grad_idx, i, j)) {
-        case -1:
-          entries_to_copy.emplace_back(from_accum, i, -1);
-          ++i;
-          break;
-        case 0:
-          entries_to_copy.emplace_back(from_accum_and_grad, i, j);
-          ++i;
-          ++j;
-          break;
-        case 1:
-          entries_to_copy.emplace_back(from_grad, -1, j);
-          ++j;
-          break;
+    const auto grad_idx_vec = grad_idx->vec<int64>();
+
+    // (1) Make room for a new row for each slice, before changing anything,
+    // so that a failed allocation leaves the accumulated gradient intact.
+    OP_REQUIRES_OK(ctx,
+                   ReserveAccumRows(ctx, grad_val, accum_nnz,
+                                    accum_nnz + grad_nnz));
+
+    // (2) Find the accumulated row that each slice of the gradient is added
+    // to, appending rows for indices not seen before in this accumulation.
+    // Slices of the gradient with the same index are chained together, so
+    // that each row is updated by one thread in (3). Neither the gradient
+    // nor the accumulated value needs to be ordered.
+    std::vector<int64> rows;         // Distinct rows the gradient adds to
+    std::vector<int64> first_slice;  // First slice added to each of rows
+    std::vector<int64> last_slice;   // Last slice added to each of rows
+    std::vector<int64> next_slice(grad_nnz, -1);
+    std::unordered_map<int64, int64> grad_rows;  // Index to position in rows
+    grad_rows.reserve(grad_nnz);
+    rows.reserve(grad_nnz);
+    first_slice.reserve(grad_nnz);
+    last_slice.reserve(grad_nnz);
+    for (int64 j = 0; j < grad_nnz; ++j) {
+      const int64 index = grad_idx_vec(j);
+      auto grad_it = grad_rows.insert({index, rows.size()});
+      if (!grad_it.second) {
+        // A repeated index within the gradient is summed into the same row.
+        const int64 k = grad_it.first->second;
+        next_slice[last_slice[k]] = j;
+        last_slice[k] = j;
+        continue;
       }
+      auto accum_it = accum_idx_map_.insert({index, accum_idx_vec_->size()});
+      if (accum_it.second) {
+        accum_idx_vec_->push_back(index);
+        count_element_->push_back(1);
+      } else {
+        ++(*count_element_)[accum_it.first->second];
+      }
+      rows.push_back(accum_it.first->second);
+      first_slice.push_back(j);
+      last_slice.push_back(j);
     }
 
-    // Handle leftovers
-    while (i < accum_nnz) {
-      sum_nnz++;
-      entries_to_copy.emplace_back(from_accum, i, -1);
-      ++i;
-    }
-    while (j < grad_nnz) {
-      sum_nnz++;
-      entries_to_copy.emplace_back(from_grad, -1, j);
-      ++j;
-    }
-
-    // (2) Copy or sum the non-zero elements into sum_indices and sum_tensor
-    std::vector<int64>* sum_indices_vec = new std::vector<int64>();
-    sum_indices_vec->reserve(sum_nnz);
-
-    std::vector<int>* sum_counts = new std::vector<int>();
-    sum_counts->reserve(sum_nnz);
-
-    Tensor* sum_tensor = nullptr;
-    PersistentTensor* tensor_sum_persistent = new PersistentTensor();
-
-    TensorShape sum_shape = grad_val->shape();
-    sum_shape.set_dim(0, sum_nnz);
-
-    OP_REQUIRES_OK(
-        ctx, ctx->allocate_persistent(dtype_, sum_shape, tensor_sum_persistent,
-                                      &sum_tensor));
-    auto sum_flat = sum_tensor->flat_outer_dims<T>();
+    // (3) Copy or add the slices into their rows, in parallel over rows.
     auto accum_flat = accum_val_->flat_outer_dims<T>();
     auto grad_flat = grad_val->flat_outer_dims<T>();
-
     const int64 num_col = grad_flat.dimension(1);
-
     Eigen::DSizes<Eigen::DenseIndex, 1> slice_shape(num_col);
-
-    for (i = 0; i < sum_nnz; ++i) {
-      const Source src = std::get<0>(entries_to_copy[i]);
-      const int64 idx_a = std::get<1>(entries_to_copy[i]);
-      const int64 idx_b = std::get<2>(entries_to_copy[i]);
-      T* sum_slice_ptr = &sum_flat(i, 0);
-      SliceT sum_slice(sum_slice_ptr, slice_shape);
-      if (src == from_accum) {
-        // Element comes from accumulator; directly copy data structures over
-        sum_indices_vec->push_back(accum_idx_vec_->at(idx_a));
-        T* accum_slice_ptr = &accum_flat(idx_a, 0);
-        SliceT accum_slice(accum_slice_ptr, slice_shape);
-        sum_slice = accum_slice;
-        sum_counts->push_back(count_element_->at(idx_a));
-      } else if (src == from_accum_and_grad) {
-        // Element is a sum of accumulated value and new gradient;
-        // compute sum here
-        sum_indices_vec->push_back(accum_idx_vec_->at(idx_a));
-        const T* grad_slice_ptr = &grad_flat(idx_b, 0);
-        SliceConstT grad_slice(grad_slice_ptr, slice_shape);
-        T* accum_slice_ptr = &accum_flat(idx_a, 0);
-        SliceT accum_slice(accum_slice_ptr, slice_shape);
-        sum_slice = grad_slice + accum_slice;
-        sum_counts->push_back(count_element_->at(idx_a) + 1);
-      } else if (src == from_grad) {
-        // Element comes from new gradient; make a copy of indices and values
-        sum_indices_vec->push_back(grad_idx->vec<int64>()(idx_b));
-        const T* grad_slice_ptr = &grad_flat(idx_b, 0);
-        SliceConstT grad_slice(grad_slice_ptr, slice_shape);
-        sum_slice = grad_slice;
-        sum_counts->push_back(1);
+    auto add_rows = [&](int64 begin, int64 end) {
+      for (int64 k = begin; k < end; ++k) {
+        SliceT accum_slice(&accum_flat(rows[k], 0), slice_shape);
+        int64 j = first_slice[k];
+        if (rows[k] >= accum_nnz) {
+          accum_slice = SliceConstT(&grad_flat(j, 0), slice_shape);
+          j = next_slice[j];
+        }
+        for (; j >= 0; j = next_slice[j]) {
+          accum_slice += SliceConstT(&grad_flat(j, 0), slice_shape);
+        }
       }
-    }
-
-    // (3) Keep output, i.e., switch pointers to point to new data structures
-    // representing the sum
-    // Indices
-    if (accum_idx_vec_ != nullptr) delete accum_idx_vec_;
-    accum_idx_vec_ = sum_indices_vec;
-    // Values
-    accum_val_ = sum_tensor;
-    delete accum_val_persistent_;
-    accum_val_persistent_ = tensor_sum_persistent;
-    // Counts
-    if (count_element_ != nullptr) delete count_element_;
-    count_element_ = sum_counts;
+    };
+    const int64 num_rows = rows.size();
+    const int64 cost_per_row =
+        num_rows > 0 ? num_col * grad_nnz / num_rows : num_col;
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+          cost_per_row, add_rows);
 
     // No need to copy shape, since shape remains the same after sum.
   }
@@ -322,33 +264,37 @@ class SparseConditionalAccumulator
       EXCLUSIVE_LOCKS_REQUIRED(this->mu_) {
     const int64 nnz = count_element_->size();
     auto accum_flat = accum_val_->flat_outer_dims<T>();
-    std::vector<T> count_typet;
-    std::transform(count_element_->begin(), count_element_->end(),
-                   std::back_inserter(count_typet),
-                   TypeConverter<T, int>::ConvertUToT);
-
-    // Option 1: divide all by counter
-    /*
-    std::transform(
-        &accum_flat(0,0), &accum_flat(nnz,0), &accum_flat(0,0),
-        std::bind2nd(std::divides<T>(),
-                     TypeConverter<T, int>::ConvertUToT(this->counter_)));
-    */
-
-    // Option 2: average element-wise
-    Eigen::DSizes<Eigen::DenseIndex, 1> slice_shape(accum_flat.dimension(1));
-    for (int64 i = 0; i < nnz; i++) {
-      T* accum_slice_ptr = &accum_flat(i, 0);
-      SliceT accum_slice(accum_slice_ptr, slice_shape);
-      accum_slice.device(ctx->template eigen_device<Device>()) =
-          accum_slice / count_typet[i];
-    }
+    const int64 num_col = accum_flat.dimension(1);
+    Eigen::DSizes<Eigen::DenseIndex, 1> slice_shape(num_col);
+
+    // Average element-wise, i.e. divide each row by the number of gradients
+    // that contributed to it.
+    auto divide_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int count = (*count_element_)[i];
+        if (count == 1) continue;
+        SliceT accum_slice(&accum_flat(i, 0), slice_shape);
+        accum_slice = accum_slice / TypeConverter<T, int>::ConvertUToT(count);
+      }
+    };
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, nnz, num_col,
+          divide_rows);
   }
 
   bool SetOutput(OpKernelContext* ctx) override {
+    // Rows are accumulated in the order their indices were first seen, and
+    // returned ordered by index.
+    const int64 nnz = accum_idx_vec_->size();
+    std::vector<int64> order(nnz);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](int64 a, int64 b) {
+      return (*accum_idx_vec_)[a] < (*accum_idx_vec_)[b];
+    });
+
     bool is_successful = true;
-    if (is_successful) is_successful = ReturnIdxTensor(ctx);
-    if (is_successful) is_successful = ReturnValTensor(ctx);
+    if (is_successful) is_successful = ReturnIdxTensor(ctx, order);
+    if (is_successful) is_successful = ReturnValTensor(ctx, order);
     if (is_successful) is_successful = ReturnShapeTensor(ctx);
     return is_successful;
   }
@@ -407,33 +353,83 @@ class SparseConditionalAccumulator
   }
 
  private:
-  inline int cmp(std::vector<int64>* a_idx, const Tensor* b_idx,
-                 const int64 a_row, const int64 b_row) {
-    const int64 a = a_idx->at(a_row);
-    const int64 b = b_idx->vec<int64>()(b_row);
-    if (a < b) {
-      return -1;
-    } else if (a > b) {
-      return 1;
+  // Makes room for 'num_rows' rows of slices shaped like those of
+  // 'grad_val' in accum_val_, keeping its first 'num_kept' rows. The
+  // capacity grows geometrically, and is kept across accumulations.
+  Status ReserveAccumRows(OpKernelContext* ctx, const Tensor* grad_val,
+                          int64 num_kept, int64 num_rows) {
+    TensorShape shape = grad_val->shape();
+    shape.set_dim(0, 0);
+    int64 capacity = 0;
+    if (accum_val_ != nullptr) {
+      TensorShape accum_shape = accum_val_->shape();
+      accum_shape.set_dim(0, 0);
+      if (accum_shape == shape) {
+        capacity = accum_val_->dim_size(0);
+        if (capacity >= num_rows) return Status::OK();
+      } else {
+        // Only the first gradient of an accumulation may change the shape
+        // of the slices.
+        DCHECK_EQ(num_kept, 0);
+      }
+    }
+    shape.set_dim(0, std::max(num_rows, 2 * capacity));
+    PersistentTensor* persistent = new PersistentTensor();
+    Tensor* val = nullptr;
+    Status s = ctx->allocate_persistent(dtype_, shape, persistent, &val);
+    if (!s.ok()) {
+      delete persistent;
+      return s;
     }
-    return 0;
+    if (num_kept > 0) {
+      const int64 row_elements = grad_val->flat_outer_dims<T>().dimension(1);
+      std::copy_n(accum_val_->flat<T>().data(), num_kept * row_elements,
+                  val->flat<T>().data());
+    }
+    // Do not delete accum_val_! It is owned by accum_val_persistent_.
+    delete accum_val_persistent_;
+    accum_val_persistent_ = persistent;
+    accum_val_ = val;
+    return Status::OK();
   }
 
-  inline bool ReturnIdxTensor(OpKernelContext* ctx) {
+  inline bool ReturnIdxTensor(OpKernelContext* ctx,
+                              const std::vector<int64>& order) {
     Tensor* idx_tensor;
-    const int64 nnz = accum_idx_vec_->size();
+    const int64 nnz = order.size();
     OP_REQUIRES_OK_BOOLEAN(ctx, ctx->allocate_output(0, {nnz}, &idx_tensor));
     // If allocate_output fails, OP_REQUIRES_OK_BOOLEAN will short-circuit
     // the remaining code and just return false
     auto idx_tensor_vec = idx_tensor->vec<int64>();
-    for (int i = 0; i < nnz; ++i) {
-      idx_tensor_vec(i) = accum_idx_vec_->at(i);
+    for (int64 i = 0; i < nnz; ++i) {
+      idx_tensor_vec(i) = (*accum_idx_vec_)[order[i]];
     }
     return true;
   }
 
-  inline bool ReturnValTensor(OpKernelContext* ctx) {
-    ctx->set_output(1, *accum_val_);
+  inline bool ReturnValTensor(OpKernelContext* ctx,
+                              const std::vector<int64>& order) {
+    // The output is a copy, as accum_val_ is reused by the next
+    // accumulation.
+    const int64 nnz = order.size();
+    TensorShape val_shape = accum_val_->shape();
+    val_shape.set_dim(0, nnz);
+    Tensor* val_tensor;
+    OP_REQUIRES_OK_BOOLEAN(ctx,
+                           ctx->allocate_output(1, val_shape, &val_tensor));
+    auto accum_flat = accum_val_->flat_outer_dims<T>();
+    auto val_flat = val_tensor->flat_outer_dims<T>();
+    const int64 num_col = accum_flat.dimension(1);
+    Eigen::DSizes<Eigen::DenseIndex, 1> slice_shape(num_col);
+    auto copy_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        SliceT val_slice(&val_flat(i, 0), slice_shape);
+        val_slice = SliceT(&accum_flat(order[i], 0), slice_shape);
+      }
+    };
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, nnz, num_col,
+          copy_rows);
     return true;
   }
 
@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/variable_ops.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/platform/prefetch.h"
 #include "tensorflow/core/util/strided_slice_op.h"
 
@@ -300,8 +301,12 @@ class StridedSliceAssignOp : public OpKernel {
     gtl::InlinedVector<int64, 4> strides;
 
     Tensor old_lhs;
+    Var* v = nullptr;
+    // Reports the assignment to delta checkpoints once it is done.
+    auto mark_rows_dirty = gtl::MakeCleanup([&v] {
+      if (v != nullptr) v->MarkAllRowsDirty();
+    });
     if (context->input_dtype(0) == DT_RESOURCE) {
-      Var* v;
       OP_REQUIRES_OK(context,
                      LookupResource(context, HandleFromInput(context, 0), &v));
       old_lhs = *v->tensor();
@@ -19,7 +19,9 @@ limitations under the License.
 #include "tensorflow/core/framework/reader_base.h"
 #include "tensorflow/core/framework/reader_op_kernel.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/io/readahead_random_access_file.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 
@@ -31,13 +33,22 @@ class TextLineReader : public ReaderBase {
       : ReaderBase(strings::StrCat("TextLineReader '", node_name, "'")),
         skip_header_lines_(skip_header_lines),
         env_(env),
+        readahead_thread_pool_(env, "text_line_reader_readahead",
+                               kReadaheadBlocks),
         line_number_(0) {}
 
   Status OnWorkStartedLocked() override {
     line_number_ = 0;
+    input_buffer_.reset(nullptr);
+    readahead_file_.reset(nullptr);
     TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(current_work(), &file_));
 
-    input_buffer_.reset(new io::InputBuffer(file_.get(), kBufferSize));
+    // input_buffer_ refills itself with reads of kBufferSize bytes; read the
+    // next one in the background while lines are parsed out of the current.
+    readahead_file_.reset(new io::ReadaheadRandomAccessFile(
+        file_.get(), kBufferSize, kReadaheadBlocks, &readahead_thread_pool_));
+    input_buffer_.reset(
+        new io::InputBuffer(readahead_file_.get(), kBufferSize));
     for (; line_number_ < skip_header_lines_; ++line_number_) {
       string line_contents;
       Status status = input_buffer_->ReadLine(&line_contents);
@@ -53,6 +64,7 @@ class TextLineReader : public ReaderBase {
 
   Status OnWorkFinishedLocked() override {
     input_buffer_.reset(nullptr);
+    readahead_file_.reset(nullptr);
     return Status::OK();
   }
 
@@ -76,6 +88,7 @@ class TextLineReader : public ReaderBase {
   Status ResetLocked() override {
     line_number_ = 0;
     input_buffer_.reset(nullptr);
+    readahead_file_.reset(nullptr);
     return ReaderBase::ResetLocked();
   }
 
@@ -85,10 +98,15 @@ class TextLineReader : public ReaderBase {
 
  private:
   enum { kBufferSize = 256 << 10 /* 256 kB */ };
+  enum { kReadaheadBlocks = 1 };
   const int skip_header_lines_;
   Env* const env_;
+  // Reads ahead on its own threads, since blocking on the file would hold
+  // up the kernels sharing the device's compute pool.
+  thread::ThreadPool readahead_thread_pool_;  // must outlive readahead_file_
   int64 line_number_;
-  std::unique_ptr<RandomAccessFile> file_;  // must outlive input_buffer_
+  std::unique_ptr<RandomAccessFile> file_;  // must outlive readahead_file_
+  std::unique_ptr<RandomAccessFile> readahead_file_;  // and input_buffer_
   std::unique_ptr<io::InputBuffer> input_buffer_;
 };
 
@@ -92,12 +92,33 @@ Status GetInputTensorFromVariable(OpKernelContext* ctx, int input,
       }
       *out = *var->tensor();
     }
+    // Sparse kernels report the rows they update with
+    // MarkVariableRowsDirty().
+    if (!sparse) var->MarkAllRowsDirty();
     return Status::OK();
   }
   *out = ctx->mutable_input(input, lock_held);
   return Status::OK();
 }
 
+// Reports to the resource variables passed as inputs `input_ids` that the
+// rows listed in `indices` may have changed, so that they are written to the
+// next delta checkpoint (see Var::MarkRowsDirty()).  `num_rows` is the size of
+// the first dimension of the variables.  Does nothing for reference
+// variables.  Kernels call this after updating the rows.
+template <typename Tindex>
+void MarkVariableRowsDirty(OpKernelContext* ctx,
+                           const std::vector<int>& input_ids,
+                           const Tensor& indices, int64 num_rows) {
+  for (int input : input_ids) {
+    if (ctx->input_dtype(input) != DT_RESOURCE) continue;
+    Var* var;
+    if (!LookupResource(ctx, HandleFromInput(ctx, input), &var).ok()) continue;
+    core::ScopedUnref unref_var(var);
+    var->MarkRowsDirty<Tindex>(indices, num_rows);
+  }
+}
+
 }  // end namespace tensorflow
 
 #endif  // TENSORFLOW_KERNELS_TRAINING_OP_HELPERS_H_
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/training_ops.h"
 #include "tensorflow/core/kernels/variable_ops.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 
 #ifdef TENSORFLOW_USE_SYCL
 #include "tensorflow/core/common_runtime/sycl/sycl_util.h"
@@ -775,6 +776,10 @@ class SparseApplyAdadeltaOp : public OpKernel {
     const Tensor& indices = ctx->input(7);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1, 2}, indices, var.dim_size(0));
+    });
 
     for (int d = 1; d < var.dims(); d++) {
       OP_REQUIRES(ctx, var.dim_size(d) == grad.dim_size(d),
@@ -962,6 +967,10 @@ class SparseApplyProximalGradientDescentOp : public OpKernel {
     const Tensor& indices = ctx->input(5);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0}, indices, var.dim_size(0));
+    });
 
     int64 inner_dim = 1;
     for (int d = 1; d < var.dims(); d++) {
@@ -1307,6 +1316,10 @@ class SparseApplyAdagradOp : public OpKernel {
     const Tensor& indices = ctx->input(4);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1}, indices, var.dim_size(0));
+    });
 
     int64 inner_dim = 1;
     for (int d = 1; d < var.dims(); d++) {
@@ -1464,6 +1477,10 @@ class SparseApplyProximalAdagradOp : public OpKernel {
     const Tensor& indices = ctx->input(6);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1}, indices, var.dim_size(0));
+    });
 
     int64 inner_dim = 1;
     for (int d = 1; d < var.dims(); d++) {
@@ -1731,6 +1748,10 @@ class SparseApplyAdagradDAOp : public OpKernel {
     const Tensor& indices = ctx->input(4);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1, 2}, indices, var.dim_size(0));
+    });
 
     const Tensor& lr = ctx->input(5);
     OP_REQUIRES(ctx, IsLegacyScalar(lr.shape()),
@@ -2078,6 +2099,10 @@ class SparseApplyFtrlOp : public OpKernel {
     const Tensor& indices = ctx->input(4);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1, 2}, indices, var.dim_size(0));
+    });
 
     const Tensor& lr = ctx->input(5);
     OP_REQUIRES(ctx,
@@ -2446,6 +2471,10 @@ class SparseApplyMomentumOp : public OpKernel {
     const Tensor& indices = ctx->input(4);
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1}, indices, var.dim_size(0));
+    });
 
     for (int d = 1; d < var.dims(); d++) {
       OP_REQUIRES(ctx, var.dim_size(d) == grad.dim_size(d),
@@ -3222,6 +3251,10 @@ class SparseApplyRMSPropOp : public OpKernel {
 
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1, 2}, indices, var.dim_size(0));
+    });
 
     for (int d = 1; d < var.dims(); d++) {
       OP_REQUIRES(
@@ -3359,6 +3392,11 @@ class SparseApplyCenteredRMSPropOp : public OpKernel {
 
     OP_REQUIRES(ctx, TensorShapeUtils::IsVector(indices.shape()),
                 errors::InvalidArgument("indices must be one-dimensional"));
+    // Reports the rows to delta checkpoints once they are updated.
+    auto mark_rows_dirty = gtl::MakeCleanup([ctx, &indices, &var] {
+      MarkVariableRowsDirty<Tindex>(ctx, {0, 1, 2, 3}, indices,
+                                    var.dim_size(0));
+    });
 
     for (int d = 1; d < var.dims(); d++) {
       OP_REQUIRES(
@@ -263,5 +263,56 @@ uint32 Extend(uint32 crc, const char *buf, size_t size) {
   return l ^ 0xffffffffu;
 }
 
+// Returns the product of the 32x32 matrix "mat" over GF(2), stored as one
+// column per uint32, and the vector "vec".
+static uint32 GF2MatrixTimes(const uint32 *mat, uint32 vec) {
+  uint32 sum = 0;
+  for (; vec != 0; vec >>= 1, ++mat) {
+    if (vec & 1) sum ^= *mat;
+  }
+  return sum;
+}
+
+// Stores mat * mat in "square".
+static void GF2MatrixSquare(uint32 *square, const uint32 *mat) {
+  for (int n = 0; n < 32; ++n) {
+    square[n] = GF2MatrixTimes(mat, mat[n]);
+  }
+}
+
+// Same approach as zlib's crc32_combine(): appending len2 zero bytes to A is
+// a linear operation on its crc, computed by repeated squaring of the operator
+// that appends a single zero bit.
+uint32 Combine(uint32 crc1, uint32 crc2, size_t len2) {
+  if (len2 == 0) return crc1;
+
+  uint32 even[32];  // Operator for an even power-of-two number of zero bits.
+  uint32 odd[32];   // Operator for an odd power-of-two number of zero bits.
+
+  // Operator for one zero bit, using the reflected CRC-32C polynomial.
+  odd[0] = 0x82f63b78ul;
+  uint32 row = 1;
+  for (int n = 1; n < 32; ++n) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  GF2MatrixSquare(even, odd);  // Two zero bits.
+  GF2MatrixSquare(odd, even);  // Four zero bits.
+
+  // Applies len2 zero bytes to crc1. The first squaring below yields the
+  // operator for one zero byte.
+  do {
+    GF2MatrixSquare(even, odd);
+    if (len2 & 1) crc1 = GF2MatrixTimes(even, crc1);
+    len2 >>= 1;
+    if (len2 == 0) break;
+    GF2MatrixSquare(odd, even);
+    if (len2 & 1) crc1 = GF2MatrixTimes(odd, crc1);
+    len2 >>= 1;
+  } while (len2 != 0);
+
+  return crc1 ^ crc2;
+}
+
 }  // namespace crc32c
 }  // namespace tensorflow
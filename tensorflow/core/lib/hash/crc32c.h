@@ -30,6 +30,13 @@ extern uint32 Extend(uint32 init_crc, const char* data, size_t n);
 // Return the crc32c of data[0,n-1]
 inline uint32 Value(const char* data, size_t n) { return Extend(0, data, n); }
 
+// Return the crc32c of concat(A, B) where crc1 is the crc32c of some string A,
+// and crc2 is the crc32c of some string B of length len2.  Combine() makes it
+// possible to checksum the pieces of a buffer independently (e.g. on several
+// threads) and derive the checksum of the whole buffer.  Takes O(log(len2))
+// time.
+extern uint32 Combine(uint32 crc1, uint32 crc2, size_t len2);
+
 static const uint32 kMaskDelta = 0xa282ead8ul;
 
 // Return a masked representation of crc.
@@ -0,0 +1,258 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/cache.h"
+
+#include <assert.h>
+#include <unordered_map>
+
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace table {
+
+Cache::~Cache() {}
+
+namespace {
+
+// LRU cache implementation
+//
+// Every entry is kept in a circular doubly linked list ordered by access
+// time, and in a hash table keyed by the entry's key.  An entry is removed
+// from both when it is evicted or erased, but is only destroyed once all
+// handles to it have been released.
+struct LRUHandle {
+  void* value;
+  void (*deleter)(const StringPiece&, void* value);
+  LRUHandle* next;
+  LRUHandle* prev;
+  size_t charge;
+  uint32 refs;
+  string key;
+};
+
+// A single shard of sharded cache.
+class LRUCache {
+ public:
+  LRUCache();
+  ~LRUCache();
+
+  // Separate from constructor so caller can easily make an array of LRUCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods.
+  Cache::Handle* Insert(const StringPiece& key, void* value, size_t charge,
+                        void (*deleter)(const StringPiece& key, void* value));
+  Cache::Handle* Lookup(const StringPiece& key);
+  void Release(Cache::Handle* handle);
+  void Erase(const StringPiece& key);
+  size_t TotalCharge() const {
+    mutex_lock l(mu_);
+    return usage_;
+  }
+
+ private:
+  void LRU_Remove(LRUHandle* e);
+  void LRU_Append(LRUHandle* e);
+  void Unref(LRUHandle* e);
+  // Removes `e` from the table and the list, and drops the cache's reference.
+  void EraseLocked(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  mutable mutex mu_;
+  size_t usage_ GUARDED_BY(mu_);
+
+  // Dummy head of LRU list.
+  // lru.prev is newest entry, lru.next is oldest entry.
+  LRUHandle lru_ GUARDED_BY(mu_);
+
+  // Keys point into the key strings of the entries.
+  std::unordered_map<StringPiece, LRUHandle*, StringPieceHasher> table_
+      GUARDED_BY(mu_);
+};
+
+LRUCache::LRUCache() : usage_(0) {
+  // Make empty circular linked list
+  lru_.next = &lru_;
+  lru_.prev = &lru_;
+}
+
+LRUCache::~LRUCache() {
+  for (LRUHandle* e = lru_.next; e != &lru_;) {
+    LRUHandle* next = e->next;
+    assert(e->refs == 1);  // Error if caller has an unreleased handle
+    Unref(e);
+    e = next;
+  }
+}
+
+void LRUCache::Unref(LRUHandle* e) {
+  assert(e->refs > 0);
+  e->refs--;
+  if (e->refs <= 0) {
+    (*e->deleter)(e->key, e->value);
+    delete e;
+  }
+}
+
+void LRUCache::LRU_Remove(LRUHandle* e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+void LRUCache::LRU_Append(LRUHandle* e) {
+  // Make "e" newest entry by inserting just before lru_
+  e->next = &lru_;
+  e->prev = lru_.prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+Cache::Handle* LRUCache::Lookup(const StringPiece& key) {
+  mutex_lock l(mu_);
+  auto it = table_.find(key);
+  if (it == table_.end()) {
+    return nullptr;
+  }
+  LRUHandle* e = it->second;
+  e->refs++;
+  LRU_Remove(e);
+  LRU_Append(e);
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void LRUCache::Release(Cache::Handle* handle) {
+  mutex_lock l(mu_);
+  Unref(reinterpret_cast<LRUHandle*>(handle));
+}
+
+Cache::Handle* LRUCache::Insert(const StringPiece& key, void* value,
+                                size_t charge,
+                                void (*deleter)(const StringPiece& key,
+                                                void* value)) {
+  mutex_lock l(mu_);
+
+  LRUHandle* e = new LRUHandle;
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key.assign(key.data(), key.size());
+  e->refs = 2;  // One from LRUCache, one for the returned handle
+
+  auto it = table_.find(key);
+  if (it != table_.end()) {
+    EraseLocked(it->second);
+  }
+  LRU_Append(e);
+  usage_ += charge;
+  table_[e->key] = e;
+
+  while (usage_ > capacity_ && lru_.next != &lru_) {
+    LRUHandle* old = lru_.next;
+    // Never evict the entry that was just inserted: the caller holds a handle
+    // to it anyway, and it would otherwise be useless to cache a block larger
+    // than the capacity.
+    if (old == e) break;
+    EraseLocked(old);
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void LRUCache::EraseLocked(LRUHandle* e) {
+  table_.erase(e->key);
+  LRU_Remove(e);
+  usage_ -= e->charge;
+  Unref(e);
+}
+
+void LRUCache::Erase(const StringPiece& key) {
+  mutex_lock l(mu_);
+  auto it = table_.find(key);
+  if (it != table_.end()) {
+    EraseLocked(it->second);
+  }
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedLRUCache : public Cache {
+ public:
+  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+
+  ~ShardedLRUCache() override {}
+
+  Handle* Insert(const StringPiece& key, void* value, size_t charge,
+                 void (*deleter)(const StringPiece& key,
+                                 void* value)) override {
+    return shard_[Shard(key)].Insert(key, value, charge, deleter);
+  }
+
+  Handle* Lookup(const StringPiece& key) override {
+    return shard_[Shard(key)].Lookup(key);
+  }
+
+  void Release(Handle* handle) override {
+    LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
+    shard_[Shard(h->key)].Release(handle);
+  }
+
+  void Erase(const StringPiece& key) override {
+    shard_[Shard(key)].Erase(key);
+  }
+
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<LRUHandle*>(handle)->value;
+  }
+
+  uint64 NewId() override {
+    mutex_lock l(id_mutex_);
+    return ++(last_id_);
+  }
+
+  size_t TotalCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+
+ private:
+  static uint32 Shard(const StringPiece& key) {
+    return Hash32(key.data(), key.size(), 0) >> (32 - kNumShardBits);
+  }
+
+  LRUCache shard_[kNumShards];
+  mutex id_mutex_;
+  uint64 last_id_ GUARDED_BY(id_mutex_);
+};
+
+}  // namespace
+
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+
+}  // namespace table
+}  // namespace tensorflow
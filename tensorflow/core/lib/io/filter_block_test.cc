@@ -0,0 +1,178 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/filter_block.h"
+
+#include <memory>
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace table {
+namespace {
+
+static StringPiece Key(int i, char* buffer) {
+  core::EncodeFixed32(buffer, i);
+  return StringPiece(buffer, sizeof(uint32));
+}
+
+class BloomTest : public ::testing::Test {
+ public:
+  BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+
+  void Reset() {
+    keys_.clear();
+    filter_.clear();
+  }
+
+  void Add(const StringPiece& s) { keys_.push_back(string(s)); }
+
+  void Build() {
+    std::vector<StringPiece> key_pieces;
+    for (const string& key : keys_) {
+      key_pieces.push_back(key);
+    }
+    filter_.clear();
+    policy_->CreateFilter(key_pieces.data(),
+                          static_cast<int>(key_pieces.size()), &filter_);
+    keys_.clear();
+  }
+
+  size_t FilterSize() const { return filter_.size(); }
+
+  bool Matches(const StringPiece& s) {
+    if (!keys_.empty()) {
+      Build();
+    }
+    return policy_->KeyMayMatch(s, filter_);
+  }
+
+  double FalsePositiveRate() {
+    char buffer[sizeof(int)];
+    int result = 0;
+    for (int i = 0; i < 10000; i++) {
+      if (Matches(Key(i + 1000000000, buffer))) {
+        result++;
+      }
+    }
+    return result / 10000.0;
+  }
+
+ private:
+  std::unique_ptr<const FilterPolicy> policy_;
+  string filter_;
+  std::vector<string> keys_;
+};
+
+TEST_F(BloomTest, EmptyFilter) {
+  ASSERT_FALSE(Matches("hello"));
+  ASSERT_FALSE(Matches("world"));
+}
+
+TEST_F(BloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_FALSE(Matches("x"));
+  ASSERT_FALSE(Matches("foo"));
+}
+
+TEST_F(BloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+  for (int length : {1, 10, 100, 1000, 10000}) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
+        << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer))) << "Length " << length << "; key "
+                                           << i;
+    }
+
+    // Check false positive rate
+    EXPECT_LE(FalsePositiveRate(), 0.02) << length;
+  }
+}
+
+TEST(FilterBlockTest, EmptyBuilder) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  FilterBlockBuilder builder(policy.get());
+  StringPiece block = builder.Finish();
+  ASSERT_EQ(string("\0\0\0\0\x0b", 5), string(block));
+  FilterBlockReader reader(policy.get(), block);
+  ASSERT_TRUE(reader.KeyMayMatch(0, "foo"));
+  ASSERT_TRUE(reader.KeyMayMatch(100000, "foo"));
+}
+
+TEST(FilterBlockTest, MultiChunk) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  FilterBlockBuilder builder(policy.get());
+
+  // First filter
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(2000);
+  builder.AddKey("bar");
+
+  // Second filter
+  builder.StartBlock(3100);
+  builder.AddKey("box");
+
+  // Third filter is empty
+
+  // Last filter
+  builder.StartBlock(9000);
+  builder.AddKey("box");
+  builder.AddKey("hello");
+
+  StringPiece block = builder.Finish();
+  FilterBlockReader reader(policy.get(), block);
+
+  // Check first filter
+  ASSERT_TRUE(reader.KeyMayMatch(0, "foo"));
+  ASSERT_TRUE(reader.KeyMayMatch(2000, "bar"));
+  ASSERT_FALSE(reader.KeyMayMatch(0, "box"));
+  ASSERT_FALSE(reader.KeyMayMatch(0, "hello"));
+
+  // Check second filter
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "box"));
+  ASSERT_FALSE(reader.KeyMayMatch(3100, "foo"));
+  ASSERT_FALSE(reader.KeyMayMatch(3100, "bar"));
+  ASSERT_FALSE(reader.KeyMayMatch(3100, "hello"));
+
+  // Check third filter (empty)
+  ASSERT_FALSE(reader.KeyMayMatch(4100, "foo"));
+  ASSERT_FALSE(reader.KeyMayMatch(4100, "bar"));
+  ASSERT_FALSE(reader.KeyMayMatch(4100, "box"));
+  ASSERT_FALSE(reader.KeyMayMatch(4100, "hello"));
+
+  // Check last filter
+  ASSERT_TRUE(reader.KeyMayMatch(9000, "box"));
+  ASSERT_TRUE(reader.KeyMayMatch(9000, "hello"));
+  ASSERT_FALSE(reader.KeyMayMatch(9000, "foo"));
+  ASSERT_FALSE(reader.KeyMayMatch(9000, "bar"));
+}
+
+}  // namespace
+}  // namespace table
+}  // namespace tensorflow
@@ -0,0 +1,213 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/readahead_random_access_file.h"
+
+#include <string.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace io {
+
+ReadaheadRandomAccessFile::ReadaheadRandomAccessFile(RandomAccessFile* file,
+                                                     size_t block_size,
+                                                     int num_blocks,
+                                                     bool owns_file, Env* env)
+    : file_(file),
+      block_size_(block_size),
+      num_blocks_(num_blocks),
+      owns_file_(owns_file),
+      env_(env),
+      thread_pool_(nullptr),
+      state_(std::make_shared<State>(file, block_size)) {
+  DCHECK_GT(block_size_, 0);
+  DCHECK_GT(num_blocks_, 0);
+}
+
+ReadaheadRandomAccessFile::ReadaheadRandomAccessFile(
+    RandomAccessFile* file, size_t block_size, int num_blocks,
+    thread::ThreadPool* thread_pool, bool owns_file)
+    : file_(file),
+      block_size_(block_size),
+      num_blocks_(num_blocks),
+      owns_file_(owns_file),
+      env_(nullptr),
+      thread_pool_(thread_pool),
+      state_(std::make_shared<State>(file, block_size)) {
+  DCHECK_GT(block_size_, 0);
+  DCHECK_GT(num_blocks_, 0);
+  DCHECK(thread_pool_ != nullptr);
+}
+
+ReadaheadRandomAccessFile::~ReadaheadRandomAccessFile() {
+  {
+    mutex_lock l(state_->mu);
+    state_->cancelled = true;
+    while (state_->num_reading > 0) {
+      state_->cond_var.wait(l);
+    }
+    state_->blocks.clear();
+  }
+  if (owns_file_) {
+    delete file_;
+  }
+}
+
+void ReadaheadRandomAccessFile::State::FetchBlock(uint64 index, Block* block) {
+  string data;
+  data.resize(block_size);
+  StringPiece result;
+  Status s = file->Read(index * block_size, block_size, &result, &data[0]);
+  if (result.data() != data.data()) {
+    memmove(&data[0], result.data(), result.size());
+  }
+  data.resize(result.size());
+  // Reaching the end of the file is not an error for a block: the short block
+  // is returned to readers, which report OUT_OF_RANGE themselves.
+  if (errors::IsOutOfRange(s)) {
+    s = Status::OK();
+  }
+  mutex_lock l(mu);
+  block->data = std::move(data);
+  block->status = s;
+  block->done = true;
+  --num_reading;
+  cond_var.notify_all();
+}
+
+std::shared_ptr<ReadaheadRandomAccessFile::Block>
+ReadaheadRandomAccessFile::GetBlock(uint64 index) const {
+  State* state = state_.get();
+  std::shared_ptr<Block> block;
+  {
+    mutex_lock l(state->mu);
+    auto it = state->blocks.find(index);
+    if (it != state->blocks.end() && it->second->started) {
+      block = it->second;
+      while (!block->done) {
+        state->cond_var.wait(l);
+      }
+      if (!state->IsCacheable(*block)) {
+        state->blocks.erase(index);
+      }
+      return block;
+    }
+    if (it != state->blocks.end()) {
+      // The background fetch has not started yet: read the block here rather
+      // than wait for a pool thread to become available.
+      block = it->second;
+    } else {
+      block = std::make_shared<Block>();
+      state->blocks[index] = block;
+    }
+    block->started = true;
+    ++state->num_reading;
+  }
+  state->FetchBlock(index, block.get());
+  if (!state->IsCacheable(*block)) {
+    mutex_lock l(state->mu);
+    auto it = state->blocks.find(index);
+    if (it != state->blocks.end() && it->second == block) {
+      state->blocks.erase(it);
+    }
+  }
+  return block;
+}
+
+void ReadaheadRandomAccessFile::Prefetch(uint64 first, uint64 last) const {
+  std::vector<std::pair<uint64, std::shared_ptr<Block>>> to_fetch;
+  {
+    mutex_lock l(state_->mu);
+    auto& blocks = state_->blocks;
+    blocks.erase(blocks.begin(), blocks.lower_bound(first));
+    for (uint64 index = last + 1; index <= last + num_blocks_; ++index) {
+      if (blocks.count(index) > 0) continue;
+      std::shared_ptr<Block> block = std::make_shared<Block>();
+      blocks[index] = block;
+      to_fetch.emplace_back(index, std::move(block));
+    }
+  }
+  // Schedule outside of the lock: ThreadPool::Schedule() may run the closure
+  // inline when its queue is full. The closures hold on to the state rather
+  // than to `this`, so that the destructor need not wait for them.
+  for (const auto& fetch : to_fetch) {
+    std::shared_ptr<State> state = state_;
+    const uint64 index = fetch.first;
+    std::shared_ptr<Block> block = fetch.second;
+    auto fn = [state, index, block]() {
+      BackgroundFetch(state.get(), index, block);
+    };
+    if (thread_pool_ != nullptr) {
+      thread_pool_->Schedule(std::move(fn));
+    } else {
+      env_->SchedClosure(std::move(fn));
+    }
+  }
+}
+
+/* static */
+void ReadaheadRandomAccessFile::BackgroundFetch(
+    State* state, uint64 index, const std::shared_ptr<Block>& block) {
+  {
+    mutex_lock l(state->mu);
+    if (block->started || state->cancelled) return;
+    block->started = true;
+    ++state->num_reading;
+  }
+  state->FetchBlock(index, block.get());
+}
+
+Status ReadaheadRandomAccessFile::Read(uint64 offset, size_t n,
+                                       StringPiece* result,
+                                       char* scratch) const {
+  if (n == 0) {
+    *result = StringPiece();
+    return Status::OK();
+  }
+  const uint64 first = offset / block_size_;
+  const uint64 last = (offset + n - 1) / block_size_;
+  size_t copied = 0;
+  bool reached_eof = false;
+  for (uint64 index = first; index <= last && !reached_eof; ++index) {
+    std::shared_ptr<Block> block = GetBlock(index);
+    if (!block->status.ok()) {
+      *result = StringPiece(scratch, copied);
+      return block->status;
+    }
+    const size_t start = index == first ? offset % block_size_ : 0;
+    const size_t available =
+        block->data.size() > start ? block->data.size() - start : 0;
+    const size_t to_copy = std::min(available, n - copied);
+    memcpy(scratch + copied, block->data.data() + start, to_copy);
+    copied += to_copy;
+    reached_eof = block->data.size() < block_size_;
+  }
+  *result = StringPiece(scratch, copied);
+  if (!reached_eof) {
+    Prefetch(first, last);
+  }
+  if (copied < n) {
+    return errors::OutOfRange("Read less bytes than requested");
+  }
+  return Status::OK();
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,153 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LIB_IO_READAHEAD_RANDOM_ACCESS_FILE_H_
+#define TENSORFLOW_LIB_IO_READAHEAD_RANDOM_ACCESS_FILE_H_
+
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+// Wraps a RandomAccessFile and reads ahead of sequential scans.
+//
+// The file is divided into fixed-size blocks. Every call to Read() serves the
+// requested range from blocks that have already been fetched (or fetches them
+// synchronously), and then schedules asynchronous reads of the `num_blocks`
+// blocks that follow the requested range. Blocks preceding the requested range
+// are discarded, so memory use is bounded by roughly `num_blocks + 1` blocks
+// for a sequential reader. With `num_blocks` == 1 this amounts to double
+// buffering: the next block is read from the file while the caller consumes
+// the current one.
+//
+// Callers that issue reads aligned to `block_size` (e.g. a BufferedInputStream
+// or InputBuffer with the same buffer size) get the best results.
+//
+// The wrapper only relies on RandomAccessFile::Read(), so it can be layered
+// over the files of any FileSystem. It pays off most for high-latency files
+// (cold local disks, network file systems), where the readahead keeps
+// `num_blocks` reads in flight at once.
+//
+// Like all RandomAccessFile implementations, this class is safe for concurrent
+// use by multiple threads, although the readahead heuristic assumes a single
+// sequential reader.
+class ReadaheadRandomAccessFile : public RandomAccessFile {
+ public:
+  // Does not take ownership of `file` unless `owns_file` is set to true.
+  // `file` must outlive *this. Background reads are scheduled with
+  // `env->SchedClosure()`.
+  // REQUIRES: block_size > 0, num_blocks > 0
+  ReadaheadRandomAccessFile(RandomAccessFile* file, size_t block_size,
+                            int num_blocks, bool owns_file = false,
+                            Env* env = Env::Default());
+
+  // As above, but background reads are scheduled on `thread_pool`, which must
+  // outlive *this. A block that a reader needs before a pool thread has picked
+  // up its fetch is read on the reader's thread instead, so a busy (or even
+  // saturated) pool delays the readahead but never the reader.
+  ReadaheadRandomAccessFile(RandomAccessFile* file, size_t block_size,
+                            int num_blocks, thread::ThreadPool* thread_pool,
+                            bool owns_file = false);
+
+  // Waits for background reads of the file that are in progress. Fetches that
+  // are still queued do nothing when they run, so the destructor does not
+  // wait for the thread pool.
+  ~ReadaheadRandomAccessFile() override;
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override;
+
+ private:
+  struct Block {
+    // Set once a thread has started reading the block from the file.
+    bool started = false;
+    bool done = false;
+    Status status;
+    // The bytes of the block. Shorter than the block size only if the block
+    // contains the end of the file.
+    string data;
+  };
+
+  // The blocks and the bookkeeping of their fetches. Shared with scheduled
+  // background fetches, which may run after *this has been destroyed.
+  struct State {
+    State(RandomAccessFile* file, size_t block_size)
+        : file(file), block_size(block_size) {}
+
+    RandomAccessFile* const file;
+    const size_t block_size;
+
+    mutex mu;
+    condition_variable cond_var;
+    // Fetched or in-flight blocks, keyed by block index.
+    std::map<uint64, std::shared_ptr<Block>> blocks GUARDED_BY(mu);
+    // Number of fetches that are reading from `file`.
+    int64 num_reading GUARDED_BY(mu) = 0;
+    // Set by the destructor. Background fetches that have not started yet
+    // are dropped.
+    bool cancelled GUARDED_BY(mu) = false;
+
+    // Returns true if later reads may be served from `block`. Failures are
+    // not cached, so that a later Read() retries the block, and neither is
+    // a short block at the end of the file, which is re-read in case the
+    // file has grown.
+    bool IsCacheable(const Block& block) const {
+      return block.status.ok() && block.data.size() == block_size;
+    }
+
+    // Reads block `index` from the file into `block`, which the caller has
+    // marked as started and counted in `num_reading`.
+    void FetchBlock(uint64 index, Block* block) LOCKS_EXCLUDED(mu);
+  };
+
+  // Returns block `index`, fetching it on the calling thread if no fetch has
+  // started yet, or waiting for an in-progress background fetch otherwise.
+  std::shared_ptr<Block> GetBlock(uint64 index) const;
+
+  // Schedules background fetches for blocks (last, last + num_blocks_] and
+  // drops blocks preceding `first`.
+  void Prefetch(uint64 first, uint64 last) const;
+
+  // Runs on a background thread to fetch `block`, unless a reader has already
+  // claimed it or the file has been destroyed.
+  static void BackgroundFetch(State* state, uint64 index,
+                              const std::shared_ptr<Block>& block);
+
+  RandomAccessFile* const file_;
+  const size_t block_size_;
+  const int num_blocks_;
+  const bool owns_file_;
+  Env* const env_;                       // Not owned.
+  thread::ThreadPool* const thread_pool_;  // Not owned. May be null.
+  const std::shared_ptr<State> state_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ReadaheadRandomAccessFile);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_IO_READAHEAD_RANDOM_ACCESS_FILE_H_
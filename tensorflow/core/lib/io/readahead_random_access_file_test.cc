@@ -0,0 +1,283 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/readahead_random_access_file.h"
+
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/buffered_inputstream.h"
+#include "tensorflow/core/lib/io/random_inputstream.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+// Adds a fixed latency to every read of the wrapped file, to emulate a local
+// file that is not in the page cache (or a remote one).
+class SlowRandomAccessFile : public RandomAccessFile {
+ public:
+  SlowRandomAccessFile(RandomAccessFile* file, int64 latency_micros)
+      : file_(file), latency_micros_(latency_micros) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    Env::Default()->SleepForMicroseconds(latency_micros_);
+    return file_->Read(offset, n, result, scratch);
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const int64 latency_micros_;
+};
+
+string TestData(size_t size) {
+  string data;
+  data.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    data.push_back('a' + (i % 26));
+  }
+  return data;
+}
+
+TEST(ReadaheadRandomAccessFile, SequentialReads) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_sequential_test";
+  const string data = TestData(1000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  for (size_t block_size : {1, 7, 64, 1000, 4096}) {
+    for (int num_blocks : {1, 2, 8}) {
+      ReadaheadRandomAccessFile readahead(file.get(), block_size, num_blocks);
+      for (size_t read_size : {1, 13, 64, 999}) {
+        std::unique_ptr<char[]> scratch(new char[read_size]);
+        size_t offset = 0;
+        while (offset < data.size()) {
+          StringPiece result;
+          Status s = readahead.Read(offset, read_size, &result, scratch.get());
+          const size_t expected = std::min(read_size, data.size() - offset);
+          if (expected < read_size) {
+            EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+          } else {
+            TF_EXPECT_OK(s);
+          }
+          EXPECT_EQ(data.substr(offset, expected), result);
+          offset += read_size;
+        }
+      }
+    }
+  }
+}
+
+TEST(ReadaheadRandomAccessFile, RandomReads) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_random_test";
+  const string data = TestData(1000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  ReadaheadRandomAccessFile readahead(file.get(), 64, 2);
+  char scratch[100];
+  StringPiece result;
+  for (uint64 offset : {900, 0, 500, 10, 990, 300}) {
+    Status s = readahead.Read(offset, 100, &result, scratch);
+    if (offset + 100 > data.size()) {
+      EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+    } else {
+      TF_EXPECT_OK(s);
+    }
+    EXPECT_EQ(data.substr(offset, 100), result);
+  }
+  EXPECT_TRUE(errors::IsOutOfRange(readahead.Read(2000, 10, &result, scratch)));
+  EXPECT_EQ("", result);
+  TF_EXPECT_OK(readahead.Read(2000, 0, &result, scratch));
+  EXPECT_EQ("", result);
+}
+
+TEST(ReadaheadRandomAccessFile, FileGrows) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_file_grows_test";
+  const string data = TestData(200);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data.substr(0, 100)));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  ReadaheadRandomAccessFile readahead(file.get(), 64, 2);
+  char scratch[64];
+  StringPiece result;
+  EXPECT_TRUE(errors::IsOutOfRange(readahead.Read(64, 64, &result, scratch)));
+  EXPECT_EQ(data.substr(64, 36), result);
+
+  // The short block at the old end of the file is read again.
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  TF_EXPECT_OK(readahead.Read(64, 64, &result, scratch));
+  EXPECT_EQ(data.substr(64, 64), result);
+}
+
+TEST(ReadaheadRandomAccessFile, ThreadPool) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_thread_pool_test";
+  const string data = TestData(1000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  thread::ThreadPool pool(env, "test", 2);
+  for (int num_blocks : {1, 4}) {
+    ReadaheadRandomAccessFile readahead(file.get(), 64, num_blocks, &pool);
+    char scratch[100];
+    StringPiece result;
+    for (uint64 offset = 0; offset + 100 <= data.size(); offset += 100) {
+      TF_EXPECT_OK(readahead.Read(offset, 100, &result, scratch));
+      EXPECT_EQ(data.substr(offset, 100), result);
+    }
+  }
+}
+
+TEST(ReadaheadRandomAccessFile, BusyThreadPool) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_busy_pool_test";
+  const string data = TestData(1000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  // Occupy the only thread of the pool, so that no readahead can start. Reads
+  // must still make progress by fetching the blocks themselves.
+  thread::ThreadPool pool(env, "test", 1);
+  Notification unblock;
+  pool.Schedule([&unblock]() { unblock.WaitForNotification(); });
+  {
+    ReadaheadRandomAccessFile readahead(file.get(), 64, 2, &pool);
+    char scratch[100];
+    StringPiece result;
+    for (uint64 offset = 0; offset + 100 <= data.size(); offset += 100) {
+      TF_EXPECT_OK(readahead.Read(offset, 100, &result, scratch));
+      EXPECT_EQ(data.substr(offset, 100), result);
+    }
+    // The destructor does not wait for the scheduled fetches, which need the
+    // pool.
+  }
+  unblock.Notify();
+}
+
+TEST(ReadaheadRandomAccessFile, BufferedInputStream) {
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_buffered_test";
+  const string data = TestData(10000);
+  TF_ASSERT_OK(WriteStringToFile(env, fname, data));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+
+  ReadaheadRandomAccessFile readahead(file.get(), 256, 4);
+  BufferedInputStream in(new RandomAccessInputStream(&readahead), 256, true);
+  string read;
+  string all;
+  while (true) {
+    Status s = in.ReadNBytes(100, &read);
+    all.append(read);
+    if (!s.ok()) {
+      EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+      break;
+    }
+  }
+  EXPECT_EQ(data, all);
+}
+
+void BM_ReadaheadSequentialReads(int iters, int block_size, int num_blocks) {
+  testing::StopTiming();
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_benchmark";
+  const int64 file_size = 64 << 20;
+  TF_CHECK_OK(WriteStringToFile(env, fname, TestData(file_size)));
+  std::unique_ptr<RandomAccessFile> file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+  std::unique_ptr<char[]> scratch(new char[block_size]);
+  testing::BytesProcessed(static_cast<int64>(iters) * file_size);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<RandomAccessFile> reader;
+    if (num_blocks > 0) {
+      reader.reset(
+          new ReadaheadRandomAccessFile(file.get(), block_size, num_blocks));
+    }
+    RandomAccessFile* f = num_blocks > 0 ? reader.get() : file.get();
+    StringPiece result;
+    for (int64 offset = 0; offset < file_size; offset += block_size) {
+      f->Read(offset, block_size, &result, scratch.get()).IgnoreError();
+    }
+  }
+}
+BENCHMARK(BM_ReadaheadSequentialReads)
+    ->ArgPair(256 << 10, 0)
+    ->ArgPair(256 << 10, 1)
+    ->ArgPair(256 << 10, 4)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 1)
+    ->ArgPair(1 << 20, 4);
+
+// Reads a file whose every read takes `kLatencyMicros`, through a
+// BufferedInputStream as RecordReader does, and parses it in chunks of 1KB.
+// num_blocks == 0 disables the readahead.
+void BM_ReadaheadSlowFile(int iters, int num_blocks, int num_threads) {
+  testing::StopTiming();
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/readahead_slow_benchmark";
+  const int64 kFileSize = 16 << 20;
+  const size_t kBlockSize = 256 << 10;
+  const int64 kLatencyMicros = 2000;
+  TF_CHECK_OK(WriteStringToFile(env, fname, TestData(kFileSize)));
+  std::unique_ptr<RandomAccessFile> local_file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &local_file));
+  SlowRandomAccessFile file(local_file.get(), kLatencyMicros);
+  std::unique_ptr<thread::ThreadPool> pool;
+  if (num_threads > 0) {
+    pool.reset(new thread::ThreadPool(env, "readahead", num_threads));
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * kFileSize);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<RandomAccessFile> readahead;
+    if (num_blocks > 0 && pool != nullptr) {
+      readahead.reset(new ReadaheadRandomAccessFile(&file, kBlockSize,
+                                                    num_blocks, pool.get()));
+    } else if (num_blocks > 0) {
+      readahead.reset(
+          new ReadaheadRandomAccessFile(&file, kBlockSize, num_blocks));
+    }
+    BufferedInputStream in(
+        new RandomAccessInputStream(num_blocks > 0 ? readahead.get() : &file),
+        kBlockSize, true);
+    string chunk;
+    while (in.ReadNBytes(1 << 10, &chunk).ok()) {
+    }
+  }
+}
+BENCHMARK(BM_ReadaheadSlowFile)
+    ->ArgPair(0, 0)
+    ->ArgPair(1, 0)
+    ->ArgPair(4, 0)
+    ->ArgPair(1, 4)
+    ->ArgPair(4, 4);
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
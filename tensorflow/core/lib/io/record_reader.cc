@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/compression.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
+#include "tensorflow/core/lib/io/readahead_random_access_file.h"
 #include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
@@ -54,11 +55,50 @@ RecordReaderOptions RecordReaderOptions::CreateRecordReaderOptions(
   return options;
 }
 
+Status ReadRecordIndex(RandomAccessFile* index_file,
+                       std::vector<uint64>* offsets) {
+  static const size_t kChunkSize = 64 << 10;
+  offsets->clear();
+  std::unique_ptr<char[]> scratch(new char[kChunkSize]);
+  uint64 pos = 0;
+  while (true) {
+    StringPiece data;
+    Status s = index_file->Read(pos, kChunkSize, &data, scratch.get());
+    if (!s.ok() && !errors::IsOutOfRange(s)) {
+      return s;
+    }
+    // kChunkSize is a multiple of the entry size, so entries never straddle
+    // chunks unless the index is truncated.
+    if (data.size() % sizeof(uint64) != 0) {
+      return errors::DataLoss("truncated record index");
+    }
+    for (size_t i = 0; i < data.size(); i += sizeof(uint64)) {
+      offsets->push_back(core::DecodeFixed64(data.data() + i));
+    }
+    if (data.size() < kChunkSize) {
+      return Status::OK();
+    }
+    pos += data.size();
+  }
+}
+
 RecordReader::RecordReader(RandomAccessFile* file,
                            const RecordReaderOptions& options)
-    : options_(options),
-      input_stream_(new RandomAccessInputStream(file)),
-      last_read_failed_(false) {
+    : options_(options), last_read_failed_(false) {
+  if (options.buffer_size > 0 && options.readahead_blocks > 0) {
+    // The BufferedInputStream below issues sequential reads of buffer_size
+    // bytes, so they line up with the readahead blocks.
+    if (options.readahead_thread_pool != nullptr) {
+      readahead_file_.reset(new ReadaheadRandomAccessFile(
+          file, options.buffer_size, options.readahead_blocks,
+          options.readahead_thread_pool));
+    } else {
+      readahead_file_.reset(new ReadaheadRandomAccessFile(
+          file, options.buffer_size, options.readahead_blocks));
+    }
+    file = readahead_file_.get();
+  }
+  input_stream_.reset(new RandomAccessInputStream(file));
   if (options.buffer_size > 0) {
     input_stream_.reset(new BufferedInputStream(input_stream_.release(),
                                                 options.buffer_size, true));
@@ -79,12 +119,17 @@ RecordReader::RecordReader(RandomAccessFile* file,
   }
 }
 
+RecordReader::~RecordReader() = default;
+
 // Read n+4 bytes from file, verify that checksum of first n bytes is
 // stored in the last 4 bytes and store the first n bytes in *result.
 //
 // offset corresponds to the user-provided value to ReadRecord()
 // and is used only in error messages.
-Status RecordReader::ReadChecksummed(uint64 offset, size_t n, string* result) {
+//
+// If verify_checksum is false, the checksum is read but not checked.
+Status RecordReader::ReadChecksummed(uint64 offset, size_t n,
+                                     bool verify_checksum, string* result) {
   if (n >= SIZE_MAX - sizeof(uint32)) {
     return errors::DataLoss("record size too large");
   }
@@ -100,9 +145,11 @@ Status RecordReader::ReadChecksummed(uint64 offset, size_t n, string* result) {
     }
   }
 
-  const uint32 masked_crc = core::DecodeFixed32(result->data() + n);
-  if (crc32c::Unmask(masked_crc) != crc32c::Value(result->data(), n)) {
-    return errors::DataLoss("corrupted record at ", offset);
+  if (verify_checksum) {
+    const uint32 masked_crc = core::DecodeFixed32(result->data() + n);
+    if (crc32c::Unmask(masked_crc) != crc32c::Value(result->data(), n)) {
+      return errors::DataLoss("corrupted record at ", offset);
+    }
   }
   result->resize(n);
   return Status::OK();
@@ -126,7 +173,7 @@ Status RecordReader::ReadRecord(uint64* offset, string* record) {
   DCHECK_EQ(desired_pos, input_stream_->Tell());
 
   // Read header data.
-  Status s = ReadChecksummed(*offset, sizeof(uint64), record);
+  Status s = ReadChecksummed(*offset, sizeof(uint64), true, record);
   if (!s.ok()) {
     last_read_failed_ = true;
     return s;
@@ -134,7 +181,8 @@ Status RecordReader::ReadRecord(uint64* offset, string* record) {
   const uint64 length = core::DecodeFixed64(record->data());
 
   // Read data
-  s = ReadChecksummed(*offset + kHeaderSize, length, record);
+  s = ReadChecksummed(*offset + kHeaderSize, length,
+                      options_.verify_data_checksum, record);
   if (!s.ok()) {
     last_read_failed_ = true;
     if (errors::IsOutOfRange(s)) {
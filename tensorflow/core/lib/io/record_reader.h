@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_LIB_IO_RECORD_READER_H_
 #define TENSORFLOW_LIB_IO_RECORD_READER_H_
 
+#include <vector>
+
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
@@ -30,6 +32,10 @@ namespace tensorflow {
 
 class RandomAccessFile;
 
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace io {
 
 class RecordReaderOptions {
@@ -42,6 +48,21 @@ class RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64 buffer_size = 0;
 
+  // If both buffer_size and readahead_blocks are non-zero, up to
+  // readahead_blocks blocks of buffer_size bytes following the current read
+  // position are read asynchronously, so that file I/O overlaps with record
+  // parsing. Set to 1 for double buffering.
+  int64 readahead_blocks = 0;
+
+  // If set, the readahead reads are issued on this pool rather than on
+  // threads started by Env::SchedClosure(). Not owned; must outlive the
+  // RecordReader.
+  thread::ThreadPool* readahead_thread_pool = nullptr;
+
+  // If false, the checksum of each record's payload is not verified. The
+  // checksum of the record length is always verified.
+  bool verify_data_checksum = true;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
@@ -51,6 +72,12 @@ class RecordReaderOptions {
 #endif  // IS_SLIM_BUILD
 };
 
+// Reads an index written through RecordWriterOptions::index_file into
+// `offsets`, so that (*offsets)[i] is the offset of record i to pass to
+// RecordReader::ReadRecord(). Returns DATA_LOSS if the index is truncated.
+Status ReadRecordIndex(RandomAccessFile* index_file,
+                       std::vector<uint64>* offsets);
+
 // Low-level interface to read TFRecord files.
 //
 // If using compression or buffering, consider using SequentialRecordReader.
@@ -64,7 +91,7 @@ class RecordReader {
       RandomAccessFile* file,
       const RecordReaderOptions& options = RecordReaderOptions());
 
-  virtual ~RecordReader() = default;
+  virtual ~RecordReader();
 
   // Read the record at "*offset" into *record and update *offset to
   // point to the offset of the next record.  Returns OK on success,
@@ -72,9 +99,13 @@ class RecordReader {
   Status ReadRecord(uint64* offset, string* record);
 
  private:
-  Status ReadChecksummed(uint64 offset, size_t n, string* result);
+  Status ReadChecksummed(uint64 offset, size_t n, bool verify_checksum,
+                         string* result);
 
   RecordReaderOptions options_;
+  // Wraps the file passed to the constructor if readahead is enabled. Must
+  // outlive `input_stream_`.
+  std::unique_ptr<RandomAccessFile> readahead_file_;
   std::unique_ptr<InputStreamInterface> input_stream_;
   bool last_read_failed_;
 
@@ -22,9 +22,13 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -105,4 +109,274 @@ TEST(RecordReaderWriterTest, TestZlib) {
   }
 }
 
+TEST(RecordReaderWriterTest, TestReadahead) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_readahead_test";
+  const int kNumRecords = 1000;
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    for (int i = 0; i < kNumRecords; ++i) {
+      TF_EXPECT_OK(writer.WriteRecord(strings::StrCat("record_", i)));
+    }
+    TF_CHECK_OK(writer.Flush());
+  }
+
+  thread::ThreadPool pool(env, "test", 2);
+  for (auto buf_size : BufferSizes()) {
+    for (bool use_pool : {false, true}) {
+      std::unique_ptr<RandomAccessFile> read_file;
+      TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+      io::RecordReaderOptions options;
+      options.buffer_size = buf_size;
+      options.readahead_blocks = 2;
+      if (use_pool) {
+        options.readahead_thread_pool = &pool;
+      }
+      io::SequentialRecordReader reader(read_file.get(), options);
+      string record;
+      for (int i = 0; i < kNumRecords; ++i) {
+        TF_CHECK_OK(reader.ReadRecord(&record));
+        EXPECT_EQ(strings::StrCat("record_", i), record);
+      }
+      EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&record)));
+    }
+  }
+}
+
+TEST(RecordReaderWriterTest, TestSkipDataChecksum) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_checksum_test";
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    TF_EXPECT_OK(writer.WriteRecord("abc"));
+    TF_CHECK_OK(writer.Flush());
+  }
+  // Corrupt the record payload, which starts after the 12 byte header.
+  string contents;
+  TF_CHECK_OK(ReadFileToString(env, fname, &contents));
+  contents[12] = 'x';
+  TF_CHECK_OK(WriteStringToFile(env, fname, contents));
+
+  std::unique_ptr<RandomAccessFile> read_file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+  {
+    io::RecordReader reader(read_file.get());
+    uint64 offset = 0;
+    string record;
+    EXPECT_TRUE(errors::IsDataLoss(reader.ReadRecord(&offset, &record)));
+  }
+  {
+    io::RecordReaderOptions options;
+    options.verify_data_checksum = false;
+    io::RecordReader reader(read_file.get(), options);
+    uint64 offset = 0;
+    string record;
+    TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+    EXPECT_EQ("xbc", record);
+  }
+}
+
+TEST(RecordReaderWriterTest, TestParallelCompression) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_parallel_test";
+  const int kNumRecords = 1000;
+  thread::ThreadPool pool(env, "test", 4);
+  for (const string compression_type : {"ZLIB", "GZIP"}) {
+    for (int block_size : {1, 100, 65536}) {
+      {
+        std::unique_ptr<WritableFile> file;
+        TF_CHECK_OK(env->NewWritableFile(fname, &file));
+        io::RecordWriterOptions options =
+            io::RecordWriterOptions::CreateRecordWriterOptions(
+                compression_type);
+        options.zlib_options.input_buffer_size = block_size;
+        options.compression_thread_pool = &pool;
+        io::RecordWriter writer(file.get(), options);
+        for (int i = 0; i < kNumRecords; ++i) {
+          TF_EXPECT_OK(writer.WriteRecord(strings::StrCat("record_", i)));
+          if (i == kNumRecords / 2) {
+            TF_EXPECT_OK(writer.Flush());
+          }
+        }
+        TF_CHECK_OK(writer.Close());
+      }
+
+      std::unique_ptr<RandomAccessFile> read_file;
+      TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+      io::SequentialRecordReader reader(
+          read_file.get(),
+          io::RecordReaderOptions::CreateRecordReaderOptions(compression_type));
+      string record;
+      for (int i = 0; i < kNumRecords; ++i) {
+        TF_CHECK_OK(reader.ReadRecord(&record));
+        EXPECT_EQ(strings::StrCat("record_", i), record);
+      }
+      EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&record)));
+    }
+  }
+}
+
+TEST(RecordReaderWriterTest, TestIndex) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_index_test";
+  string index_fname = fname + ".index";
+  const int kNumRecords = 1000;
+  for (const string compression_type : {"", "ZLIB"}) {
+    {
+      std::unique_ptr<WritableFile> file;
+      TF_CHECK_OK(env->NewWritableFile(fname, &file));
+      std::unique_ptr<WritableFile> index_file;
+      TF_CHECK_OK(env->NewWritableFile(index_fname, &index_file));
+      io::RecordWriterOptions options =
+          io::RecordWriterOptions::CreateRecordWriterOptions(compression_type);
+      options.index_file = index_file.get();
+      io::RecordWriter writer(file.get(), options);
+      for (int i = 0; i < kNumRecords; ++i) {
+        TF_EXPECT_OK(writer.WriteRecord(strings::StrCat("record_", i)));
+      }
+      TF_CHECK_OK(writer.Close());
+      TF_CHECK_OK(index_file->Close());
+    }
+
+    std::unique_ptr<RandomAccessFile> index_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(index_fname, &index_file));
+    std::vector<uint64> offsets;
+    TF_CHECK_OK(io::ReadRecordIndex(index_file.get(), &offsets));
+    ASSERT_EQ(kNumRecords, offsets.size());
+
+    std::unique_ptr<RandomAccessFile> read_file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &read_file));
+    io::RecordReader reader(
+        read_file.get(),
+        io::RecordReaderOptions::CreateRecordReaderOptions(compression_type));
+    string record;
+    for (int i : {0, 999, 500, 1, 998, 499, 501, 0}) {
+      uint64 offset = offsets[i];
+      TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+      EXPECT_EQ(strings::StrCat("record_", i), record);
+      if (i + 1 < kNumRecords) {
+        EXPECT_EQ(offsets[i + 1], offset);
+      }
+    }
+  }
+
+  // An index whose size is not a multiple of the entry size is rejected.
+  TF_CHECK_OK(WriteStringToFile(env, index_fname, string(12, '\0')));
+  std::unique_ptr<RandomAccessFile> index_file;
+  TF_CHECK_OK(env->NewRandomAccessFile(index_fname, &index_file));
+  std::vector<uint64> offsets;
+  EXPECT_TRUE(
+      errors::IsDataLoss(io::ReadRecordIndex(index_file.get(), &offsets)));
+}
+
+// Reads 10 records chosen uniformly at random from a 16MB file, either by
+// scanning from the start of the file or through the record index.
+static void BM_ReadRandomRecords(int iters, int use_index) {
+  testing::StopTiming();
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/record_reader_index_benchmark";
+  const int kRecordSize = 1024;
+  const int kNumRecords = 16 << 10;
+  const int kNumSamples = 10;
+  std::vector<uint64> offsets;
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    std::unique_ptr<WritableFile> index_file;
+    TF_CHECK_OK(env->NewWritableFile(fname + ".index", &index_file));
+    io::RecordWriterOptions options;
+    options.index_file = index_file.get();
+    io::RecordWriter writer(file.get(), options);
+    const string record(kRecordSize, 'x');
+    for (int i = 0; i < kNumRecords; ++i) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+    TF_CHECK_OK(file->Close());
+    TF_CHECK_OK(index_file->Close());
+  }
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumSamples);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (use_index) {
+      // Loading the index is part of the cost of random access.
+      std::unique_ptr<RandomAccessFile> index_file;
+      TF_CHECK_OK(env->NewRandomAccessFile(fname + ".index", &index_file));
+      TF_CHECK_OK(io::ReadRecordIndex(index_file.get(), &offsets));
+    }
+    string record;
+    for (int j = 0; j < kNumSamples; ++j) {
+      const int index = rnd.Uniform(kNumRecords);
+      if (use_index) {
+        io::RecordReader reader(file.get());
+        uint64 offset = offsets[index];
+        TF_CHECK_OK(reader.ReadRecord(&offset, &record));
+      } else {
+        io::RecordReaderOptions options;
+        options.buffer_size = 256 << 10;
+        io::SequentialRecordReader reader(file.get(), options);
+        for (int k = 0; k <= index; ++k) {
+          TF_CHECK_OK(reader.ReadRecord(&record));
+        }
+      }
+    }
+  }
+}
+BENCHMARK(BM_ReadRandomRecords)->Arg(0)->Arg(1);
+
+// Writes 16MB of ZLIB compressed records made of words drawn from a small
+// vocabulary, with `num_threads` compression threads (0 for the serial
+// ZlibOutputBuffer). The label reports the compression ratio.
+static void BM_WriteZlibRecords(int iters, int num_threads) {
+  testing::StopTiming();
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/record_writer_benchmark";
+  const int kRecordSize = 1024;
+  const int kNumRecords = 16 << 10;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<string> records(kNumRecords);
+  for (string& record : records) {
+    while (record.size() < kRecordSize) {
+      strings::StrAppend(&record, "word", rnd.Uniform(1000), " ");
+    }
+    record.resize(kRecordSize);
+  }
+  std::unique_ptr<thread::ThreadPool> pool;
+  if (num_threads > 0) {
+    pool.reset(new thread::ThreadPool(env, "compress", num_threads));
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumRecords *
+                          kRecordSize);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriterOptions options =
+        io::RecordWriterOptions::CreateRecordWriterOptions("ZLIB");
+    options.compression_thread_pool = pool.get();
+    io::RecordWriter writer(file.get(), options);
+    for (const string& record : records) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+    TF_CHECK_OK(file->Close());
+  }
+  testing::StopTiming();
+  uint64 file_size;
+  TF_CHECK_OK(env->GetFileSize(fname, &file_size));
+  testing::SetLabel(strings::Printf(
+      "ratio %.2f", static_cast<double>(kNumRecords) * kRecordSize /
+                        static_cast<double>(file_size)));
+}
+BENCHMARK(BM_WriteZlibRecords)->Arg(0)->Arg(1)->Arg(4)->Arg(8);
+
 }  // namespace tensorflow
@@ -62,15 +62,25 @@ RecordWriter::RecordWriter(WritableFile* dest,
 #if defined(IS_SLIM_BUILD)
     LOG(FATAL) << "Zlib compression is unsupported on mobile platforms.";
 #else   // IS_SLIM_BUILD
-    ZlibOutputBuffer* zlib_output_buffer = new ZlibOutputBuffer(
-        dest, options.zlib_options.input_buffer_size,
-        options.zlib_options.output_buffer_size, options.zlib_options);
-    Status s = zlib_output_buffer->Init();
+    Status s;
+    if (options.compression_thread_pool != nullptr) {
+      ParallelZlibOutputBuffer* zlib_output_buffer =
+          new ParallelZlibOutputBuffer(
+              dest, options.zlib_options.input_buffer_size,
+              options.compression_thread_pool, options.zlib_options);
+      s = zlib_output_buffer->Init();
+      dest_ = zlib_output_buffer;
+    } else {
+      ZlibOutputBuffer* zlib_output_buffer = new ZlibOutputBuffer(
+          dest, options.zlib_options.input_buffer_size,
+          options.zlib_options.output_buffer_size, options.zlib_options);
+      s = zlib_output_buffer->Init();
+      dest_ = zlib_output_buffer;
+    }
     if (!s.ok()) {
       LOG(FATAL) << "Failed to initialize Zlib inputbuffer. Error: "
                  << s.ToString();
     }
-    dest_ = zlib_output_buffer;
 #endif  // IS_SLIM_BUILD
   } else if (options.compression_type == RecordWriterOptions::NONE) {
     // Nothing to do
@@ -107,7 +117,16 @@ Status RecordWriter::WriteRecord(StringPiece data) {
 
   TF_RETURN_IF_ERROR(dest_->Append(StringPiece(header, sizeof(header))));
   TF_RETURN_IF_ERROR(dest_->Append(data));
-  return dest_->Append(StringPiece(footer, sizeof(footer)));
+  TF_RETURN_IF_ERROR(dest_->Append(StringPiece(footer, sizeof(footer))));
+
+  if (options_.index_file != nullptr) {
+    char index_entry[sizeof(uint64)];
+    core::EncodeFixed64(index_entry, offset_);
+    TF_RETURN_IF_ERROR(options_.index_file->Append(
+        StringPiece(index_entry, sizeof(index_entry))));
+  }
+  offset_ += sizeof(header) + data.size() + sizeof(footer);
+  return Status::OK();
 }
 
 Status RecordWriter::Close() {
@@ -29,6 +29,10 @@ namespace tensorflow {
 
 class WritableFile;
 
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace io {
 
 class RecordWriterOptions {
@@ -39,9 +43,24 @@ class RecordWriterOptions {
   static RecordWriterOptions CreateRecordWriterOptions(
       const string& compression_type);
 
+  // If set, the offset of every record written is appended to this file as a
+  // fixed64, so that record i can later be read directly from the offset
+  // stored at byte 8 * i (see ReadRecordIndex()). Offsets are positions in the
+  // uncompressed record stream, as accepted by RecordReader::ReadRecord();
+  // with compression, reading an offset still requires inflating the file up
+  // to it. Like the destination file, `index_file` must be initially empty
+  // and is neither flushed nor closed by the RecordWriter. Not owned.
+  WritableFile* index_file = nullptr;
+
 // Options specific to zlib compression.
 #if !defined(IS_SLIM_BUILD)
   ZlibCompressionOptions zlib_options;
+
+  // If set, the output is compressed in parallel on this pool, in independent
+  // blocks of zlib_options.input_buffer_size bytes (see
+  // ParallelZlibOutputBuffer). The file is readable like any other ZLIB or
+  // GZIP TFRecord file. Not owned; must outlive the RecordWriter.
+  thread::ThreadPool* compression_thread_pool = nullptr;
 #endif  // IS_SLIM_BUILD
 };
 
@@ -75,6 +94,8 @@ class RecordWriter {
  private:
   WritableFile* dest_;
   RecordWriterOptions options_;
+  // Offset of the next record in the uncompressed record stream.
+  uint64 offset_ = 0;
 
   TF_DISALLOW_COPY_AND_ASSIGN(RecordWriter);
 };
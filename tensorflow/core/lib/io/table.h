@@ -62,6 +62,13 @@ class Table {
   // be close to the file length.
   uint64 ApproximateOffsetOf(const StringPiece& key) const;
 
+  // Looks up "key".  If the table contains it, stores the corresponding value
+  // in "*value" and returns OK.  Returns NOT_FOUND if the table does not
+  // contain "key".  Unlike seeking an iterator, this consults the filter of
+  // the candidate block (see Options::filter_policy), so most lookups of
+  // missing keys do not read any data block.
+  Status Get(const StringPiece& key, string* value) const;
+
  private:
   struct Rep;
   Rep* rep_;
@@ -69,6 +76,9 @@ class Table {
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const StringPiece&);
 
+  void ReadMeta(const Footer& footer);
+  void ReadFilter(const StringPiece& filter_handle_value);
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
@@ -21,6 +21,9 @@ limitations under the License.
 namespace tensorflow {
 namespace table {
 
+class Cache;
+class FilterPolicy;
+
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
 // being stored in a file.  The following enum describes which
@@ -60,6 +63,17 @@ struct Options {
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
+
+  // If non-null, use the specified cache for blocks read by Table.  The cache
+  // may be shared by many tables, and must outlive all of them.  With a null
+  // cache every lookup reads (and decompresses) its data block from the file.
+  Cache* block_cache = nullptr;
+
+  // If non-null, TableBuilder stores a filter built with this policy for the
+  // keys of every data block, and Table::Get() consults it to avoid reading
+  // blocks that cannot contain the looked-up key.  Tables must be opened with
+  // a policy of the same Name() for the filters to be used.  Not owned.
+  const FilterPolicy* filter_policy = nullptr;
 };
 
 }  // namespace table
@@ -17,19 +17,25 @@ limitations under the License.
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/block.h"
 #include "tensorflow/core/lib/io/block_builder.h"
+#include "tensorflow/core/lib/io/cache.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
 #include "tensorflow/core/lib/io/format.h"
 #include "tensorflow/core/lib/io/iterator.h"
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/snappy.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace table {
@@ -223,12 +229,15 @@ class TableConstructor : public Constructor {
 
     // Open the table
     source_ = new StringSource(sink.contents());
-    Options table_options;
-    return Table::Open(table_options, source_, sink.contents().size(), &table_);
+    return Table::Open(options, source_, sink.contents().size(), &table_);
   }
 
   Iterator* NewIterator() const override { return table_->NewIterator(); }
 
+  Status Get(const StringPiece& key, string* value) const {
+    return table_->Get(key, value);
+  }
+
   uint64 ApproximateOffsetOf(const StringPiece& key) const {
     return table_->ApproximateOffsetOf(key);
   }
@@ -621,5 +630,154 @@ TEST(TableTest, SeekToFirstKeyDoesNotReadTooMuch) {
   EXPECT_LT(c.BytesRead(), 200);
 }
 
+TEST(TableTest, Get) {
+  TableConstructor c;
+  c.Add("k01", "hello");
+  c.Add("k02", string(10000, 'x'));
+  c.Add("k03", "hello3");
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  c.Finish(options, &keys, &kvmap);
+
+  string value;
+  TF_EXPECT_OK(c.Get("k01", &value));
+  EXPECT_EQ("hello", value);
+  TF_EXPECT_OK(c.Get("k02", &value));
+  EXPECT_EQ(string(10000, 'x'), value);
+  TF_EXPECT_OK(c.Get("k03", &value));
+  EXPECT_EQ("hello3", value);
+  EXPECT_TRUE(errors::IsNotFound(c.Get("k00", &value)));
+  EXPECT_TRUE(errors::IsNotFound(c.Get("k01a", &value)));
+  EXPECT_TRUE(errors::IsNotFound(c.Get("k04", &value)));
+}
+
+TEST(TableTest, FilterPolicy) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  TableConstructor c;
+  for (int i = 0; i < 1000; i++) {
+    c.Add(strings::Printf("k%05d", 2 * i), strings::Printf("v%05d", i));
+  }
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.filter_policy = policy.get();
+  c.Finish(options, &keys, &kvmap);
+
+  string value;
+  for (int i = 0; i < 1000; i++) {
+    TF_EXPECT_OK(c.Get(strings::Printf("k%05d", 2 * i), &value));
+    EXPECT_EQ(strings::Printf("v%05d", i), value);
+  }
+
+  // Missing keys between existing ones fall into a data block, but the
+  // filter of that block almost always rules them out.
+  const uint64 bytes_read = c.BytesRead();
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(
+        errors::IsNotFound(c.Get(strings::Printf("k%05d", 2 * i + 1), &value)));
+  }
+  EXPECT_LT(c.BytesRead() - bytes_read, 50 * 1024);
+}
+
+TEST(TableTest, FilterPolicyMismatch) {
+  // Tables written without filters, or with filters of another policy, are
+  // still readable.
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  TableConstructor c;
+  c.Add("k01", "hello");
+  c.Add("k03", "hello3");
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  c.Finish(options, &keys, &kvmap);
+
+  options.filter_policy = policy.get();
+  TableConstructor c2;
+  c2.Add("k01", "hello");
+  c2.Add("k03", "hello3");
+  c2.Finish(options, &keys, &kvmap);
+
+  for (TableConstructor* t : {&c, &c2}) {
+    string value;
+    TF_EXPECT_OK(t->Get("k03", &value));
+    EXPECT_EQ("hello3", value);
+    EXPECT_TRUE(errors::IsNotFound(t->Get("k02", &value)));
+  }
+}
+
+TEST(TableTest, BlockCache) {
+  std::unique_ptr<Cache> cache(NewLRUCache(1 << 20));
+  TableConstructor c;
+  for (int i = 0; i < 100; i++) {
+    c.Add(strings::Printf("k%05d", i), string(100, 'a' + i % 26));
+  }
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.block_cache = cache.get();
+  c.Finish(options, &keys, &kvmap);
+
+  string value;
+  TF_EXPECT_OK(c.Get("k00050", &value));
+  EXPECT_EQ(string(100, 'a' + 50 % 26), value);
+  const uint64 bytes_read = c.BytesRead();
+  EXPECT_GT(cache->TotalCharge(), 0);
+
+  // The block is served from the cache, by Get() as well as by iterators.
+  TF_EXPECT_OK(c.Get("k00050", &value));
+  EXPECT_EQ(string(100, 'a' + 50 % 26), value);
+  std::unique_ptr<Iterator> iter(c.NewIterator());
+  iter->Seek("k00050");
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_EQ(string(100, 'a' + 50 % 26), iter->value());
+  EXPECT_EQ(bytes_read, c.BytesRead());
+}
+
+// Point lookups in a table of 10000 entries spread over 4KB blocks, half of
+// them for missing keys.
+static void BM_TableGet(int iters, int use_cache, int use_filter) {
+  testing::StopTiming();
+  std::unique_ptr<Cache> cache(NewLRUCache(64 << 20));
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  const int kNumEntries = 10000;
+  TableConstructor c;
+  string tmp;
+  for (int i = 0; i < kNumEntries; i++) {
+    c.Add(strings::Printf("k%08d", 2 * i),
+          test::CompressibleString(&rnd, 0.5, 100, &tmp));
+  }
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 4096;
+  if (use_cache) options.block_cache = cache.get();
+  if (use_filter) options.filter_policy = policy.get();
+  c.Finish(options, &keys, &kvmap);
+  std::vector<string> lookups;
+  for (int i = 0; i < 1000; i++) {
+    lookups.push_back(strings::Printf("k%08d", rnd.Uniform(2 * kNumEntries)));
+  }
+  string value;
+  testing::ItemsProcessed(static_cast<int64>(iters) * lookups.size());
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    for (const string& key : lookups) {
+      c.Get(key, &value).IgnoreError();
+    }
+  }
+}
+BENCHMARK(BM_TableGet)
+    ->ArgPair(0, 0)
+    ->ArgPair(0, 1)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1);
+
 }  // namespace table
 }  // namespace tensorflow
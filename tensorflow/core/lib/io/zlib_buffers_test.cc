@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
@@ -106,6 +107,84 @@ TEST(ZlibBuffers, Gzip) {
   TestAllCombinations(CompressionOptions::GZIP(), CompressionOptions::GZIP());
 }
 
+void TestParallelCompression(CompressionOptions input_options,
+                             CompressionOptions output_options) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/zlib_buffers_parallel_test";
+  thread::ThreadPool pool(env, "test", 4);
+  for (auto file_size : NumCopies()) {
+    string data = GenTestString(file_size);
+    for (auto block_size : InputBufferSizes()) {
+      for (bool with_flush : {false, true}) {
+        std::unique_ptr<WritableFile> file_writer;
+        TF_ASSERT_OK(env->NewWritableFile(fname, &file_writer));
+        ParallelZlibOutputBuffer out(file_writer.get(), block_size, &pool,
+                                     output_options);
+        TF_ASSERT_OK(out.Init());
+        StringPiece remaining(data);
+        while (!remaining.empty()) {
+          const size_t n = std::min<size_t>(remaining.size(), 777);
+          TF_ASSERT_OK(out.Append(remaining.substr(0, n)));
+          remaining.remove_prefix(n);
+          if (with_flush) {
+            TF_ASSERT_OK(out.Flush());
+          }
+        }
+        TF_ASSERT_OK(out.Close());
+        TF_ASSERT_OK(file_writer->Close());
+
+        std::unique_ptr<RandomAccessFile> file_reader;
+        TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file_reader));
+        std::unique_ptr<RandomAccessInputStream> input_stream(
+            new RandomAccessInputStream(file_reader.get()));
+        ZlibInputStream in(input_stream.get(), 1000, 1000, input_options);
+        // Reading past the end makes zlib verify the stream trailer.
+        string result;
+        EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(data.size() + 1,
+                                                       &result)));
+        EXPECT_EQ(result, data);
+      }
+    }
+  }
+}
+
+TEST(ParallelZlibOutputBuffer, DefaultOptions) {
+  TestParallelCompression(CompressionOptions::DEFAULT(),
+                          CompressionOptions::DEFAULT());
+}
+
+TEST(ParallelZlibOutputBuffer, RawDeflate) {
+  TestParallelCompression(CompressionOptions::RAW(), CompressionOptions::RAW());
+}
+
+TEST(ParallelZlibOutputBuffer, Gzip) {
+  TestParallelCompression(CompressionOptions::GZIP(),
+                          CompressionOptions::GZIP());
+}
+
+TEST(ParallelZlibOutputBuffer, EmptyStream) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/zlib_buffers_parallel_empty_test";
+  thread::ThreadPool pool(env, "test", 2);
+  std::unique_ptr<WritableFile> file_writer;
+  TF_ASSERT_OK(env->NewWritableFile(fname, &file_writer));
+  ParallelZlibOutputBuffer out(file_writer.get(), 100, &pool,
+                               CompressionOptions::GZIP());
+  TF_ASSERT_OK(out.Init());
+  TF_ASSERT_OK(out.Close());
+  TF_ASSERT_OK(file_writer->Close());
+  EXPECT_TRUE(errors::IsFailedPrecondition(out.Append("abc")));
+
+  std::unique_ptr<RandomAccessFile> file_reader;
+  TF_ASSERT_OK(env->NewRandomAccessFile(fname, &file_reader));
+  std::unique_ptr<RandomAccessInputStream> input_stream(
+      new RandomAccessInputStream(file_reader.get()));
+  ZlibInputStream in(input_stream.get(), 100, 100, CompressionOptions::GZIP());
+  string result;
+  EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(1, &result)));
+  EXPECT_EQ("", result);
+}
+
 void TestMultipleWrites(uint8 input_buf_size, uint8 output_buf_size,
                         int num_writes, bool with_flush = false) {
   Env* env = Env::Default();
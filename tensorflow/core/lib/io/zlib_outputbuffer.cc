@@ -15,7 +15,11 @@ limitations under the License.
 
 #include "tensorflow/core/lib/io/zlib_outputbuffer.h"
 
+#include <algorithm>
+
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 namespace io {
@@ -223,5 +227,236 @@ Status ZlibOutputBuffer::Deflate(int flush) {
   return errors::DataLoss(error_string);
 }
 
+ParallelZlibOutputBuffer::ParallelZlibOutputBuffer(
+    WritableFile* file, int64 block_bytes, thread::ThreadPool* thread_pool,
+    const ZlibCompressionOptions& zlib_options)
+    : file_(file),
+      block_bytes_(block_bytes),
+      thread_pool_(thread_pool),
+      zlib_options_(zlib_options) {
+  DCHECK_GT(block_bytes_, 0);
+}
+
+ParallelZlibOutputBuffer::~ParallelZlibOutputBuffer() {
+  if (!closed_) {
+    LOG(WARNING)
+        << "ParallelZlibOutputBuffer::Close() not called. Possible data loss";
+  }
+  mutex_lock l(mu_);
+  for (const auto& block : pending_) {
+    while (!block->done) {
+      cond_var_.wait(l);
+    }
+  }
+}
+
+Status ParallelZlibOutputBuffer::Init() {
+  const int window_bits = zlib_options_.window_bits;
+  if (window_bits >= 8 && window_bits <= 15) {
+    format_ = kZlib;
+    window_bits_ = window_bits;
+  } else if (window_bits >= 16 + 8 && window_bits <= 16 + 15) {
+    format_ = kGzip;
+    window_bits_ = window_bits - 16;
+  } else if (window_bits >= -15 && window_bits <= -8) {
+    format_ = kRaw;
+    window_bits_ = -window_bits;
+  } else {
+    return errors::InvalidArgument("Unsupported window_bits: ", window_bits);
+  }
+  // zlib silently uses a 512 byte window when asked for a 256 byte one.
+  window_bits_ = std::max(window_bits_, 9);
+
+  // Validate the remaining options up front rather than on the first block.
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int status = deflateInit2(&stream, zlib_options_.compression_level,
+                            zlib_options_.compression_method, -window_bits_,
+                            zlib_options_.mem_level,
+                            zlib_options_.compression_strategy);
+  if (status != Z_OK) {
+    return errors::InvalidArgument("deflateInit failed with status", status);
+  }
+  deflateEnd(&stream);
+
+  int level = zlib_options_.compression_level;
+  if (level == Z_DEFAULT_COMPRESSION) level = 6;
+  const bool fast = zlib_options_.compression_strategy >= Z_HUFFMAN_ONLY ||
+                    level < 2;
+  string header;
+  switch (format_) {
+    case kZlib: {
+      // CMF and FLG bytes as described in RFC 1950.
+      const int flevel = fast ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+      uint16 cmf_flg = ((Z_DEFLATED + ((window_bits_ - 8) << 4)) << 8) |
+                       (flevel << 6);
+      cmf_flg += 31 - cmf_flg % 31;
+      header.push_back(static_cast<char>(cmf_flg >> 8));
+      header.push_back(static_cast<char>(cmf_flg & 0xff));
+      check_ = adler32(0L, Z_NULL, 0);
+      break;
+    }
+    case kGzip: {
+      // Same header as written by deflate(): no file name, no extra data, no
+      // comment, no modification time and an unknown operating system.
+      const char xfl = level == 9 ? 2 : fast ? 4 : 0;
+      header = {'\x1f', '\x8b', Z_DEFLATED, 0, 0, 0, 0, 0, xfl, '\xff'};
+      check_ = crc32(0L, Z_NULL, 0);
+      break;
+    }
+    case kRaw:
+      break;
+  }
+  if (!header.empty()) {
+    TF_RETURN_IF_ERROR(file_->Append(header));
+  }
+  input_.reserve(block_bytes_);
+  return Status::OK();
+}
+
+void ParallelZlibOutputBuffer::Compress(Block* block) const {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int error = deflateInit2(&stream, zlib_options_.compression_level,
+                           zlib_options_.compression_method, -window_bits_,
+                           zlib_options_.mem_level,
+                           zlib_options_.compression_strategy);
+  if (error != Z_OK) {
+    block->status = errors::DataLoss("deflateInit failed with status ", error);
+    return;
+  }
+  const int flush = block->last ? Z_FINISH : Z_SYNC_FLUSH;
+  // deflateBound() does not account for the sync flush marker.
+  block->output.resize(deflateBound(&stream, block->input.size()) + 16);
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(block->input.data()));
+  stream.avail_in = block->input.size();
+  while (true) {
+    stream.next_out =
+        reinterpret_cast<Bytef*>(&block->output[stream.total_out]);
+    stream.avail_out = block->output.size() - stream.total_out;
+    error = deflate(&stream, flush);
+    if (error == Z_STREAM_END) break;
+    if (error != Z_OK && error != Z_BUF_ERROR) {
+      string error_string =
+          strings::StrCat("deflate() failed with error ", error);
+      if (stream.msg != nullptr) {
+        strings::StrAppend(&error_string, ": ", stream.msg);
+      }
+      block->status = errors::DataLoss(error_string);
+      break;
+    }
+    if (flush == Z_SYNC_FLUSH && stream.avail_out > 0) break;
+    block->output.resize(block->output.size() * 2);
+  }
+  block->output.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  const Bytef* data = reinterpret_cast<const Bytef*>(block->input.data());
+  if (format_ == kZlib) {
+    block->check = adler32(adler32(0L, Z_NULL, 0), data, block->input.size());
+  } else if (format_ == kGzip) {
+    block->check = crc32(crc32(0L, Z_NULL, 0), data, block->input.size());
+  }
+}
+
+void ParallelZlibOutputBuffer::ScheduleBlock(bool last) {
+  std::shared_ptr<Block> block = std::make_shared<Block>();
+  block->input.swap(input_);
+  block->last = last;
+  input_.reserve(block_bytes_);
+  pending_.push_back(block);
+  thread_pool_->Schedule([this, block]() {
+    Compress(block.get());
+    mutex_lock l(mu_);
+    block->done = true;
+    cond_var_.notify_all();
+  });
+}
+
+Status ParallelZlibOutputBuffer::WriteBlocks(size_t max_pending) {
+  while (!pending_.empty()) {
+    std::shared_ptr<Block> block = pending_.front();
+    {
+      mutex_lock l(mu_);
+      if (!block->done && pending_.size() <= max_pending) break;
+      while (!block->done) {
+        cond_var_.wait(l);
+      }
+    }
+    pending_.pop_front();
+    TF_RETURN_IF_ERROR(block->status);
+    TF_RETURN_IF_ERROR(file_->Append(block->output));
+    const uLong size = block->input.size();
+    if (format_ == kZlib) {
+      check_ = adler32_combine(check_, block->check, size);
+    } else if (format_ == kGzip) {
+      check_ = crc32_combine(check_, block->check, size);
+    }
+    total_in_ += size;
+  }
+  return Status::OK();
+}
+
+Status ParallelZlibOutputBuffer::Append(const StringPiece& data) {
+  if (closed_) {
+    return errors::FailedPrecondition("Append() called after Close()");
+  }
+  StringPiece remaining = data;
+  while (!remaining.empty()) {
+    const size_t n = std::min<size_t>(remaining.size(),
+                                      block_bytes_ - input_.size());
+    input_.append(remaining.data(), n);
+    remaining.remove_prefix(n);
+    if (input_.size() == block_bytes_) {
+      ScheduleBlock(false);
+      TF_RETURN_IF_ERROR(WriteBlocks(2 * thread_pool_->NumThreads()));
+    }
+  }
+  return Status::OK();
+}
+
+Status ParallelZlibOutputBuffer::Flush() {
+  if (closed_) {
+    return errors::FailedPrecondition("Flush() called after Close()");
+  }
+  if (!input_.empty()) {
+    ScheduleBlock(false);
+  }
+  return WriteBlocks(0);
+}
+
+Status ParallelZlibOutputBuffer::Sync() {
+  TF_RETURN_IF_ERROR(Flush());
+  return file_->Sync();
+}
+
+Status ParallelZlibOutputBuffer::Close() {
+  if (closed_) {
+    return errors::FailedPrecondition("Close() called twice");
+  }
+  closed_ = true;
+  // The last block ends the deflate stream even if it is empty.
+  ScheduleBlock(true);
+  TF_RETURN_IF_ERROR(WriteBlocks(0));
+  char trailer[2 * sizeof(uint32)];
+  switch (format_) {
+    case kZlib:
+      // The adler32 check value is stored in network byte order.
+      for (int i = 0; i < 4; ++i) {
+        trailer[i] = static_cast<char>((check_ >> (24 - 8 * i)) & 0xff);
+      }
+      return file_->Append(StringPiece(trailer, sizeof(uint32)));
+    case kGzip:
+      core::EncodeFixed32(trailer, static_cast<uint32>(check_));
+      core::EncodeFixed32(trailer + sizeof(uint32),
+                          static_cast<uint32>(total_in_));
+      return file_->Append(StringPiece(trailer, sizeof(trailer)));
+    case kRaw:
+      break;
+  }
+  return Status::OK();
+}
+
 }  // namespace io
 }  // namespace tensorflow
@@ -18,6 +18,8 @@ limitations under the License.
 
 #include <zlib.h>
 
+#include <deque>
+#include <memory>
 #include <string>
 
 #include "tensorflow/core/lib/core/status.h"
@@ -25,9 +27,15 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
+namespace thread {
+class ThreadPool;
+}  // namespace thread
+
 namespace io {
 
 // Provides support for writing compressed output to file using zlib
@@ -140,6 +148,102 @@ class ZlibOutputBuffer : public WritableFile {
   TF_DISALLOW_COPY_AND_ASSIGN(ZlibOutputBuffer);
 };
 
+// Writes the same zlib, gzip or raw deflate stream format as ZlibOutputBuffer,
+// but compresses it on a thread pool.
+//
+// The input is split into blocks of `block_bytes` bytes which are deflated
+// independently and concatenated in order (the approach taken by pigz). Every
+// block but the last ends with a sync flush marker, so the concatenation is a
+// single valid deflate stream, and the check value in the trailer is combined
+// from per-block values. The output can be read by ZlibInputStream or any
+// other zlib/gzip decoder. Since blocks do not share a history window, the
+// output is slightly larger than ZlibOutputBuffer's with the same options;
+// blocks of a few hundred KB make the difference negligible.
+//
+// `zlib_options.flush_mode`, `input_buffer_size` and `output_buffer_size` are
+// ignored.
+//
+// A given instance of a ParallelZlibOutputBuffer is NOT safe for concurrent
+// use by multiple threads.
+class ParallelZlibOutputBuffer : public WritableFile {
+ public:
+  // Does not take ownership of `file` or `thread_pool`, which must outlive
+  // *this.
+  // REQUIRES: block_bytes > 0
+  ParallelZlibOutputBuffer(WritableFile* file, int64 block_bytes,
+                           thread::ThreadPool* thread_pool,
+                           const ZlibCompressionOptions& zlib_options);
+
+  // Waits for blocks that are still being compressed. Any data that has not
+  // been written by `Close()` is lost.
+  ~ParallelZlibOutputBuffer() override;
+
+  // Validates the options and writes the stream header. This call is required
+  // before any other operation on the buffer.
+  Status Init();
+
+  // Adds `data` to the current block. Full blocks are handed to the thread
+  // pool, and compressed blocks are written to file in order. At most two
+  // blocks per pool thread are buffered at any time.
+  Status Append(const StringPiece& data) override;
+
+  // Compresses any cached input and writes all compressed blocks to file.
+  Status Flush() override;
+
+  // Compresses any cached input, ends the stream and writes the trailer.
+  // After calling this, any further calls to `Append()`, `Flush()` or
+  // `Close()` will fail. Does not close `file`.
+  Status Close() override;
+
+  // Flushes and syncs `file`.
+  Status Sync() override;
+
+ private:
+  struct Block {
+    string input;
+    bool last = false;
+    bool done = false;
+    Status status;
+    string output;
+    // adler32 (zlib) or crc32 (gzip) of `input`.
+    uLong check = 0;
+  };
+
+  enum Format { kZlib, kGzip, kRaw };
+
+  // Deflates `block->input` into `block->output`. Runs on the thread pool.
+  void Compress(Block* block) const;
+
+  // Hands the cached input to the thread pool as a new block.
+  void ScheduleBlock(bool last);
+
+  // Writes compressed blocks to file in order, waiting for blocks that are
+  // still in progress until at most `max_pending` blocks remain.
+  Status WriteBlocks(size_t max_pending);
+
+  WritableFile* const file_;  // Not owned
+  const int64 block_bytes_;
+  thread::ThreadPool* const thread_pool_;  // Not owned
+  const ZlibCompressionOptions zlib_options_;
+  Format format_ = kZlib;
+  int window_bits_ = MAX_WBITS;
+  bool closed_ = false;
+
+  // Input that has not been handed to the thread pool yet.
+  string input_;
+  // Blocks handed to the thread pool that have not been written yet, in
+  // stream order.
+  std::deque<std::shared_ptr<Block>> pending_;
+  // Check value and size of the data written so far.
+  uLong check_ = 0;
+  uint64 total_in_ = 0;
+
+  mutex mu_;
+  condition_variable cond_var_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParallelZlibOutputBuffer);
+};
+
 }  // namespace io
 }  // namespace tensorflow
 
@@ -129,6 +129,57 @@ REGISTER_OP("RestoreV2")
       }
     });
 
+REGISTER_OP("SaveDeltaV2")
+    .Input("prefix: string")
+    .Input("base_prefix: string")
+    .Input("tensor_names: string")
+    .Input("shape_and_slices: string")
+    .Input("tensors: dtypes")
+    .Input("rows_known: bool")
+    .Input("changed_rows: N * int64")
+    .Attr("dtypes: list(type)")
+    .Attr("N: int >= 1")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      ShapeHandle s;
+      DimensionHandle unused_dim;
+      int n;
+      TF_RETURN_IF_ERROR(c->GetAttr("N", &n));
+      const int num_tensors = c->num_inputs() - 5 - n;
+
+      // Validate prefix and base_prefix.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+
+      // Validate tensor_names, shapes_and_slices and rows_known.
+      for (int i : {2, 3, 4 + num_tensors}) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 1, &s));
+        TF_RETURN_IF_ERROR(
+            c->WithValue(c->Dim(s, 0), num_tensors, &unused_dim));
+      }
+      for (int i = 0; i < n; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(5 + num_tensors + i), 1, &s));
+      }
+      return Status::OK();
+    });
+
+REGISTER_OP("RestoreDeltaV2")
+    .Input("prefix: string")
+    .Input("tensor_names: string")
+    .Input("shape_and_slices: string")
+    .Output("tensors: dtypes")
+    .Attr("dtypes: list(type)")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle shape0, shape1, shape2;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &shape0));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &shape1));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &shape2));
+      TF_RETURN_IF_ERROR(c->Merge(shape1, shape2, &shape0));
+      return UnknownShape(c);
+    });
+
 REGISTER_OP("MergeV2Checkpoints")
     .Input("checkpoint_prefixes: string")
     .Input("destination_prefix: string")
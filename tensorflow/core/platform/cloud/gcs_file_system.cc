@@ -81,6 +81,10 @@ constexpr size_t kDefaultMaxCacheSize = 2 * kDefaultBlockSize;
 // will be evicted on the next read.
 constexpr char kMaxStaleness[] = "GCS_READ_CACHE_MAX_STALENESS";
 constexpr uint64 kDefaultMaxStaleness = 0;
+// The environment variable that sets the maximum number of blocks fetched ahead
+// of sequential reads, in parallel. A value of 0 (the default) disables
+// prefetching.
+constexpr char kPrefetchBlocks[] = "GCS_READ_CACHE_PREFETCH_BLOCKS";
 // The environment variable that overrides the maximum age of entries in the
 // Stat cache. A value of 0 (the default) means nothing is cached.
 constexpr char kStatCacheMaxAge[] = "GCS_STAT_CACHE_MAX_AGE";
@@ -627,6 +631,9 @@ GcsFileSystem::GcsFileSystem()
   if (GetEnvVar(kMaxStaleness, strings::safe_strtou64, &value)) {
     max_staleness = value;
   }
+  if (GetEnvVar(kPrefetchBlocks, strings::safe_strtou64, &value)) {
+    max_prefetch_blocks_ = value;
+  }
   if (std::getenv(kReadCacheDisabled)) {
     // Setting either to 0 disables the cache; set both for good measure.
     block_size = max_bytes = 0;
@@ -811,7 +818,7 @@ void GcsFileSystem::ResetFileBlockCache(size_t block_size_bytes,
 std::unique_ptr<FileBlockCache> GcsFileSystem::MakeFileBlockCache(
     size_t block_size, size_t max_bytes, uint64 max_staleness) {
   std::unique_ptr<FileBlockCache> file_block_cache(new RamFileBlockCache(
-      block_size, max_bytes, max_staleness,
+      block_size, max_bytes, max_staleness, max_prefetch_blocks_,
       [this](const string& filename, size_t offset, size_t n, char* buffer,
              size_t* bytes_transferred) {
         return LoadBufferFromGCS(filename, offset, n, buffer,
@@ -276,6 +276,9 @@ class GcsFileSystem : public FileSystem {
   mutex mu_;
   std::unique_ptr<AuthProvider> auth_provider_ GUARDED_BY(mu_);
   std::unique_ptr<HttpRequest::Factory> http_request_factory_;
+  // The maximum number of blocks the block cache fetches ahead of sequential
+  // reads. Must be declared before file_block_cache_.
+  size_t max_prefetch_blocks_ = 0;
   // block_cache_lock_ protects the file_block_cache_ pointer (Note that
   // FileBlockCache instances are themselves threadsafe).
   mutex block_cache_lock_;
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/platform/cloud/ram_file_block_cache.h"
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include "tensorflow/core/lib/gtl/cleanup.h"
@@ -76,15 +77,20 @@ Status RamFileBlockCache::UpdateLRU(const Key& key,
     block->lru_iterator = lru_list_.begin();
   }
 
-  // Check for inconsistent state. If there is a block later in the same file
-  // in the cache, and our current block is not block size, this likely means
-  // we have inconsistent state within the cache. Note: it's possible some
-  // incomplete reads may still go undetected.
+  // Check for inconsistent state. If there is a block with data later in the
+  // same file in the cache, and our current block is not block size, this
+  // likely means we have inconsistent state within the cache. Blocks that are
+  // still being prefetched, or that were prefetched past the end of the file,
+  // hold no data and are ignored. Note: it's possible some incomplete reads may
+  // still go undetected.
   if (block->data.size() < block_size_) {
-    Key fmax = std::make_pair(key.first, std::numeric_limits<size_t>::max());
-    auto fcmp = block_map_.upper_bound(fmax);
-    if (fcmp != block_map_.begin() && key < (--fcmp)->first) {
-      return errors::Internal("Block cache contents are inconsistent.");
+    for (auto it = block_map_.upper_bound(key);
+         it != block_map_.end() && it->first.first == key.first; ++it) {
+      mutex_lock l(it->second->mu);
+      if (it->second->state == FetchState::FINISHED &&
+          !it->second->data.empty()) {
+        return errors::Internal("Block cache contents are inconsistent.");
+      }
     }
   }
 
@@ -173,6 +179,7 @@ Status RamFileBlockCache::Read(const string& filename, size_t offset, size_t n,
     finish += block_size_;
   }
   size_t total_bytes_transferred = 0;
+  bool reached_eof = false;
   // Now iterate through the blocks, reading them one at a time.
   for (size_t pos = start; pos < finish; pos += block_size_) {
     Key key = std::make_pair(filename, pos);
@@ -210,13 +217,70 @@ Status RamFileBlockCache::Read(const string& filename, size_t offset, size_t n,
     }
     if (data.size() < block_size_) {
       // The block was a partial block and thus signals EOF at its upper bound.
+      reached_eof = true;
       break;
     }
   }
   *bytes_transferred = total_bytes_transferred;
+  if (prefetch_pool_ && !reached_eof) {
+    MaybePrefetch(filename, offset, offset + n, finish);
+  }
   return Status::OK();
 }
 
+void RamFileBlockCache::MaybePrefetch(const string& filename, size_t offset,
+                                      size_t end, size_t finish) {
+  // A read is sequential if it starts at most one block away from where the
+  // previous read of the file ended. Reads that start at the beginning of a
+  // file are likely to be the first of a sequential scan.
+  ReadPattern pattern;
+  size_t window = 0;
+  if (read_patterns_.Lookup(filename, &pattern)) {
+    if (offset + block_size_ >= pattern.end &&
+        offset <= pattern.end + block_size_) {
+      window = std::max<size_t>(1, 2 * pattern.window);
+    }
+  } else if (offset == 0) {
+    window = 1;
+  }
+  window = std::min(window, max_prefetch_blocks_);
+  window = std::min(window, max_bytes_ / block_size_ / 2);
+  pattern.end = end;
+  pattern.window = window;
+  read_patterns_.Insert(filename, pattern);
+
+  for (size_t i = 0; i < window; ++i) {
+    Key key = std::make_pair(filename, finish + i * block_size_);
+    {
+      mutex_lock lock(mu_);
+      if (block_map_.find(key) != block_map_.end()) {
+        continue;
+      }
+    }
+    std::shared_ptr<Block> block = Lookup(key);
+    prefetch_pool_->Schedule([this, key, block]() { Prefetch(key, block); });
+  }
+}
+
+void RamFileBlockCache::Prefetch(const Key& key,
+                                 const std::shared_ptr<Block>& block) {
+  // If a reader got to the block first, this waits for (or reuses) its fetch.
+  Status status = MaybeFetch(key, block);
+  if (status.ok() && !block->data.empty()) {
+    // Trim the cache to make room for the block.
+    UpdateLRU(key, block).IgnoreError();
+    return;
+  }
+  // The block is past the end of the file, or could not be fetched: drop it
+  // rather than let it occupy the cache. A reader will fetch it again if
+  // needed.
+  mutex_lock lock(mu_);
+  auto entry = block_map_.find(key);
+  if (entry != block_map_.end() && entry->second == block) {
+    RemoveBlock(entry);
+  }
+}
+
 bool RamFileBlockCache::ValidateAndUpdateFileSignature(const string& filename,
                                                        int64 file_signature) {
   mutex_lock lock(mu_);
@@ -262,6 +326,7 @@ void RamFileBlockCache::Flush() {
   lru_list_.clear();
   lra_list_.clear();
   cache_size_ = 0;
+  read_patterns_.Clear();
 }
 
 void RamFileBlockCache::RemoveFile(const string& filename) {
@@ -24,6 +24,8 @@ limitations under the License.
 #include <vector>
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/cloud/expiring_lru_cache.h"
 #include "tensorflow/core/platform/cloud/file_block_cache.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -37,6 +39,13 @@ namespace tensorflow {
 ///
 /// This class should be shared by read-only random access files on a remote
 /// filesystem (e.g. GCS).
+///
+/// If `max_prefetch_blocks` is non-zero, the cache detects sequential reads of
+/// a file and fetches the blocks that follow the read concurrently, in the
+/// background. The number of blocks fetched ahead starts at one and doubles
+/// with every sequential read, up to `max_prefetch_blocks` (and at most half of
+/// `max_bytes`, so that prefetched blocks do not evict the blocks being read).
+/// A non-sequential read stops the prefetching for the file.
 class RamFileBlockCache : public FileBlockCache {
  public:
   /// The callback executed when a block is not found in the cache, and needs to
@@ -51,20 +60,35 @@ class RamFileBlockCache : public FileBlockCache {
 
   RamFileBlockCache(size_t block_size, size_t max_bytes, uint64 max_staleness,
                     BlockFetcher block_fetcher, Env* env = Env::Default())
+      : RamFileBlockCache(block_size, max_bytes, max_staleness,
+                          0 /* max_prefetch_blocks */, block_fetcher, env) {}
+
+  RamFileBlockCache(size_t block_size, size_t max_bytes, uint64 max_staleness,
+                    size_t max_prefetch_blocks, BlockFetcher block_fetcher,
+                    Env* env = Env::Default())
       : block_size_(block_size),
         max_bytes_(max_bytes),
         max_staleness_(max_staleness),
+        max_prefetch_blocks_(max_prefetch_blocks),
         block_fetcher_(block_fetcher),
-        env_(env) {
+        env_(env),
+        read_patterns_(kReadPatternMaxAge, kMaxReadPatterns, env) {
     if (max_staleness_ > 0) {
       pruning_thread_.reset(env_->StartThread(ThreadOptions(), "TF_prune_FBC",
                                               [this] { Prune(); }));
     }
+    if (IsCacheEnabled() && max_prefetch_blocks_ > 0) {
+      prefetch_pool_.reset(new thread::ThreadPool(
+          env_, "TF_prefetch_FBC", static_cast<int>(max_prefetch_blocks_)));
+    }
     VLOG(1) << "GCS file block cache is "
             << (IsCacheEnabled() ? "enabled" : "disabled");
   }
 
   ~RamFileBlockCache() override {
+    // Destroying prefetch_pool_ will block until all scheduled prefetches have
+    // completed.
+    prefetch_pool_.reset();
     if (pruning_thread_) {
       stop_pruning_thread_.Notify();
       // Destroying pruning_thread_ will block until Prune() receives the above
@@ -108,6 +132,7 @@ class RamFileBlockCache : public FileBlockCache {
   size_t block_size() const override { return block_size_; }
   size_t max_bytes() const override { return max_bytes_; }
   uint64 max_staleness() const override { return max_staleness_; }
+  size_t max_prefetch_blocks() const { return max_prefetch_blocks_; }
 
   /// The current size (in bytes) of the cache.
   size_t CacheSize() const override LOCKS_EXCLUDED(mu_);
@@ -126,6 +151,8 @@ class RamFileBlockCache : public FileBlockCache {
   const size_t max_bytes_;
   /// The maximum staleness of any block in the LRU cache, in seconds.
   const uint64 max_staleness_;
+  /// The maximum number of blocks fetched ahead of sequential reads.
+  const size_t max_prefetch_blocks_;
   /// The callback to read a block from the underlying filesystem.
   const BlockFetcher block_fetcher_;
   /// The Env from which we read timestamps.
@@ -182,6 +209,19 @@ class RamFileBlockCache : public FileBlockCache {
     condition_variable cond_var;
   };
 
+  /// \brief The recent reads of a file, used to detect sequential reads.
+  struct ReadPattern {
+    /// The end offset of the last read.
+    size_t end = 0;
+    /// The number of blocks fetched ahead of the last read.
+    size_t window = 0;
+  };
+
+  /// The number of files for which the read pattern is tracked, and the time
+  /// (in seconds) after which an idle file starts over as a random reader.
+  static constexpr size_t kMaxReadPatterns = 1024;
+  static constexpr uint64 kReadPatternMaxAge = 60;
+
   /// \brief The block map type for the file block cache.
   ///
   /// The block map is an ordered map from Key to Block.
@@ -199,6 +239,16 @@ class RamFileBlockCache : public FileBlockCache {
   Status MaybeFetch(const Key& key, const std::shared_ptr<Block>& block)
       LOCKS_EXCLUDED(mu_);
 
+  /// Update the read pattern of `filename` with a read of [offset, end), and
+  /// schedule the fetches of the blocks following `finish` if the reads are
+  /// sequential.
+  void MaybePrefetch(const string& filename, size_t offset, size_t end,
+                     size_t finish) LOCKS_EXCLUDED(mu_);
+
+  /// Fetch the block at `key` on a prefetch thread.
+  void Prefetch(const Key& key, const std::shared_ptr<Block>& block)
+      LOCKS_EXCLUDED(mu_);
+
   /// Trim the block cache to make room for another entry.
   void Trim() EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
@@ -219,6 +269,13 @@ class RamFileBlockCache : public FileBlockCache {
   /// Notification for stopping the cache pruning thread.
   Notification stop_pruning_thread_;
 
+  /// The threads fetching blocks ahead of sequential reads. Null if
+  /// prefetching is disabled.
+  std::unique_ptr<thread::ThreadPool> prefetch_pool_;
+
+  /// The read pattern of recently read files.
+  ExpiringLRUCache<ReadPattern> read_patterns_;
+
   /// Guards access to the block map, LRU list, and cached byte count.
   mutable mutex mu_;
 
@@ -17,10 +17,13 @@ limitations under the License.
 #include <cstring>
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/cloud/now_seconds_env.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -560,5 +563,138 @@ TEST(RamFileBlockCacheTest, Flush) {
   EXPECT_EQ(calls, 2);
 }
 
+// Returns a fetcher for a file of `file_size` bytes, where byte i is 'a' + i %
+// 26, which counts the calls for each offset in `calls`.
+RamFileBlockCache::BlockFetcher CountingFetcher(
+    size_t file_size, mutex* mu, std::map<size_t, int>* calls) {
+  return [file_size, mu, calls](const string& filename, size_t offset,
+                                size_t n, char* buffer,
+                                size_t* bytes_transferred) {
+    {
+      mutex_lock l(*mu);
+      (*calls)[offset]++;
+    }
+    size_t i = 0;
+    for (; i < n && offset + i < file_size; ++i) {
+      buffer[i] = 'a' + (offset + i) % 26;
+    }
+    *bytes_transferred = i;
+    return Status::OK();
+  };
+}
+
+TEST(RamFileBlockCacheTest, PrefetchSequentialReads) {
+  const size_t block_size = 16;
+  const size_t file_size = 100 * block_size;
+  mutex mu;
+  std::map<size_t, int> calls;
+  {
+    RamFileBlockCache cache(block_size, 16 * block_size, 0, 4,
+                            CountingFetcher(file_size, &mu, &calls));
+    EXPECT_EQ(4, cache.max_prefetch_blocks());
+    std::vector<char> out;
+    for (size_t offset = 0; offset < file_size; offset += 10) {
+      TF_EXPECT_OK(ReadCache(&cache, "", offset, 10, &out));
+      ASSERT_EQ(10, out.size());
+      for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_EQ('a' + (offset + i) % 26, out[i]);
+      }
+    }
+    // Destroying the cache waits for the prefetches past the end of the file.
+  }
+  // Every block was fetched exactly once, whether by a read or a prefetch.
+  for (size_t offset = 0; offset < file_size; offset += block_size) {
+    EXPECT_EQ(1, gtl::FindWithDefault(calls, offset, 0)) << offset;
+  }
+}
+
+TEST(RamFileBlockCacheTest, PrefetchBlocksAhead) {
+  const size_t block_size = 16;
+  mutex mu;
+  std::map<size_t, int> calls;
+  Notification prefetched;
+  auto counting_fetcher = CountingFetcher(10 * block_size, &mu, &calls);
+  auto fetcher = [&counting_fetcher, &prefetched, block_size](
+                     const string& filename, size_t offset, size_t n,
+                     char* buffer, size_t* bytes_transferred) {
+    Status status =
+        counting_fetcher(filename, offset, n, buffer, bytes_transferred);
+    if (offset == block_size) {
+      prefetched.Notify();
+    }
+    return status;
+  };
+  RamFileBlockCache cache(block_size, 16 * block_size, 0, 4, fetcher);
+  std::vector<char> out;
+  // A read at the beginning of the file starts prefetching the next block.
+  TF_EXPECT_OK(ReadCache(&cache, "a", 0, block_size, &out));
+  EXPECT_TRUE(WaitForNotificationWithTimeout(&prefetched, 10000000));
+  TF_EXPECT_OK(ReadCache(&cache, "a", block_size, block_size, &out));
+  mutex_lock l(mu);
+  EXPECT_EQ(1, calls[block_size]);
+}
+
+TEST(RamFileBlockCacheTest, NoPrefetchForRandomReads) {
+  const size_t block_size = 16;
+  mutex mu;
+  std::map<size_t, int> calls;
+  {
+    RamFileBlockCache cache(block_size, 16 * block_size, 0, 4,
+                            CountingFetcher(10 * block_size, &mu, &calls));
+    std::vector<char> out;
+    for (size_t block : {5, 2, 9, 4, 7}) {
+      TF_EXPECT_OK(ReadCache(&cache, "", block * block_size, 4, &out));
+    }
+  }
+  EXPECT_EQ(5, calls.size());
+}
+
+TEST(RamFileBlockCacheTest, PrefetchPastEndOfFile) {
+  const size_t block_size = 16;
+  const size_t file_size = 2 * block_size + block_size / 2;
+  mutex mu;
+  std::map<size_t, int> calls;
+  RamFileBlockCache cache(block_size, 16 * block_size, 0, 4,
+                          CountingFetcher(file_size, &mu, &calls));
+  std::vector<char> out;
+  for (size_t offset = 0; offset < file_size; offset += block_size) {
+    TF_EXPECT_OK(ReadCache(&cache, "", offset, block_size, &out));
+  }
+  EXPECT_EQ(block_size / 2, out.size());
+  Status status = ReadCache(&cache, "", file_size + 1, block_size, &out);
+  EXPECT_EQ(error::OUT_OF_RANGE, status.code());
+  EXPECT_EQ(file_size, cache.CacheSize());
+}
+
+void BM_SequentialReads(int iters, int max_prefetch_blocks) {
+  testing::StopTiming();
+  const size_t block_size = 1 << 20;
+  const size_t file_size = 64 * block_size;
+  const int64 kLatencyMicros = 5000;
+  // Emulates a remote file system with a fixed latency per request.
+  auto fetcher = [file_size, kLatencyMicros](const string& filename,
+                                             size_t offset, size_t n,
+                                             char* buffer,
+                                             size_t* bytes_transferred) {
+    Env::Default()->SleepForMicroseconds(kLatencyMicros);
+    *bytes_transferred = offset < file_size ? std::min(n, file_size - offset)
+                                            : 0;
+    memset(buffer, 'x', *bytes_transferred);
+    return Status::OK();
+  };
+  RamFileBlockCache cache(block_size, 16 * block_size, 0, max_prefetch_blocks,
+                          fetcher);
+  std::vector<char> out;
+  testing::BytesProcessed(static_cast<int64>(iters) * file_size);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    const string filename = strings::StrCat("file_", i);
+    for (size_t offset = 0; offset < file_size; offset += 256 << 10) {
+      TF_CHECK_OK(ReadCache(&cache, filename, offset, 256 << 10, &out));
+    }
+  }
+}
+BENCHMARK(BM_SequentialReads)->Arg(0)->Arg(1)->Arg(4)->Arg(8);
+
 }  // namespace
 }  // namespace tensorflow
@@ -22,11 +22,13 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/null_file_system.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -84,6 +86,87 @@ TEST_F(DefaultEnvTest, IncompleteReadOutOfRange) {
   EXPECT_EQ(input, result);
 }
 
+TEST_F(DefaultEnvTest, ReadBatch) {
+  const string filename = io::JoinPath(BaseDir(), "read_batch");
+  const string input = CreateTestFile(env_, filename, 100000);
+  std::unique_ptr<RandomAccessFile> f;
+  TF_EXPECT_OK(env_->NewRandomAccessFile(filename, &f));
+
+  std::vector<uint64> offsets = {0, 99990, 4096, 50000, 7, 100000, 12345};
+  std::vector<std::unique_ptr<char[]>> scratches;
+  std::vector<RandomAccessFile::ReadRequest> requests(offsets.size());
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    scratches.emplace_back(new char[100]);
+    requests[i].offset = offsets[i];
+    requests[i].n = 100;
+    requests[i].scratch = scratches.back().get();
+  }
+  // The reads past the end of the file fail, the others succeed.
+  EXPECT_EQ(error::OUT_OF_RANGE, f->ReadBatch(&requests).code());
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    const string expected = input.substr(std::min<size_t>(offsets[i], 100000),
+                                         requests[i].n);
+    EXPECT_EQ(expected, requests[i].result) << offsets[i];
+    if (expected.size() < requests[i].n) {
+      EXPECT_EQ(error::OUT_OF_RANGE, requests[i].status.code()) << offsets[i];
+    } else {
+      TF_EXPECT_OK(requests[i].status) << offsets[i];
+    }
+  }
+
+  std::vector<RandomAccessFile::ReadRequest> empty;
+  TF_EXPECT_OK(f->ReadBatch(&empty));
+}
+
+#if !defined(PLATFORM_WINDOWS)
+TEST_F(DefaultEnvTest, DirectIO) {
+  const string filename = io::JoinPath(BaseDir(), "direct_io");
+  const string input = CreateTestFile(env_, filename, 3 * 4096 + 1000);
+  // Files of at least one byte are opened with O_DIRECT, where the file system
+  // supports it.
+  setenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE", "1", 1);
+  std::unique_ptr<RandomAccessFile> f;
+  TF_EXPECT_OK(env_->NewRandomAccessFile(filename, &f));
+  unsetenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE");
+
+  std::unique_ptr<char[]> scratch(new char[input.size() + 100]);
+  StringPiece result;
+  for (uint64 offset : {0, 1, 4095, 4096, 5000, 12288, 13000}) {
+    for (size_t n : {1, 100, 4096, 8193}) {
+      const string expected = input.substr(offset, n);
+      Status s = f->Read(offset, n, &result, scratch.get());
+      if (expected.size() < n) {
+        EXPECT_EQ(error::OUT_OF_RANGE, s.code()) << offset << " " << n;
+      } else {
+        TF_EXPECT_OK(s) << offset << " " << n;
+      }
+      EXPECT_EQ(expected, result) << offset << " " << n;
+    }
+  }
+  EXPECT_EQ(error::OUT_OF_RANGE,
+            f->Read(input.size() + 10, 10, &result, scratch.get()).code());
+  EXPECT_EQ("", result);
+}
+
+TEST_F(DefaultEnvTest, DirectIOLargeRead) {
+  const string filename = io::JoinPath(BaseDir(), "direct_io_large");
+  const string input = CreateTestFile(env_, filename, (9 << 20) + 1000);
+  setenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE", "1", 1);
+  std::unique_ptr<RandomAccessFile> f;
+  TF_EXPECT_OK(env_->NewRandomAccessFile(filename, &f));
+  unsetenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE");
+
+  // Reads larger than the aligned buffer are split into several reads.
+  std::unique_ptr<char[]> scratch(new char[input.size()]);
+  StringPiece result;
+  TF_EXPECT_OK(f->Read(1, input.size() - 1, &result, scratch.get()));
+  EXPECT_EQ(input.substr(1), result);
+  EXPECT_EQ(error::OUT_OF_RANGE,
+            f->Read(5000, input.size(), &result, scratch.get()).code());
+  EXPECT_EQ(input.substr(5000), result);
+}
+#endif  // !defined(PLATFORM_WINDOWS)
+
 TEST_F(DefaultEnvTest, ReadFileToString) {
   for (const int length : {0, 1, 1212, 2553, 4928, 8196, 9000, (1 << 20) - 1,
                            1 << 20, (1 << 20) + 1}) {
@@ -377,4 +460,76 @@ TEST_F(DefaultEnvTest, CreateUniqueFileName) {
   EXPECT_TRUE(str_util::EndsWith(filename, suffix));
 }
 
+// Reads `batch_size` ranges of `read_size` bytes at random offsets of a 64MB
+// file per ReadBatch() call (or one Read() call per range if batch_size is
+// 0). Reports reads per second as items, and throughput.
+void ReadBatchBenchmark(int iters, int read_size, int batch_size,
+                        bool direct_io) {
+  testing::StopTiming();
+  Env* env = Env::Default();
+  const string filename =
+      io::JoinPath(testing::TmpDir(), "read_batch_benchmark");
+  const int64 kFileSize = 64 << 20;
+  CreateTestFile(env, filename, kFileSize);
+  std::unique_ptr<RandomAccessFile> f;
+#if !defined(PLATFORM_WINDOWS)
+  if (direct_io) {
+    setenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE", "1", 1);
+  }
+#endif
+  TF_CHECK_OK(env->NewRandomAccessFile(filename, &f));
+#if !defined(PLATFORM_WINDOWS)
+  unsetenv("TF_POSIX_DIRECT_IO_MIN_FILE_SIZE");
+#endif
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  const int num_reads = std::max(batch_size, 1);
+  std::vector<std::unique_ptr<char[]>> scratches;
+  std::vector<RandomAccessFile::ReadRequest> requests(num_reads);
+  for (auto& request : requests) {
+    scratches.emplace_back(new char[read_size]);
+    request.n = read_size;
+    request.scratch = scratches.back().get();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_reads);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_reads * read_size);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (auto& request : requests) {
+      request.offset = rnd.Uniform64(kFileSize / read_size) * read_size;
+    }
+    if (batch_size == 0) {
+      for (auto& request : requests) {
+        TF_CHECK_OK(f->Read(request.offset, request.n, &request.result,
+                            request.scratch));
+      }
+    } else {
+      TF_CHECK_OK(f->ReadBatch(&requests));
+    }
+  }
+}
+
+// Reads through the page cache, which holds the whole file.
+void BM_ReadBatch(int iters, int read_size, int batch_size) {
+  ReadBatchBenchmark(iters, read_size, batch_size, false);
+}
+BENCHMARK(BM_ReadBatch)
+    ->ArgPair(4 << 10, 0)
+    ->ArgPair(4 << 10, 16)
+    ->ArgPair(4 << 10, 64)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 16);
+
+// Reads from the device with O_DIRECT (where TmpDir() supports it), as for a
+// cold page cache.
+void BM_ReadBatchDirect(int iters, int read_size, int batch_size) {
+  ReadBatchBenchmark(iters, read_size, batch_size, true);
+}
+BENCHMARK(BM_ReadBatchDirect)
+    ->ArgPair(4 << 10, 0)
+    ->ArgPair(4 << 10, 16)
+    ->ArgPair(4 << 10, 64)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 16);
+
 }  // namespace tensorflow
@@ -51,6 +51,16 @@ void FileSystem::FlushCaches() {}
 
 RandomAccessFile::~RandomAccessFile() {}
 
+Status RandomAccessFile::ReadBatch(std::vector<ReadRequest>* requests) const {
+  Status status;
+  for (ReadRequest& request : *requests) {
+    request.status =
+        Read(request.offset, request.n, &request.result, request.scratch);
+    status.Update(request.status);
+  }
+  return status;
+}
+
 WritableFile::~WritableFile() {}
 
 FileSystemRegistry::~FileSystemRegistry() {}
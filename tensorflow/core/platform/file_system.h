@@ -238,6 +238,28 @@ class RandomAccessFile {
   virtual Status Read(uint64 offset, size_t n, StringPiece* result,
                       char* scratch) const = 0;
 
+  /// \brief A range of the file to read with ReadBatch().
+  struct ReadRequest {
+    uint64 offset = 0;
+    size_t n = 0;
+    /// Must point to at least `n` bytes, which ReadBatch() may write.
+    char* scratch = nullptr;
+    /// Set by ReadBatch(), as Read() would set them for this range.
+    StringPiece result;
+    Status status;
+  };
+
+  /// \brief Reads all the ranges of `requests`, possibly concurrently.
+  ///
+  /// Sets the `result` and `status` of every request. Returns OK if every
+  /// request succeeded, and the status of the first failed request otherwise.
+  ///
+  /// The default implementation calls Read() for one request at a time;
+  /// implementations can override it to keep many reads in flight.
+  ///
+  /// Safe for concurrent use by multiple threads.
+  virtual Status ReadBatch(std::vector<ReadRequest>* requests) const;
+
  private:
   TF_DISALLOW_COPY_AND_ASSIGN(RandomAccessFile);
 };
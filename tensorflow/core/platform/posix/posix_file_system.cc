@@ -17,6 +17,8 @@ limitations under the License.
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #if !defined(__APPLE__)
 #include <sys/sendfile.h>
@@ -27,12 +29,18 @@ limitations under the License.
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/file_system_helper.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/platform/posix/error.h"
 #include "tensorflow/core/platform/posix/posix_file_system.h"
 
@@ -41,19 +49,110 @@ namespace tensorflow {
 // 128KB of copy buffer
 constexpr size_t kPosixCopyFileBufferSize = 128 * 1024;
 
+// The environment variable that enables O_DIRECT reads. Files of at least this
+// many bytes are read without going through the page cache, which avoids
+// polluting it (and an extra copy) for large files read once. Unset or 0
+// disables direct I/O.
+constexpr char kDirectIOMinFileSize[] = "TF_POSIX_DIRECT_IO_MIN_FILE_SIZE";
+
+// The alignment of the offsets, sizes and buffers of O_DIRECT reads.
+constexpr size_t kDirectIOAlignment = 4096;
+
+// The largest aligned buffer an O_DIRECT read goes through. Larger reads
+// are split into reads of this size.
+constexpr size_t kDirectIOBufferSize = 4 << 20;
+
+// The number of threads issuing the reads of ReadBatch().
+constexpr int kNumReadBatchThreads = 16;
+
+namespace {
+
+thread::ThreadPool* ReadBatchThreadPool() {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "posix_read_batch", kNumReadBatchThreads);
+  return pool;
+}
+
+}  // namespace
+
 // pread() based random-access
 class PosixRandomAccessFile : public RandomAccessFile {
  private:
   string filename_;
   int fd_;
+  // Whether fd_ was opened with O_DIRECT.
+  bool direct_io_;
+
+  // Reads through an aligned buffer, as required by O_DIRECT.
+  Status ReadDirect(uint64 offset, size_t n, StringPiece* result,
+                    char* scratch) const {
+    const uint64 begin = offset / kDirectIOAlignment * kDirectIOAlignment;
+    const uint64 end = (offset + n + kDirectIOAlignment - 1) /
+                       kDirectIOAlignment * kDirectIOAlignment;
+    const size_t buffer_size = std::min<uint64>(end - begin,
+                                                kDirectIOBufferSize);
+    char* buffer = static_cast<char*>(
+        port::AlignedMalloc(buffer_size, static_cast<int>(kDirectIOAlignment)));
+    if (buffer == nullptr) {
+      *result = StringPiece();
+      return Status(error::RESOURCE_EXHAUSTED,
+                    strings::StrCat("Failed to allocate ", buffer_size,
+                                    " bytes to read ", filename_));
+    }
+    Status s;
+    size_t copied = 0;
+    bool eof = false;
+    for (uint64 pos = begin; pos < end && s.ok() && !eof;
+         pos += buffer_size) {
+      const size_t length = std::min<uint64>(end - pos, buffer_size);
+      size_t done = 0;
+      while (done < length) {
+        ssize_t r = pread(fd_, buffer + done, length - done,
+                          static_cast<off_t>(pos + done));
+        if (r > 0) {
+          done += r;
+          // Only the read that reaches EOF may return a partial block.
+          if (r % kDirectIOAlignment != 0) {
+            eof = true;
+            break;
+          }
+        } else if (r == 0) {
+          eof = true;
+          break;
+        } else if (errno == EINTR || errno == EAGAIN) {
+          // Retry
+        } else {
+          s = IOError(filename_, errno);
+          break;
+        }
+      }
+      // Copies the part of the buffer that falls within [offset, offset + n).
+      const uint64 copy_begin = std::max<uint64>(pos, offset);
+      const uint64 copy_end = std::min<uint64>(pos + done, offset + n);
+      if (copy_end > copy_begin) {
+        memcpy(scratch + copied, buffer + (copy_begin - pos),
+               copy_end - copy_begin);
+        copied += copy_end - copy_begin;
+      }
+    }
+    port::AlignedFree(buffer);
+    *result = StringPiece(scratch, copied);
+    if (s.ok() && copied < n) {
+      s = Status(error::OUT_OF_RANGE, "Read less bytes than requested");
+    }
+    return s;
+  }
 
  public:
-  PosixRandomAccessFile(const string& fname, int fd)
-      : filename_(fname), fd_(fd) {}
+  PosixRandomAccessFile(const string& fname, int fd, bool direct_io)
+      : filename_(fname), fd_(fd), direct_io_(direct_io) {}
   ~PosixRandomAccessFile() override { close(fd_); }
 
   Status Read(uint64 offset, size_t n, StringPiece* result,
               char* scratch) const override {
+    if (direct_io_) {
+      return ReadDirect(offset, n, result, scratch);
+    }
     Status s;
     char* dst = scratch;
     while (n > 0 && s.ok()) {
@@ -73,6 +172,32 @@ class PosixRandomAccessFile : public RandomAccessFile {
     *result = StringPiece(scratch, dst - scratch);
     return s;
   }
+
+  // Issues the reads concurrently from a shared thread pool, so that the disk
+  // (or the network file system behind the mount) sees many requests at once.
+  Status ReadBatch(std::vector<ReadRequest>* requests) const override {
+    if (requests->empty()) {
+      return Status::OK();
+    }
+    BlockingCounter counter(requests->size() - 1);
+    for (size_t i = 1; i < requests->size(); ++i) {
+      ReadRequest* request = &(*requests)[i];
+      ReadBatchThreadPool()->Schedule([this, request, &counter]() {
+        request->status = Read(request->offset, request->n, &request->result,
+                               request->scratch);
+        counter.DecrementCount();
+      });
+    }
+    ReadRequest* first = &requests->front();
+    first->status =
+        Read(first->offset, first->n, &first->result, first->scratch);
+    counter.Wait();
+    Status status;
+    for (const ReadRequest& request : *requests) {
+      status.Update(request.status);
+    }
+    return status;
+  }
 };
 
 class PosixWritableFile : public WritableFile {
@@ -143,11 +268,28 @@ Status PosixFileSystem::NewRandomAccessFile(
     const string& fname, std::unique_ptr<RandomAccessFile>* result) {
   string translated_fname = TranslateName(fname);
   Status s;
-  int fd = open(translated_fname.c_str(), O_RDONLY);
+  bool direct_io = false;
+  int fd = -1;
+#if defined(O_DIRECT)
+  const char* min_size_str = getenv(kDirectIOMinFileSize);
+  int64 min_size;
+  struct stat sbuf;
+  if (min_size_str != nullptr &&
+      strings::safe_strto64(min_size_str, &min_size) && min_size > 0 &&
+      stat(translated_fname.c_str(), &sbuf) == 0 && sbuf.st_size >= min_size) {
+    // Not all file systems support O_DIRECT (e.g. tmpfs); fall back to
+    // buffered reads on those.
+    fd = open(translated_fname.c_str(), O_RDONLY | O_DIRECT);
+    direct_io = fd >= 0;
+  }
+#endif
+  if (fd < 0) {
+    fd = open(translated_fname.c_str(), O_RDONLY);
+  }
   if (fd < 0) {
     s = IOError(fname, errno);
   } else {
-    result->reset(new PosixRandomAccessFile(translated_fname, fd));
+    result->reset(new PosixRandomAccessFile(translated_fname, fd, direct_io));
   }
   return s;
 }
@@ -44,6 +44,16 @@ Status ValidateInput(const Tensor& parent, const Tensor& element, int64 index) {
 template <typename T>
 Status HandleElementToSlice(Tensor element, Tensor* parent, int64 index,
                             bool /* can_move */) {
+  if (DataTypeCanUseMemcpy(DataTypeToEnum<T>::v())) {
+    // The slice is contiguous in the (row-major) parent buffer, so a single
+    // memcpy is the cheapest way to fill it.
+    const int64 num_elements = element.NumElements();
+    if (num_elements > 0) {
+      T* dst = parent->flat_outer_dims<T>().data() + index * num_elements;
+      memcpy(dst, element.flat<T>().data(), num_elements * sizeof(T));
+    }
+    return Status::OK();
+  }
   parent->flat_outer_dims<T>().chip(index, 0) = element.flat<T>();
   return Status::OK();
 }
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <cstring>
 #include <vector>
 
 #include "tensorflow/core/example/example.pb.h"
@@ -27,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/util/presized_cuckoo_map.h"
@@ -60,6 +62,87 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+template <typename T>
+class LimitedArraySlice {
+ public:
+  LimitedArraySlice(T* begin, size_t num_elements)
+      : current_(begin), end_(begin + num_elements) {}
+
+  // May return negative if there were push_back calls after slice was filled.
+  int64 EndDistance() const { return end_ - current_; }
+
+  // Attempts to push value to the back of this. If the slice has
+  // already been filled, this method has no effect on the underlying data, but
+  // it changes the number returned by EndDistance into negative values.
+  void push_back(T&& value) {
+    if (EndDistance() > 0) *current_ = std::move(value);
+    ++current_;
+  }
+
+  // Returns a pointer to `n` elements at the back of this, which the caller
+  // must fill. Like push_back, returns nullptr if the slice does not have room
+  // for all of them, and changes EndDistance accordingly.
+  T* AppendUninitialized(size_t n) {
+    T* result = EndDistance() >= static_cast<int64>(n) ? current_ : nullptr;
+    current_ += n;
+    return result;
+  }
+
+ private:
+  T* current_;
+  T* end_;
+};
+
+// Returns a pointer to `n` new elements at the back of `vec`.
+template <typename T>
+T* AppendUninitialized(size_t n, SmallVector<T>* vec) {
+  const size_t old_size = vec->size();
+  vec->resize(old_size + n);
+  return vec->data() + old_size;
+}
+
+template <typename T>
+T* AppendUninitialized(size_t n, LimitedArraySlice<T>* slice) {
+  return slice->AppendUninitialized(n);
+}
+
+// Decodes the packed varints in [begin, end) into `out`, which must have room
+// for one value per varint. Skips storing the values if `out` is nullptr.
+// Returns false if the data is malformed.
+//
+// This avoids the per-value overhead of CodedInputStream::ReadVarint64, and
+// decodes one-byte varints (the common case for ids and small counts) without
+// entering the general loop.
+bool DecodePackedVarints(const uint8* begin, const uint8* end, int64* out) {
+  const uint8* p = begin;
+  while (p < end) {
+    uint64 value = *p++;
+    if (TF_PREDICT_FALSE(value >= 0x80)) {
+      value &= 0x7F;
+      for (int shift = 7;; shift += 7) {
+        // A varint is at most 10 bytes long.
+        if (p == end || shift > 63) return false;
+        const uint64 byte = *p++;
+        value |= (byte & 0x7F) << shift;
+        if (byte < 0x80) break;
+      }
+    }
+    if (out != nullptr) *out++ = static_cast<int64>(value);
+  }
+  return true;
+}
+
+// Returns the number of varints in [begin, end), i.e. the number of bytes that
+// do not have the continuation bit set. The loop is simple enough to be
+// vectorized by the compiler.
+size_t CountPackedVarints(const uint8* begin, const uint8* end) {
+  size_t count = 0;
+  for (const uint8* p = begin; p < end; ++p) {
+    count += *p < 0x80;
+  }
+  return count;
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -161,10 +244,26 @@ class Feature {
         if (!stream.ReadVarint32(&packed_length)) return false;
         auto packed_limit = stream.PushLimit(packed_length);
 
-        while (!stream.ExpectAtEnd()) {
-          uint32 buffer32;
-          if (!stream.ReadLittleEndian32(&buffer32)) return false;
-          float_list->push_back(bit_cast<float>(buffer32));
+        if (packed_length % sizeof(float) != 0) return false;
+        const void* data;
+        int size;
+        if (port::kLittleEndian &&
+            stream.GetDirectBufferPointer(&data, &size) &&
+            static_cast<uint32>(size) >= packed_length) {
+          // The wire format of packed floats matches their in-memory layout,
+          // so copy them directly into the output.
+          const size_t num_elements = packed_length / sizeof(float);
+          float* out = AppendUninitialized(num_elements, float_list);
+          if (out != nullptr) {
+            std::memcpy(out, data, packed_length);
+          }
+          if (!stream.Skip(packed_length)) return false;
+        } else {
+          while (!stream.ExpectAtEnd()) {
+            uint32 buffer32;
+            if (!stream.ReadLittleEndian32(&buffer32)) return false;
+            float_list->push_back(bit_cast<float>(buffer32));
+          }
         }
 
         stream.PopLimit(packed_limit);
@@ -203,10 +302,24 @@ class Feature {
         if (!stream.ReadVarint32(&packed_length)) return false;
         auto packed_limit = stream.PushLimit(packed_length);
 
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64>(n));
+        const void* data;
+        int size;
+        if (stream.GetDirectBufferPointer(&data, &size) &&
+            static_cast<uint32>(size) >= packed_length) {
+          // Count the values first so that they can be decoded directly into
+          // the output.
+          const uint8* begin = static_cast<const uint8*>(data);
+          const uint8* end = begin + packed_length;
+          const size_t num_elements = CountPackedVarints(begin, end);
+          int64* out = AppendUninitialized(num_elements, int64_list);
+          if (!DecodePackedVarints(begin, end, out)) return false;
+          if (!stream.Skip(packed_length)) return false;
+        } else {
+          while (!stream.ExpectAtEnd()) {
+            protobuf_uint64 n;  // There is no API for int64
+            if (!stream.ReadVarint64(&n)) return false;
+            int64_list->push_back(static_cast<int64>(n));
+          }
         }
 
         stream.PopLimit(packed_limit);
@@ -445,28 +558,6 @@ struct SeededHasher {
   uint64 seed{0xDECAFCAFFE};
 };
 
-template <typename T>
-class LimitedArraySlice {
- public:
-  LimitedArraySlice(T* begin, size_t num_elements)
-      : current_(begin), end_(begin + num_elements) {}
-
-  // May return negative if there were push_back calls after slice was filled.
-  int64 EndDistance() const { return end_ - current_; }
-
-  // Attempts to push value to the back of this. If the slice has
-  // already been filled, this method has no effect on the underlying data, but
-  // it changes the number returned by EndDistance into negative values.
-  void push_back(T&& value) {
-    if (EndDistance() > 0) *current_ = std::move(value);
-    ++current_;
-  }
-
- private:
-  T* current_;
-  T* end_;
-};
-
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
   LOG(WARNING) << "Data loss! Feature '" << feature_name
                << "' is present in multiple concatenated "
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <limits>
+
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/lib/random/philox_random.h"
@@ -168,6 +170,48 @@ TEST(FastParse, Packed) {
       "\x0a\x0d\x0a\x0b\x0a\x03\x61\x67\x65\x12\x04\x1a\x02\x08\x0d");
 }
 
+TEST(FastParse, PackedMultiByteVarint) {
+  TestCorrectness(string("\x0a\x0f\x0a\x0d\x0a\x03"
+                         "age"
+                         "\x12\x06\x1a\x04\x0a\x02\xac\x02"));
+}
+
+// Tests that both parsers reject serialized.
+void TestMalformed(const string& serialized) {
+  Example example;
+  Example fast_example;
+  EXPECT_FALSE(example.ParseFromString(serialized));
+  EXPECT_FALSE(TestFastParse(serialized, &fast_example));
+}
+
+TEST(FastParse, PackedTruncatedVarint) {
+  TestMalformed(string("\x0a\x0f\x0a\x0d\x0a\x03"
+                       "age"
+                       "\x12\x06\x1a\x04\x0a\x02\xac\x82"));
+}
+
+TEST(FastParse, PackedFloatsWithPartialValue) {
+  const char kSerialized[] =
+      "\x0a\x10\x0a\x0e\x0a\x03"
+      "age"
+      "\x12\x07\x12\x05\x0a\x03\x00\x00\x00";
+  TestMalformed(string(kSerialized, sizeof(kSerialized) - 1));
+}
+
+TEST(FastParse, PackedLongLists) {
+  Example example;
+  auto& features = *example.mutable_features()->mutable_feature();
+  auto* int64_list = features["ints"].mutable_int64_list();
+  auto* float_list = features["floats"].mutable_float_list();
+  for (int64 i = 0; i < 1000; ++i) {
+    int64_list->add_value(i * i * i * (i % 2 == 0 ? 1 : -1));
+    float_list->add_value(i / 7.0f);
+  }
+  int64_list->add_value(std::numeric_limits<int64>::max());
+  int64_list->add_value(std::numeric_limits<int64>::min());
+  TestCorrectness(Serialize(example));
+}
+
 TEST(FastParse, EmptyFeatures) {
   Example example;
   example.mutable_features();
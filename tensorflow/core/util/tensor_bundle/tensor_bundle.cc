@@ -19,8 +19,10 @@ limitations under the License.
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <set>
 #include <utility>
 
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb_text.h"
@@ -32,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/framework/variant_tensor_data.h"
 #include "tensorflow/core/framework/versions.h"
 #include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
@@ -54,6 +57,10 @@ const int kTensorBundleVersion = 1;
 // Size of our input buffer for streaming reads
 static const int kBufferSize = 1024 * 1024;
 
+// Size of the chunks that large tensors are split into when a thread pool is
+// available for copying, reading and checksumming them in parallel.
+static const size_t kParallelChunkSize = 1024 * 1024;
+
 // Key to the special BundleHeaderProto entry.  Do not change this, as clients
 // can make the assumption that the header is always the first entry in the
 // bundle.
@@ -306,6 +313,99 @@ Status WriteVariantTensor(const Tensor& val, FileOutputBuffer* out,
   return Status::OK();
 }
 
+// Splits [0, size) into chunks of at most kParallelChunkSize bytes and calls
+// "fn(offset, length, &chunk_crc32c)" for each of them, running the calls
+// concurrently on "pool" unless it is null.  "fn" must compute the crc32c of
+// the bytes it handles.  Blocks until all calls have returned.  On OK, stores
+// the crc32c of the whole range in "crc32c"; otherwise returns the first error.
+Status RunInChunks(
+    thread::ThreadPool* pool, size_t size,
+    const std::function<Status(size_t, size_t, uint32*)>& fn, uint32* crc32c) {
+  if (pool == nullptr || size <= kParallelChunkSize) {
+    return fn(0, size, crc32c);
+  }
+  const size_t num_chunks =
+      (size + kParallelChunkSize - 1) / kParallelChunkSize;
+  auto chunk_length = [size](size_t i) {
+    return std::min(kParallelChunkSize, size - i * kParallelChunkSize);
+  };
+  std::vector<Status> statuses(num_chunks);
+  std::vector<uint32> crcs(num_chunks);
+  auto run_chunk = [&](size_t i) {
+    statuses[i] = fn(i * kParallelChunkSize, chunk_length(i), &crcs[i]);
+  };
+  BlockingCounter counter(num_chunks - 1);
+  for (size_t i = 1; i < num_chunks; ++i) {
+    pool->Schedule([&run_chunk, &counter, i] {
+      run_chunk(i);
+      counter.DecrementCount();
+    });
+  }
+  run_chunk(0);
+  counter.Wait();
+
+  *crc32c = 0;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    TF_RETURN_IF_ERROR(statuses[i]);
+    *crc32c = crc32c::Combine(*crc32c, crcs[i], chunk_length(i));
+  }
+  return Status::OK();
+}
+
+// Reads file[offset, offset+size) into "destination" with positional reads,
+// which are issued concurrently on "pool" if it is not null.  Stores the
+// crc32c of the restored bytes into "actual_crc32c".
+Status ReadAndChecksum(thread::ThreadPool* pool, RandomAccessFile* file,
+                       uint64 offset, size_t size, char* destination,
+                       uint32* actual_crc32c) {
+  return RunInChunks(
+      pool, size,
+      [file, offset, destination](size_t chunk_offset, size_t length,
+                                  uint32* crc32c) {
+        char* chunk = destination + chunk_offset;
+        StringPiece sp;
+        TF_RETURN_IF_ERROR(
+            file->Read(offset + chunk_offset, length, &sp, chunk));
+        if (sp.data() != chunk) {
+          memmove(chunk, sp.data(), length);
+        }
+        *crc32c = crc32c::Value(chunk, length);
+        return Status::OK();
+      },
+      actual_crc32c);
+}
+
+// Hands out bytes [offset, offset + size) of a read-only memory region as the
+// buffer of a single tensor, keeping the region alive until that tensor is
+// destroyed.  Deletes itself when the buffer is deallocated, so it must be
+// released to the tensor once the allocation succeeded.
+class MemmappedRangeAllocator : public Allocator {
+ public:
+  MemmappedRangeAllocator(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                          uint64 offset, uint64 size)
+      : region_(std::move(region)), offset_(offset), size_(size) {}
+
+  string Name() override { return "MemmappedRangeAllocator"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    const char* data = static_cast<const char*>(region_->data()) + offset_;
+    if (reinterpret_cast<intptr_t>(data) % alignment != 0 ||
+        num_bytes != size_) {
+      return nullptr;
+    }
+    return const_cast<char*>(data);
+  }
+
+  void DeallocateRaw(void* ptr) override { delete this; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const uint64 offset_;
+  const uint64 size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemmappedRangeAllocator);
+};
+
 // Returns whether "slice_spec" is a full slice, with respect to the full shape.
 //
 // This can happen say, when "slice_spec" is
@@ -386,7 +486,8 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
   status_ = env_->NewWritableFile(tmp_data_path_, &wrapper);
   if (!status_.ok()) return;
   out_ = std::unique_ptr<FileOutputBuffer>(
-      new FileOutputBuffer(wrapper.release(), 8 << 20 /* 8MB write buffer */));
+      new FileOutputBuffer(wrapper.release(), 8 << 20 /* 8MB write buffer */,
+                           options_.thread_pool));
 
   VLOG(1) << "Writing to file " << tmp_data_path_;
 }
@@ -695,9 +796,11 @@ Status MergeBundles(Env* env, gtl::ArraySlice<string> prefixes,
 
 // Interface for reading a tensor bundle.
 
-BundleReader::BundleReader(Env* env, StringPiece prefix)
+BundleReader::BundleReader(Env* env, StringPiece prefix,
+                           const Options& options)
     : env_(env),
       prefix_(std::string(prefix)),
+      options_(options),
       metadata_(nullptr),
       table_(nullptr),
       iter_(nullptr) {
@@ -823,17 +926,14 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
     char* backing_buffer = const_cast<char*>((ret->tensor_data().data()));
     size_t unused_bytes_read;
     if (entry.size() > kBufferSize) {
-      StringPiece sp;
-      TF_RETURN_IF_ERROR(buffered_file->file()->Read(
-          entry.offset(), entry.size(), &sp, backing_buffer));
-      if (sp.data() != backing_buffer) {
-        memmove(backing_buffer, sp.data(), entry.size());
-      }
+      TF_RETURN_IF_ERROR(ReadAndChecksum(
+          options_.thread_pool, buffered_file->file(), entry.offset(),
+          entry.size(), backing_buffer, &actual_crc32c));
     } else {
       TF_RETURN_IF_ERROR(buffered_file->ReadNBytes(entry.size(), backing_buffer,
                                                    &unused_bytes_read));
+      actual_crc32c = crc32c::Value(backing_buffer, entry.size());
     }
-    actual_crc32c = crc32c::Value(backing_buffer, entry.size());
   } else if (entry.dtype() == DT_VARIANT) {
     // Relies on io::InputBuffer's buffering, because we issue many neighboring
     // reads for a single string tensor.
@@ -872,6 +972,53 @@ Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   }
 }
 
+Status BundleReader::LookupMemmapped(StringPiece key, Tensor* val) {
+  CHECK(val != nullptr);
+  BundleEntryProto entry;
+  TF_RETURN_IF_ERROR(GetBundleEntryProto(key, &entry));
+  const TensorShape shape(entry.shape());
+
+  if (!entry.slices().empty() || !DataTypeCanUseMemcpy(entry.dtype()) ||
+      shape.num_elements() == 0) {
+    *val = Tensor(entry.dtype(), shape);
+    return Lookup(key, val);
+  }
+  if (entry.size() != shape.num_elements() * DataTypeSize(entry.dtype())) {
+    return errors::DataLoss("Invalid size in bundle entry: key ", key,
+                            "; stored size ", entry.size(), "; expected size ",
+                            shape.num_elements() * DataTypeSize(entry.dtype()));
+  }
+
+  // Maps the data file if it has not been mapped.
+  std::shared_ptr<ReadOnlyMemoryRegion>& region =
+      memmapped_data_[entry.shard_id()];
+  if (region == nullptr) {
+    std::unique_ptr<ReadOnlyMemoryRegion> new_region;
+    TF_RETURN_IF_ERROR(env_->NewReadOnlyMemoryRegionFromFile(
+        DataFilename(prefix_, entry.shard_id(), num_shards_), &new_region));
+    region = std::move(new_region);
+  }
+  if (entry.offset() + entry.size() > region->length()) {
+    return errors::DataLoss("Data file is too short for bundle entry: key ",
+                            key, "; entry ends at byte ",
+                            entry.offset() + entry.size(), " of a file of ",
+                            region->length(), " bytes");
+  }
+
+  std::unique_ptr<MemmappedRangeAllocator> allocator(
+      new MemmappedRangeAllocator(region, entry.offset(), entry.size()));
+  Tensor tensor(allocator.get(), entry.dtype(), shape);
+  if (tensor.tensor_data().data() == nullptr) {
+    // The tensor is not aligned in the data file, so it must be copied.
+    *val = Tensor(entry.dtype(), shape);
+    return GetValue(entry, val);
+  }
+  // The allocator is owned by the tensor from this point.
+  allocator.release();
+  *val = std::move(tensor);
+  return Status::OK();
+}
+
 Status BundleReader::ReadCurrent(Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
@@ -1060,6 +1207,246 @@ string BundleReader::DebugString() {
   return shape_str;
 }
 
+// Delta bundles.
+
+namespace {
+
+// Keys of the row indices and rows that AddDelta() stores for "key".
+string DeltaIndicesKey(StringPiece key) {
+  return strings::StrCat(key, "/.DELTA_INDICES");
+}
+string DeltaRowsKey(StringPiece key) {
+  return strings::StrCat(key, "/.DELTA_ROWS");
+}
+
+// Key of the scalar string tensor that AddDeltaBase() stores.
+const char* const kDeltaBaseKey = "/.DELTA_BASE";
+
+// Allocates "val" with the stored dtype and shape and looks it up.
+Status LookupNewTensor(BundleReader* reader, StringPiece key, Tensor* val) {
+  DataType dtype;
+  TensorShape shape;
+  TF_RETURN_IF_ERROR(reader->LookupDtypeAndShape(key, &dtype, &shape));
+  *val = Tensor(dtype, shape);
+  return reader->Lookup(key, val);
+}
+
+// True if only the changed rows of "val" may be stored.
+bool HasRows(const Tensor& val) {
+  return DataTypeCanUseMemcpy(val.dtype()) && val.dims() > 0 &&
+         val.NumElements() > 0;
+}
+
+// Adds the rows "changed_rows" of "val", in increasing order, under "key".
+Status AddChangedRows(BundleWriter* writer, StringPiece key, const Tensor& val,
+                      const std::vector<int64>& changed_rows) {
+  if (changed_rows.empty()) return Status::OK();
+  // Past this point, a full copy is smaller and faster to restore.
+  const int64 num_rows = val.dim_size(0);
+  if (static_cast<int64>(changed_rows.size()) * 2 > num_rows) {
+    return writer->Add(key, val);
+  }
+
+  const size_t row_bytes = val.TotalBytes() / num_rows;
+  const char* data = val.tensor_data().data();
+  const int64 num_changed = changed_rows.size();
+  Tensor indices(DT_INT64, TensorShape({num_changed}));
+  TensorShape rows_shape = val.shape();
+  rows_shape.set_dim(0, num_changed);
+  Tensor rows(val.dtype(), rows_shape);
+  char* rows_data = GetBackingBuffer(rows);
+  for (int64 i = 0; i < num_changed; ++i) {
+    indices.vec<int64>()(i) = changed_rows[i];
+    memcpy(rows_data + i * row_bytes, data + changed_rows[i] * row_bytes,
+           row_bytes);
+  }
+  TF_RETURN_IF_ERROR(writer->Add(DeltaIndicesKey(key), indices));
+  return writer->Add(DeltaRowsKey(key), rows);
+}
+
+// Applies the deltas of the tensor keyed by "key" to "val".  "*found" tells
+// whether "val" already holds the tensor, and is updated.  If "fixed_shape",
+// "val" is preallocated and the deltas may not change its dtype or shape.
+Status ApplyDeltas(gtl::ArraySlice<BundleReader*> deltas, StringPiece key,
+                   bool fixed_shape, bool* found, Tensor* val) {
+  for (BundleReader* delta : deltas) {
+    if (delta->Contains(key)) {
+      Tensor full_val;
+      TF_RETURN_IF_ERROR(LookupNewTensor(delta, key, &full_val));
+      if (fixed_shape && (full_val.dtype() != val->dtype() ||
+                          full_val.shape() != val->shape())) {
+        return errors::DataLoss(
+            "Delta bundle holds ", key, " as ",
+            DataTypeString(full_val.dtype()), full_val.shape().DebugString(),
+            ", expected ", DataTypeString(val->dtype()),
+            val->shape().DebugString());
+      }
+      *val = full_val;
+      *found = true;
+      continue;
+    }
+    const string indices_key = DeltaIndicesKey(key);
+    if (!delta->Contains(indices_key)) continue;
+    if (!*found) {
+      return errors::DataLoss("Delta bundle holds changed rows of ", key,
+                              ", but no earlier bundle holds the tensor");
+    }
+    if (!HasRows(*val)) {
+      return errors::DataLoss("Delta bundle holds changed rows of ", key,
+                              ", but the tensor has no rows: ",
+                              DataTypeString(val->dtype()),
+                              val->shape().DebugString());
+    }
+    Tensor indices;
+    Tensor rows;
+    TF_RETURN_IF_ERROR(LookupNewTensor(delta, indices_key, &indices));
+    TF_RETURN_IF_ERROR(LookupNewTensor(delta, DeltaRowsKey(key), &rows));
+
+    TensorShape expected_rows_shape = val->shape();
+    expected_rows_shape.set_dim(0, indices.NumElements());
+    if (indices.dtype() != DT_INT64 || indices.dims() != 1 ||
+        rows.dtype() != val->dtype() || rows.shape() != expected_rows_shape) {
+      return errors::DataLoss(
+          "Changed rows of ", key, " do not match the tensor: ",
+          DataTypeString(rows.dtype()), rows.shape().DebugString(), " vs. ",
+          DataTypeString(val->dtype()), val->shape().DebugString());
+    }
+    const int64 num_rows = val->dim_size(0);
+    const size_t row_bytes = val->TotalBytes() / num_rows;
+    char* data = GetBackingBuffer(*val);
+    const char* rows_data = rows.tensor_data().data();
+    const auto indices_vec = indices.vec<int64>();
+    for (int64 i = 0; i < indices_vec.size(); ++i) {
+      const int64 row = indices_vec(i);
+      if (row < 0 || row >= num_rows) {
+        return errors::DataLoss("Changed row index ", row, " of ", key,
+                                " is out of range [0, ", num_rows, ")");
+      }
+      memcpy(data + row * row_bytes, rows_data + i * row_bytes, row_bytes);
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+Status AddDelta(BundleWriter* writer, StringPiece key, const Tensor& base_val,
+                const Tensor& val) {
+  if (base_val.dtype() != val.dtype() || base_val.shape() != val.shape() ||
+      !HasRows(val)) {
+    return writer->Add(key, val);
+  }
+  const int64 num_rows = val.dim_size(0);
+  const size_t row_bytes = val.TotalBytes() / num_rows;
+  const char* base_data = base_val.tensor_data().data();
+  const char* data = val.tensor_data().data();
+  std::vector<int64> changed_rows;
+  for (int64 i = 0; i < num_rows; ++i) {
+    if (memcmp(base_data + i * row_bytes, data + i * row_bytes, row_bytes) !=
+        0) {
+      changed_rows.push_back(i);
+    }
+  }
+  return AddChangedRows(writer, key, val, changed_rows);
+}
+
+Status AddDeltaRows(BundleWriter* writer, StringPiece key, const Tensor& val,
+                    const std::vector<bool>& changed_rows) {
+  if (!HasRows(val)) {
+    return writer->Add(key, val);
+  }
+  const int64 num_rows =
+      std::min<int64>(val.dim_size(0), changed_rows.size());
+  std::vector<int64> rows;
+  for (int64 i = 0; i < num_rows; ++i) {
+    if (changed_rows[i]) rows.push_back(i);
+  }
+  return AddChangedRows(writer, key, val, rows);
+}
+
+string DeltaSliceKey(StringPiece full_tensor_key,
+                     const TensorSlice& slice_spec) {
+  return checkpoint::EncodeTensorNameSlice(full_tensor_key.ToString(),
+                                           slice_spec);
+}
+
+Status AddDeltaBase(BundleWriter* writer, StringPiece base_name) {
+  if (base_name.empty() || io::Basename(base_name) != base_name) {
+    return errors::InvalidArgument(
+        "The base of a delta bundle must be named by a basename, got \"",
+        base_name, "\"");
+  }
+  Tensor base(DT_STRING, TensorShape({}));
+  base.scalar<string>()() = base_name.ToString();
+  return writer->Add(kDeltaBaseKey, base);
+}
+
+Status OpenDeltaChain(Env* env, StringPiece prefix,
+                      std::vector<std::unique_ptr<BundleReader>>* readers) {
+  readers->clear();
+  const string dir = io::Dirname(prefix).ToString();
+  string current = prefix.ToString();
+  std::set<string> visited;
+  while (true) {
+    if (!visited.insert(current).second) {
+      return errors::DataLoss("Delta bundle chain of ", prefix,
+                              " has a cycle through ", current);
+    }
+    std::unique_ptr<BundleReader> reader(new BundleReader(env, current));
+    TF_RETURN_IF_ERROR(reader->status());
+    const bool is_delta = reader->Contains(kDeltaBaseKey);
+    Tensor base;
+    if (is_delta) {
+      TF_RETURN_IF_ERROR(LookupNewTensor(reader.get(), kDeltaBaseKey, &base));
+    }
+    readers->push_back(std::move(reader));
+    if (!is_delta) break;
+    if (base.dtype() != DT_STRING || base.dims() != 0) {
+      return errors::DataLoss("Bad base of delta bundle ", current, ": ",
+                              DataTypeString(base.dtype()),
+                              base.shape().DebugString());
+    }
+    current = io::JoinPath(dir, base.scalar<string>()());
+  }
+  std::reverse(readers->begin(), readers->end());
+  return Status::OK();
+}
+
+Status LookupWithDeltas(BundleReader* base,
+                        gtl::ArraySlice<BundleReader*> deltas, StringPiece key,
+                        Tensor* val) {
+  bool found = false;
+  if (base->Contains(key)) {
+    TF_RETURN_IF_ERROR(LookupNewTensor(base, key, val));
+    found = true;
+  }
+  TF_RETURN_IF_ERROR(ApplyDeltas(deltas, key, /*fixed_shape=*/false, &found,
+                                 val));
+  if (!found) {
+    return errors::NotFound("Key ", key, " not found in checkpoint");
+  }
+  return Status::OK();
+}
+
+Status LookupSliceWithDeltas(BundleReader* base,
+                             gtl::ArraySlice<BundleReader*> deltas,
+                             StringPiece full_tensor_key,
+                             const TensorSlice& slice_spec, Tensor* val) {
+  bool found = false;
+  if (base->Contains(full_tensor_key)) {
+    TF_RETURN_IF_ERROR(base->LookupSlice(full_tensor_key, slice_spec, val));
+    found = true;
+  }
+  TF_RETURN_IF_ERROR(ApplyDeltas(deltas,
+                                 DeltaSliceKey(full_tensor_key, slice_spec),
+                                 /*fixed_shape=*/true, &found, val));
+  if (!found) {
+    return errors::NotFound("Slice ", slice_spec.DebugString(), " of ",
+                            full_tensor_key, " not found in checkpoint");
+  }
+  return Status::OK();
+}
+
 FileOutputBuffer::~FileOutputBuffer() { delete file_; }
 
 Status FileOutputBuffer::Append(StringPiece data) {
@@ -1068,21 +1455,18 @@ Status FileOutputBuffer::Append(StringPiece data) {
   // points to tensor buffers, which may be concurrently written.
   if (data.size() + position_ <= buffer_size_) {
     // Can fit into the current buffer.
-    memcpy(&buffer_[position_], data.data(), data.size());
-    crc32c_ = crc32c::Extend(crc32c_, &buffer_[position_], data.size());
+    CopyToBuffer(data);
   } else if (data.size() <= buffer_size_) {
     // Cannot fit, but can fit after flushing.
     TF_RETURN_IF_ERROR(FlushBuffer());
-    memcpy(&buffer_[0], data.data(), data.size());
-    crc32c_ = crc32c::Extend(crc32c_, &buffer_[0], data.size());
+    CopyToBuffer(data);
   } else {
     // Cannot fit even after flushing.  So we break down "data" by chunk, and
     // flush/checksum each chunk.
     TF_RETURN_IF_ERROR(FlushBuffer());
     for (size_t i = 0; i < data.size(); i += buffer_size_) {
       const size_t nbytes = std::min(data.size() - i, buffer_size_);
-      memcpy(&buffer_[0], data.data() + i, nbytes);
-      crc32c_ = crc32c::Extend(crc32c_, &buffer_[0], nbytes);
+      CopyToBuffer(StringPiece(data.data() + i, nbytes));
       position_ = nbytes;
       TF_RETURN_IF_ERROR(FlushBuffer());
     }
@@ -1097,6 +1481,25 @@ Status FileOutputBuffer::Close() {
   return file_->Close();
 }
 
+void FileOutputBuffer::CopyToBuffer(StringPiece data) {
+  char* destination = &buffer_[position_];
+  if (thread_pool_ == nullptr || data.size() <= kParallelChunkSize) {
+    memcpy(destination, data.data(), data.size());
+    crc32c_ = crc32c::Extend(crc32c_, destination, data.size());
+    return;
+  }
+  uint32 crc32c = 0;
+  TF_CHECK_OK(RunInChunks(
+      thread_pool_, data.size(),
+      [&data, destination](size_t offset, size_t length, uint32* chunk_crc32c) {
+        memcpy(destination + offset, data.data() + offset, length);
+        *chunk_crc32c = crc32c::Value(destination + offset, length);
+        return Status::OK();
+      },
+      &crc32c));
+  crc32c_ = crc32c::Combine(crc32c_, crc32c, data.size());
+}
+
 Status FileOutputBuffer::FlushBuffer() {
   if (position_ > 0) {
     TF_RETURN_IF_ERROR(file_->Append(StringPiece(&buffer_[0], position_)));
@@ -64,13 +64,16 @@ limitations under the License.
 #include "tensorflow/core/protobuf/tensor_bundle.pb.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/table.h"
@@ -110,8 +113,13 @@ class BundleWriter {
   struct Options {
     Options() {}
     // Alignment, in bytes, for tensor data.
-    // Must be >= 1. The default size of 1 densely packs tensors.
+    // Must be >= 1. The default size of 1 densely packs tensors.  Bundles that
+    // are read with BundleReader::LookupMemmapped() should be written with an
+    // alignment of Allocator::kAllocatorAlignment.
     int data_alignment{1};
+    // If set, the bytes of large tensors are copied into the write buffer and
+    // checksummed in parallel on this pool.  Not owned.
+    thread::ThreadPool* thread_pool{nullptr};
   };
   BundleWriter(Env* env, StringPiece prefix,
                const Options& options = Options());
@@ -181,7 +189,14 @@ Status MergeBundles(Env* env, gtl::ArraySlice<string> prefixes,
 // All threads accessing the same BundleReader must synchronize.
 class BundleReader {
  public:
-  BundleReader(Env* const env, StringPiece prefix);
+  struct Options {
+    Options() {}
+    // If set, large tensors are read from the data files in several chunks,
+    // which are fetched and checksummed in parallel on this pool.  Not owned.
+    thread::ThreadPool* thread_pool{nullptr};
+  };
+  BundleReader(Env* const env, StringPiece prefix,
+               const Options& options = Options());
   ~BundleReader();
 
   // Is ok() iff the reader construction is successful (completed the read of
@@ -218,6 +233,22 @@ class BundleReader {
   // REQUIRES: status().ok()
   Status Lookup(StringPiece key, Tensor* val) TF_MUST_USE_RESULT;
 
+  // Looks up the tensor keyed by "key" and replaces "val" with it.  If the
+  // tensor is stored in one piece, has a POD dtype, and is suitably aligned in
+  // its data file (see BundleWriter::Options::data_alignment), the returned
+  // tensor is backed by a read-only memory mapping of the data file instead
+  // of a copy.  The mapping is shared by all tensors from the same data file,
+  // and stays valid after this reader is destroyed.  Other tensors are
+  // restored as if by Lookup().
+  //
+  // This makes restoring large read-only tensors, e.g. for serving, nearly
+  // free, and lets several processes that load the same bundle share its
+  // pages.  The caller must never modify the contents of a memory-mapped
+  // tensor.  Unlike Lookup(), does not validate the stored crc32c checksum of
+  // memory-mapped tensors, which would require reading all of their pages.
+  // REQUIRES: status().ok()
+  Status LookupMemmapped(StringPiece key, Tensor* val) TF_MUST_USE_RESULT;
+
   // Looks up the tensor pointed to by the internal iterator.
   //
   // On error, "val" may contain nonsense data.
@@ -284,6 +315,7 @@ class BundleReader {
 
   Env* env_;  // Not owned.
   const string prefix_;
+  const Options options_;
 
   Status status_;
   RandomAccessFile* metadata_;  // Owned.
@@ -291,6 +323,10 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32, io::InputBuffer*> data_;
+  // Memory mappings of the data files, shared with the tensors returned by
+  // LookupMemmapped().  Populated on-demand.
+  std::unordered_map<int32, std::shared_ptr<ReadOnlyMemoryRegion>>
+      memmapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
@@ -305,13 +341,86 @@ class BundleReader {
   TF_DISALLOW_COPY_AND_ASSIGN(BundleReader);
 };
 
+// Delta bundles.
+//
+// A delta bundle records how tensors changed with respect to some earlier
+// state, typically restored from a full bundle.  For a tensor of rank >= 1
+// with a POD dtype, and the same dtype and shape as before, only the rows
+// (slices along dimension 0) that changed are stored, together with their
+// indices.  Other tensors are stored in full.  Unchanged tensors are omitted.
+// When few rows of large tensors (e.g. embedding tables) change between two
+// saves, a delta bundle is much smaller than a full one.
+//
+// A full base bundle may be followed by a chain of delta bundles, each of
+// which is relative to the state restored from the bundles before it.  A delta
+// bundle may record the bundle it is relative to with AddDeltaBase(), so that
+// OpenDeltaChain() can find the whole chain from the last bundle.
+
+// Adds "val" under "key" to the delta bundle being written by "writer".
+// "base_val" is the previous value of the tensor.
+Status AddDelta(BundleWriter* writer, StringPiece key, const Tensor& base_val,
+                const Tensor& val) TF_MUST_USE_RESULT;
+
+// Like AddDelta(), for a tensor whose changed rows are already known: row "i"
+// of "val" changed iff "changed_rows[i]" is true.  Rows past the end of
+// "changed_rows" did not change.  The caller guarantees that the dtype and
+// shape of the tensor did not change.
+Status AddDeltaRows(BundleWriter* writer, StringPiece key, const Tensor& val,
+                    const std::vector<bool>& changed_rows) TF_MUST_USE_RESULT;
+
+// Returns the key under which delta bundles store the slice "slice_spec" of
+// the partitioned tensor "full_tensor_key".  Base bundles store it with
+// BundleWriter::AddSlice() as usual.
+string DeltaSliceKey(StringPiece full_tensor_key,
+                     const TensorSlice& slice_spec);
+
+// Records in the delta bundle being written by "writer" that it is relative
+// to the bundle with prefix "base_name", which must live in the same
+// directory.  "base_name" is the basename of that prefix, so that the chain
+// can be moved to another directory as a whole.
+Status AddDeltaBase(BundleWriter* writer,
+                    StringPiece base_name) TF_MUST_USE_RESULT;
+
+// Opens the bundle with prefix "prefix" and, following the bases recorded by
+// AddDeltaBase(), the bundles it is relative to.  On success, "readers" holds
+// the full base bundle first and "prefix" last; a bundle without a recorded
+// base yields a single reader.
+Status OpenDeltaChain(Env* env, StringPiece prefix,
+                      std::vector<std::unique_ptr<BundleReader>>* readers)
+    TF_MUST_USE_RESULT;
+
+// Restores the tensor keyed by "key" from the bundle "base" followed by the
+// delta bundles "deltas", in order, and stores it into "val".  Unlike
+// BundleReader::Lookup(), allocates "val".  Returns a NotFound error if "key"
+// exists in none of the bundles.
+// REQUIRES: status().ok() for all readers
+Status LookupWithDeltas(BundleReader* base,
+                        gtl::ArraySlice<BundleReader*> deltas, StringPiece key,
+                        Tensor* val) TF_MUST_USE_RESULT;
+
+// Like LookupWithDeltas(), for the slice "slice_spec" of the partitioned
+// tensor "full_tensor_key".  Like BundleReader::LookupSlice(), "val" must be
+// allocated with the shape of the slice.
+Status LookupSliceWithDeltas(BundleReader* base,
+                             gtl::ArraySlice<BundleReader*> deltas,
+                             StringPiece full_tensor_key,
+                             const TensorSlice& slice_spec,
+                             Tensor* val) TF_MUST_USE_RESULT;
+
 // A buffering wrapper for a WritableFile.  Useful if the caller wishes to issue
 // small writes to a file (e.g. writing out a list of small varints).
 // External synchronization must be used in the presence of concurrent callers.
+//
+// If "thread_pool" is not null, large appends are copied into the buffer and
+// checksummed in parallel on it.
 class FileOutputBuffer {
  public:
-  FileOutputBuffer(WritableFile* file, size_t buffer_size)
-      : file_(file), position_(0), buffer_size_(buffer_size) {
+  FileOutputBuffer(WritableFile* file, size_t buffer_size,
+                   thread::ThreadPool* thread_pool = nullptr)
+      : file_(file),
+        position_(0),
+        buffer_size_(buffer_size),
+        thread_pool_(thread_pool) {
     DCHECK_GT(buffer_size, 0);
     buffer_.resize(buffer_size);
   }
@@ -332,6 +441,11 @@ class FileOutputBuffer {
   // Appends the buffered data to the underlying file. Does NOT flush the file.
   Status FlushBuffer();
 
+  // Copies "data" to buffer_[position_, position_ + data.size()) and extends
+  // the running checksum with the copied bytes.  Does not update position_.
+  // REQUIRES: position_ + data.size() <= buffer_size_
+  void CopyToBuffer(StringPiece data);
+
   WritableFile* file_;  // Owned.
 
   // buffer_[0, position_) holds the buffered data not yet appended to the
@@ -339,6 +453,7 @@ class FileOutputBuffer {
   size_t position_;
   const size_t buffer_size_;
   std::vector<char> buffer_;
+  thread::ThreadPool* const thread_pool_;  // Not owned; may be null.
 
   // Checksum of all appended bytes since construction or last clear_crc32c().
   uint32 crc32c_ = 0;
@@ -18,7 +18,9 @@ limitations under the License.
 #include <random>
 #include <vector>
 
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/framework/variant_op_registry.h"
@@ -671,6 +673,295 @@ TEST(TensorBundleTest, Checksum) {
   }
 }
 
+TEST(TensorBundleTest, ThreadPool) {
+  thread::ThreadPool pool(Env::Default(), "bundle_test", 4);
+  // Sizes that fit in the write buffer, exceed it, and exceed several
+  // parallel chunks without being a multiple of the chunk size.
+  const Tensor medium = test::AsTensor<float>(
+      std::vector<float>(3 * 256 * 1024 + 7, 1.5f), {3 * 256 * 1024 + 7});
+  Tensor large(DT_INT64, TensorShape({3 * 1024 * 1024 + 3}));
+  auto large_flat = large.flat<int64>();
+  for (int64 i = 0; i < large_flat.size(); ++i) {
+    large_flat(i) = i * 7 - 3;
+  }
+  {
+    BundleWriter::Options opts;
+    opts.thread_pool = &pool;
+    BundleWriter writer(Env::Default(), Prefix("thread_pool"), opts);
+    TF_EXPECT_OK(writer.Add("large", large));
+    TF_EXPECT_OK(writer.Add("medium", medium));
+    TF_EXPECT_OK(writer.Add("small", Constant_2x3<float>(2.f)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  // The checksums must not depend on whether a pool is used when reading.
+  for (thread::ThreadPool* read_pool :
+       std::vector<thread::ThreadPool*>{&pool, nullptr}) {
+    BundleReader::Options opts;
+    opts.thread_pool = read_pool;
+    BundleReader reader(Env::Default(), Prefix("thread_pool"), opts);
+    TF_ASSERT_OK(reader.status());
+    Expect<int64>(&reader, "large", large);
+    Expect<float>(&reader, "medium", medium);
+    Expect<float>(&reader, "small", Constant_2x3<float>(2.f));
+  }
+
+  // Corrupts the last chunk of "large".
+  const string datafile = DataFilename(Prefix("thread_pool"), 0, 1);
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), datafile, &data));
+  const size_t pos = large.TotalBytes() - 1;
+  data[pos] = ~data[pos];
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), datafile, data));
+  BundleReader::Options opts;
+  opts.thread_pool = &pool;
+  BundleReader reader(Env::Default(), Prefix("thread_pool"), opts);
+  TF_ASSERT_OK(reader.status());
+  Tensor val(DT_INT64, large.shape());
+  Status status = reader.Lookup("large", &val);
+  EXPECT_TRUE(errors::IsDataLoss(status));
+  EXPECT_TRUE(
+      str_util::StrContains(status.ToString(), "Checksum does not match"));
+}
+
+TEST(TensorBundleTest, Memmapped) {
+  Tensor large(DT_INT64, TensorShape({1000, 10}));
+  auto large_flat = large.flat<int64>();
+  for (int64 i = 0; i < large_flat.size(); ++i) {
+    large_flat(i) = i * 3 + 1;
+  }
+  const Tensor strings = test::AsTensor<string>({"hello", "world"});
+  for (int alignment : {1, static_cast<int>(Allocator::kAllocatorAlignment)}) {
+    {
+      BundleWriter::Options opts;
+      opts.data_alignment = alignment;
+      BundleWriter writer(Env::Default(), Prefix("memmapped"), opts);
+      TF_EXPECT_OK(writer.Add("a_small", Constant(true, TensorShape({3}))));
+      TF_EXPECT_OK(writer.Add("b_large", large));
+      TF_EXPECT_OK(writer.Add("c_strings", strings));
+      TF_EXPECT_OK(writer.Add("d_empty", Constant(1.f, TensorShape({0, 2}))));
+      TF_EXPECT_OK(writer.AddSlice("e_sliced", TensorShape({2, 3}),
+                                   TensorSlice::ParseOrDie("0,1:-"),
+                                   Constant(2.f, TensorShape({1, 3}))));
+      TF_EXPECT_OK(writer.AddSlice("e_sliced", TensorShape({2, 3}),
+                                   TensorSlice::ParseOrDie("1,1:-"),
+                                   Constant(3.f, TensorShape({1, 3}))));
+      TF_ASSERT_OK(writer.Finish());
+    }
+    Tensor a, b, b_again;
+    {
+      BundleReader reader(Env::Default(), Prefix("memmapped"));
+      TF_ASSERT_OK(reader.status());
+      TF_ASSERT_OK(reader.LookupMemmapped("a_small", &a));
+      TF_ASSERT_OK(reader.LookupMemmapped("b_large", &b));
+      TF_ASSERT_OK(reader.LookupMemmapped("b_large", &b_again));
+
+      Tensor val;
+      TF_ASSERT_OK(reader.LookupMemmapped("c_strings", &val));
+      test::ExpectTensorEqual<string>(strings, val);
+      TF_ASSERT_OK(reader.LookupMemmapped("d_empty", &val));
+      EXPECT_EQ(TensorShape({0, 2}), val.shape());
+      TF_ASSERT_OK(reader.LookupMemmapped("e_sliced", &val));
+      test::ExpectTensorEqual<float>(
+          test::AsTensor<float>({2, 2, 2, 3, 3, 3}, TensorShape({2, 3})), val);
+      EXPECT_TRUE(errors::IsNotFound(reader.LookupMemmapped("missing", &val)));
+    }
+    // The tensors remain valid after the reader has been destroyed.
+    test::ExpectTensorEqual<bool>(Constant(true, TensorShape({3})), a);
+    test::ExpectTensorEqual<int64>(large, b);
+    test::ExpectTensorEqual<int64>(large, b_again);
+    // Aligned tensors share the mapping rather than being copied.
+    EXPECT_EQ(alignment > 1,
+              b.tensor_data().data() == b_again.tensor_data().data());
+  }
+}
+
+TEST(TensorBundleTest, Deltas) {
+  Tensor embedding(DT_FLOAT, TensorShape({100, 4}));
+  embedding.flat<float>().setConstant(1.f);
+  const Tensor bias = Constant(2.f, TensorShape({4}));
+  Tensor step = test::AsScalar<int64>(10);
+  {
+    BundleWriter writer(Env::Default(), Prefix("delta_base"));
+    TF_EXPECT_OK(writer.Add("bias", bias));
+    TF_EXPECT_OK(writer.Add("embedding", embedding));
+    TF_EXPECT_OK(writer.Add("step", step));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  // First delta: two rows of "embedding" and "step" change.
+  Tensor embedding1 = tensor::DeepCopy(embedding);
+  embedding1.matrix<float>()(3, 1) = 5.f;
+  embedding1.matrix<float>()(50, 0) = 6.f;
+  const Tensor step1 = test::AsScalar<int64>(20);
+  {
+    BundleWriter writer(Env::Default(), Prefix("delta_1"));
+    TF_EXPECT_OK(AddDelta(&writer, "bias", bias, bias));
+    TF_EXPECT_OK(AddDelta(&writer, "embedding", embedding, embedding1));
+    TF_EXPECT_OK(AddDelta(&writer, "step", step, step1));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleReader reader(Env::Default(), Prefix("delta_1"));
+    TF_ASSERT_OK(reader.status());
+    EXPECT_EQ(AllTensorKeys(&reader),
+              std::vector<string>({"embedding/.DELTA_INDICES",
+                                   "embedding/.DELTA_ROWS", "step"}));
+    TensorShape shape;
+    TF_ASSERT_OK(reader.LookupTensorShape("embedding/.DELTA_ROWS", &shape));
+    EXPECT_EQ(TensorShape({2, 4}), shape);
+  }
+
+  // Second delta: one more row changes, and "bias" changes shape.
+  Tensor embedding2 = tensor::DeepCopy(embedding1);
+  embedding2.matrix<float>()(99, 3) = 7.f;
+  const Tensor bias2 = Constant(3.f, TensorShape({5}));
+  {
+    BundleWriter writer(Env::Default(), Prefix("delta_2"));
+    TF_EXPECT_OK(AddDelta(&writer, "bias", bias, bias2));
+    TF_EXPECT_OK(AddDelta(&writer, "embedding", embedding1, embedding2));
+    TF_EXPECT_OK(AddDelta(&writer, "step", step1, step1));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  BundleReader base(Env::Default(), Prefix("delta_base"));
+  BundleReader delta1(Env::Default(), Prefix("delta_1"));
+  BundleReader delta2(Env::Default(), Prefix("delta_2"));
+  TF_ASSERT_OK(base.status());
+  TF_ASSERT_OK(delta1.status());
+  TF_ASSERT_OK(delta2.status());
+  Tensor val;
+  TF_ASSERT_OK(LookupWithDeltas(&base, {&delta1}, "embedding", &val));
+  test::ExpectTensorEqual<float>(embedding1, val);
+  TF_ASSERT_OK(LookupWithDeltas(&base, {&delta1, &delta2}, "embedding", &val));
+  test::ExpectTensorEqual<float>(embedding2, val);
+  TF_ASSERT_OK(LookupWithDeltas(&base, {&delta1, &delta2}, "bias", &val));
+  test::ExpectTensorEqual<float>(bias2, val);
+  TF_ASSERT_OK(LookupWithDeltas(&base, {&delta1, &delta2}, "step", &val));
+  test::ExpectTensorEqual<int64>(step1, val);
+  TF_ASSERT_OK(LookupWithDeltas(&base, {}, "step", &val));
+  test::ExpectTensorEqual<int64>(step, val);
+  EXPECT_TRUE(errors::IsNotFound(
+      LookupWithDeltas(&base, {&delta1, &delta2}, "missing", &val)));
+  // Row changes without a base tensor.
+  EXPECT_TRUE(errors::IsDataLoss(
+      LookupWithDeltas(&delta2, {&delta1}, "embedding", &val)));
+
+  // Row changes of tensors without rows.
+  {
+    BundleWriter writer(Env::Default(), Prefix("delta_empty_base"));
+    TF_EXPECT_OK(writer.Add("empty", Tensor(DT_FLOAT, TensorShape({0, 4}))));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleWriter writer(Env::Default(), Prefix("delta_no_rows"));
+    TF_EXPECT_OK(writer.Add("step/.DELTA_INDICES",
+                            test::AsTensor<int64>({0}, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("step/.DELTA_ROWS", step1));
+    TF_EXPECT_OK(writer.Add("empty/.DELTA_INDICES",
+                            test::AsTensor<int64>({0}, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("empty/.DELTA_ROWS", bias));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader empty_base(Env::Default(), Prefix("delta_empty_base"));
+  BundleReader no_rows(Env::Default(), Prefix("delta_no_rows"));
+  TF_ASSERT_OK(empty_base.status());
+  TF_ASSERT_OK(no_rows.status());
+  EXPECT_TRUE(errors::IsDataLoss(
+      LookupWithDeltas(&base, {&no_rows}, "step", &val)));
+  EXPECT_TRUE(errors::IsDataLoss(
+      LookupWithDeltas(&empty_base, {&no_rows}, "empty", &val)));
+}
+
+TEST(TensorBundleTest, DeltaChains) {
+  Tensor embedding(DT_FLOAT, TensorShape({10, 2}));
+  embedding.flat<float>().setConstant(1.f);
+  const Tensor step = test::AsScalar<int64>(10);
+  TensorSlice slice;
+  TF_ASSERT_OK(TensorSlice::Parse("0,5:-", &slice));
+  Tensor part = Constant(2.f, TensorShape({5, 2}));
+  {
+    BundleWriter writer(Env::Default(), Prefix("chain_base"));
+    TF_EXPECT_OK(writer.Add("embedding", embedding));
+    TF_EXPECT_OK(writer.Add("step", step));
+    TF_EXPECT_OK(writer.AddSlice("part", TensorShape({10, 2}), slice, part));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  // First delta: rows of the known changed rows are stored.
+  Tensor embedding1 = tensor::DeepCopy(embedding);
+  embedding1.matrix<float>()(2, 0) = 5.f;
+  Tensor part1 = tensor::DeepCopy(part);
+  part1.matrix<float>()(4, 1) = 6.f;
+  {
+    BundleWriter writer(Env::Default(), Prefix("chain_1"));
+    TF_EXPECT_OK(AddDeltaBase(&writer, "chain_base"));
+    std::vector<bool> changed(10);
+    changed[2] = true;
+    TF_EXPECT_OK(AddDeltaRows(&writer, "embedding", embedding1, changed));
+    // Rows past the end of "changed" did not change.
+    TF_EXPECT_OK(AddDeltaRows(&writer, "part", part1, {false, false}));
+    TF_EXPECT_OK(AddDeltaRows(&writer, DeltaSliceKey("part", slice), part1,
+                              {false, false, false, false, true}));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleReader reader(Env::Default(), Prefix("chain_1"));
+    TF_ASSERT_OK(reader.status());
+    TensorShape shape;
+    TF_ASSERT_OK(reader.LookupTensorShape("embedding/.DELTA_ROWS", &shape));
+    EXPECT_EQ(TensorShape({1, 2}), shape);
+    EXPECT_FALSE(reader.Contains("part"));
+  }
+
+  // Second delta: "step" is stored in full.
+  const Tensor step2 = test::AsScalar<int64>(20);
+  {
+    BundleWriter writer(Env::Default(), Prefix("chain_2"));
+    TF_EXPECT_OK(AddDeltaBase(&writer, "chain_1"));
+    TF_EXPECT_OK(AddDeltaRows(&writer, "step", step2, {}));
+    TF_ASSERT_OK(writer.Finish());
+  }
+
+  std::vector<std::unique_ptr<BundleReader>> readers;
+  TF_ASSERT_OK(OpenDeltaChain(Env::Default(), Prefix("chain_2"), &readers));
+  ASSERT_EQ(3, readers.size());
+  std::vector<BundleReader*> deltas = {readers[1].get(), readers[2].get()};
+  Tensor val;
+  TF_ASSERT_OK(LookupWithDeltas(readers[0].get(), deltas, "embedding", &val));
+  test::ExpectTensorEqual<float>(embedding1, val);
+  TF_ASSERT_OK(LookupWithDeltas(readers[0].get(), deltas, "step", &val));
+  test::ExpectTensorEqual<int64>(step2, val);
+  val = Tensor(DT_FLOAT, TensorShape({5, 2}));
+  TF_ASSERT_OK(LookupSliceWithDeltas(readers[0].get(), deltas, "part", slice,
+                                     &val));
+  test::ExpectTensorEqual<float>(part1, val);
+
+  // A bundle without a base is a chain of one.
+  TF_ASSERT_OK(
+      OpenDeltaChain(Env::Default(), Prefix("chain_base"), &readers));
+  EXPECT_EQ(1, readers.size());
+
+  // Bases are named by basenames, and must exist.
+  {
+    BundleWriter writer(Env::Default(), Prefix("chain_bad"));
+    EXPECT_TRUE(errors::IsInvalidArgument(
+        AddDeltaBase(&writer, Prefix("chain_base"))));
+    TF_EXPECT_OK(AddDeltaBase(&writer, "missing"));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_FALSE(
+      OpenDeltaChain(Env::Default(), Prefix("chain_bad"), &readers).ok());
+
+  // Cycles are detected.
+  {
+    BundleWriter writer(Env::Default(), Prefix("chain_cycle"));
+    TF_EXPECT_OK(AddDeltaBase(&writer, "chain_cycle"));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  EXPECT_TRUE(errors::IsDataLoss(
+      OpenDeltaChain(Env::Default(), Prefix("chain_cycle"), &readers)));
+}
+
 TEST(TensorBundleTest, Endianness) {
   BundleWriter writer(Env::Default(), Prefix("end"));
   TF_EXPECT_OK(writer.Add("key", Constant_2x3<float>(1.0)));
@@ -859,4 +1150,93 @@ BM_BundleAlignment(4096, 512);
 BM_BundleAlignment(4096, 4096);
 BM_BundleAlignment(4096, 1048576);
 
+// Measures the throughput of saving (if "read" is false) or restoring one
+// tensor of "size_mb" MB, with "num_threads" threads for copying, I/O and
+// checksumming.
+static void BM_BundleLargeTensor(int iters, bool read, int size_mb,
+                                 int num_threads) {
+  testing::StopTiming();
+  std::unique_ptr<thread::ThreadPool> pool;
+  if (num_threads > 0) {
+    pool.reset(
+        new thread::ThreadPool(Env::Default(), "bm_bundle", num_threads));
+  }
+  const Tensor val = Constant(1.f, TensorShape({size_mb * 256 * 1024}));
+  BundleWriter::Options write_opts;
+  write_opts.thread_pool = pool.get();
+  if (read) {
+    BundleWriter writer(Env::Default(), Prefix("bm_large"), write_opts);
+    TF_CHECK_OK(writer.Add("big", val));
+    TF_CHECK_OK(writer.Finish());
+  }
+  BundleReader::Options read_opts;
+  read_opts.thread_pool = pool.get();
+  testing::BytesProcessed(static_cast<int64>(iters) * val.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (read) {
+      BundleReader reader(Env::Default(), Prefix("bm_large"), read_opts);
+      Tensor t(DT_FLOAT, val.shape());
+      TF_CHECK_OK(reader.Lookup("big", &t));
+    } else {
+      BundleWriter writer(Env::Default(), Prefix("bm_large"), write_opts);
+      TF_CHECK_OK(writer.Add("big", val));
+      TF_CHECK_OK(writer.Finish());
+    }
+  }
+  testing::StopTiming();
+}
+
+// Measures the time to load one tensor of "size_mb" MB from a bundle, with or
+// without memory mapping.
+static void BM_BundleLoadLargeTensor(int iters, int size_mb, bool memmapped) {
+  testing::StopTiming();
+  const Tensor val = Constant(1.f, TensorShape({size_mb * 256 * 1024}));
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = Allocator::kAllocatorAlignment;
+    BundleWriter writer(Env::Default(), Prefix("bm_load"), opts);
+    TF_CHECK_OK(writer.Add("big", val));
+    TF_CHECK_OK(writer.Finish());
+  }
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    BundleReader reader(Env::Default(), Prefix("bm_load"));
+    Tensor t;
+    if (memmapped) {
+      TF_CHECK_OK(reader.LookupMemmapped("big", &t));
+    } else {
+      TF_CHECK_OK(reader.Lookup("big", &t));
+    }
+  }
+  testing::StopTiming();
+}
+
+static void BM_BundleLookup(int iters, int size_mb) {
+  BM_BundleLoadLargeTensor(iters, size_mb, false);
+}
+BENCHMARK(BM_BundleLookup)->Arg(1)->Arg(64);
+
+static void BM_BundleLookupMemmapped(int iters, int size_mb) {
+  BM_BundleLoadLargeTensor(iters, size_mb, true);
+}
+BENCHMARK(BM_BundleLookupMemmapped)->Arg(1)->Arg(64);
+
+static void BM_BundleSaveLargeTensor(int iters, int size_mb, int num_threads) {
+  BM_BundleLargeTensor(iters, false, size_mb, num_threads);
+}
+BENCHMARK(BM_BundleSaveLargeTensor)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+static void BM_BundleRestoreLargeTensor(int iters, int size_mb,
+                                        int num_threads) {
+  BM_BundleLargeTensor(iters, true, size_mb, num_threads);
+}
+BENCHMARK(BM_BundleRestoreLargeTensor)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
 }  // namespace tensorflow
@@ -20,9 +20,11 @@ from __future__ import print_function
 from os import path
 import shutil
 import tempfile
+import time
 
 import numpy as np
 
+from tensorflow.python.client import session
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.data.ops import iterator_ops
 from tensorflow.python.framework import constant_op
@@ -199,6 +201,34 @@ class FilesystemCacheDatasetTest(test.TestCase):
       self.assertAllEqual(elements, elements_itr1)
       self.assertAllEqual(elements, elements_itr2)
 
+  def testReadErrorIsRepeated(self):
+    components = np.array([1, 2, 3, 4])
+    cache_dataset = (dataset_ops.Dataset.from_tensor_slices(components)
+                     .cache(self.cache_prefix))
+    iterator = cache_dataset.make_initializable_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      sess.run(iterator.initializer)
+      for _ in range(4):
+        sess.run(get_next)
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
+      # Corrupt the cached tensors, so that their checksums don't match.
+      data_file = self.cache_prefix + ".data-00000-of-00001"
+      with open(data_file, "rb") as f:
+        data = f.read()
+      with open(data_file, "wb") as f:
+        f.write(bytes(bytearray(b ^ 0xff for b in bytearray(data))))
+
+      sess.run(iterator.initializer)
+      with self.assertRaises(errors.DataLossError):
+        sess.run(get_next)
+      # Later calls report the same error.
+      with self.assertRaises(errors.DataLossError):
+        sess.run(get_next)
+
 
 class MemoryCacheDatasetTest(test.TestCase):
 
@@ -313,5 +343,51 @@ class MemoryCacheDatasetTest(test.TestCase):
         sess.run(itr.get_next())
 
 
+class FileCacheDatasetBenchmark(test.Benchmark):
+
+  def benchmarkSecondEpochThroughput(self):
+    num_elements = 10000
+    for element_size in [1, 1024, 64 * 1024]:
+      tmp_dir = tempfile.mkdtemp()
+      try:
+        cache_prefix = path.join(tmp_dir, "cache")
+        with ops.Graph().as_default():
+          dataset = dataset_ops.Dataset.from_tensors(
+              array_ops.zeros([element_size], dtype=dtypes.uint8)).repeat(
+                  num_elements).cache(cache_prefix)
+          iterator = dataset.make_initializable_iterator()
+          next_element = iterator.get_next()
+
+          with session.Session() as sess:
+            # The first epoch populates the cache files.
+            sess.run(iterator.initializer)
+            try:
+              while True:
+                sess.run(next_element.op)
+            except errors.OutOfRangeError:
+              pass
+
+            deltas = []
+            for _ in range(5):
+              sess.run(iterator.initializer)
+              start = time.time()
+              for _ in range(num_elements):
+                sess.run(next_element.op)
+              end = time.time()
+              deltas.append(end - start)
+
+            median_wall_time = np.median(deltas) / num_elements
+            print("File cache element size: %d bytes Median wall time per "
+                  "element: %f microseconds" % (element_size,
+                                                 median_wall_time * 1e6))
+            self.report_benchmark(
+                iters=num_elements,
+                wall_time=median_wall_time,
+                name="benchmark_file_cache_second_epoch_element_size_%d" %
+                element_size)
+      finally:
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+
+
 if __name__ == "__main__":
   test.main()
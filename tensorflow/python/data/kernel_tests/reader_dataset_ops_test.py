@@ -19,8 +19,14 @@ from __future__ import print_function
 
 import gzip
 import os
+import shutil
+import tempfile
+import time
 import zlib
 
+import numpy as np
+
+from tensorflow.python.client import session
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.data.ops import iterator_ops
 from tensorflow.python.data.ops import readers
@@ -781,6 +787,29 @@ class TFRecordDatasetTest(test.TestCase):
       with self.assertRaises(errors.OutOfRangeError):
         sess.run(next_element)
 
+  def testVerifyDataChecksum(self):
+    # Flip a byte of the data of the first record, past its 12 byte header.
+    with open(self.test_filenames[0], "r+b") as f:
+      f.seek(12)
+      data = bytearray(f.read(1))
+      f.seek(12)
+      f.write(bytes(bytearray([data[0] ^ 0xff])))
+
+    with self.test_session() as sess:
+      next_element = readers.TFRecordDataset(
+          [self.test_filenames[0]]).make_one_shot_iterator().get_next()
+      with self.assertRaises(errors.DataLossError):
+        sess.run(next_element)
+
+      next_element = readers.TFRecordDataset(
+          [self.test_filenames[0]],
+          verify_data_checksum=False).make_one_shot_iterator().get_next()
+      self.assertNotEqual(self._record(0, 0), sess.run(next_element))
+      for j in range(1, self._num_records):
+        self.assertAllEqual(self._record(0, j), sess.run(next_element))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(next_element)
+
   def testReadFromDatasetOfFiles(self):
     files = dataset_ops.Dataset.from_tensor_slices(self.test_filenames)
     d = readers.TFRecordDataset(files)
@@ -812,5 +841,65 @@ class TFRecordDatasetTest(test.TestCase):
       self.assertEqual(sorted(expected), sorted(actual))
 
 
+class TFRecordDatasetBenchmark(test.Benchmark):
+
+  def _createFiles(self, tmp_dir, num_files, records_per_file, record_size):
+    filenames = []
+    record = b"x" * record_size
+    for i in range(num_files):
+      fn = os.path.join(tmp_dir, "tf_record.%d" % i)
+      filenames.append(fn)
+      writer = python_io.TFRecordWriter(fn)
+      for _ in range(records_per_file):
+        writer.write(record)
+      writer.close()
+    return filenames
+
+  def benchmarkReadThroughput(self):
+    num_records = 8192
+    record_size = 4096
+    for num_files in [1, 64]:
+      for num_parallel_reads in [None, 4]:
+        tmp_dir = tempfile.mkdtemp()
+        try:
+          filenames = self._createFiles(tmp_dir, num_files,
+                                        num_records // num_files, record_size)
+          with ops.Graph().as_default():
+            dataset = readers.TFRecordDataset(
+                filenames, num_parallel_reads=num_parallel_reads).batch(256)
+            iterator = dataset.make_initializable_iterator()
+            next_element = iterator.get_next()
+
+            with session.Session() as sess:
+              deltas = []
+              for _ in range(5):
+                sess.run(iterator.initializer)
+                start = time.time()
+                try:
+                  while True:
+                    sess.run(next_element.op)
+                except errors.OutOfRangeError:
+                  pass
+                end = time.time()
+                deltas.append(end - start)
+
+              median_wall_time = np.median(deltas)
+              name = ("benchmark_tf_record_dataset_files_%d_parallel_reads_%d" %
+                      (num_files, num_parallel_reads or 1))
+              print("%s: median wall time %f seconds (%f MB/s)" %
+                    (name, median_wall_time,
+                     num_records * record_size / median_wall_time / 1e6))
+              self.report_benchmark(
+                  iters=num_records,
+                  wall_time=median_wall_time,
+                  extras={
+                      "bytes_per_second":
+                          num_records * record_size / median_wall_time
+                  },
+                  name=name)
+        finally:
+          shutil.rmtree(tmp_dir, ignore_errors=True)
+
+
 if __name__ == "__main__":
   test.main()
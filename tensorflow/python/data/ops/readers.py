@@ -79,7 +79,8 @@ class TextLineDataset(dataset_ops.Dataset):
 class _TFRecordDataset(dataset_ops.Dataset):
   """A `Dataset` comprising records from one or more TFRecord files."""
 
-  def __init__(self, filenames, compression_type=None, buffer_size=None):
+  def __init__(self, filenames, compression_type=None, buffer_size=None,
+               verify_data_checksum=True):
     """Creates a `TFRecordDataset`.
 
     Args:
@@ -88,6 +89,8 @@ class _TFRecordDataset(dataset_ops.Dataset):
         `""` (no compression), `"ZLIB"`, or `"GZIP"`.
       buffer_size: (Optional.) A `tf.int64` scalar representing the number of
         bytes in the read buffer. 0 means no buffering.
+      verify_data_checksum: (Optional.) A Python boolean. If False, the
+        checksum of each record's data is not verified.
     """
     super(_TFRecordDataset, self).__init__()
     # Force the type to string even if filenames is an empty list.
@@ -102,10 +105,12 @@ class _TFRecordDataset(dataset_ops.Dataset):
         "buffer_size",
         buffer_size,
         argument_default=_DEFAULT_READER_BUFFER_SIZE_BYTES)
+    self._verify_data_checksum = verify_data_checksum
 
   def _as_variant_tensor(self):
     return gen_dataset_ops.tf_record_dataset(
-        self._filenames, self._compression_type, self._buffer_size)
+        self._filenames, self._compression_type, self._buffer_size,
+        verify_data_checksum=self._verify_data_checksum)
 
   @property
   def output_classes(self):
@@ -162,7 +167,7 @@ class TFRecordDataset(dataset_ops.Dataset):
   """A `Dataset` comprising records from one or more TFRecord files."""
 
   def __init__(self, filenames, compression_type=None, buffer_size=None,
-               num_parallel_reads=None):
+               num_parallel_reads=None, verify_data_checksum=True):
     """Creates a `TFRecordDataset` to read for one or more TFRecord files.
 
     NOTE: The `num_parallel_reads` argument can be used to improve performance
@@ -178,6 +183,10 @@ class TFRecordDataset(dataset_ops.Dataset):
       num_parallel_reads: (Optional.) A `tf.int64` scalar representing the
         number of files to read in parallel. Defaults to reading files
         sequentially.
+      verify_data_checksum: (Optional.) A Python boolean. If False, the
+        checksum of each record's data is not verified, which saves time
+        when reading trusted files. The checksum of each record's length is
+        always verified. Defaults to True.
 
     Raises:
       TypeError: If any argument does not have the expected type.
@@ -201,9 +210,11 @@ class TFRecordDataset(dataset_ops.Dataset):
     self._compression_type = compression_type
     self._buffer_size = buffer_size
     self._num_parallel_reads = num_parallel_reads
+    self._verify_data_checksum = verify_data_checksum
 
     def read_one_file(filename):
-      return _TFRecordDataset(filename, compression_type, buffer_size)
+      return _TFRecordDataset(filename, compression_type, buffer_size,
+                              verify_data_checksum)
 
     if num_parallel_reads is None:
       self._impl = filenames.flat_map(read_one_file)
@@ -221,7 +232,8 @@ class TFRecordDataset(dataset_ops.Dataset):
     return TFRecordDataset(filenames or self._filenames,
                            compression_type or self._compression_type,
                            buffer_size or self._buffer_size,
-                           num_parallel_reads or self._num_parallel_reads)
+                           num_parallel_reads or self._num_parallel_reads,
+                           self._verify_data_checksum)
 
   def _as_variant_tensor(self):
     return self._impl._as_variant_tensor()  # pylint: disable=protected-access
@@ -222,6 +222,26 @@ class IndexedSlicesConditionalAccumulatorTest(test.TestCase):
       self.assertAllEqual(val.values, [[5, 5], [0, 20], [30, 0]])
       self.assertAllEqual(val.dense_shape, [-1, 2])
 
+  def testAccumulatorUnorderedRepeatedIndices(self):
+    with self.test_session() as sess:
+      q = data_flow_ops.SparseConditionalAccumulator(
+          dtypes_lib.float32, name="Q", shape=())
+
+      accum_op = q.apply_grad([2, 0],
+                              np.array([[1, 1], [2, 2]]).astype(np.float32))
+      accum_op.run()
+      # Slices with the same index are summed, and count once towards the
+      # average of their row.
+      accum_op = q.apply_grad(
+          [0, 1, 0],
+          np.array([[1, 0], [3, 3], [1, 0]]).astype(np.float32))
+      accum_op.run()
+
+      takeg_t = q.take_indexed_slices_grad(1)
+      val = sess.run(takeg_t)
+      self.assertAllEqual(val.indices, [0, 1, 2])
+      self.assertAllEqual(val.values, [[2, 1], [3, 3], [1, 1]])
+
   def testParallelApplyGrad(self):
     with self.test_session() as sess:
       q = data_flow_ops.SparseConditionalAccumulator(
@@ -22,7 +22,7 @@ from tensorflow.python.ops import gen_collective_ops
 
 
 def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
-               subdiv_offsets=(0)):
+               subdiv_offsets=(0), compression='none'):
   """Reduces tensors collectively, across devices.
 
   Args:
@@ -38,6 +38,9 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
     subdiv_offsets: a list of integer offsets into the tensor at which each
       independent subdivision should begin.  Use [0] if no subdivision should
       be done.
+    compression: string naming the encoding of the partial reductions sent
+      between devices: 'none', 'fp16', 'bf16' or 'int8'.  Only supported for
+      float tensors on CPU.
 
   Returns:
     An Op implementing the distributed reduction.
@@ -55,7 +58,8 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
                                               instance_key=instance_key,
                                               merge_op=merge_op,
                                               final_op=final_op,
-                                              subdiv_offsets=subdiv_offsets)
+                                              subdiv_offsets=subdiv_offsets,
+                                              compression=compression)
 
 
 def broadcast_send(t, shape, dtype, group_size, group_key, instance_key):
@@ -29,7 +29,8 @@ from tensorflow.python.platform import test
 
 class CollectiveOpTest(test.TestCase):
 
-  def _testCollectiveReduce(self, t0, t1, expected):
+  def _testCollectiveReduce(self, t0, t1, expected, compression='none',
+                            tolerance=1e-5):
     group_key = 1
     instance_key = 1
     with self.test_session(
@@ -37,22 +38,29 @@ class CollectiveOpTest(test.TestCase):
       with ops.device('/CPU:0'):
         in0 = constant_op.constant(t0)
         colred0 = collective_ops.all_reduce(in0, 2, group_key, instance_key,
-                                            'Add', 'Div', [0])
+                                            'Add', 'Div', [0], compression)
       with ops.device('/CPU:1'):
         in1 = constant_op.constant(t1)
         colred1 = collective_ops.all_reduce(in1, 2, group_key, instance_key,
-                                            'Add', 'Div', [0])
+                                            'Add', 'Div', [0], compression)
       run_options = config_pb2.RunOptions()
       run_options.experimental.collective_graph_key = 1
       results = sess.run([colred0, colred1], options=run_options)
-    self.assertAllClose(results[0], expected, rtol=1e-5, atol=1e-5)
-    self.assertAllClose(results[1], expected, rtol=1e-5, atol=1e-5)
+    self.assertAllClose(results[0], expected, rtol=tolerance, atol=tolerance)
+    self.assertAllClose(results[1], expected, rtol=tolerance, atol=tolerance)
 
   def testCollectiveReduce(self):
     self._testCollectiveReduce([0.1, 1.1, 2.1, 3.1, 4.1, 5.1, 6.1, 7.1],
                                [0.3, 1.3, 2.3, 3.3, 4.3, 5.3, 6.3, 7.3],
                                [0.2, 1.2, 2.2, 3.2, 4.2, 5.2, 6.2, 7.2])
 
+  def testCollectiveReduceCompressed(self):
+    for compression in ('fp16', 'bf16', 'int8'):
+      self._testCollectiveReduce([0.1, 1.1, 2.1, 3.1, 4.1, 5.1, 6.1, 7.1],
+                                 [0.3, 1.3, 2.3, 3.3, 4.3, 5.3, 6.3, 7.3],
+                                 [0.2, 1.2, 2.2, 3.2, 4.2, 5.2, 6.2, 7.2],
+                                 compression=compression, tolerance=5e-2)
+
   def _testCollectiveBroadcast(self, t0):
     group_key = 1
     instance_key = 1
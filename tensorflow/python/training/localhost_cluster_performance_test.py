@@ -18,6 +18,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import threading
 import time
 
 import numpy as np
@@ -25,7 +26,11 @@ import numpy as np
 from tensorflow.python.client import session as session_lib
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
+from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import data_flow_ops
 from tensorflow.python.ops import partitioned_variables
+from tensorflow.python.ops import random_ops
+from tensorflow.python.ops import state_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.ops import variables
 from tensorflow.python.platform import test
@@ -113,5 +118,76 @@ class PartitionedVariablesBenchmark(test.Benchmark):
                 "100_parameter_servers_partsize_%d_floats" % partition_size))
 
 
+class SparseGradientAggregationBenchmark(test.Benchmark):
+
+  def _benchmark_sparse_gradient_aggregation(self, num_workers, num_rows, dim):
+    vocab_size = 1000 * 1000
+    workers, _ = test.create_local_cluster(num_workers=num_workers, num_ps=1)
+    worker_sessions = [session_lib.Session(w.target) for w in workers]
+
+    with ops.device("/job:ps/task:0"):
+      var = variables.Variable(
+          array_ops.zeros([vocab_size, dim]), name="embedding")
+      accumulator = data_flow_ops.SparseConditionalAccumulator(
+          dtypes.float32, shape=var.get_shape(), shared_name="accumulator")
+    local_step = array_ops.placeholder(dtypes.int64, shape=[])
+
+    # Each worker sends the PS an unordered gradient with repeated indices,
+    # like the gradient of an embedding lookup.
+    apply_ops = []
+    for i in range(num_workers):
+      with ops.device("/job:worker/task:%d" % i):
+        indices = random_ops.random_uniform(
+            [num_rows], maxval=vocab_size, dtype=dtypes.int64)
+        values = random_ops.random_normal([num_rows, dim])
+        apply_ops.append(
+            accumulator.apply_grad(indices, values, local_step=local_step))
+
+    # The chief applies the aggregated gradient once per window.
+    with ops.device("/job:ps/task:0"):
+      grad = accumulator.take_indexed_slices_grad(num_workers)
+      update = state_ops.scatter_sub(var, grad.indices, grad.values)
+
+    worker_sessions[0].run(var.initializer)
+
+    def run_step(step):
+      threads = [
+          threading.Thread(
+              target=sess.run, args=(apply_op,), kwargs={
+                  "feed_dict": {local_step: step}
+              })
+          for sess, apply_op in zip(worker_sessions, apply_ops)
+      ]
+      for thread in threads:
+        thread.start()
+      worker_sessions[0].run(update.op)
+      for thread in threads:
+        thread.join()
+
+    run_step(0)
+    deltas = []
+    iters = 20
+    for step in range(1, iters + 1):
+      start_time = time.time()
+      run_step(step)
+      deltas.append(time.time() - start_time)
+
+    median_deltas = np.median(deltas)
+    name = "sparse_gradient_aggregation_%d_workers_%d_rows_%d_dim" % (
+        num_workers, num_rows, dim)
+    self.report_benchmark(
+        iters=iters,
+        wall_time=median_deltas,
+        name=name,
+        extras={"rows_per_second": num_workers * num_rows / median_deltas})
+
+  def benchmark_sparse_gradient_aggregation(self):
+    for num_workers in (2, 8):
+      for num_rows in (1000, 100 * 1000):
+        with ops.Graph().as_default():
+          self._benchmark_sparse_gradient_aggregation(
+              num_workers, num_rows, dim=64)
+
+
 if __name__ == "__main__":
   test.main()
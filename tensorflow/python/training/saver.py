@@ -39,6 +39,7 @@ from tensorflow.python.client import session
 from tensorflow.python.eager import context
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import device as pydev
+from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors
 from tensorflow.python.framework import meta_graph
 from tensorflow.python.framework import ops
@@ -46,6 +47,7 @@ from tensorflow.python.lib.io import file_io
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
 from tensorflow.python.ops import gen_io_ops
+from tensorflow.python.ops import gen_resource_variable_ops
 from tensorflow.python.ops import io_ops
 from tensorflow.python.ops import resource_variable_ops
 from tensorflow.python.ops import state_ops
@@ -832,6 +834,97 @@ class BulkSaverBuilder(BaseSaverBuilder):
       return io_ops.restore_v2(filename_tensor, names, slices, dtypes)
 
 
+class DeltaSaverBuilder(BulkSaverBuilder):
+  """SaverBuilder that can write delta checkpoints.
+
+  A delta checkpoint only holds the rows (slices along dimension 0) of each
+  resource variable that were written since the previous checkpoint, which it
+  refers to.  Other saveables are saved in full.  The checkpoints it writes
+  are restored with `RestoreDeltaV2`, which follows the chain of bases.
+
+  The rows written to a variable are tracked by the variable itself, so at most
+  one such builder should save each variable.
+  """
+
+  def __init__(self, write_version=saver_pb2.SaverDef.V2):
+    if write_version != saver_pb2.SaverDef.V2:
+      raise ValueError("Delta checkpoints require the V2 checkpoint format.")
+    super(DeltaSaverBuilder, self).__init__(write_version)
+    self._delta_base_tensor = None
+
+  def save_op(self, filename_tensor, saveables):
+    """Create an Op to save 'saveables', relative to a fed base checkpoint.
+
+    Args:
+      filename_tensor: String Tensor.
+      saveables: A list of BaseSaverBuilder.SaveableObject objects.
+
+    Returns:
+      An Operation that save the variables.
+    """
+    # Feeding an empty base writes a full checkpoint.
+    self._delta_base_tensor = constant_op.constant("", name="delta_base")
+    tensor_names = []
+    tensors = []
+    tensor_slices = []
+    rows_known = []
+    changed_rows = []
+    for saveable in saveables:
+      for spec in saveable.specs:
+        tensor_names.append(spec.name)
+        tensor_slices.append(spec.slice_spec)
+        if isinstance(saveable, BaseSaverBuilder.ResourceVariableSaveable):
+          # pylint: disable=protected-access
+          with ops.device(saveable._var_device):
+            known, rows = gen_resource_variable_ops.take_variable_dirty_rows(
+                saveable.handle_op)
+            # Reads the value after taking the written rows, so that rows
+            # written in between are saved again by the next checkpoint.
+            with ops.control_dependencies([known]):
+              value = gen_resource_variable_ops.read_variable_op(
+                  saveable.handle_op, spec.dtype)
+          # pylint: enable=protected-access
+          with ops.device("/device:CPU:0"):
+            tensors.append(array_ops.identity(value))
+          rows_known.append(known)
+          changed_rows.append(rows)
+        else:
+          tensors.append(spec.tensor)
+          rows_known.append(constant_op.constant(False))
+          changed_rows.append(constant_op.constant([], dtype=dtypes.int64))
+    return io_ops.save_delta_v2(filename_tensor, self._delta_base_tensor,
+                                tensor_names, tensor_slices, tensors,
+                                array_ops.stack(rows_known), changed_rows)
+
+  def bulk_restore(self, filename_tensor, saveables, preferred_shard,
+                   restore_sequentially):
+
+    # Ignored: bulk restore is internally sequential.
+    del restore_sequentially
+    restore_specs = []
+    for saveable in saveables:
+      for spec in saveable.specs:
+        restore_specs.append((spec.name, spec.slice_spec, spec.dtype))
+
+    names, slices, dtypes_list = zip(*restore_specs)
+    # Load all tensors onto CPU 0 for compatibility with existing code.
+    with ops.device("cpu:0"):
+      return io_ops.restore_delta_v2(filename_tensor, names, slices,
+                                     dtypes_list)
+
+  def _build_internal(self, names_to_saveables, sharded=False, **kwargs):
+    """build() that also records the tensor to feed the base checkpoint in."""
+    if sharded:
+      raise ValueError("Delta checkpoints cannot be sharded.")
+    if context.executing_eagerly():
+      raise ValueError("Delta checkpoints are not supported when eager "
+                       "execution is enabled.")
+    saver_def = super(DeltaSaverBuilder, self)._build_internal(
+        names_to_saveables, sharded=sharded, **kwargs)
+    saver_def.delta_base_tensor_name = self._delta_base_tensor.name
+    return saver_def
+
+
 def _get_saver_or_default():
   """Returns the saver from SAVERS collection, or creates a default one.
 
@@ -1145,6 +1238,25 @@ class Saver(object):
 
   If you create several savers, you can specify a different filename for the
   protocol buffer file in the call to `save()`.
+
+  Savers of models with large, sparsely updated resource variables (e.g.
+  embeddings) can write *delta checkpoints* by passing `delta_checkpoints` to
+  the constructor.  After each full checkpoint, that many checkpoints only hold
+  the rows of those variables written since the previous checkpoint, and name
+  it as their base:
+
+  ```python
+  saver = tf.train.Saver(delta_checkpoints=9)
+  saver.save(sess, 'my-model', global_step=0) ==> full
+  saver.save(sess, 'my-model', global_step=1000) ==> delta of 'my-model-0'
+  ...
+  saver.save(sess, 'my-model', global_step=10000) ==> full
+  ```
+
+  Such checkpoints must be restored by a `Saver` created with
+  `delta_checkpoints`, which reads the whole chain of bases, and the saver
+  keeps the bases of the checkpoints it keeps.  The rows are tracked by the
+  variables, so only one such saver should save each variable.
   """
 
   def __init__(self,
@@ -1162,7 +1274,8 @@ class Saver(object):
                write_version=saver_pb2.SaverDef.V2,
                pad_step_number=False,
                save_relative_paths=False,
-               filename=None):
+               filename=None,
+               delta_checkpoints=0):
     """Creates a `Saver`.
 
     The constructor adds ops to save and restore variables.
@@ -1220,7 +1333,8 @@ class Saver(object):
         The `saver_def` proto should be the one returned by the
         `as_saver_def()` call of the `Saver` that was created for that `Graph`.
       builder: Optional `SaverBuilder` to use if a `saver_def` was not provided.
-        Defaults to `BulkSaverBuilder()`.
+        Defaults to `BulkSaverBuilder()`, or `DeltaSaverBuilder()` if
+        `delta_checkpoints` is positive.
       defer_build: If `True`, defer adding the save and restore ops to the
         `build()` call. In that case `build()` should be called before
         finalizing the graph or using the saver.
@@ -1240,10 +1354,15 @@ class Saver(object):
         checkpoint directory and reload from the copied directory.
       filename: If known at graph construction time, filename used for variable
         loading/saving.
+      delta_checkpoints: Number of delta checkpoints to write after each full
+        checkpoint.  Defaults to 0, which only writes full checkpoints.
+        Requires the V2 format and is not supported with `sharded` or when
+        eager execution is enabled.
 
     Raises:
       TypeError: If `var_list` is invalid.
-      ValueError: If any of the keys or values in `var_list` are not unique.
+      ValueError: If any of the keys or values in `var_list` are not unique, or
+        if `delta_checkpoints` is used with `sharded` or the V1 format.
       RuntimeError: If eager execution is enabled and`var_list` does not specify
         a list of varialbes to save.
 
@@ -1260,6 +1379,12 @@ class Saver(object):
       raise RuntimeError(
           "When eager execution is enabled, `var_list` must specify a list or "
           "dict of variables to save")
+    if delta_checkpoints:
+      if sharded or write_version != saver_pb2.SaverDef.V2:
+        raise ValueError("Delta checkpoints require unsharded V2 checkpoints.")
+      if context.executing_eagerly():
+        raise ValueError("Delta checkpoints are not supported when eager "
+                         "execution is enabled.")
     self._var_list = var_list
     self._reshape = reshape
     self._sharded = sharded
@@ -1275,8 +1400,17 @@ class Saver(object):
     self._write_version = write_version
     self._pad_step_number = pad_step_number
     self._filename = filename
+    self._delta_checkpoints = delta_checkpoints
     self._last_checkpoints = []
     self._checkpoints_to_be_deleted = []
+    # The full checkpoint and the deltas written on top of it since.
+    self._delta_chain = []
+    # Base of each checkpoint written by this saver, "" for full ones.
+    self._delta_bases = {}
+    # Checkpoints kept every N hours, and the ones that are due for deletion
+    # but still the base of a kept checkpoint.
+    self._kept_checkpoints = []
+    self._checkpoints_kept_as_bases = []
     if context.executing_eagerly():
       self._next_checkpoint_time = (
           time.time() + self._keep_checkpoint_every_n_hours * 3600)
@@ -1308,7 +1442,10 @@ class Saver(object):
 
     if not self.saver_def or context.executing_eagerly():
       if self._builder is None:
-        self._builder = BulkSaverBuilder(self._write_version)
+        if self._delta_checkpoints:
+          self._builder = DeltaSaverBuilder(self._write_version)
+        else:
+          self._builder = BulkSaverBuilder(self._write_version)
 
       if self._var_list is None:
         # pylint: disable=protected-access
@@ -1341,6 +1478,9 @@ class Saver(object):
           self.saver_def.save_tensor_name, self._name)
       self.saver_def.restore_op_name = ops.prepend_name_scope(
           self.saver_def.restore_op_name, self._name)
+      if self.saver_def.delta_base_tensor_name:
+        self.saver_def.delta_base_tensor_name = ops.prepend_name_scope(
+            self.saver_def.delta_base_tensor_name, self._name)
 
     self._check_saver_def()
     if not context.executing_eagerly():
@@ -1415,9 +1555,13 @@ class Saver(object):
     kept for every 0.5 hours of training; if `N` is 10, an additional
     checkpoint is kept for every 10 hours of training.
 
+    Checkpoints that are the base of a kept delta checkpoint are only deleted
+    once no kept checkpoint needs them anymore.
+
     Args:
       meta_graph_suffix: Suffix for `MetaGraphDef` file. Defaults to 'meta'.
     """
+    to_delete = []
     if self._checkpoints_to_be_deleted:
       p = self._checkpoints_to_be_deleted.pop(0)
       # Do not delete the file if we keep_checkpoint_every_n_hours is set and we
@@ -1426,23 +1570,50 @@ class Saver(object):
       if should_keep:
         self._next_checkpoint_time += (
             self.saver_def.keep_checkpoint_every_n_hours * 3600)
-        return
-
-      # Otherwise delete the files.
-      try:
-        checkpoint_prefix = self._CheckpointFilename(p)
-        self._delete_file_if_exists(
-            self._MetaGraphFilename(checkpoint_prefix, meta_graph_suffix))
-        if self.saver_def.version == saver_pb2.SaverDef.V2:
-          # V2 has a metadata file and some data files.
-          self._delete_file_if_exists(checkpoint_prefix + ".index")
-          self._delete_file_if_exists(checkpoint_prefix +
-                                      ".data-?????-of-?????")
-        else:
-          # V1, Legacy.  Exact match on the data file.
-          self._delete_file_if_exists(checkpoint_prefix)
-      except Exception as e:  # pylint: disable=broad-except
-        logging.warning("Ignoring: %s", str(e))
+        if self._delta_bases:
+          self._kept_checkpoints.append(p)
+      else:
+        to_delete.append(p)
+    if self._delta_bases:
+      to_delete = self._checkpoints_kept_as_bases + to_delete
+      bases = self._DeltaBasesOf(self._last_checkpoints +
+                                 self._kept_checkpoints)
+      self._checkpoints_kept_as_bases = [
+          p for p in to_delete if self._CheckpointFilename(p) in bases]
+      to_delete = [
+          p for p in to_delete if self._CheckpointFilename(p) not in bases]
+      for p in to_delete:
+        self._delta_bases.pop(self._CheckpointFilename(p), None)
+
+    for p in to_delete:
+      self._DeleteCheckpoint(p, meta_graph_suffix)
+
+  def _DeltaBasesOf(self, checkpoints):
+    """Returns the prefixes of all bases of the given checkpoints."""
+    bases = set()
+    for p in checkpoints:
+      base = self._delta_bases.get(self._CheckpointFilename(p))
+      while base and base not in bases:
+        bases.add(base)
+        base = self._delta_bases.get(base)
+    return bases
+
+  def _DeleteCheckpoint(self, p, meta_graph_suffix):
+    """Deletes the files of a `(filename, time)` checkpoint."""
+    try:
+      checkpoint_prefix = self._CheckpointFilename(p)
+      self._delete_file_if_exists(
+          self._MetaGraphFilename(checkpoint_prefix, meta_graph_suffix))
+      if self.saver_def.version == saver_pb2.SaverDef.V2:
+        # V2 has a metadata file and some data files.
+        self._delete_file_if_exists(checkpoint_prefix + ".index")
+        self._delete_file_if_exists(checkpoint_prefix +
+                                    ".data-?????-of-?????")
+      else:
+        # V1, Legacy.  Exact match on the data file.
+        self._delete_file_if_exists(checkpoint_prefix)
+    except Exception as e:  # pylint: disable=broad-except
+      logging.warning("Ignoring: %s", str(e))
 
   def _delete_file_if_exists(self, filespec):
     for pathname in file_io.get_matching_files(filespec):
@@ -1481,6 +1652,9 @@ class Saver(object):
         saver_def.save_tensor_name, export_scope)
     saver_def.restore_op_name = ops.strip_name_scope(
         saver_def.restore_op_name, export_scope)
+    if saver_def.delta_base_tensor_name:
+      saver_def.delta_base_tensor_name = ops.strip_name_scope(
+          saver_def.delta_base_tensor_name, export_scope)
     return saver_def
 
   @staticmethod
@@ -1646,6 +1820,18 @@ class Saver(object):
           self._build_eager(
               checkpoint_file, build_save=True, build_restore=False)
           model_checkpoint_path = self.saver_def.save_tensor_name
+        elif self._delta_checkpoints and self.saver_def.delta_base_tensor_name:
+          base = self._NextDeltaBase(checkpoint_file)
+          # The rows written since the base are consumed by the save, so a
+          # failed save starts the next chain with a full checkpoint.
+          delta_chain = self._delta_chain
+          self._delta_chain = []
+          model_checkpoint_path = sess.run(
+              self.saver_def.save_tensor_name,
+              {self.saver_def.filename_tensor_name: checkpoint_file,
+               self.saver_def.delta_base_tensor_name: base})
+          self._delta_chain = (delta_chain if base else []) + [checkpoint_file]
+          self._delta_bases[checkpoint_file] = base
         else:
           model_checkpoint_path = sess.run(
               self.saver_def.save_tensor_name,
@@ -1681,6 +1867,16 @@ class Saver(object):
     else:
       return model_checkpoint_path
 
+  def _NextDeltaBase(self, checkpoint_file):
+    """Returns the base of the next checkpoint, or "" to write a full one."""
+    if (not self._delta_chain or
+        len(self._delta_chain) > self._delta_checkpoints or
+        checkpoint_file in self._delta_chain or
+        os.path.dirname(checkpoint_file) != os.path.dirname(
+            self._delta_chain[-1])):
+      return ""
+    return self._delta_chain[-1]
+
   def export_meta_graph(self,
                         filename=None,
                         collection_list=None,
@@ -1447,6 +1447,79 @@ class KeepCheckpointEveryNHoursTest(test.TestCase):
       self.assertTrue(saver_module.checkpoint_exists(s4))
 
 
+class DeltaCheckpointTest(test.TestCase):
+
+  def _get_test_dir(self, dirname):
+    test_dir = os.path.join(self.get_temp_dir(), dirname)
+    gfile.MakeDirs(test_dir)
+    return test_dir
+
+  def _data_size(self, prefix):
+    return os.path.getsize(prefix + ".data-00000-of-00001")
+
+  def testDeltaChains(self):
+    save_dir = self._get_test_dir("delta_chains")
+    save_path = os.path.join(save_dir, "delta")
+
+    with self.test_session(graph=ops_lib.Graph()) as sess:
+      emb = resource_variable_ops.ResourceVariable(
+          array_ops.zeros([1000, 10]), name="emb")
+      w = variables.Variable(1.0, name="w")
+      save = saver_module.Saver(
+          {"emb": emb, "w": w}, max_to_keep=2, delta_checkpoints=2)
+      self.evaluate(variables.global_variables_initializer())
+
+      def update(row, value):
+        self.evaluate(resource_variable_ops.resource_scatter_update(
+            emb.handle, [row], array_ops.fill([1, 10], value)))
+
+      s0 = save.save(sess, save_path, global_step=0)
+      update(3, 1.0)
+      s1 = save.save(sess, save_path, global_step=1)
+      update(7, 2.0)
+      s2 = save.save(sess, save_path, global_step=2)
+      # The deltas only hold the written row of "emb".
+      self.assertLess(self._data_size(s1) * 10, self._data_size(s0))
+      self.assertLess(self._data_size(s2) * 10, self._data_size(s0))
+
+      # The chain is full, so this one is a full checkpoint again.
+      update(3, 4.0)
+      s3 = save.save(sess, save_path, global_step=3)
+      self.assertEqual(self._data_size(s0), self._data_size(s3))
+      self.assertEqual([s2, s3], save.last_checkpoints)
+      # s2 is kept, so its bases are kept too.
+      self.assertTrue(saver_module.checkpoint_exists(s0))
+      self.assertTrue(saver_module.checkpoint_exists(s1))
+
+      self.evaluate(variables.global_variables_initializer())
+      save.restore(sess, s2)
+      expected = np.zeros([1000, 10], dtype=np.float32)
+      expected[3] = 1.0
+      expected[7] = 2.0
+      self.assertAllEqual(expected, self.evaluate(emb))
+      self.assertEqual(1.0, self.evaluate(w))
+
+      # Restoring writes all rows, so the next delta holds all of them.
+      s4 = save.save(sess, save_path, global_step=4)
+      self.assertEqual([s3, s4], save.last_checkpoints)
+      self.assertFalse(saver_module.checkpoint_exists(s0))
+      self.assertFalse(saver_module.checkpoint_exists(s1))
+      self.assertFalse(saver_module.checkpoint_exists(s2))
+
+      self.evaluate(variables.global_variables_initializer())
+      save.restore(sess, s4)
+      self.assertAllEqual(expected, self.evaluate(emb))
+
+  def testUnsupported(self):
+    with ops_lib.Graph().as_default():
+      v = resource_variable_ops.ResourceVariable(1.0, name="v")
+      with self.assertRaisesRegexp(ValueError, "unsharded V2"):
+        saver_module.Saver([v], sharded=True, delta_checkpoints=1)
+      with self.assertRaisesRegexp(ValueError, "unsharded V2"):
+        saver_module.Saver(
+            [v], write_version=saver_pb2.SaverDef.V1, delta_checkpoints=1)
+
+
 class SaveRestoreWithVariableNameMap(test.TestCase):
 
   def _testNonReshape(self, variable_op):